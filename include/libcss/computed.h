@@ -139,6 +139,83 @@ typedef struct css_computed_image {
   } data;
 } css_computed_image;
 
+/**
+ * Classes of change reported by css_computed_style_diff
+ */
+typedef enum css_computed_change {
+	CSS_COMPUTED_CHANGE_NONE	= 0,
+	CSS_COMPUTED_CHANGE_LAYOUT	= (1 << 0), /**< Box geometry */
+	CSS_COMPUTED_CHANGE_PAINT	= (1 << 1), /**< Rendering only */
+	CSS_COMPUTED_CHANGE_TEXT	= (1 << 2), /**< Text/generated content */
+	CSS_COMPUTED_CHANGE_INHERITED	= (1 << 3)  /**< Inherited property */
+} css_computed_change;
+
+/**
+ * A computed length, as consumed by box layout
+ */
+typedef struct css_computed_layout_length {
+	css_fixed value;	/**< Length, if type has one */
+	css_unit unit;		/**< Units of value */
+	uint8_t type;		/**< Property-specific type, e.g. CSS_WIDTH_AUTO */
+} css_computed_layout_length;
+
+/**
+ * Snapshot of the layout-relevant properties of a computed style
+ *
+ * Values are as returned by the corresponding css_computed_* accessors.
+ * Box edges are indexed top, right, bottom, left.
+ */
+typedef struct css_computed_layout {
+	css_computed_layout_length width;
+	css_computed_layout_length height;
+	css_computed_layout_length min_width;
+	css_computed_layout_length min_height;
+	css_computed_layout_length max_width;
+	css_computed_layout_length max_height;
+
+	css_computed_layout_length offset[4];	/**< top, right, bottom, left */
+	css_computed_layout_length margin[4];
+	css_computed_layout_length padding[4];
+	css_computed_layout_length border_width[4];
+
+	int32_t flex_grow;
+	int32_t flex_shrink;
+	int32_t flex_basis;
+
+	uint8_t flex_grow_type;
+	uint8_t flex_shrink_type;
+	uint8_t flex_basis_type;
+	uint8_t flex_direction;
+	uint8_t flex_wrap;
+	uint8_t justify_content;
+	uint8_t align_content;
+	uint8_t align_items;
+	uint8_t align_self;
+
+	uint8_t border_style[4];
+
+	uint8_t display;
+	uint8_t position;
+	uint8_t floating;
+	uint8_t clear;
+	uint8_t overflow_x;
+	uint8_t overflow_y;
+	uint8_t direction;
+	uint8_t writing_mode;
+} css_computed_layout;
+
+/**
+ * Computed style allocation statistics
+ *
+ * Covers computed styles and their fixed-size extension blocks.
+ */
+typedef struct css_computed_alloc_stats {
+	uint64_t allocs;	/**< Blocks allocated, in total */
+	uint64_t frees;		/**< Blocks freed, in total */
+	uint32_t slabs;		/**< Slabs currently held */
+	size_t slab_bytes;	/**< Memory currently held in slabs */
+} css_computed_alloc_stats;
+
 css_error css_computed_style_destroy(css_computed_style *style);
 
 css_error css_computed_style_compose(
@@ -150,6 +227,24 @@ css_error css_computed_style_compose(
 		void *pw,
 		css_computed_style **result);
 
+css_error css_computed_style_diff(
+		const css_computed_style *old_style,
+		const css_computed_style *new_style,
+		uint32_t *changes);
+
+css_error css_computed_layout_snapshot(
+		const css_computed_style *style,
+		bool root,
+		css_computed_layout *layout);
+
+css_error css_computed_layout_snapshot_batch(
+		const css_computed_style *const *styles,
+		size_t n_styles,
+		css_computed_layout *layouts);
+
+css_error css_computed_style_alloc_stats(css_computed_alloc_stats *stats);
+css_error css_computed_style_pool_trim(void);
+
 /******************************************************************************
  * Property accessors below here                                              *
  ******************************************************************************/
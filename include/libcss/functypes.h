@@ -17,8 +17,23 @@ extern "C"
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <libcss/errors.h>
 #include <libcss/types.h>
 
+/**
+ * Type of allocation function for libcss
+ *
+ * The semantics of this function are the same as for realloc().
+ *
+ * \param ptr   Pointer to object to reallocate, or NULL for a new allocation
+ * \param size  Required length in bytes, or zero to free ::ptr
+ * \param pw    Pointer to client data
+ * \return Pointer to allocated object, or NULL on failure
+ */
+typedef void *(*css_allocator_fn)(void *ptr, size_t size, void *pw);
+
+css_error css_allocator_set(css_allocator_fn alloc, void *pw);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,21 @@ typedef enum css_pseudo_element {
 	CSS_PSEUDO_ELEMENT_COUNT	= 5	/**< Number of pseudo elements */
 } css_pseudo_element;
 
+/**
+ * Masks of pseudo elements, for selecting the styles of only some of them
+ */
+typedef enum css_pseudo_element_mask {
+	CSS_PSEUDO_ELEMENT_MASK_FIRST_LINE   = (1 << CSS_PSEUDO_ELEMENT_FIRST_LINE),
+	CSS_PSEUDO_ELEMENT_MASK_FIRST_LETTER = (1 << CSS_PSEUDO_ELEMENT_FIRST_LETTER),
+	CSS_PSEUDO_ELEMENT_MASK_BEFORE       = (1 << CSS_PSEUDO_ELEMENT_BEFORE),
+	CSS_PSEUDO_ELEMENT_MASK_AFTER        = (1 << CSS_PSEUDO_ELEMENT_AFTER),
+
+	CSS_PSEUDO_ELEMENT_MASK_ALL = (CSS_PSEUDO_ELEMENT_MASK_FIRST_LINE |
+			CSS_PSEUDO_ELEMENT_MASK_FIRST_LETTER |
+			CSS_PSEUDO_ELEMENT_MASK_BEFORE |
+			CSS_PSEUDO_ELEMENT_MASK_AFTER)
+} css_pseudo_element_mask;
+
 /**
  * Style selection result set
  */
@@ -224,6 +239,15 @@ css_error css_select_style(css_select_ctx *ctx, void *node,
 		uint64_t media, const css_stylesheet *inline_style,
 		css_select_handler *handler, void *pw,
 		css_select_results **result);
+css_error css_select_style_pseudo_elements(css_select_ctx *ctx, void *node,
+		uint64_t media, const css_stylesheet *inline_style,
+		uint32_t pseudo_elements,
+		css_select_handler *handler, void *pw,
+		css_select_results **result);
+css_error css_select_pseudo_element(css_select_ctx *ctx, void *node,
+		uint64_t media, css_pseudo_element pseudo_element,
+		css_select_handler *handler, void *pw,
+		css_computed_style **style);
 css_error css_select_results_destroy(css_select_results *results);    
 
 css_error css_select_font_faces(css_select_ctx *ctx,
@@ -138,11 +138,30 @@ typedef struct css_stylesheet_params {
 
 css_error css_stylesheet_create(const css_stylesheet_params *params,
 		css_stylesheet **stylesheet);
+css_error css_stylesheet_create_from_buffer(
+		const css_stylesheet_params *params,
+		const uint8_t *data, size_t len,
+		css_stylesheet **stylesheet);
+css_error css_stylesheet_create_parallel(
+		const css_stylesheet_params *params,
+		const uint8_t *data, size_t len, uint32_t n_threads,
+		css_stylesheet **stylesheet);
+css_error css_stylesheet_create_shared(const css_stylesheet_params *params,
+		const uint8_t *data, size_t len,
+		css_stylesheet **stylesheet);
+css_error css_stylesheet_create_inline(const css_stylesheet_params *params,
+		const uint8_t *data, size_t len,
+		css_stylesheet **stylesheet);
+css_error css_stylesheet_cache_flush(void);
+css_error css_stylesheet_load_compiled(const css_stylesheet_params *params,
+		const uint8_t *data, size_t len,
+		css_stylesheet **stylesheet);
 css_error css_stylesheet_destroy(css_stylesheet *sheet);
 
 css_error css_stylesheet_append_data(css_stylesheet *sheet,
 		const uint8_t *data, size_t len);
 css_error css_stylesheet_data_done(css_stylesheet *sheet);
+css_error css_stylesheet_optimise(css_stylesheet *sheet);
 
 css_error css_stylesheet_next_pending_import(css_stylesheet *parent,
 		lwc_string **url, uint64_t *media);
@@ -161,6 +180,9 @@ css_error css_stylesheet_set_disabled(css_stylesheet *sheet, bool disabled);
 
 css_error css_stylesheet_size(css_stylesheet *sheet, size_t *size);
 
+css_error css_stylesheet_serialise(css_stylesheet *sheet,
+		uint8_t *data, size_t *len);
+
 #ifdef __cplusplus
 }
 #endif
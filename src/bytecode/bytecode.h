@@ -55,6 +55,9 @@ typedef enum shape {
 	SHAPE_RECT = 0
 } shape;
 
+/** Number of words in a bitmap with a bit for each property */
+#define CSS_PROP_BITMAP_WORDS	((CSS_N_PROPERTIES + 31) / 32)
+
 static inline css_code_t buildOPV(opcode_t opcode, uint8_t flags, uint16_t value)
 {
 	return (opcode & 0x3ff) | (flags << 10) | ((value & 0x3fff) << 18);
@@ -33,6 +33,7 @@
 #include <libcss/errors.h>
 
 #include "lex/lex.h"
+#include "utils/alloc.h"
 #include "utils/parserutilserror.h"
 #include "utils/utils.h"
 
@@ -161,6 +162,57 @@ static inline bool startNMStart(uint8_t c);
 static inline bool startStringChar(uint8_t c);
 static inline bool startURLChar(uint8_t c);
 static inline bool isSpace(uint8_t c);
+static inline size_t scanRun(css_lexer *lexer, uint8_t cls,
+		const uint8_t **run);
+
+/* Character classes */
+#define CHAR_NMSTART	0x01	/**< nmstart, or '\\' */
+#define CHAR_NMCHAR	0x02	/**< nmchar, or '\\' */
+#define CHAR_URLCHAR	0x04	/**< urlchar, or '\\' */
+#define CHAR_STRINGCHAR	0x08	/**< stringchar, or '\\' */
+#define CHAR_SPACE	0x10	/**< wc */
+#define CHAR_BLANK	0x20	/**< wc, excluding newlines */
+#define CHAR_COMMENT	0x40	/**< ASCII other than '*', '/' and newlines */
+#define CHAR_ESCAPE	0x80	/**< '\\' */
+
+/**
+ * Classes of each input byte. Bytes >= 0x80 are assumed to be part of a
+ * nonascii character.
+ */
+static const uint8_t charClass[256] = {
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,	/* 00 - 07 */
+	0x40, 0x7c, 0x10, 0x40, 0x10, 0x10, 0x40, 0x40,	/* 08 - 0f */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,	/* 10 - 17 */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,	/* 18 - 1f */
+	0x78, 0x4c, 0x40, 0x4c, 0x4c, 0x4c, 0x4c, 0x40,	/* 20 - 27 */
+	0x4c, 0x48, 0x0c, 0x4c, 0x4c, 0x4e, 0x4c, 0x0c,	/* 28 - 2f */
+	0x4e, 0x4e, 0x4e, 0x4e, 0x4e, 0x4e, 0x4e, 0x4e,	/* 30 - 37 */
+	0x4e, 0x4e, 0x4c, 0x4c, 0x4c, 0x4c, 0x4c, 0x4c,	/* 38 - 3f */
+	0x4c, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f,	/* 40 - 47 */
+	0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f,	/* 48 - 4f */
+	0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f,	/* 50 - 57 */
+	0x4f, 0x4f, 0x4f, 0x4c, 0xcf, 0x4c, 0x4c, 0x4f,	/* 58 - 5f */
+	0x4c, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f,	/* 60 - 67 */
+	0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f,	/* 68 - 6f */
+	0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f,	/* 70 - 77 */
+	0x4f, 0x4f, 0x4f, 0x4c, 0x4c, 0x4c, 0x4c, 0x40,	/* 78 - 7f */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* 80 - 87 */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* 88 - 8f */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* 90 - 97 */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* 98 - 9f */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* a0 - a7 */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* a8 - af */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* b0 - b7 */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* b8 - bf */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* c0 - c7 */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* c8 - cf */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* d0 - d7 */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* d8 - df */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* e0 - e7 */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* e8 - ef */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* f0 - f7 */
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,	/* f8 - ff */
+};
 
 /**
  * Create a lexer instance
@@ -178,7 +230,7 @@ css_error css__lexer_create(parserutils_inputstream *input, css_lexer **lexer)
 	if (input == NULL || lexer == NULL)
 		return CSS_BADPARM;
 
-	lex = malloc(sizeof(css_lexer));
+	lex = css__malloc(sizeof(css_lexer));
 	if (lex == NULL)
 		return CSS_NOMEM;
 
@@ -214,7 +266,7 @@ css_error css__lexer_destroy(css_lexer *lexer)
 	if (lexer->unescapedTokenData != NULL)
 		parserutils_buffer_destroy(lexer->unescapedTokenData);
 
-	free(lexer);
+	css__free(lexer);
 
 	return CSS_OK;
 }
@@ -294,7 +346,7 @@ css_error css__lexer_get_token(css_lexer *lexer, css_token **token)
 	case sMATCH:
 		return Match(lexer, token);
 	case sURI:
-		return URI(lexer, token);
+		return URIOrUnicodeRangeOrIdentOrFunction(lexer, token);
 	case sIDENT:
 		return IdentOrFunction(lexer, token);
 	case sESCAPEDIDENT:
@@ -768,7 +820,7 @@ css_error Comment(css_lexer *lexer, css_token **token)
 {
 	const uint8_t *cptr;
 	uint8_t c;
-	size_t clen;
+	size_t clen, run;
 	parserutils_error perror;
 	enum { Initial = 0, InComment = 1 };
 
@@ -798,6 +850,14 @@ css_error Comment(css_lexer *lexer, css_token **token)
 		lexer->substate = InComment;
 
 		while (1) {
+			if (lexer->context.lastWasCR == false) {
+				run = scanRun(lexer, CHAR_COMMENT, &cptr);
+				if (run > 0) {
+					APPEND(lexer, cptr, run);
+					lexer->context.lastWasStar = false;
+				}
+			}
+
 			perror = parserutils_inputstream_peek(lexer->input,
 					lexer->bytesReadForToken, &cptr, &clen);
 			if (perror != PARSERUTILS_OK && 
@@ -1792,13 +1852,18 @@ css_error consumeNMChars(css_lexer *lexer)
 {
 	const uint8_t *cptr;
 	uint8_t c;
-	size_t clen;
+	size_t clen, run;
 	css_error error;
 	parserutils_error perror;
 
 	/* nmchar = [a-zA-Z] | '-' | '_' | nonascii | escape */
 
 	do {
+		/* Consume any run of plain characters in one go */
+		run = scanRun(lexer, CHAR_NMCHAR, &cptr);
+		if (run > 0)
+			APPEND(lexer, cptr, run);
+
 		perror = parserutils_inputstream_peek(lexer->input, 
 				lexer->bytesReadForToken, &cptr, &clen);
 		if (perror != PARSERUTILS_OK && perror != PARSERUTILS_EOF)
@@ -1887,13 +1952,18 @@ css_error consumeStringChars(css_lexer *lexer)
 {
 	const uint8_t *cptr;
 	uint8_t c;
-	size_t clen;
+	size_t clen, run;
 	css_error error;
 	parserutils_error perror;
 
 	/* stringchar = urlchar | ' ' | ')' | '\' nl */
 
 	do {
+		/* Consume any run of plain characters in one go */
+		run = scanRun(lexer, CHAR_STRINGCHAR, &cptr);
+		if (run > 0)
+			APPEND(lexer, cptr, run);
+
 		perror = parserutils_inputstream_peek(lexer->input,
 				lexer->bytesReadForToken, &cptr, &clen);
 		if (perror != PARSERUTILS_OK && perror != PARSERUTILS_EOF)
@@ -2060,13 +2130,18 @@ css_error consumeURLChars(css_lexer *lexer)
 {
 	const uint8_t *cptr;
 	uint8_t c;
-	size_t clen;
+	size_t clen, run;
 	css_error error;
 	parserutils_error perror;
 
 	/* urlchar = [\t!#-&(*-~] | nonascii | escape */
 
 	do {
+		/* Consume any run of plain characters in one go */
+		run = scanRun(lexer, CHAR_URLCHAR, &cptr);
+		if (run > 0)
+			APPEND(lexer, cptr, run);
+
 		perror = parserutils_inputstream_peek(lexer->input, 
 				lexer->bytesReadForToken, &cptr, &clen);
 		if (perror != PARSERUTILS_OK && perror != PARSERUTILS_EOF)
@@ -2111,10 +2186,16 @@ css_error consumeWChars(css_lexer *lexer)
 {
 	const uint8_t *cptr;
 	uint8_t c;
-	size_t clen;
+	size_t clen, run;
 	parserutils_error perror;
 
 	do {
+		if (lexer->context.lastWasCR == false) {
+			run = scanRun(lexer, CHAR_BLANK, &cptr);
+			if (run > 0)
+				APPEND(lexer, cptr, run);
+		}
+
 		perror = parserutils_inputstream_peek(lexer->input, 
 				lexer->bytesReadForToken, &cptr, &clen);
 		if (perror != PARSERUTILS_OK && perror != PARSERUTILS_EOF)
@@ -2155,29 +2236,58 @@ css_error consumeWChars(css_lexer *lexer)
 
 bool startNMChar(uint8_t c)
 {
-	return c == '_' || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || 
-		('0' <= c && c <= '9') || c == '-' || c >= 0x80 || c == '\\';
+	return (charClass[c] & CHAR_NMCHAR) != 0;
 }
 
 bool startNMStart(uint8_t c)
 {
-	return c == '_' || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
-		c >= 0x80 || c == '\\';
+	return (charClass[c] & CHAR_NMSTART) != 0;
 }
 
 bool startStringChar(uint8_t c)
 {
-	return startURLChar(c) || c == ' ' || c == ')';
+	return (charClass[c] & CHAR_STRINGCHAR) != 0;
 }
 
 bool startURLChar(uint8_t c)
 {
-	return c == '\t' || c == '!' || ('#' <= c && c <= '&') || c == '(' ||
-		('*' <= c && c <= '~') || c >= 0x80 || c == '\\';
+	return (charClass[c] & CHAR_URLCHAR) != 0;
 }
 
 bool isSpace(uint8_t c)
 {
-	return c == ' ' || c == '\r' || c == '\n' || c == '\f' || c == '\t';
+	return (charClass[c] & CHAR_SPACE) != 0;
 }
 
+/**
+ * Find the run of input at the current read position which consists only
+ * of ASCII characters in a given class, and contains no escapes.
+ *
+ * The run is found by scanning the inputstream's UTF-8 buffer directly,
+ * so it ends, at the latest, with the data decoded so far.
+ *
+ * \param lexer  The lexer instance
+ * \param cls    Character class of run
+ * \param run    Pointer to location to receive start of run
+ * \return Length of run, in bytes
+ */
+size_t scanRun(css_lexer *lexer, uint8_t cls, const uint8_t **run)
+{
+	const parserutils_buffer *utf8 = lexer->input->utf8;
+	size_t off = lexer->input->cursor + lexer->bytesReadForToken;
+	const uint8_t *ptr, *end;
+
+	if (off >= utf8->length)
+		return 0;
+
+	ptr = utf8->data + off;
+	end = utf8->data + utf8->length;
+
+	*run = ptr;
+
+	while (ptr < end && *ptr < 0x80 &&
+			(charClass[*ptr] & (cls | CHAR_ESCAPE)) == cls)
+		ptr++;
+
+	return ptr - *run;
+}
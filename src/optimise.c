@@ -0,0 +1,538 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *		  http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+
+#include "stylesheet.h"
+#include "bytecode/bytecode.h"
+#include "select/select.h"
+#include "utils/alloc.h"
+#include "utils/utils.h"
+
+/*
+ * Stylesheet optimisation
+ *
+ * css_stylesheet_optimise() rewrites a parsed sheet into a smaller one
+ * with the same cascade:
+ *
+ *   + Declarations overridden by a later declaration of the same property
+ *     in the same style, or in a later rule with identical selectors in
+ *     the same block, are dropped.
+ *
+ *   + A rule whose selectors are identical to those of a later rule in
+ *     the same block is merged into the later rule, provided no rule in
+ *     between sets any of the properties the earlier rule sets.  The
+ *     merged style has the earlier rule's declarations first, so they
+ *     keep their precedence relative to the later rule's.
+ *
+ *   + Rules left with no declarations, which can never affect the cascade,
+ *     are removed from the sheet and its selector hash.
+ *
+ * Unknown pseudo-classes and pseudo-elements make a selector invalid when
+ * it is parsed, so there are no such selectors left to drop here.
+ */
+
+/* Flags for the properties set by later declarations */
+#define OVERRIDE_ANY		(1 << 0)
+#define OVERRIDE_IMPORTANT	(1 << 1)
+
+/** Entry in the table of rules, keyed by their selectors */
+typedef struct rule_entry {
+	css_rule_selector *rule;	/**< Latest rule with selectors */
+	uint32_t seq;			/**< Position of rule in sheet */
+	uint32_t hash;			/**< Hash of rule's selectors */
+} rule_entry;
+
+/**
+ * Hash a selector chain
+ *
+ * \param hash      Hash to continue from
+ * \param selector  Selector chain to hash
+ * \return Updated hash value
+ */
+static uint32_t _selector_hash(uint32_t hash, const css_selector *selector)
+{
+	for (; selector != NULL; selector = selector->combinator) {
+		const css_selector_detail *d = &selector->data;
+
+		hash = (hash ^ selector->specificity) * 0x01000193;
+
+		for (;;) {
+			hash = (hash ^ (d->type | (d->comb << 4))) * 0x01000193;
+			hash = (hash ^ (uint32_t) (uintptr_t) d->qname.name) *
+					0x01000193;
+
+			if (d->next == 0)
+				break;
+			d++;
+		}
+	}
+
+	return hash;
+}
+
+/**
+ * Determine whether two selector chains are identical
+ *
+ * \param a  Selector chain to compare
+ * \param b  Selector chain to compare against
+ * \return true if the chains are identical, false otherwise
+ */
+static bool _selector_equal(const css_selector *a, const css_selector *b)
+{
+	for (; a != NULL && b != NULL; a = a->combinator, b = b->combinator) {
+		const css_selector_detail *da = &a->data;
+		const css_selector_detail *db = &b->data;
+
+		if (a->specificity != b->specificity)
+			return false;
+
+		for (;;) {
+			if (da->type != db->type || da->comb != db->comb ||
+					da->next != db->next ||
+					da->value_type != db->value_type ||
+					da->negate != db->negate ||
+					da->qname.ns != db->qname.ns ||
+					da->qname.name != db->qname.name)
+				return false;
+
+			if (da->value_type == CSS_SELECTOR_DETAIL_VALUE_STRING) {
+				if (da->value.string != db->value.string)
+					return false;
+			} else if (da->value.nth.a != db->value.nth.a ||
+					da->value.nth.b != db->value.nth.b) {
+				return false;
+			}
+
+			if (da->next == 0)
+				break;
+			da++;
+			db++;
+		}
+	}
+
+	return a == NULL && b == NULL;
+}
+
+/**
+ * Determine whether two selector rules have identical selectors
+ *
+ * \param a  Rule to compare
+ * \param b  Rule to compare against
+ * \return true if the rules' selectors are identical, false otherwise
+ */
+static bool _selectors_equal(const css_rule_selector *a,
+		const css_rule_selector *b)
+{
+	uint32_t i;
+
+	if (a->base.items != b->base.items)
+		return false;
+
+	for (i = 0; i < a->base.items; i++) {
+		if (_selector_equal(a->selectors[i], b->selectors[i]) == false)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Drop a style's pre-decoded form, which refers to its bytecode
+ *
+ * \param style  Style to consider
+ */
+static void _drop_decoded(css_style *style)
+{
+	if (style->decoded != NULL) {
+		css__free(style->decoded);
+		style->decoded = NULL;
+	}
+
+	style->cascades = 0;
+}
+
+/**
+ * Find the declarations of a style
+ *
+ * \param style  Style to examine
+ * \param decls  Pointer to location to receive declarations, or NULL if
+ *               the style's bytecode can't be decoded.  The caller must
+ *               free the array.
+ * \param count  Pointer to location to receive number of declarations
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ */
+static css_error _declarations(const css_style *style,
+		css_select_declaration **decls, uint32_t *count)
+{
+	css_error error;
+
+	*decls = css__malloc((style->used > 0 ? style->used : 1) *
+			sizeof(css_select_declaration));
+	if (*decls == NULL)
+		return CSS_NOMEM;
+
+	error = css__select_style_declarations(style, *decls, count);
+	if (error != CSS_OK) {
+		css__free(*decls);
+		*decls = NULL;
+	}
+
+	return error == CSS_NOMEM ? error : CSS_OK;
+}
+
+/**
+ * Note the properties a style sets
+ *
+ * \param style  Style to examine
+ * \param later  Array, indexed by property, to update with OVERRIDE_ANY
+ *               for each property the style sets, and OVERRIDE_IMPORTANT
+ *               for each it sets with an !important declaration
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ *
+ * If the style's bytecode can't be decoded, nothing is noted.
+ */
+static css_error _note_declarations(const css_style *style, uint8_t *later)
+{
+	css_select_declaration *decls;
+	uint32_t n_decls, i;
+	css_error error;
+
+	error = _declarations(style, &decls, &n_decls);
+	if (error != CSS_OK || decls == NULL)
+		return error;
+
+	for (i = 0; i < n_decls; i++) {
+		if (decls[i].reported)
+			later[decls[i].prop] |= decls[i].important ?
+					OVERRIDE_IMPORTANT : OVERRIDE_ANY;
+	}
+
+	css__free(decls);
+
+	return CSS_OK;
+}
+
+/**
+ * Drop the declarations of a style which later ones override
+ *
+ * \param style  Style to process
+ * \param later  Array, indexed by property, of the properties set by
+ *               declarations which follow the style, as produced by
+ *               _note_declarations().  Updated with the style's own.
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ *
+ * A declaration is overridden by a later declaration of the same property
+ * if the later one is !important, or the earlier one isn't.  The style's
+ * property bitmaps are updated to match.  Styles whose bytecode can't be
+ * decoded are left alone.
+ */
+static css_error _drop_overridden(css_style *style, uint8_t *later)
+{
+	css_select_declaration *decls;
+	uint32_t n_decls, used, i;
+	css_error error;
+
+	error = _declarations(style, &decls, &n_decls);
+	if (error != CSS_OK || decls == NULL)
+		return error;
+
+	memset(style->props, 0, sizeof(style->props));
+	memset(style->important, 0, sizeof(style->important));
+
+	/* Walk backwards, so each declaration is tested against all those
+	 * which follow it */
+	for (i = n_decls; i > 0; i--) {
+		css_select_declaration *decl = &decls[i - 1];
+		uint32_t bit = 1u << (decl->prop % 32);
+
+		if (decl->reported == false)
+			continue;
+
+		if ((later[decl->prop] & (decl->important ?
+				OVERRIDE_IMPORTANT : OVERRIDE_ANY)) != 0) {
+			/* Mark as dropped */
+			decl->prop = CSS_N_PROPERTIES;
+			continue;
+		}
+
+		if (decl->important) {
+			later[decl->prop] |= OVERRIDE_IMPORTANT | OVERRIDE_ANY;
+			style->important[decl->prop / 32] |= bit;
+		} else {
+			later[decl->prop] |= OVERRIDE_ANY;
+			style->props[decl->prop / 32] |= bit;
+		}
+	}
+
+	/* Compact the bytecode over the dropped declarations */
+	used = 0;
+	for (i = 0; i < n_decls; i++) {
+		uint32_t end = i + 1 < n_decls ? decls[i + 1].offset :
+				style->used;
+
+		if (decls[i].prop == CSS_N_PROPERTIES)
+			continue;
+
+		memmove(style->bytecode + used,
+				style->bytecode + decls[i].offset,
+				(end - decls[i].offset) * sizeof(css_code_t));
+		used += end - decls[i].offset;
+	}
+
+	style->sheet->size -= (style->used - used) * sizeof(css_code_t);
+	style->used = used;
+
+	css__free(decls);
+
+	return CSS_OK;
+}
+
+/**
+ * Determine whether the declarations of a rule may be moved later
+ *
+ * \param style     Style of rule to move
+ * \param seq       Position of rule in sheet
+ * \param last_set  Position of the last rule to set each property
+ * \return true if no later rule sets any property \a style sets
+ */
+static bool _may_move(const css_style *style, uint32_t seq,
+		const uint32_t *last_set)
+{
+	uint32_t prop;
+
+	for (prop = 0; prop < CSS_N_PROPERTIES; prop++) {
+		uint32_t bit = 1u << (prop % 32);
+
+		if (((style->props[prop / 32] | style->important[prop / 32]) &
+				bit) != 0 && last_set[prop] > seq)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Merge the style of a rule into the start of a later rule's style
+ *
+ * \param sheet  Stylesheet containing rules
+ * \param from   Rule to merge, which is removed from the sheet
+ * \param to     Rule to merge into
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ */
+static css_error _merge_rule(css_stylesheet *sheet, css_rule_selector *from,
+		css_rule_selector *to)
+{
+	css_style *a = from->style;
+	css_style *b = to->style;
+	css_code_t *bytecode;
+	css_error error;
+	uint32_t i;
+
+	bytecode = css__malloc((a->used + b->used) * sizeof(css_code_t));
+	if (bytecode == NULL)
+		return CSS_NOMEM;
+
+	error = css__stylesheet_remove_rule(sheet, &from->base);
+	if (error != CSS_OK) {
+		css__free(bytecode);
+		return error;
+	}
+
+	memcpy(bytecode, a->bytecode, a->used * sizeof(css_code_t));
+	memcpy(bytecode + a->used, b->bytecode, b->used * sizeof(css_code_t));
+
+	css__free(b->bytecode);
+	b->bytecode = bytecode;
+	b->used += a->used;
+	b->allocated = b->used;
+
+	for (i = 0; i < CSS_PROP_BITMAP_WORDS; i++) {
+		b->props[i] |= a->props[i];
+		b->important[i] |= a->important[i];
+	}
+
+	/* The removed rule's bytecode is now counted in the later rule */
+	sheet->size += a->used * sizeof(css_code_t);
+
+	css__stylesheet_rule_destroy(sheet, &from->base);
+
+	return CSS_OK;
+}
+
+/**
+ * Merge rules with identical selectors, where the cascade permits
+ *
+ * \param sheet  Stylesheet to process
+ * \return CSS_OK on success, appropriate error otherwise
+ */
+static css_error _merge_rules(css_stylesheet *sheet)
+{
+	rule_entry *table;
+	uint32_t *last_set;
+	uint8_t later[CSS_N_PROPERTIES];
+	uint32_t n_rules = 0, n_slots = 1, seq = 0, prop;
+	css_error error = CSS_OK;
+	css_rule *r;
+
+	for (r = sheet->rule_list; r != NULL; r = css__rule_next(r))
+		n_rules++;
+
+	while (n_slots < n_rules * 2)
+		n_slots <<= 1;
+
+	table = css__calloc(n_slots, sizeof(rule_entry));
+	last_set = css__calloc(CSS_N_PROPERTIES, sizeof(uint32_t));
+	if (table == NULL || last_set == NULL) {
+		error = CSS_NOMEM;
+		goto cleanup;
+	}
+
+	for (r = sheet->rule_list; r != NULL; r = css__rule_next(r)) {
+		css_rule_selector *rule = (css_rule_selector *) r;
+		rule_entry *entry;
+		uint32_t hash = 0x811c9dc5, slot, i;
+
+		/* Rule positions start from 1, so 0 means unset */
+		seq++;
+
+		if (r->type != CSS_RULE_SELECTOR || r->items == 0 ||
+				rule->style == NULL)
+			continue;
+
+		for (i = 0; i < r->items; i++)
+			hash = _selector_hash(hash, rule->selectors[i]);
+
+		for (slot = hash & (n_slots - 1); table[slot].rule != NULL;
+				slot = (slot + 1) & (n_slots - 1)) {
+			if (table[slot].hash == hash &&
+					_selectors_equal(table[slot].rule, rule))
+				break;
+		}
+		entry = &table[slot];
+
+		if (entry->rule != NULL &&
+				entry->rule->base.parent == r->parent) {
+			/* Whatever this rule overrides in the earlier one is
+			 * dead, wherever the rules are */
+			memset(later, 0, CSS_N_PROPERTIES);
+
+			error = _note_declarations(rule->style, later);
+			if (error == CSS_OK)
+				error = _drop_overridden(entry->rule->style,
+						later);
+
+			if (error == CSS_OK && _may_move(entry->rule->style,
+					entry->seq, last_set))
+				error = _merge_rule(sheet, entry->rule, rule);
+
+			if (error != CSS_OK)
+				goto cleanup;
+		}
+
+		entry->rule = rule;
+		entry->seq = seq;
+		entry->hash = hash;
+
+		for (prop = 0; prop < CSS_N_PROPERTIES; prop++) {
+			uint32_t bit = 1u << (prop % 32);
+
+			if (((rule->style->props[prop / 32] |
+					rule->style->important[prop / 32]) &
+					bit) != 0)
+				last_set[prop] = seq;
+		}
+	}
+
+cleanup:
+	if (last_set != NULL)
+		css__free(last_set);
+	if (table != NULL)
+		css__free(table);
+
+	return error;
+}
+
+/**
+ * Optimise a stylesheet for selection
+ *
+ * \param sheet  The stylesheet to optimise
+ * \return CSS_OK on success,
+ *         CSS_BADPARM on bad parameters,
+ *         CSS_INVALID if the sheet is still being parsed, or is shared,
+ *         CSS_NOMEM on memory exhaustion
+ *
+ * Merges rules with identical selectors, drops declarations which are
+ * overridden within their rule, and removes rules left with nothing to
+ * cascade.  The result of selection is unchanged.
+ *
+ * This must be called after css_stylesheet_data_done(), and before the
+ * sheet is added to any selection context.  Shared sheets can't be
+ * optimised, as other users may be selecting with them.  If optimisation
+ * fails, the sheet remains valid, and may be partly optimised.
+ */
+css_error css_stylesheet_optimise(css_stylesheet *sheet)
+{
+	css_error error;
+	css_rule *r, *next;
+
+	if (sheet == NULL)
+		return CSS_BADPARM;
+
+	if (sheet->parser != NULL || sheet->cache_entry != NULL)
+		return CSS_INVALID;
+
+	error = css__stylesheet_unpool_styles(sheet);
+	if (error != CSS_OK)
+		return error;
+
+	for (r = sheet->rule_list; r != NULL; r = css__rule_next(r)) {
+		css_style *style = css__rule_style(r);
+
+		if (style != NULL)
+			_drop_decoded(style);
+	}
+
+	error = _merge_rules(sheet);
+
+	for (r = sheet->rule_list; r != NULL && error == CSS_OK;
+			r = css__rule_next(r)) {
+		css_style *style = css__rule_style(r);
+		uint8_t later[CSS_N_PROPERTIES];
+
+		memset(later, 0, sizeof(later));
+
+		if (style != NULL)
+			error = _drop_overridden(style, later);
+	}
+
+	/* Inline styles have a single rule, which isn't in the hash and
+	 * must stay, so only rules with selectors are removed */
+	for (r = sheet->rule_list; r != NULL && error == CSS_OK; r = next) {
+		css_rule_selector *rule = (css_rule_selector *) r;
+
+		next = css__rule_next(r);
+
+		if (r->type != CSS_RULE_SELECTOR || r->items == 0 ||
+				(rule->style != NULL && rule->style->used > 0))
+			continue;
+
+		error = css__stylesheet_remove_rule(sheet, r);
+		if (error == CSS_OK)
+			css__stylesheet_rule_destroy(sheet, r);
+	}
+
+	/* Removing rules may have left a style cached for the parser */
+	if (sheet->cached_style != NULL) {
+		css__stylesheet_style_destroy(sheet->cached_style);
+		sheet->cached_style = NULL;
+	}
+
+	css__stylesheet_pool_styles(sheet);
+	css__select_prepare_styles(sheet);
+
+	return error;
+}
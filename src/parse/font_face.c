@@ -14,6 +14,7 @@
 #include "parse/propstrings.h"
 #include "parse/properties/utils.h"
 #include "select/font_face.h"
+#include "utils/alloc.h"
 
 static bool font_rule_font_family_reserved(css_language *c, 
 		const css_token *ident)
@@ -228,7 +229,7 @@ static css_error font_face_parse_src(css_language *c,
 		/* This will be inefficient if there are a lot of locations - 
 		 * probably not a problem in practice.
 		 */
-		new_srcs = realloc(srcs, 
+		new_srcs = css__realloc(srcs, 
 				(n_srcs + 1) * sizeof(css_font_face_src));
 		if (new_srcs == NULL) {
 			error = CSS_NOMEM;
@@ -251,7 +252,7 @@ cleanup:
 	if (error != CSS_OK) {
 		*ctx = orig_ctx;
 		if (srcs != NULL) 
-			free(srcs);
+			css__free(srcs);
 	}
 
 	return error;
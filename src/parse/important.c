@@ -110,17 +110,34 @@ void css__make_style_important(css_style *style)
 				break;
 
 			case CSS_PROP_BACKGROUND_IMAGE:
+				if (value == BACKGROUND_IMAGE_URI) {
+					offset++; /* string table entry */
+				} else if (value ==
+						BACKGROUND_IMAGE_LINEAR_GRADIENT ||
+						value == BACKGROUND_IMAGE_REPEATING_LINEAR_GRADIENT) {
+					offset += 2; /* angle + units */
+
+					/* Colour stops, terminated by 0 */
+					do {
+						if (getValue(bytecode[offset]) ==
+								COLOR_SET)
+							offset++; /* colour */
+						offset += 3; /* opv, stop + units */
+					} while (bytecode[offset] != 0);
+
+					offset++;
+				}
+				break;
+
 			case CSS_PROP_CUE_AFTER:
 			case CSS_PROP_CUE_BEFORE:
 			case CSS_PROP_LIST_STYLE_IMAGE:
-				assert(BACKGROUND_IMAGE_URI == 
-				       (enum op_background_image)CUE_AFTER_URI);
-				assert(BACKGROUND_IMAGE_URI == 
-				       (enum op_background_image)CUE_BEFORE_URI);
-				assert(BACKGROUND_IMAGE_URI ==
-				       (enum op_background_image)LIST_STYLE_IMAGE_URI);
-
-				if (value == BACKGROUND_IMAGE_URI) 
+				assert(CUE_AFTER_URI == 
+				       (enum op_cue_after)CUE_BEFORE_URI);
+				assert(CUE_AFTER_URI ==
+				       (enum op_cue_after)LIST_STYLE_IMAGE_URI);
+
+				if (value == CUE_AFTER_URI) 
 					offset++; /* string table entry */
 				break;
 
@@ -316,11 +333,16 @@ void css__make_style_important(css_style *style)
 			case CSS_PROP_PAUSE_AFTER:
 			case CSS_PROP_PAUSE_BEFORE:
 			case CSS_PROP_TEXT_INDENT:
+			case CSS_PROP_BORDER_TOP_LEFT_RADIUS:
+			case CSS_PROP_BORDER_TOP_RIGHT_RADIUS:
+			case CSS_PROP_BORDER_BOTTOM_RIGHT_RADIUS:
+			case CSS_PROP_BORDER_BOTTOM_LEFT_RADIUS:
 				assert(MIN_HEIGHT_SET == (enum op_min_height)MIN_WIDTH_SET);
 				assert(MIN_HEIGHT_SET == (enum op_min_height)PADDING_SET);
 				assert(MIN_HEIGHT_SET == (enum op_min_height)PAUSE_AFTER_SET);
 				assert(MIN_HEIGHT_SET == (enum op_min_height)PAUSE_BEFORE_SET);
 				assert(MIN_HEIGHT_SET == (enum op_min_height)TEXT_INDENT_SET);
+				assert(MIN_HEIGHT_SET == (enum op_min_height)BORDER_RADIUS_SET);
 
 				if (value == MIN_HEIGHT_SET)
 					offset += 2; /* length + units */
@@ -21,6 +21,7 @@
 #include "parse/properties/utils.h"
 
 #include "utils/parserutilserror.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 typedef struct context_entry {
@@ -124,14 +125,14 @@ css_error css__language_create(css_stylesheet *sheet, css_parser *parser,
 	if (sheet == NULL || parser == NULL || language == NULL)
 		return CSS_BADPARM;
 
-	c = malloc(sizeof(css_language));
+	c = css__malloc(sizeof(css_language));
 	if (c == NULL)
 		return CSS_NOMEM;
 
 	perror = parserutils_stack_create(sizeof(context_entry), 
 			STACK_CHUNK, &c->context);
 	if (perror != PARSERUTILS_OK) {
-		free(c);
+		css__free(c);
 		return css_error_from_parserutils_error(perror);
 	}
 
@@ -140,7 +141,7 @@ css_error css__language_create(css_stylesheet *sheet, css_parser *parser,
 	error = css__parser_setopt(parser, CSS_PARSER_EVENT_HANDLER, &params);
 	if (error != CSS_OK) {
 		parserutils_stack_destroy(c->context);
-		free(c);
+		css__free(c);
 		return error;
 	}
 
@@ -178,12 +179,12 @@ css_error css__language_destroy(css_language *language)
 			lwc_string_unref(language->namespaces[i].uri);
 		}
 
-		free(language->namespaces);
+		css__free(language->namespaces);
 	}
 
 	parserutils_stack_destroy(language->context);
 	
-	free(language);
+	css__free(language);
 
 	return CSS_OK;
 }
@@ -908,7 +909,7 @@ css_error addNamespace(css_language *c, lwc_string *prefix, lwc_string *uri)
 
 		if (idx == c->num_namespaces) {
 			/* Not found, create a new mapping */
-			css_namespace *ns = realloc(c->namespaces, 
+			css_namespace *ns = css__realloc(c->namespaces, 
 					sizeof(css_namespace) * 
 						(c->num_namespaces + 1));
 
@@ -1396,6 +1397,10 @@ css_error parsePseudo(css_language *c, const parserutils_vector *vector,
 	if (lut_idx == N_ELEMENTS(pseudo_lut))
 		return CSS_INVALID;
 
+	/* Names are case insensitive, so keep the canonical, lower case, one.
+	 * Selection then compares pseudo class and element names by pointer */
+	qname.name = c->strings[pseudo_lut[lut_idx].index];
+
 	/* Required a pseudo element, but didn't find one: invalid */
 	if (require_element && type != CSS_SELECTOR_PSEUDO_ELEMENT)
 		return CSS_INVALID;
@@ -1881,15 +1886,8 @@ css_error parseProperty(css_language *c, const css_token *property,
 	const css_token *token;
 
 	/* Find property index */
-	/** \todo improve on this linear search */
-	for (i = FIRST_PROP; i <= LAST_PROP; i++) {
-		bool match = false;
-
-		if (lwc_string_caseless_isequal(property->idata, c->strings[i],
-				&match) == lwc_error_ok && match)
-			break;
-	}
-	if (i == LAST_PROP + 1)
+	i = css__propstrings_lookup(property->idata);
+	if (i < FIRST_PROP || i > LAST_PROP)
 		return CSS_INVALID;
 
 	/* Get handler */
@@ -8,10 +8,17 @@
 #include <assert.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <string.h>
+
+#ifdef WITH_PTHREADS
+#include <pthread.h>
+#endif
 
 #include <libwapcaplet/libwapcaplet.h>
 
+#include <parserutils/charset/mibenum.h>
 #include <parserutils/input/inputstream.h>
+#include <parserutils/utils/buffer.h>
 #include <parserutils/utils/stack.h>
 #include <parserutils/utils/vector.h>
 
@@ -19,6 +26,7 @@
 #include "lex/lex.h"
 #include "parse/parse.h"
 #include "utils/parserutilserror.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #undef DEBUG_STACK
@@ -96,6 +104,10 @@ struct css_parser
 
 	const css_token *pushback;	/**< Push back buffer */
 
+	css_token *ahead;		/**< Tokens lexed ahead of parsing, 
+					 * used instead of the lexer, or NULL */
+	size_t n_ahead;			/**< Number of tokens lexed ahead */
+
 	bool parseError;		/**< A parse error has occurred */
 	parserutils_stack *open_items;	/**< Stack of open brackets */
 
@@ -116,6 +128,7 @@ static css_error transition(css_parser *parser, parser_state to,
 static css_error transitionNoRet(css_parser *parser, parser_state to);
 static css_error done(css_parser *parser);
 static css_error expect(css_parser *parser, css_token_type type);
+static inline css_error nextToken(css_parser *parser, css_token **token);
 static css_error getToken(css_parser *parser, const css_token **token);
 static css_error pushBack(css_parser *parser, const css_token *token);
 static css_error eatWS(css_parser *parser);
@@ -240,7 +253,7 @@ css_error css__parser_destroy(css_parser *parser)
 
 	parserutils_inputstream_destroy(parser->stream);
 
-	free(parser);
+	css__free(parser);
 
 	return CSS_OK;
 }
@@ -337,6 +350,564 @@ css_error css__parser_completed(css_parser *parser)
 	return error;
 }
 
+/**
+ * Determine whether a buffer holds well-formed UTF-8
+ *
+ * \param data  Pointer to data
+ * \param len   Length, in bytes, of data
+ * \return True if data is well-formed, false otherwise
+ *
+ * Overlong forms, surrogates and codepoints beyond U+10FFFF are rejected,
+ * as the inputstream would replace them with U+FFFD.
+ */
+static bool utf8_valid(const uint8_t *data, size_t len)
+{
+	const uint8_t *end = data + len;
+
+	while (data < end) {
+		uint8_t c = *data;
+		size_t n, i;
+
+		if (c < 0x80) {
+			/* Skip runs of ASCII a word at a time */
+			while ((size_t) (end - data) >= sizeof(uint32_t)) {
+				uint32_t w;
+
+				memcpy(&w, data, sizeof(w));
+				if ((w & 0x80808080) != 0)
+					break;
+
+				data += sizeof(w);
+			}
+
+			if (data < end && *data < 0x80)
+				data++;
+
+			continue;
+		}
+
+		if (c >= 0xc2 && c <= 0xdf)
+			n = 2;
+		else if (c >= 0xe0 && c <= 0xef)
+			n = 3;
+		else if (c >= 0xf0 && c <= 0xf4)
+			n = 4;
+		else
+			return false;
+
+		if ((size_t) (end - data) < n)
+			return false;
+
+		for (i = 1; i < n; i++) {
+			if ((data[i] & 0xc0) != 0x80)
+				return false;
+		}
+
+		if ((c == 0xe0 && data[1] < 0xa0) ||
+				(c == 0xed && data[1] > 0x9f) ||
+				(c == 0xf0 && data[1] < 0x90) ||
+				(c == 0xf4 && data[1] > 0x8f))
+			return false;
+
+		data += n;
+	}
+
+	return true;
+}
+
+/**
+ * Determine whether a complete buffer may be inserted into a parser's 
+ * inputstream without conversion
+ *
+ * \param parser  The parser to use
+ * \param data    Pointer to location of data, updated to skip any BOM
+ * \param len     Pointer to length, in bytes, of data, updated to match
+ * \param utf8    Pointer to location to receive result
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * If the data is well-formed UTF-8, the inputstream's charset is set to
+ * UTF-8 and \a utf8 is set to true.
+ */
+static css_error buffer_charset(css_parser *parser, const uint8_t **data,
+		size_t *len, bool *utf8)
+{
+	parserutils_error perror;
+	const char *charset;
+	uint32_t source;
+	uint16_t mibenum;
+
+	*utf8 = false;
+
+	charset = parserutils_inputstream_read_charset(parser->stream, 
+			&source);
+	mibenum = parserutils_charset_mibenum_from_name(charset, 
+			strlen(charset));
+
+	/* Detect the charset as the inputstream would */
+	perror = css__charset_extract(*data, *len, &mibenum, &source);
+
+	if (perror != PARSERUTILS_OK || mibenum != 
+			parserutils_charset_mibenum_from_name("UTF-8", 
+					SLEN("UTF-8")) ||
+			utf8_valid(*data, *len) == false)
+		return CSS_OK;
+
+	/* Skip any BOM */
+	if (*len >= 3 && (*data)[0] == 0xef && (*data)[1] == 0xbb && 
+			(*data)[2] == 0xbf) {
+		*data += 3;
+		*len -= 3;
+	}
+
+	perror = parserutils_inputstream_change_charset(parser->stream, 
+			"UTF-8", source);
+	if (perror != PARSERUTILS_OK)
+		return css_error_from_parserutils_error(perror);
+
+	*utf8 = true;
+
+	return CSS_OK;
+}
+
+/**
+ * Parse a complete stylesheet, held in a single buffer
+ *
+ * \param parser  The parser to use
+ * \param data    Pointer to the stylesheet data
+ * \param len     Length, in bytes, of data
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * This is equivalent to css__parser_parse_chunk() followed by
+ * css__parser_completed(), and must be called before either.  If the data
+ * is well-formed UTF-8, it is inserted directly into the inputstream's
+ * decoded buffer, avoiding the copy into the raw buffer and the charset
+ * conversion.
+ */
+css_error css__parser_parse_buffer(css_parser *parser, const uint8_t *data,
+		size_t len)
+{
+	parserutils_error perror;
+	css_error error;
+	bool utf8;
+
+	if (parser == NULL || data == NULL)
+		return CSS_BADPARM;
+
+	error = buffer_charset(parser, &data, &len, &utf8);
+	if (error != CSS_OK)
+		return error;
+
+	if (utf8) {
+		if (len > 0) {
+			perror = parserutils_inputstream_insert(
+					parser->stream, data, len);
+			if (perror != PARSERUTILS_OK)
+				return css_error_from_parserutils_error(
+						perror);
+		}
+	} else {
+		error = css__parser_parse_chunk(parser, data, len);
+		if (error != CSS_OK && error != CSS_NEEDDATA)
+			return error;
+	}
+
+	return css__parser_completed(parser);
+}
+
+#ifdef WITH_PTHREADS
+/** Maximum number of threads used to parse a buffer */
+#define MAX_PARSE_THREADS 32
+
+/**
+ * Tokens lexed from one run of a buffer, ahead of parsing
+ */
+typedef struct token_run {
+	const uint8_t *data;		/**< Start of run */
+	size_t len;			/**< Length, in bytes, of run */
+	bool last;			/**< Run ends the buffer */
+
+	parserutils_inputstream *stream;	/**< Inputstream for run */
+	css_lexer *lexer;		/**< Lexer for run */
+	parserutils_buffer *tokens;	/**< Array of tokens lexed */
+	parserutils_buffer *text;	/**< Data of the tokens lexed */
+
+	bool ends_block;		/**< Last token lexed was a '}' */
+	css_error error;		/**< Result of lexing run */
+
+	pthread_t thread;		/**< Thread lexing run */
+	bool threaded;			/**< Whether run is lexed by thread */
+} token_run;
+
+/**
+ * Split a buffer into runs, at the ends of top-level blocks
+ *
+ * \param data    Pointer to data
+ * \param len     Length, in bytes, of data
+ * \param runs    Array of runs to fill in
+ * \param n_runs  Number of runs wanted
+ * \return Number of runs filled in
+ *
+ * Each run but the last ends with a '}' which closes a top-level block,
+ * outside strings, comments and escapes, so all but the last end between
+ * two tokens.  The runs are about the same length.
+ */
+static uint32_t split_buffer(const uint8_t *data, size_t len,
+		token_run *runs, uint32_t n_runs)
+{
+	size_t start = 0, pos = 0;
+	uint32_t depth = 0, n = 0;
+
+	while (pos < len && n + 1 < n_runs) {
+		uint8_t c = data[pos++];
+
+		switch (c) {
+		case '"':
+		case '\'':
+			/* Strings end at the matching quote or a newline */
+			while (pos < len && data[pos] != c && 
+					data[pos] != '\n' && data[pos] != '\r' &&
+					data[pos] != '\f') {
+				if (data[pos] == '\\' && pos + 1 < len) {
+					if (data[pos + 1] == '\r' && 
+							pos + 2 < len &&
+							data[pos + 2] == '\n')
+						pos++;
+					pos++;
+				}
+				pos++;
+			}
+			pos++;
+			break;
+		case '/':
+			if (pos < len && data[pos] == '*') {
+				pos++;
+				while (pos + 1 < len && (data[pos] != '*' ||
+						data[pos + 1] != '/'))
+					pos++;
+				pos += 2;
+			}
+			break;
+		case '\\':
+			pos++;
+			break;
+		case '{':
+		case '(':
+		case '[':
+			depth++;
+			break;
+		case ')':
+		case ']':
+			if (depth > 0)
+				depth--;
+			break;
+		case '}':
+			if (depth > 0)
+				depth--;
+
+			/* End the run here, if it's long enough */
+			if (depth == 0 && pos - start >= 
+					(len - start) / (n_runs - n)) {
+				runs[n].data = data + start;
+				runs[n].len = pos - start;
+				runs[n].last = false;
+				n++;
+
+				start = pos;
+			}
+			break;
+		}
+	}
+
+	runs[n].data = data + start;
+	runs[n].len = len - start;
+	runs[n].last = true;
+
+	return n + 1;
+}
+
+/**
+ * Prepare a run for lexing
+ *
+ * \param run  The run to prepare
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The run must be finalised with token_run_fini(), whether or not this
+ * succeeds.
+ */
+static css_error token_run_init(token_run *run)
+{
+	parserutils_error perror;
+
+	run->stream = NULL;
+	run->lexer = NULL;
+	run->tokens = NULL;
+	run->text = NULL;
+	run->ends_block = false;
+	run->threaded = false;
+
+	perror = parserutils_inputstream_create("UTF-8", CSS_CHARSET_DICTATED,
+			css__charset_extract, &run->stream);
+	if (perror != PARSERUTILS_OK)
+		return css_error_from_parserutils_error(perror);
+
+	if (run->len > 0) {
+		perror = parserutils_inputstream_insert(run->stream, 
+				run->data, run->len);
+		if (perror != PARSERUTILS_OK)
+			return css_error_from_parserutils_error(perror);
+	}
+
+	perror = parserutils_inputstream_append(run->stream, NULL, 0);
+	if (perror != PARSERUTILS_OK)
+		return css_error_from_parserutils_error(perror);
+
+	perror = parserutils_buffer_create(&run->tokens);
+	if (perror != PARSERUTILS_OK)
+		return css_error_from_parserutils_error(perror);
+
+	perror = parserutils_buffer_create(&run->text);
+	if (perror != PARSERUTILS_OK)
+		return css_error_from_parserutils_error(perror);
+
+	return css__lexer_create(run->stream, &run->lexer);
+}
+
+/**
+ * Finalise a run
+ *
+ * \param run  The run to finalise
+ */
+static void token_run_fini(token_run *run)
+{
+	if (run->lexer != NULL)
+		css__lexer_destroy(run->lexer);
+
+	if (run->text != NULL)
+		parserutils_buffer_destroy(run->text);
+
+	if (run->tokens != NULL)
+		parserutils_buffer_destroy(run->tokens);
+
+	if (run->stream != NULL)
+		parserutils_inputstream_destroy(run->stream);
+}
+
+/**
+ * Lex a run into an array of tokens (thread entry point)
+ *
+ * \param pw  The run to lex
+ * \return NULL.  The result is stored in the run.
+ *
+ * Only parserutils objects belonging to the run are used, so runs may be
+ * lexed concurrently.  No strings are interned; the parser does that.
+ */
+static void *token_run_lex(void *pw)
+{
+	token_run *run = pw;
+	parserutils_error perror;
+	css_token *t, *tokens;
+	size_t i, n_tokens, offset = 0;
+	css_error error;
+
+	do {
+		error = css__lexer_get_token(run->lexer, &t);
+		if (error != CSS_OK)
+			break;
+
+		/* Only the last run produces an EOF token */
+		if (t->type == CSS_TOKEN_EOF && run->last == false)
+			break;
+
+		/* Until the text is complete, only whether a token's data 
+		 * pointer is NULL matters */
+		if (t->data.data != NULL) {
+			perror = parserutils_buffer_append(run->text, 
+					t->data.data, t->data.len);
+			if (perror != PARSERUTILS_OK) {
+				error = css_error_from_parserutils_error(
+						perror);
+				break;
+			}
+		}
+
+		run->ends_block = (t->type == CSS_TOKEN_CHAR && 
+				t->data.len == 1 && t->data.data[0] == '}');
+
+		perror = parserutils_buffer_append(run->tokens, 
+				(const uint8_t *) t, sizeof(css_token));
+		if (perror != PARSERUTILS_OK) {
+			error = css_error_from_parserutils_error(perror);
+			break;
+		}
+	} while (t->type != CSS_TOKEN_EOF);
+
+	/* Point the tokens at their data */
+	tokens = (css_token *) run->tokens->data;
+	n_tokens = run->tokens->length / sizeof(css_token);
+
+	for (i = 0; i < n_tokens; i++) {
+		if (tokens[i].data.data != NULL) {
+			tokens[i].data.data = run->text->data + offset;
+			offset += tokens[i].data.len;
+		}
+	}
+
+	run->error = error;
+
+	return NULL;
+}
+
+/**
+ * Parse the tokens lexed from a run
+ *
+ * \param parser  The parser to use
+ * \param run     The run to parse
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The run must remain valid until parsing is complete, as the parser may
+ * keep a pointer to its last token.
+ */
+static css_error parse_token_run(css_parser *parser, token_run *run)
+{
+	parser_state *state;
+	css_error error = CSS_OK;
+
+	parser->ahead = (css_token *) run->tokens->data;
+	parser->n_ahead = run->tokens->length / sizeof(css_token);
+
+	do {
+		state = parserutils_stack_get_current(parser->states);
+		if (state == NULL)
+			break;
+
+		error = parseFuncs[state->state](parser);
+	} while (error == CSS_OK);
+
+	/* Running out of tokens is expected before the last run */
+	if (error == CSS_NEEDDATA && run->last == false)
+		error = CSS_OK;
+
+	return error;
+}
+#endif
+
+/**
+ * Parse a complete stylesheet, held in a single buffer, using several 
+ * threads
+ *
+ * \param parser     The parser to use
+ * \param data       Pointer to the stylesheet data
+ * \param len        Length, in bytes, of data
+ * \param n_threads  Maximum number of threads to use, including this one
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * This produces the same result as css__parser_parse_buffer().  UTF-8 
+ * data is split into runs at the ends of top-level blocks, and each run 
+ * after the first is lexed by a thread of its own, while this thread 
+ * lexes the first and parses the runs in order.  Interning and parsing 
+ * happen in this thread alone, so neither the string table nor the 
+ * stylesheet need be thread-safe.
+ *
+ * Should a run turn out not to end between two tokens, the rest of the 
+ * buffer is lexed in one go instead.  Without thread support, this is the 
+ * same as css__parser_parse_buffer().
+ */
+css_error css__parser_parse_buffer_parallel(css_parser *parser,
+		const uint8_t *data, size_t len, uint32_t n_threads)
+{
+#ifdef WITH_PTHREADS
+	token_run runs[MAX_PARSE_THREADS], rest;
+	const uint8_t *utf8_data = data;
+	size_t utf8_len = len;
+	uint32_t n_runs = 0, i;
+	bool lexed_rest = false;
+	css_error error;
+	bool utf8;
+
+	if (parser == NULL || data == NULL)
+		return CSS_BADPARM;
+
+	if (n_threads > MAX_PARSE_THREADS)
+		n_threads = MAX_PARSE_THREADS;
+
+	if (n_threads > 1) {
+		error = buffer_charset(parser, &utf8_data, &utf8_len, &utf8);
+		if (error != CSS_OK)
+			return error;
+
+		if (utf8)
+			n_runs = split_buffer(utf8_data, utf8_len, 
+					runs, n_threads);
+	}
+
+	if (n_runs < 2)
+		return css__parser_parse_buffer(parser, data, len);
+
+	/* Runs which can't be given a thread are lexed here, in turn */
+	for (i = 0; i < n_runs; i++) {
+		runs[i].error = token_run_init(&runs[i]);
+		if (i > 0 && runs[i].error == CSS_OK)
+			runs[i].threaded = (pthread_create(&runs[i].thread, 
+					NULL, token_run_lex, &runs[i]) == 0);
+	}
+
+	error = CSS_OK;
+
+	for (i = 0; i < n_runs; i++) {
+		token_run *run = &runs[i];
+
+		if (run->threaded)
+			pthread_join(run->thread, NULL);
+		else if (run->error == CSS_OK && error == CSS_OK && 
+				lexed_rest == false)
+			token_run_lex(run);
+
+		if (error != CSS_OK || lexed_rest)
+			continue;
+
+		error = run->error;
+		if (error != CSS_OK)
+			continue;
+
+		if (run->last == false && run->ends_block == false) {
+			/* The run ended within a token */
+			rest.data = run->data;
+			rest.len = utf8_data + utf8_len - run->data;
+			rest.last = true;
+
+			error = token_run_init(&rest);
+			if (error == CSS_OK) {
+				token_run_lex(&rest);
+				error = rest.error;
+			}
+
+			lexed_rest = true;
+			run = &rest;
+
+			if (error != CSS_OK)
+				continue;
+		}
+
+		error = parse_token_run(parser, run);
+	}
+
+	parser->ahead = NULL;
+	parser->n_ahead = 0;
+
+	for (i = 0; i < n_runs; i++)
+		token_run_fini(&runs[i]);
+
+	if (lexed_rest)
+		token_run_fini(&rest);
+
+	return error;
+#else
+	UNUSED(n_threads);
+
+	return css__parser_parse_buffer(parser, data, len);
+#endif
+}
+
 /**
  * Retrieve document charset information from a CSS parser
  *
@@ -397,21 +968,21 @@ css_error css__parser_create_internal(const char *charset,
 	if (parser == NULL)
 		return CSS_BADPARM;
 
-	p = malloc(sizeof(css_parser));
+	p = css__malloc(sizeof(css_parser));
 	if (p == NULL)
 		return CSS_NOMEM;
 
 	perror = parserutils_inputstream_create(charset, cs_source,
 			css__charset_extract, &p->stream);
 	if (perror != PARSERUTILS_OK) {
-		free(p);
+		css__free(p);
 		return css_error_from_parserutils_error(perror);
 	}
 
 	error = css__lexer_create(p->stream, &p->lexer);
 	if (error != CSS_OK) {
 		parserutils_inputstream_destroy(p->stream);
-		free(p);
+		css__free(p);
 		return error;
 	}
 
@@ -420,7 +991,7 @@ css_error css__parser_create_internal(const char *charset,
 	if (perror != PARSERUTILS_OK) {
 		css__lexer_destroy(p->lexer);
 		parserutils_inputstream_destroy(p->stream);
-		free(p);
+		css__free(p);
 		return css_error_from_parserutils_error(perror);
 	}
 
@@ -430,7 +1001,7 @@ css_error css__parser_create_internal(const char *charset,
 		parserutils_stack_destroy(p->states);
 		css__lexer_destroy(p->lexer);
 		parserutils_inputstream_destroy(p->stream);
-		free(p);
+		css__free(p);
 		return css_error_from_parserutils_error(perror);
 	}
 
@@ -441,7 +1012,7 @@ css_error css__parser_create_internal(const char *charset,
 		parserutils_stack_destroy(p->states);
 		css__lexer_destroy(p->lexer);
 		parserutils_inputstream_destroy(p->stream);
-		free(p);
+		css__free(p);
 		return css_error_from_parserutils_error(perror);
 	}
 
@@ -452,12 +1023,14 @@ css_error css__parser_create_internal(const char *charset,
 		parserutils_stack_destroy(p->states);
 		css__lexer_destroy(p->lexer);
 		parserutils_inputstream_destroy(p->stream);
-		free(p);
+		css__free(p);
 		return css_error_from_parserutils_error(perror);
 	}
 
 	p->quirks = false;
 	p->pushback = NULL;
+	p->ahead = NULL;
+	p->n_ahead = 0;
 	p->parseError = false;
 	p->match_char = 0;
 	p->event = NULL;
@@ -580,6 +1153,34 @@ css_error expect(css_parser *parser, css_token_type type)
 	return CSS_OK;
 }
 
+/**
+ * Read the next token from the lexer, or from the tokens lexed ahead
+ *
+ * \param parser  The parser instance
+ * \param token   Pointer to location to receive token
+ * \return CSS_OK on success, 
+ *         CSS_NEEDDATA if the tokens lexed ahead have run out,
+ *         appropriate error otherwise
+ */
+css_error nextToken(css_parser *parser, css_token **token)
+{
+	if (parser->ahead == NULL)
+		return css__lexer_get_token(parser->lexer, token);
+
+	if (parser->n_ahead == 0)
+		return CSS_NEEDDATA;
+
+	*token = parser->ahead;
+
+	/* As with the lexer, EOF is returned for every read after it */
+	if ((*token)->type != CSS_TOKEN_EOF) {
+		parser->ahead++;
+		parser->n_ahead--;
+	}
+
+	return CSS_OK;
+}
+
 /**
  * Retrieve the next token in the input
  *
@@ -601,14 +1202,14 @@ css_error getToken(css_parser *parser, const css_token **token)
 		/* Otherwise, ask the lexer */
 		css_token *t;
 
-		error = css__lexer_get_token(parser->lexer, &t);
+		error = nextToken(parser, &t);
 		if (error != CSS_OK)
 			return error;
 
 		/* If the last token read was whitespace, keep reading
 		 * tokens until we encounter one that isn't whitespace */
 		while (parser->last_was_ws && t->type == CSS_TOKEN_S) {
-			error = css__lexer_get_token(parser->lexer, &t);
+			error = nextToken(parser, &t);
 			if (error != CSS_OK)
 				return error;
 		}
@@ -2182,7 +2783,7 @@ css_error parseMalformedDeclaration(css_parser *parser)
 
 css_error parseMalformedSelector(css_parser *parser)
 {
-	enum { Initial = 0, Go = 1 };
+	enum { Initial = 0, Go = 1, WS = 2 };
 	parser_state *state = parserutils_stack_get_current(parser->states);
 	const css_token *token;
 	css_error error;
@@ -2262,12 +2863,15 @@ css_error parseMalformedSelector(css_parser *parser)
 					parser->open_items) == NULL)
 				break;
 		}
-	}
 
-	/* Consume any trailing whitespace after the ruleset */
-	error = eatWS(parser);
-	if (error != CSS_OK)
-		return error;
+		state->substate = WS;
+		/* Fall through */
+	case WS:
+		/* Consume any trailing whitespace after the ruleset */
+		error = eatWS(parser);
+		if (error != CSS_OK)
+			return error;
+	}
 
 	/* Discard the tokens we've read */
         unref_interned_strings_in_tokens(parser);
@@ -2278,7 +2882,7 @@ css_error parseMalformedSelector(css_parser *parser)
 
 css_error parseMalformedAtRule(css_parser *parser)
 {
-	enum { Initial = 0, Go = 1 };
+	enum { Initial = 0, Go = 1, WS = 2 };
 	parser_state *state = parserutils_stack_get_current(parser->states);
 	const css_token *token = NULL;
 	css_error error;
@@ -2371,12 +2975,15 @@ css_error parseMalformedAtRule(css_parser *parser)
 					parser->open_items) == NULL)
 				break;
 		}
-	}
 
-	/* Consume any trailing whitespace after the at-rule */
-	error = eatWS(parser);
-	if (error != CSS_OK)
-		return error;
+		state->substate = WS;
+		/* Fall through */
+	case WS:
+		/* Consume any trailing whitespace after the at-rule */
+		error = eatWS(parser);
+		if (error != CSS_OK)
+			return error;
+	}
 
 	/* Discard the tokens we've read */
         unref_interned_strings_in_tokens(parser);
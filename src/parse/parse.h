@@ -69,6 +69,10 @@ css_error css__parser_setopt(css_parser *parser, css_parser_opttype type,
 css_error css__parser_parse_chunk(css_parser *parser, const uint8_t *data, 
 		size_t len);
 css_error css__parser_completed(css_parser *parser);
+css_error css__parser_parse_buffer(css_parser *parser, const uint8_t *data,
+		size_t len);
+css_error css__parser_parse_buffer_parallel(css_parser *parser,
+		const uint8_t *data, size_t len, uint32_t n_threads);
 
 const char *css__parser_read_charset(css_parser *parser, 
 		css_charset_source *source);
@@ -38,6 +38,7 @@ css_error css__parse_azimuth(css_language *c,
 	uint16_t value = 0;
 	css_fixed length = 0;
 	uint32_t unit = 0;
+	int keyword = LAST_KNOWN;
 	bool match;
 
 	/* angle | [ IDENT(left-side, far-left, left, center-left, center, 
@@ -52,19 +53,16 @@ css_error css__parse_azimuth(css_language *c,
 		return CSS_INVALID;
 	}
 
-	if (token->type == CSS_TOKEN_IDENT &&
-		(lwc_string_caseless_isequal(token->idata, c->strings[INHERIT],
-			&match) == lwc_error_ok && match)) {
+	if (token->type == CSS_TOKEN_IDENT)
+		keyword = css__parse_keyword(c, token);
+
+	if (keyword == INHERIT) {
 		parserutils_vector_iterate(vector, ctx);
 		flags = FLAG_INHERIT;
-	} else if (token->type == CSS_TOKEN_IDENT &&
-		(lwc_string_caseless_isequal(token->idata, c->strings[LEFTWARDS],
-			&match) == lwc_error_ok && match)) {
+	} else if (keyword == LEFTWARDS) {
 		parserutils_vector_iterate(vector, ctx);
 		value = AZIMUTH_LEFTWARDS;
-	} else if (token->type == CSS_TOKEN_IDENT &&
-		(lwc_string_caseless_isequal(token->idata, c->strings[RIGHTWARDS],
-			&match) == lwc_error_ok && match)) {
+	} else if (keyword == RIGHTWARDS) {
 		parserutils_vector_iterate(vector, ctx);
 		value = AZIMUTH_RIGHTWARDS;
 	} else if (token->type == CSS_TOKEN_IDENT) {
@@ -73,47 +71,38 @@ css_error css__parse_azimuth(css_language *c,
 		/* Now, we may have one of the other keywords or behind,
 		 * potentially followed by behind or other keyword, 
 		 * respectively */
-		if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[LEFT_SIDE],
-				&match) == lwc_error_ok && match)) {
+		switch (css__parse_keyword(c, token)) {
+		case LEFT_SIDE:
 			value = AZIMUTH_LEFT_SIDE;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[FAR_LEFT],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case FAR_LEFT:
 			value = AZIMUTH_FAR_LEFT;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[LEFT],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case LEFT:
 			value = AZIMUTH_LEFT;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[CENTER_LEFT],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case CENTER_LEFT:
 			value = AZIMUTH_CENTER_LEFT;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[CENTER],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case CENTER:
 			value = AZIMUTH_CENTER;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[CENTER_RIGHT],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case CENTER_RIGHT:
 			value = AZIMUTH_CENTER_RIGHT;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[RIGHT],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case RIGHT:
 			value = AZIMUTH_RIGHT;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[FAR_RIGHT],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case FAR_RIGHT:
 			value = AZIMUTH_FAR_RIGHT;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[RIGHT_SIDE],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case RIGHT_SIDE:
 			value = AZIMUTH_RIGHT_SIDE;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[BEHIND],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case BEHIND:
 			value = AZIMUTH_BEHIND;
-		} else {
+			break;
+		default:
 			*ctx = orig_ctx;
 			return CSS_INVALID;
 		}
@@ -127,43 +116,35 @@ css_error css__parse_azimuth(css_language *c,
 				value == AZIMUTH_BEHIND) {
 			parserutils_vector_iterate(vector, ctx);
 
-			if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[LEFT_SIDE],
-					&match) == lwc_error_ok && match)) {
+			switch (css__parse_keyword(c, token)) {
+			case LEFT_SIDE:
 				value |= AZIMUTH_LEFT_SIDE;
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[FAR_LEFT],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case FAR_LEFT:
 				value |= AZIMUTH_FAR_LEFT;
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[LEFT],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case LEFT:
 				value |= AZIMUTH_LEFT;
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[CENTER_LEFT],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case CENTER_LEFT:
 				value |= AZIMUTH_CENTER_LEFT;
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[CENTER],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case CENTER:
 				value |= AZIMUTH_CENTER;
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[CENTER_RIGHT],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case CENTER_RIGHT:
 				value |= AZIMUTH_CENTER_RIGHT;
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[RIGHT],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case RIGHT:
 				value |= AZIMUTH_RIGHT;
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[FAR_RIGHT],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case FAR_RIGHT:
 				value |= AZIMUTH_FAR_RIGHT;
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[RIGHT_SIDE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case RIGHT_SIDE:
 				value |= AZIMUTH_RIGHT_SIDE;
-			} else {
+				break;
+			default:
 				*ctx = orig_ctx;
 				return CSS_INVALID;
 			}
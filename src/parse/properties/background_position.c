@@ -63,35 +63,20 @@ css_error css__parse_background_position(css_language *c,
 				break;
 
 			if (token->type == CSS_TOKEN_IDENT) {
-				if ((lwc_string_caseless_isequal(
-						token->idata, c->strings[LEFT],
-						&match) == lwc_error_ok && 
-						match)) {
+				int keyword = css__parse_keyword(c, token);
+
+				if (keyword == LEFT) {
 					value[i] = 
 						BACKGROUND_POSITION_HORZ_LEFT;
-				} else if ((lwc_string_caseless_isequal(
-						token->idata, c->strings[RIGHT],
-						&match) == lwc_error_ok && 
-						match)) {
+				} else if (keyword == RIGHT) {
 					value[i] = 
 						BACKGROUND_POSITION_HORZ_RIGHT;
-				} else if ((lwc_string_caseless_isequal(
-						token->idata, c->strings[TOP],
-						&match) == lwc_error_ok && 
-						match)) {
+				} else if (keyword == TOP) {
 					value[i] = BACKGROUND_POSITION_VERT_TOP;
-				} else if ((lwc_string_caseless_isequal(
-						token->idata, 
-						c->strings[BOTTOM],
-						&match) == lwc_error_ok && 
-						match)) {
+				} else if (keyword == BOTTOM) {
 					value[i] = 
 						BACKGROUND_POSITION_VERT_BOTTOM;
-				} else if ((lwc_string_caseless_isequal(
-						token->idata, 
-						c->strings[CENTER],
-						&match) == lwc_error_ok && 
-						match)) {
+				} else if (keyword == CENTER) {
 					/* We'll fix this up later */
 					value[i] = 
 						BACKGROUND_POSITION_VERT_CENTER;
@@ -36,7 +36,7 @@ css_error css__parse_border_style(css_language *c,
 	const css_token *token;
 	uint16_t side_val[4];
 	uint32_t side_count = 0;
-	bool match;
+	int keyword;
 	css_error error;
 
 	/* Firstly, handle inherit */
@@ -76,25 +76,26 @@ css_error css__parse_border_style(css_language *c,
 		if (token->type != CSS_TOKEN_IDENT) 
 			break;
 
-		if ((lwc_string_caseless_isequal(token->idata, c->strings[NONE], &match) == lwc_error_ok && match)) {
+		keyword = css__parse_keyword(c, token);
+		if (keyword == NONE) {
 			side_val[side_count] = BORDER_STYLE_NONE;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[HIDDEN], &match) == lwc_error_ok && match)) {
+		} else if (keyword == HIDDEN) {
 			side_val[side_count] = BORDER_STYLE_HIDDEN;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[DOTTED], &match) == lwc_error_ok && match)) {
+		} else if (keyword == DOTTED) {
 			side_val[side_count] = BORDER_STYLE_DOTTED;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[DASHED], &match) == lwc_error_ok && match)) {
+		} else if (keyword == DASHED) {
 			side_val[side_count] = BORDER_STYLE_DASHED;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[SOLID], &match) == lwc_error_ok && match)) {
+		} else if (keyword == SOLID) {
 			side_val[side_count] = BORDER_STYLE_SOLID;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[LIBCSS_DOUBLE], &match) == lwc_error_ok && match)) {
+		} else if (keyword == LIBCSS_DOUBLE) {
 			side_val[side_count] = BORDER_STYLE_DOUBLE;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[GROOVE], &match) == lwc_error_ok && match)) {
+		} else if (keyword == GROOVE) {
 			side_val[side_count] = BORDER_STYLE_GROOVE;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[RIDGE], &match) == lwc_error_ok && match)) {
+		} else if (keyword == RIDGE) {
 			side_val[side_count] = BORDER_STYLE_RIDGE;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[INSET], &match) == lwc_error_ok && match)) {
+		} else if (keyword == INSET) {
 			side_val[side_count] = BORDER_STYLE_INSET;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[OUTSET], &match) == lwc_error_ok && match)) {
+		} else if (keyword == OUTSET) {
 			side_val[side_count] = BORDER_STYLE_OUTSET;
 		} else {
 			break;
@@ -122,8 +122,7 @@ void output_token_type_check(FILE *outputf, bool do_token_check, struct keyval_l
 	fprintf(outputf,
 		"	int orig_ctx = *ctx;\n"
 		"	css_error error;\n"
-		"	const css_token *token;\n"
-		"	bool match;\n\n"
+		"	const css_token *token;\n\n"
 		"	token = parserutils_vector_iterate(vector, ctx);\n"
 		"	if (%stoken == NULL%s",
 		do_token_check ? "(" : "",
@@ -162,31 +161,40 @@ void output_ident(FILE *outputf, bool only_ident, struct keyval *parseid, struct
 {
 	int ident_count;
 
+	/* Keywords are matched with a switch over the propstring index of
+	 * the token, so the cost does not depend on the number of keywords.
+	 * Other token types fall through to the default case. */
+	if (only_ident) {
+		fprintf(outputf,
+			"switch (css__parse_keyword(c, token)) {\n");
+	} else {
+		fprintf(outputf,
+			"switch ((token->type == CSS_TOKEN_IDENT) ?\n"
+			"\t\t\tcss__parse_keyword(c, token) : LAST_KNOWN) {\n");
+	}
+
 	for (ident_count = 0 ; ident_count < IDENT->count; ident_count++) {
 		struct keyval *ckv = IDENT->item[ident_count];
 
 		fprintf(outputf,
-			"if (");
-		if (!only_ident) {
-			fprintf(outputf,
-			"(token->type == CSS_TOKEN_IDENT) && ");
-		}
-		fprintf(outputf,
-			"(lwc_string_caseless_isequal(token->idata, c->strings[%s], &match) == lwc_error_ok && match)) {\n",
+			"\tcase %s:\n",
 			ckv->key);
 		if (strcmp(ckv->key,"INHERIT") == 0) {
 		fprintf(outputf,
-			"\t\t\terror = css_stylesheet_style_inherit(result, %s);\n",
+			"\t\terror = css_stylesheet_style_inherit(result, %s);\n",
 			parseid->val);
 		} else {
 		fprintf(outputf,
-			"\t\t\terror = css__stylesheet_style_appendOPV(result, %s, %s);\n",
+			"\t\terror = css__stylesheet_style_appendOPV(result, %s, %s);\n",
 			parseid->val,
 			ckv->val);
 		}
 		fprintf(outputf,
-			"\t} else ");
+			"\t\tbreak;\n");
 	}
+
+	fprintf(outputf,
+		"\tdefault:\n\t");
 }
 
 void output_uri(FILE *outputf, struct keyval *parseid, struct keyval_list *kvlist)
@@ -613,6 +621,9 @@ output_header(outputf, descriptor, base.item[0], is_generic);
 			output_invalidcss(outputf);
 		}
 
+		if (IDENT.count > 0)
+			fprintf(outputf, "\t\tbreak;\n\t}\n\n");
+
 		output_footer(outputf);
 
 	}
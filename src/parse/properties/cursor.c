@@ -119,76 +119,61 @@ css_error css__parse_cursor(css_language *c,
 
 		/* IDENT */
 		if (token != NULL && token->type == CSS_TOKEN_IDENT) {
-			if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[AUTO],
-					&match) == lwc_error_ok && match)) {
+			switch (css__parse_keyword(c, token)) {
+			case AUTO:
 				error=CSS_APPEND(CURSOR_AUTO);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[CROSSHAIR],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case CROSSHAIR:
 				error=CSS_APPEND(CURSOR_CROSSHAIR);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[DEFAULT],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case DEFAULT:
 				error=CSS_APPEND(CURSOR_DEFAULT);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[POINTER],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case POINTER:
 				error=CSS_APPEND(CURSOR_POINTER);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[MOVE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case MOVE:
 				error=CSS_APPEND(CURSOR_MOVE);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[E_RESIZE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case E_RESIZE:
 				error=CSS_APPEND(CURSOR_E_RESIZE);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[NE_RESIZE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case NE_RESIZE:
 				error=CSS_APPEND(CURSOR_NE_RESIZE);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[NW_RESIZE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case NW_RESIZE:
 				error=CSS_APPEND(CURSOR_NW_RESIZE);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[N_RESIZE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case N_RESIZE:
 				error=CSS_APPEND(CURSOR_N_RESIZE);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[SE_RESIZE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case SE_RESIZE:
 				error=CSS_APPEND(CURSOR_SE_RESIZE);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[SW_RESIZE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case SW_RESIZE:
 				error=CSS_APPEND(CURSOR_SW_RESIZE);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[S_RESIZE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case S_RESIZE:
 				error=CSS_APPEND(CURSOR_S_RESIZE);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[W_RESIZE],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case W_RESIZE:
 				error=CSS_APPEND(CURSOR_W_RESIZE);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[LIBCSS_TEXT],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case LIBCSS_TEXT:
 				error=CSS_APPEND(CURSOR_TEXT);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[WAIT],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case WAIT:
 				error=CSS_APPEND(CURSOR_WAIT);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[HELP],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case HELP:
 				error=CSS_APPEND(CURSOR_HELP);
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[PROGRESS],
-					&match) == lwc_error_ok && match)) {
+				break;
+			case PROGRESS:
 				error=CSS_APPEND(CURSOR_PROGRESS);
-			} else {
+				break;
+			default:
 				error =  CSS_INVALID;
+				break;
 			}
 		}
 
@@ -38,7 +38,7 @@ css_error css__parse_elevation(css_language *c,
 	uint16_t value = 0;
 	css_fixed length = 0;
 	uint32_t unit = 0;
-	bool match;
+	int keyword = LAST_KNOWN;
 
 	/* angle | IDENT(below, level, above, higher, lower, inherit) */
 	token = parserutils_vector_peek(vector, *ctx);
@@ -47,40 +47,25 @@ css_error css__parse_elevation(css_language *c,
 		return CSS_INVALID;
 	}
 
-	if (token->type == CSS_TOKEN_IDENT &&
-		(lwc_string_caseless_isequal(
-			token->idata, c->strings[INHERIT],
-			&match) == lwc_error_ok && match)) {
+	if (token->type == CSS_TOKEN_IDENT)
+		keyword = css__parse_keyword(c, token);
+
+	if (keyword == INHERIT) {
 		parserutils_vector_iterate(vector, ctx);
 		flags = FLAG_INHERIT;
-	} else if (token->type == CSS_TOKEN_IDENT &&
-		(lwc_string_caseless_isequal(
-			token->idata, c->strings[BELOW],
-			&match) == lwc_error_ok && match)) {
+	} else if (keyword == BELOW) {
 		parserutils_vector_iterate(vector, ctx);
 		value = ELEVATION_BELOW;
-	} else if (token->type == CSS_TOKEN_IDENT &&
-		(lwc_string_caseless_isequal(
-			token->idata, c->strings[LEVEL],
-			&match) == lwc_error_ok && match)) {
+	} else if (keyword == LEVEL) {
 		parserutils_vector_iterate(vector, ctx);
 		value = ELEVATION_LEVEL;
-	} else if (token->type == CSS_TOKEN_IDENT &&
-		(lwc_string_caseless_isequal(
-			token->idata, c->strings[ABOVE],
-			&match) == lwc_error_ok && match)) {
+	} else if (keyword == ABOVE) {
 		parserutils_vector_iterate(vector, ctx);
 		value = ELEVATION_ABOVE;
-	} else if (token->type == CSS_TOKEN_IDENT &&
-		(lwc_string_caseless_isequal(
-			token->idata, c->strings[HIGHER],
-			&match) == lwc_error_ok && match)) {
+	} else if (keyword == HIGHER) {
 		parserutils_vector_iterate(vector, ctx);
 		value = ELEVATION_HIGHER;
-	} else if (token->type == CSS_TOKEN_IDENT &&
-		(lwc_string_caseless_isequal(
-			token->idata, c->strings[LOWER],
-			&match) == lwc_error_ok && match)) {
+	} else if (keyword == LOWER) {
 		parserutils_vector_iterate(vector, ctx);
 		value = ELEVATION_LOWER;
 	} else {
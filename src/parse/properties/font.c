@@ -18,7 +18,6 @@ static css_error parse_system_font(css_language *c,
 		css_style *result, css_system_font *system_font) 
 {
 	css_error error;
-	bool match;
 
 	/* style */
 	switch (system_font->style) {
@@ -138,17 +137,24 @@ static css_error parse_system_font(css_language *c,
 		return error;
 
 	/* font family */
-	if ((lwc_string_caseless_isequal(system_font->family, c->strings[SERIF], &match) == lwc_error_ok && match)) 
+	switch (css__propstrings_lookup(system_font->family)) {
+	case SERIF:
 		error = css__stylesheet_style_appendOPV(result, CSS_PROP_FONT_FAMILY, 0, FONT_FAMILY_SERIF);
-	else if ((lwc_string_caseless_isequal(system_font->family, c->strings[SANS_SERIF], &match) == lwc_error_ok && match))
+		break;
+	case SANS_SERIF:
 		error = css__stylesheet_style_appendOPV(result, CSS_PROP_FONT_FAMILY, 0, FONT_FAMILY_SANS_SERIF);
-	else if ((lwc_string_caseless_isequal(system_font->family, c->strings[CURSIVE], &match) == lwc_error_ok && match))
+		break;
+	case CURSIVE:
 		error = css__stylesheet_style_appendOPV(result, CSS_PROP_FONT_FAMILY, 0, FONT_FAMILY_CURSIVE);
-	else if ((lwc_string_caseless_isequal(system_font->family, c->strings[FANTASY], &match) == lwc_error_ok && match))
+		break;
+	case FANTASY:
 		error = css__stylesheet_style_appendOPV(result, CSS_PROP_FONT_FAMILY, 0, FONT_FAMILY_FANTASY);
-	else if ((lwc_string_caseless_isequal(system_font->family, c->strings[MONOSPACE], &match) == lwc_error_ok && match))
+		break;
+	case MONOSPACE:
 		error = css__stylesheet_style_appendOPV(result, CSS_PROP_FONT_FAMILY, 0, FONT_FAMILY_MONOSPACE);
-	else {
+		break;
+	default:
+	{
 		uint32_t snumber;
 
 		error = css__stylesheet_string_add(c->sheet, lwc_string_ref(system_font->family), &snumber);
@@ -160,6 +166,8 @@ static css_error parse_system_font(css_language *c,
 			return error;
 
 		error = css__stylesheet_style_append(result, snumber);
+		break;
+	}
 	}
 	if (error != CSS_OK)
 		return error;
@@ -22,23 +22,16 @@
  */
 static bool font_family_reserved(css_language *c, const css_token *ident)
 {
-	bool match;
-
-	return (lwc_string_caseless_isequal(
-			ident->idata, c->strings[SERIF],
-			&match) == lwc_error_ok && match) ||
-		(lwc_string_caseless_isequal(
-			ident->idata, c->strings[SANS_SERIF],
-			&match) == lwc_error_ok && match) ||
-		(lwc_string_caseless_isequal(
-			ident->idata, c->strings[CURSIVE],
-			&match) == lwc_error_ok && match) ||
-		(lwc_string_caseless_isequal(
-			ident->idata, c->strings[FANTASY],
-			&match) == lwc_error_ok && match) ||
-		(lwc_string_caseless_isequal(
-			ident->idata, c->strings[MONOSPACE],
-			&match) == lwc_error_ok && match);
+	switch (css__parse_keyword(c, ident)) {
+	case SERIF:
+	case SANS_SERIF:
+	case CURSIVE:
+	case FANTASY:
+	case MONOSPACE:
+		return true;
+	default:
+		return false;
+	}
 }
 
 /**
@@ -52,31 +45,28 @@ static bool font_family_reserved(css_language *c, const css_token *ident)
 static css_code_t font_family_value(css_language *c, const css_token *token, bool first)
 {
 	uint16_t value;
-	bool match;
 
 	if (token->type == CSS_TOKEN_IDENT) {
-		if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[SERIF],
-				&match) == lwc_error_ok && match))
+		switch (css__parse_keyword(c, token)) {
+		case SERIF:
 			value = FONT_FAMILY_SERIF;
-		else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[SANS_SERIF],
-				&match) == lwc_error_ok && match))
+			break;
+		case SANS_SERIF:
 			value = FONT_FAMILY_SANS_SERIF;
-		else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[CURSIVE],
-				&match) == lwc_error_ok && match))
+			break;
+		case CURSIVE:
 			value = FONT_FAMILY_CURSIVE;
-		else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[FANTASY],
-				&match) == lwc_error_ok && match))
+			break;
+		case FANTASY:
 			value = FONT_FAMILY_FANTASY;
-		else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[MONOSPACE],
-				&match) == lwc_error_ok && match))
+			break;
+		case MONOSPACE:
 			value = FONT_FAMILY_MONOSPACE;
-		else
+			break;
+		default:
 			value = FONT_FAMILY_IDENT_LIST;
+			break;
+		}
 	} else {
 		value = FONT_FAMILY_STRING;
 	}
@@ -34,7 +34,6 @@ css_error css__parse_overflow(css_language *c,
 	int orig_ctx = *ctx;
 	css_error error1, error2 = CSS_OK;
 	const css_token *token;
-	bool match;
 
 	token = parserutils_vector_iterate(vector, ctx);
 	if ((token == NULL) || ((token->type != CSS_TOKEN_IDENT))) {
@@ -42,48 +41,40 @@ css_error css__parse_overflow(css_language *c,
 		return CSS_INVALID;
 	}
 
-	if ((lwc_string_caseless_isequal(token->idata,
-			c->strings[INHERIT], &match) == lwc_error_ok &&
-			match)) {
+	switch (css__parse_keyword(c, token)) {
+	case INHERIT:
 		error1 = css_stylesheet_style_inherit(result,
 				CSS_PROP_OVERFLOW_X);
 		error2 = css_stylesheet_style_inherit(result,
 				CSS_PROP_OVERFLOW_Y);
-
-	} else if ((lwc_string_caseless_isequal(token->idata,
-			c->strings[VISIBLE], &match) == lwc_error_ok &&
-			match)) {
+		break;
+	case VISIBLE:
 		error1 = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_OVERFLOW_X, 0, OVERFLOW_VISIBLE);
 		error2 = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_OVERFLOW_Y, 0, OVERFLOW_VISIBLE);
-
-	} else if ((lwc_string_caseless_isequal(token->idata,
-			c->strings[HIDDEN], &match) == lwc_error_ok &&
-			match)) {
+		break;
+	case HIDDEN:
 		error1 = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_OVERFLOW_X, 0, OVERFLOW_HIDDEN);
 		error2 = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_OVERFLOW_Y, 0, OVERFLOW_HIDDEN);
-
-	} else if ((lwc_string_caseless_isequal(token->idata,
-			c->strings[SCROLL], &match) == lwc_error_ok &&
-			match)) {
+		break;
+	case SCROLL:
 		error1 = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_OVERFLOW_X, 0, OVERFLOW_SCROLL);
 		error2 = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_OVERFLOW_Y, 0, OVERFLOW_SCROLL);
-
-	} else if ((lwc_string_caseless_isequal(token->idata,
-			c->strings[AUTO], &match) == lwc_error_ok &&
-			match)) {
+		break;
+	case AUTO:
 		error1 = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_OVERFLOW_X, 0, OVERFLOW_AUTO);
 		error2 = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_OVERFLOW_Y, 0, OVERFLOW_AUTO);
-
-	} else {
+		break;
+	default:
 		error1 = CSS_INVALID;
+		break;
 	}
 
 	if (error2 != CSS_OK)
@@ -50,19 +50,17 @@ css_error css__parse_play_during(css_language *c,
 	}
 
 	if (token->type == CSS_TOKEN_IDENT) {
-		if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[INHERIT],
-				&match) == lwc_error_ok && match)) {
+		switch (css__parse_keyword(c, token)) {
+		case INHERIT:
 			flags |= FLAG_INHERIT;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[NONE],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case NONE:
 			value = PLAY_DURING_NONE;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[AUTO],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case AUTO:
 			value = PLAY_DURING_AUTO;
-		} else {
+			break;
+		default:
 			*ctx = orig_ctx;
 			return CSS_INVALID;
 		}
@@ -34,7 +34,7 @@ css_error css__parse_text_decoration(css_language *c,
 	int orig_ctx = *ctx;
 	css_error error = CSS_INVALID;
 	const css_token *token;
-	bool match;
+	int keyword;
 
 	/* IDENT([ underline || overline || line-through || blink ])
 	 * | IDENT (none, inherit) */
@@ -44,58 +44,40 @@ css_error css__parse_text_decoration(css_language *c,
 		return CSS_INVALID;
 	}
 
-	if (lwc_string_caseless_isequal(token->idata,
-			c->strings[INHERIT],
-			&match) == lwc_error_ok && match) {
+	keyword = css__parse_keyword(c, token);
+	if (keyword == INHERIT) {
 		error = css_stylesheet_style_inherit(result, CSS_PROP_TEXT_DECORATION);
-	} else if (lwc_string_caseless_isequal(token->idata,
-				c->strings[NONE],
-				&match) == lwc_error_ok && match) {
+	} else if (keyword == NONE) {
 		error = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_TEXT_DECORATION, 0, TEXT_DECORATION_NONE);
 	} else {
 		uint16_t value = 0;
 		while (token != NULL) {
-			if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[UNDERLINE],
-					&match) == lwc_error_ok && match)) {
-				if ((value & TEXT_DECORATION_UNDERLINE) == 0)
-					value |= TEXT_DECORATION_UNDERLINE;
-				else {
-					*ctx = orig_ctx;
-					return CSS_INVALID;
-				}
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[OVERLINE],
-					&match) == lwc_error_ok && match)) {
-				if ((value & TEXT_DECORATION_OVERLINE) == 0)
-					value |= TEXT_DECORATION_OVERLINE;
-				else {
-					*ctx = orig_ctx;
-					return CSS_INVALID;
-				}
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[LINE_THROUGH],
-					&match) == lwc_error_ok && match)) {
-				if ((value & TEXT_DECORATION_LINE_THROUGH) == 0)
-					value |= TEXT_DECORATION_LINE_THROUGH;
-				else {
-					*ctx = orig_ctx;
-					return CSS_INVALID;
-				}
-			} else if ((lwc_string_caseless_isequal(
-					token->idata, c->strings[BLINK],
-					&match) == lwc_error_ok && match)) {
-				if ((value & TEXT_DECORATION_BLINK) == 0)
-					value |= TEXT_DECORATION_BLINK;
-				else {
-					*ctx = orig_ctx;
-					return CSS_INVALID;
-				}
-			} else {
+			uint16_t flag;
+
+			switch (css__parse_keyword(c, token)) {
+			case UNDERLINE:
+				flag = TEXT_DECORATION_UNDERLINE;
+				break;
+			case OVERLINE:
+				flag = TEXT_DECORATION_OVERLINE;
+				break;
+			case LINE_THROUGH:
+				flag = TEXT_DECORATION_LINE_THROUGH;
+				break;
+			case BLINK:
+				flag = TEXT_DECORATION_BLINK;
+				break;
+			default:
+				*ctx = orig_ctx;
+				return CSS_INVALID;
+			}
+
+			if ((value & flag) != 0) {
 				*ctx = orig_ctx;
 				return CSS_INVALID;
 			}
+			value |= flag;
 
 			consumeWhitespace(vector, ctx);
 
@@ -31,75 +31,60 @@
 css_error css__parse_list_style_type_value(css_language *c, const css_token *ident,
 		uint16_t *value)
 {
-	bool match;
-
 	/* IDENT (disc, circle, square, decimal, decimal-leading-zero,
 	 *	  lower-roman, upper-roman, lower-greek, lower-latin,
 	 *	  upper-latin, armenian, georgian, lower-alpha, upper-alpha,
 	 *	  none)
 	 */
-	if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[DISC],
-			&match) == lwc_error_ok && match)) {
+	switch (css__parse_keyword(c, ident)) {
+	case DISC:
 		*value = LIST_STYLE_TYPE_DISC;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[CIRCLE],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case CIRCLE:
 		*value = LIST_STYLE_TYPE_CIRCLE;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[SQUARE],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case SQUARE:
 		*value = LIST_STYLE_TYPE_SQUARE;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[DECIMAL],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case DECIMAL:
 		*value = LIST_STYLE_TYPE_DECIMAL;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[DECIMAL_LEADING_ZERO],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case DECIMAL_LEADING_ZERO:
 		*value = LIST_STYLE_TYPE_DECIMAL_LEADING_ZERO;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[LOWER_ROMAN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case LOWER_ROMAN:
 		*value = LIST_STYLE_TYPE_LOWER_ROMAN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[UPPER_ROMAN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case UPPER_ROMAN:
 		*value = LIST_STYLE_TYPE_UPPER_ROMAN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[LOWER_GREEK],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case LOWER_GREEK:
 		*value = LIST_STYLE_TYPE_LOWER_GREEK;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[LOWER_LATIN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case LOWER_LATIN:
 		*value = LIST_STYLE_TYPE_LOWER_LATIN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[UPPER_LATIN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case UPPER_LATIN:
 		*value = LIST_STYLE_TYPE_UPPER_LATIN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[ARMENIAN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case ARMENIAN:
 		*value = LIST_STYLE_TYPE_ARMENIAN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[GEORGIAN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case GEORGIAN:
 		*value = LIST_STYLE_TYPE_GEORGIAN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[LOWER_ALPHA],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case LOWER_ALPHA:
 		*value = LIST_STYLE_TYPE_LOWER_ALPHA;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[UPPER_ALPHA],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case UPPER_ALPHA:
 		*value = LIST_STYLE_TYPE_UPPER_ALPHA;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[NONE],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case NONE:
 		*value = LIST_STYLE_TYPE_NONE;
-	} else
+		break;
+	default:
 		return CSS_INVALID;
+	}
 
 	return CSS_OK;
 }
@@ -367,7 +352,6 @@ css_error css__parse_colour_specifier(css_language *c,
 {
 	int orig_ctx = *ctx;
 	const css_token *token;
-	bool match;
 	css_error error;
 
 	consumeWhitespace(vector, ctx);
@@ -394,18 +378,17 @@ css_error css__parse_colour_specifier(css_language *c,
 	}
 
 	if (token->type == CSS_TOKEN_IDENT) {
-		if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[TRANSPARENT],
-				&match) == lwc_error_ok && match)) {
+		switch (css__parse_keyword(c, token)) {
+		case TRANSPARENT:
 			*value = COLOR_TRANSPARENT;
 			*result = 0; /* black transparent */
 			return CSS_OK;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[CURRENTCOLOR],
-				&match) == lwc_error_ok && match)) {
+		case CURRENTCOLOR:
 			*value = COLOR_CURRENT_COLOR;
 			*result = 0;
 			return CSS_OK;
+		default:
+			break;
 		}
 
 		error = css__parse_named_colour(c, token->idata, result);
@@ -439,22 +422,21 @@ css_error css__parse_colour_specifier(css_language *c,
 		uint8_t r = 0, g = 0, b = 0, a = 0xff;
 		int colour_channels = 0;
 
-		if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[RGB],
-				&match) == lwc_error_ok && match)) {
+		switch (css__parse_keyword(c, token)) {
+		case RGB:
 			colour_channels = 3;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[RGBA],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case RGBA:
 			colour_channels = 4;
-		} if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[HSL],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case HSL:
 			colour_channels = 5;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[HSLA],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case HSLA:
 			colour_channels = 6;
+			break;
+		default:
+			break;
 		}
 
 		if (colour_channels == 3 || colour_channels == 4) {
@@ -831,15 +813,9 @@ css_error css__parse_named_colour(css_language *c, lwc_string *data,
 		0xff9acd32  /* YELLOWGREEN */
 	};
 	int i;
-	bool match;
-
-	for (i = FIRST_COLOUR; i <= LAST_COLOUR; i++) {
-		if (lwc_string_caseless_isequal(data, c->strings[i],
-				&match) == lwc_error_ok && match)
-			break;
-	}
 
-	if (i <= LAST_COLOUR) {
+	i = css__propstrings_lookup(data);
+	if (i >= FIRST_COLOUR && i <= LAST_COLOUR) {
 		/* Known named colour */
 		*result = colourmap[i - FIRST_COLOUR];
 		return CSS_OK;
@@ -10,6 +10,22 @@
 
 #include "parse/language.h"
 
+/**
+ * Identify the known string named by a token, ignoring case
+ *
+ * \param c	 Parsing context
+ * \param token  Token to consider
+ * \return Propstring index of the token's data, or LAST_KNOWN if unknown
+ *
+ * Keywords are matched by switching on the result.
+ */
+static inline int css__parse_keyword(css_language *c, const css_token *token)
+{
+	UNUSED(c);
+
+	return css__propstrings_lookup(token->idata);
+}
+
 static inline bool is_css_inherit(css_language *c, const css_token *token) 
 {
 	bool match;
@@ -22,17 +22,14 @@
  */
 static bool voice_family_reserved(css_language *c, const css_token *ident)
 {
-	bool match;
-
-	return (lwc_string_caseless_isequal(
-			ident->idata, c->strings[MALE],
-			&match) == lwc_error_ok && match) ||
-		(lwc_string_caseless_isequal(
-			ident->idata, c->strings[FEMALE],
-			&match) == lwc_error_ok && match) ||
-		(lwc_string_caseless_isequal(
-			ident->idata, c->strings[CHILD],
-			&match) == lwc_error_ok && match);
+	switch (css__parse_keyword(c, ident)) {
+	case MALE:
+	case FEMALE:
+	case CHILD:
+		return true;
+	default:
+		return false;
+	}
 }
 
 /**
@@ -45,23 +42,22 @@ static bool voice_family_reserved(css_language *c, const css_token *ident)
 static css_code_t voice_family_value(css_language *c, const css_token *token, bool first)
 {
 	uint16_t value;
-	bool match;
 
 	if (token->type == CSS_TOKEN_IDENT) {
-		if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[MALE],
-				&match) == lwc_error_ok && match))
+		switch (css__parse_keyword(c, token)) {
+		case MALE:
 			value = VOICE_FAMILY_MALE;
-		else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[FEMALE],
-				&match) == lwc_error_ok && match))
+			break;
+		case FEMALE:
 			value = VOICE_FAMILY_FEMALE;
-		else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[CHILD],
-				&match) == lwc_error_ok && match))
+			break;
+		case CHILD:
 			value = VOICE_FAMILY_CHILD;
-		else
+			break;
+		default:
 			value = VOICE_FAMILY_IDENT_LIST;
+			break;
+		}
 	} else {
 		value = VOICE_FAMILY_STRING;
 	}
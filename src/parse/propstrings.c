@@ -9,15 +9,22 @@
 #include "stylesheet.h"
 
 #include <assert.h>
+#include <string.h>
 
 typedef struct stringmap_entry {
 	const char *data;
 	size_t len;
 } stringmap_entry;
 
+/** Number of slots in the keyword table; a power of two */
+#define KEYWORD_TABLE_SIZE 2048
+
 typedef struct css__propstrings_ctx {
 	uint32_t count;
 	lwc_string *strings[LAST_KNOWN];
+	/** Open addressed table of propstring indices plus one, keyed by
+	 * caseless hash of the string. Empty slots are 0. */
+	uint16_t keywords[KEYWORD_TABLE_SIZE];
 } css__propstrings_ctx;
 
 static css__propstrings_ctx css__propstrings;
@@ -630,6 +637,24 @@ css_error css__propstrings_get(lwc_string ***strings)
 			if (lerror != lwc_error_ok)
 				return CSS_NOMEM;
 		}
+
+		/* Index all known strings by their caseless hash */
+		for (i = 0; i < LAST_KNOWN; i++) {
+			lwc_hash hash;
+			uint32_t slot;
+
+			lerror = lwc_string_caseless_hash_value(
+					css__propstrings.strings[i], &hash);
+			if (lerror != lwc_error_ok)
+				return CSS_NOMEM;
+
+			slot = hash & (KEYWORD_TABLE_SIZE - 1);
+			while (css__propstrings.keywords[slot] != 0)
+				slot = (slot + 1) & (KEYWORD_TABLE_SIZE - 1);
+
+			css__propstrings.keywords[slot] = i + 1;
+		}
+
 		css__propstrings.count++;
 	}
 
@@ -652,7 +677,42 @@ void css__propstrings_unref(void)
 
 		for (i = 0; i < LAST_KNOWN; i++)
 			lwc_string_unref(css__propstrings.strings[i]);
+
+		memset(css__propstrings.keywords, 0,
+				sizeof(css__propstrings.keywords));
 	}
 }
 
+/**
+ * Find the known string matching a string, ignoring case
+ *
+ * \param string  String to look up
+ * \return Index of matching propstring, or LAST_KNOWN if none matches
+ *
+ * The propstring list must be held by the caller.  The result is intended
+ * to be used as the controlling expression of a switch over the propstring
+ * enumeration.
+ */
+int css__propstrings_lookup(lwc_string *string)
+{
+	lwc_hash hash;
+	uint32_t slot;
+
+	assert(css__propstrings.count > 0);
 
+	if (lwc_string_caseless_hash_value(string, &hash) != lwc_error_ok)
+		return LAST_KNOWN;
+
+	for (slot = hash & (KEYWORD_TABLE_SIZE - 1);
+			css__propstrings.keywords[slot] != 0;
+			slot = (slot + 1) & (KEYWORD_TABLE_SIZE - 1)) {
+		int i = css__propstrings.keywords[slot] - 1;
+
+		/* Both strings have been caselessly interned */
+		if (css__propstrings.strings[i]->insensitive ==
+				string->insensitive)
+			return i;
+	}
+
+	return LAST_KNOWN;
+}
@@ -150,6 +150,7 @@ enum {
 
 css_error css__propstrings_get(lwc_string ***strings);
 void css__propstrings_unref(void);
+int css__propstrings_lookup(lwc_string *string);
 
 #endif
 
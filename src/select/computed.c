@@ -5,14 +5,17 @@
  * Copyright 2009 John-Mark Bell <jmb@netsurf-browser.org>
  */
 
+#include <stddef.h>
 #include <string.h>
 #include <libcss/computed.h>
 
 #include "select/arena.h"
 #include "select/computed.h"
 #include "select/dispatch.h"
+#include "select/pool.h"
 #include "select/propget.h"
 #include "select/propset.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 static css_error compute_absolute_color(css_computed_style *style,
@@ -73,10 +76,12 @@ css_error css__computed_style_create(css_computed_style **result)
 	if (result == NULL)
 		return CSS_BADPARM;
 
-	s = calloc(sizeof(css_computed_style), 1);
+	s = css__pool_alloc(sizeof(css_computed_style));
 	if (s == NULL)
 		return CSS_NOMEM;
 
+	memset(s, 0, sizeof(css_computed_style));
+
 	s->bin = UINT32_MAX;
 	*result = s;
 
@@ -111,7 +116,7 @@ css_error css__computed_uncommon_destroy(css_computed_uncommon *uncommon)
 				lwc_string_unref(c->name);
 			}
 
-			free(uncommon->counter_increment);
+			css__free(uncommon->counter_increment);
 		}
 
 		if (uncommon->counter_reset != NULL) {
@@ -122,7 +127,7 @@ css_error css__computed_uncommon_destroy(css_computed_uncommon *uncommon)
 				lwc_string_unref(c->name);
 			}
 
-			free(uncommon->counter_reset);
+			css__free(uncommon->counter_reset);
 		}
 
 		if (uncommon->cursor != NULL) {
@@ -132,7 +137,7 @@ css_error css__computed_uncommon_destroy(css_computed_uncommon *uncommon)
 				lwc_string_unref(*s);
 			}
 
-			free(uncommon->cursor);
+			css__free(uncommon->cursor);
 		}
 
 		if (uncommon->content != NULL) {
@@ -163,10 +168,10 @@ css_error css__computed_uncommon_destroy(css_computed_uncommon *uncommon)
 				}
 			}
 
-			free(uncommon->content);
+			css__free(uncommon->content);
 		}
 
-		free(uncommon);
+		css__pool_free(uncommon, sizeof(css_computed_uncommon));
 	}
 
 	return CSS_OK;
@@ -180,6 +185,8 @@ css_error css__computed_uncommon_destroy(css_computed_uncommon *uncommon)
  */
 css_error css_computed_style_destroy(css_computed_style *style)
 {
+	size_t i;
+
 	if (style == NULL)
 		return CSS_BADPARM;
 
@@ -193,12 +200,15 @@ css_error css_computed_style_destroy(css_computed_style *style)
 		css__arena_remove_style(style);
 	}
 
-	if (style->page != NULL) {
-		free(style->page);
+	/* Flat extension blocks hold no references */
+	for (i = 0; i < GROUP_COUNT; i++) {
+		if (prop_groups[i].size != 0)
+			css__pool_free(prop_groups[i].block(style),
+					prop_groups[i].size);
 	}
 
 	if (style->i.aural != NULL) {
-		free(style->i.aural);
+		css__free(style->i.aural);
 	}
 
 	if (style->font_family != NULL) {
@@ -208,7 +218,7 @@ css_error css_computed_style_destroy(css_computed_style *style)
 			lwc_string_unref(*s);
 		}
 
-		free(style->font_family);
+		css__free(style->font_family);
 	}
 
 	if (style->quotes != NULL) {
@@ -218,7 +228,7 @@ css_error css_computed_style_destroy(css_computed_style *style)
 			lwc_string_unref(*s);
 		}
 
-		free(style->quotes);
+		css__free(style->quotes);
 	}
 
 	if (style->i.list_style_image != NULL)
@@ -228,10 +238,9 @@ css_error css_computed_style_destroy(css_computed_style *style)
 	if (style->background_image != NULL)
 		css__computed_image_destroy(style->background_image);
 
-  if (style->radius != NULL)
-		free(style->radius);
+	css__pool_free(style->layout, sizeof(css_computed_layout));
 
-	free(style);
+	css__pool_free(style, sizeof(css_computed_style));
 
 	return CSS_OK;
 }
@@ -297,6 +306,7 @@ css_error css_computed_style_compose(
 		css_computed_style **result)
 {
 	css_computed_style *composed;
+	bool skip[GROUP_COUNT];
 	css_error error;
 	size_t i;
 
@@ -310,26 +320,17 @@ css_error css_computed_style_compose(
 		return error;
 	}
 
+	/* Extension blocks absent from both styles hold initial values
+	 * throughout, so the composed style may leave them absent, too */
+	for (i = 0; i < GROUP_COUNT; i++) {
+		skip[i] = css__group_present(parent, i) == false &&
+				css__group_present(child, i) == false;
+	}
+
 	/* Iterate through the properties */
 	for (i = 0; i < CSS_N_PROPERTIES; i++) {
-		/* Skip any in extension blocks if the block does not exist */
-		switch(prop_dispatch[i].group) {
-		case GROUP_NORMAL:
-			break;
-		case GROUP_UNCOMMON:
-			if (parent->i.uncommon == NULL &&
-					child->i.uncommon == NULL)
-				continue;
-			break;
-		case GROUP_PAGE:
-			if (parent->page == NULL && child->page == NULL)
-				continue;
-			break;
-		case GROUP_AURAL:
-			if (parent->i.aural == NULL && child->i.aural == NULL)
-				continue;
-			break;
-		}
+		if (skip[prop_dispatch[i].group])
+			continue;
 
 		/* Compose the property */
 		error = prop_dispatch[i].compose(parent, child, composed);
@@ -348,6 +349,798 @@ css_error css_computed_style_compose(
 	return css__arena_intern_style(result);
 }
 
+/******************************************************************************
+ * Style differencing                                                         *
+ ******************************************************************************/
+
+/**
+ * Determine the change classes implied by a change to a property
+ *
+ * \param prop  The property which has changed
+ * \return Mask of css_computed_change values
+ */
+static inline uint32_t diff_impact(opcode_t prop)
+{
+	uint32_t impact = prop_dispatch[prop].impact;
+
+	if (prop_dispatch[prop].inherited)
+		impact |= CSS_COMPUTED_CHANGE_INHERITED;
+
+	return impact;
+}
+
+/**
+ * Location of (part of) a property's storage within a computed style block
+ */
+typedef struct diff_region {
+	uint16_t offset;	/**< Byte offset of region within block */
+	uint8_t size;		/**< Size of region, in bytes */
+	uint8_t mask;		/**< Mask for a single byte, or 0 for whole bytes */
+	uint8_t prop;		/**< Property stored in region */
+} diff_region;
+
+/** Maximum number of regions in the storage map */
+#define DIFF_MAX_REGIONS 512
+
+/**
+ * Storage map of the property groups, derived from prop_dispatch
+ */
+static struct diff_map {
+	bool built;			/**< Whether the map has been built */
+	uint16_t n_regions;		/**< Number of entries in regions */
+	diff_region regions[DIFF_MAX_REGIONS];
+	struct {
+		uint16_t first;		/**< Index of group's first region */
+		uint16_t count;		/**< Number of regions in group */
+		uint32_t impact;	/**< Union of group's change classes */
+		/** Bits of each byte which belong to a region */
+		uint8_t claimed[sizeof(struct css_computed_style_i)];
+		/** Contents of an absent block, with initial values */
+		uint8_t absent[sizeof(struct css_computed_style_i)];
+	} groups[GROUP_COUNT];
+} diff_map;
+
+/**
+ * Scratch style, with every extension block present
+ */
+typedef struct diff_scratch {
+	css_computed_style style;
+	css_computed_uncommon uncommon;
+	css_computed_page page;
+	css_computed_flexbox flexbox;
+	css_computed_border_radius radius;
+} diff_scratch;
+
+/**
+ * Initialise a scratch style
+ *
+ * \param s     Scratch style to initialise
+ * \param fill  Byte to fill storage with
+ *
+ * Pointers are cleared, as setters release the values they replace.
+ */
+static void diff_scratch_init(diff_scratch *s, int fill)
+{
+	memset(s, fill, sizeof(*s));
+
+	s->style.i.list_style_image = NULL;
+	s->style.i.uncommon = &s->uncommon;
+	s->style.i.aural = NULL;
+	s->style.font_family = NULL;
+	s->style.quotes = NULL;
+	s->style.page = &s->page;
+	s->style.next = NULL;
+	s->style.flexbox = &s->flexbox;
+	s->style.radius = &s->radius;
+	s->style.background_image = NULL;
+	s->style.layout = NULL;
+
+	s->uncommon.counter_increment = NULL;
+	s->uncommon.counter_reset = NULL;
+	s->uncommon.content = NULL;
+	s->uncommon.cursor = NULL;
+	s->uncommon.next = NULL;
+}
+
+/**
+ * Retrieve a property group's block from a style, for comparison
+ *
+ * \param style  Style to retrieve block from
+ * \param group  Group to retrieve block of
+ * \param size   Pointer to location to receive comparable size of block
+ * \return Pointer to block, or NULL if the group has no storage
+ *
+ * Absent extension blocks are represented by their initial values.
+ */
+static const uint8_t *diff_group_block(const css_computed_style *style,
+		enum prop_group group, size_t *size)
+{
+	const void *block;
+
+	switch (group) {
+	case GROUP_NORMAL:
+		*size = offsetof(struct css_computed_style_i, uncommon);
+		return (const uint8_t *) &style->i;
+	case GROUP_UNCOMMON:
+		*size = sizeof(struct css_computed_uncommon_i);
+		block = style->i.uncommon != NULL ?
+				&style->i.uncommon->i : NULL;
+		break;
+	default:
+		*size = prop_groups[group].size;
+		if (*size == 0)
+			return NULL;
+
+		block = prop_groups[group].block(style);
+		break;
+	}
+
+	return block != NULL ? block : diff_map.groups[group].absent;
+}
+
+/**
+ * UA default callback used while probing initial handlers
+ *
+ * \param pw        Unused
+ * \param property  Unused
+ * \param hint      Hint to populate
+ * \return CSS_OK, always.
+ */
+static css_error diff_probe_ua_default(void *pw, uint32_t property,
+		css_hint *hint)
+{
+	UNUSED(pw);
+	UNUSED(property);
+
+	memset(hint, 0, sizeof(*hint));
+
+	return CSS_OK;
+}
+
+/**
+ * Initialise the selection state used to run initial handlers
+ *
+ * \param state    State to initialise
+ * \param handler  Handler table to initialise, for use by state
+ */
+static void diff_probe_state_init(css_select_state *state,
+		css_select_handler *handler)
+{
+	memset(handler, 0, sizeof(*handler));
+	handler->ua_default_for_property = diff_probe_ua_default;
+
+	memset(state, 0, sizeof(*state));
+	state->handler = handler;
+}
+
+/**
+ * Font size callback used while computing initial values
+ *
+ * \param pw      Unused
+ * \param parent  Unused
+ * \param size    Hint to populate
+ * \return CSS_OK, always.
+ *
+ * No initial value is relative to the font size, so any size will do.
+ */
+static css_error diff_probe_font_size(void *pw, const css_hint *parent,
+		css_hint *size)
+{
+	UNUSED(pw);
+	UNUSED(parent);
+
+	size->status = CSS_FONT_SIZE_DIMENSION;
+	size->data.length.value = INTTOFIX(16);
+	size->data.length.unit = CSS_UNIT_PX;
+
+	return CSS_OK;
+}
+
+/**
+ * Record the contents of each group's block when all its properties have
+ * their computed initial values, which is what an absent block represents
+ */
+static void diff_probe_absent(void)
+{
+	css_select_handler handler;
+	css_select_state state;
+	diff_scratch s;
+	uint32_t group;
+	opcode_t prop;
+
+	diff_probe_state_init(&state, &handler);
+
+	/* Storage not written by initial handlers keeps its default */
+	diff_scratch_init(&s, 0);
+	s.uncommon.i = default_uncommon.i;
+	s.page = default_page;
+	s.flexbox = default_flexbox;
+	s.radius = default_border_radius;
+
+	state.computed = &s.style;
+
+	for (prop = 0; prop < CSS_N_PROPERTIES; prop++)
+		prop_dispatch[prop].initial(&state);
+
+	css__compute_absolute_values(NULL, &s.style,
+			diff_probe_font_size, NULL);
+
+	for (group = GROUP_NORMAL + 1; group < GROUP_COUNT; group++) {
+		const uint8_t *block;
+		size_t size;
+
+		block = diff_group_block(&s.style, group, &size);
+		if (block != NULL)
+			memcpy(diff_map.groups[group].absent, block, size);
+	}
+}
+
+/**
+ * Add the storage of a property to the map
+ *
+ * \param prop   Property to probe
+ * \param group  Property's group
+ *
+ * As for the initial value template, the property's initial handler is
+ * run over one scratch style with every bit clear, and another with every
+ * bit set.  A bit belongs to the property if the handler changes it in
+ * either style.
+ */
+static void diff_probe_property(opcode_t prop, enum prop_group group)
+{
+	diff_scratch orig[2], scratch[2];
+	css_select_handler handler;
+	css_select_state state;
+	const uint8_t *o[2], *s[2];
+	diff_region *r = NULL;
+	size_t size, b;
+	int k;
+
+	diff_probe_state_init(&state, &handler);
+
+	for (k = 0; k < 2; k++) {
+		diff_scratch_init(&orig[k], k == 0 ? 0 : 0xff);
+		diff_scratch_init(&scratch[k], k == 0 ? 0 : 0xff);
+
+		state.computed = &scratch[k].style;
+		if (prop_dispatch[prop].initial(&state) != CSS_OK)
+			return;
+
+		o[k] = diff_group_block(&orig[k].style, group, &size);
+		s[k] = diff_group_block(&scratch[k].style, group, &size);
+	}
+
+	for (b = 0; b < size; b++) {
+		uint8_t owned = (s[0][b] ^ o[0][b]) | (s[1][b] ^ o[1][b]);
+
+		if (owned == 0)
+			continue;
+
+		diff_map.groups[group].claimed[b] |= owned;
+
+		/* Merge whole bytes into the property's previous region */
+		if (owned == 0xff && r != NULL && r->mask == 0 &&
+				r->offset + r->size == b && r->size < UINT8_MAX) {
+			r->size++;
+			continue;
+		}
+
+		if (diff_map.n_regions == DIFF_MAX_REGIONS)
+			return;
+
+		r = &diff_map.regions[diff_map.n_regions++];
+		r->offset = b;
+		r->size = 1;
+		r->mask = owned == 0xff ? 0 : owned;
+		r->prop = prop;
+	}
+}
+
+/**
+ * Build the storage map, if it hasn't been built already
+ *
+ * The map is built on first use, so the first call must not race with
+ * another, as with the rest of LibCSS.
+ */
+static void diff_map_build(void)
+{
+	uint32_t group;
+	opcode_t prop;
+
+	if (diff_map.built)
+		return;
+
+	diff_probe_absent();
+
+	for (group = 0; group < GROUP_COUNT; group++) {
+		size_t size;
+		diff_scratch s;
+
+		diff_scratch_init(&s, 0);
+		if (diff_group_block(&s.style, group, &size) == NULL)
+			continue;
+
+		diff_map.groups[group].first = diff_map.n_regions;
+
+		for (prop = 0; prop < CSS_N_PROPERTIES; prop++) {
+			if (prop_dispatch[prop].group != group)
+				continue;
+
+			diff_map.groups[group].impact |= diff_impact(prop);
+			diff_probe_property(prop, group);
+		}
+
+		diff_map.groups[group].count = diff_map.n_regions -
+				diff_map.groups[group].first;
+	}
+
+	/* The list style image is compared as a pointer, separately */
+	memset(diff_map.groups[GROUP_NORMAL].claimed +
+			offsetof(struct css_computed_style_i,
+					list_style_image),
+			0xff, sizeof(lwc_string *));
+
+	diff_map.built = true;
+}
+
+/**
+ * Compare the properties stored in two instances of a style block
+ *
+ * \param group  Group the block belongs to
+ * \param a      First block
+ * \param b      Second block
+ * \param size   Size of the directly comparable part of the block
+ * \return Mask of css_computed_change values
+ */
+static uint32_t diff_block(enum prop_group group,
+		const uint8_t *a, const uint8_t *b, size_t size)
+{
+	const diff_region *r = diff_map.regions + diff_map.groups[group].first;
+	const diff_region *end = r + diff_map.groups[group].count;
+	const uint8_t *claimed = diff_map.groups[group].claimed;
+	uint32_t changes = CSS_COMPUTED_CHANGE_NONE;
+	size_t i;
+
+	/* Most blocks are identical; only classify those which are not */
+	if (memcmp(a, b, size) == 0)
+		return changes;
+
+	for (; r != end; r++) {
+		if (r->mask != 0) {
+			if (((a[r->offset] ^ b[r->offset]) & r->mask) == 0)
+				continue;
+		} else if (memcmp(a + r->offset, b + r->offset,
+				r->size) == 0) {
+			continue;
+		}
+
+		changes |= diff_impact(r->prop);
+	}
+
+	/* Storage which a property uses for only some of its values, such
+	 * as the rectangle of clip, isn't written by its initial handler.
+	 * Changes there are attributed to every property in the group. */
+	for (i = 0; i < size; i++) {
+		if (((a[i] ^ b[i]) & ~claimed[i]) != 0)
+			return changes | diff_map.groups[group].impact;
+	}
+
+	return changes;
+}
+
+/**
+ * Compare two NULL-terminated string lists
+ *
+ * \return True if the lists are equal, false otherwise
+ */
+static bool diff_string_list_equal(lwc_string **a, lwc_string **b)
+{
+	if (a == b)
+		return true;
+
+	if (a == NULL || b == NULL)
+		return false;
+
+	for (; *a != NULL && *b != NULL; a++, b++) {
+		if (*a != *b)
+			return false;
+	}
+
+	return *a == *b;
+}
+
+/**
+ * Compare two counter lists
+ *
+ * \return True if the lists are equal, false otherwise
+ */
+static bool diff_counters_equal(const css_computed_counter *a,
+		const css_computed_counter *b)
+{
+	if (a == b)
+		return true;
+
+	if (a == NULL || b == NULL)
+		return false;
+
+	for (; a->name != NULL && b->name != NULL; a++, b++) {
+		if (a->name != b->name || a->value != b->value)
+			return false;
+	}
+
+	return a->name == b->name;
+}
+
+/**
+ * Compare two content item lists
+ *
+ * \return True if the lists are equal, false otherwise
+ */
+static bool diff_content_equal(const css_computed_content_item *a,
+		const css_computed_content_item *b)
+{
+	if (a == b)
+		return true;
+
+	if (a == NULL || b == NULL)
+		return false;
+
+	for (; a->type != CSS_COMPUTED_CONTENT_NONE; a++, b++) {
+		if (a->type != b->type)
+			return false;
+
+		switch (a->type) {
+		case CSS_COMPUTED_CONTENT_STRING:
+			if (a->data.string != b->data.string)
+				return false;
+			break;
+		case CSS_COMPUTED_CONTENT_URI:
+			if (a->data.uri != b->data.uri)
+				return false;
+			break;
+		case CSS_COMPUTED_CONTENT_ATTR:
+			if (a->data.attr != b->data.attr)
+				return false;
+			break;
+		case CSS_COMPUTED_CONTENT_COUNTER:
+			if (a->data.counter.name != b->data.counter.name ||
+					a->data.counter.style !=
+					b->data.counter.style)
+				return false;
+			break;
+		case CSS_COMPUTED_CONTENT_COUNTERS:
+			if (a->data.counters.name != b->data.counters.name ||
+					a->data.counters.sep !=
+					b->data.counters.sep ||
+					a->data.counters.style !=
+					b->data.counters.style)
+				return false;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return b->type == CSS_COMPUTED_CONTENT_NONE;
+}
+
+/**
+ * Compare two colour stop lists
+ *
+ * \return True if the lists are equal, false otherwise
+ */
+static bool diff_stops_equal(const css_computed_color_stop *a,
+		const css_computed_color_stop *b, uint8_t nstop)
+{
+	uint8_t i;
+
+	for (i = 0; i < nstop; i++) {
+		if (a[i].color != b[i].color || a[i].stop != b[i].stop ||
+				a[i].stopunit != b[i].stopunit)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare two computed images
+ *
+ * \return True if the images are equal, false otherwise
+ */
+static bool diff_image_equal(const css_computed_image *a,
+		const css_computed_image *b)
+{
+	if (a == b)
+		return true;
+
+	if (a == NULL || b == NULL || a->type != b->type)
+		return false;
+
+	switch (a->type) {
+	case CSS_COMPUTED_IMAGE_URI:
+		return a->data.uri == b->data.uri;
+	case CSS_COMPUTED_IMAGE_LINEAR_GRADIENT:
+	case CSS_COMPUTED_IMAGE_REPEATING_LINEAR_GRADIENT:
+	{
+		const css_computed_linear_gradient *la = a->data.linear;
+		const css_computed_linear_gradient *lb = b->data.linear;
+
+		return la->angle == lb->angle &&
+				la->angleunit == lb->angleunit &&
+				la->nstop == lb->nstop &&
+				diff_stops_equal(la->stops, lb->stops,
+						la->nstop);
+	}
+	case CSS_COMPUTED_IMAGE_RADIAL_GRADIENT:
+	case CSS_COMPUTED_IMAGE_REPEATING_RADIAL_GRADIENT:
+	{
+		const css_computed_radial_gradient *ra = a->data.radial;
+		const css_computed_radial_gradient *rb = b->data.radial;
+
+		return ra->info == rb->info &&
+				ra->x == rb->x && ra->y == rb->y &&
+				ra->xradius == rb->xradius &&
+				ra->yradius == rb->yradius &&
+				ra->xunit == rb->xunit &&
+				ra->yunit == rb->yunit &&
+				ra->xradiusunit == rb->xradiusunit &&
+				ra->yradiusunit == rb->yradiusunit &&
+				ra->nstop == rb->nstop &&
+				diff_stops_equal(ra->stops, rb->stops,
+						ra->nstop);
+	}
+	default:
+		break;
+	}
+
+	return true;
+}
+
+/**
+ * Determine which classes of property differ between two computed styles
+ *
+ * \param old_style  The style previously in use
+ * \param new_style  The replacement style
+ * \param changes    Pointer to location to receive mask of
+ *                   css_computed_change values
+ * \return CSS_OK on success,
+ *         CSS_BADPARM on bad parameters.
+ *
+ * Absent extension blocks compare as their initial values. Values are
+ * compared as stored, so two styles which differ only in the units of
+ * an unresolved length will be reported as changed.
+ */
+css_error css_computed_style_diff(
+		const css_computed_style *old_style,
+		const css_computed_style *new_style,
+		uint32_t *changes)
+{
+	const css_computed_uncommon *ua, *ub;
+	uint32_t result = CSS_COMPUTED_CHANGE_NONE;
+	uint32_t group;
+
+	if (old_style == NULL || new_style == NULL || changes == NULL)
+		return CSS_BADPARM;
+
+	/* Interned styles with identical content share a pointer */
+	if (old_style == new_style) {
+		*changes = CSS_COMPUTED_CHANGE_NONE;
+		return CSS_OK;
+	}
+
+	diff_map_build();
+
+	for (group = 0; group < GROUP_COUNT; group++) {
+		const uint8_t *a, *b;
+		size_t size;
+
+		a = diff_group_block(old_style, group, &size);
+		b = diff_group_block(new_style, group, &size);
+		if (a != b)
+			result |= diff_block(group, a, b, size);
+	}
+
+	if (old_style->i.list_style_image != new_style->i.list_style_image)
+		result |= diff_impact(CSS_PROP_LIST_STYLE_IMAGE);
+
+	if (old_style->font_family != new_style->font_family &&
+			!diff_string_list_equal(old_style->font_family,
+					new_style->font_family))
+		result |= diff_impact(CSS_PROP_FONT_FAMILY);
+
+	if (old_style->quotes != new_style->quotes &&
+			!diff_string_list_equal(old_style->quotes,
+					new_style->quotes))
+		result |= diff_impact(CSS_PROP_QUOTES);
+
+	if (!diff_image_equal(old_style->background_image,
+			new_style->background_image))
+		result |= diff_impact(CSS_PROP_BACKGROUND_IMAGE);
+
+	ua = old_style->i.uncommon;
+	ub = new_style->i.uncommon;
+	if (ua != ub) {
+		if (ua == NULL)
+			ua = &default_uncommon;
+		if (ub == NULL)
+			ub = &default_uncommon;
+
+		if (!diff_counters_equal(ua->counter_increment,
+				ub->counter_increment))
+			result |= diff_impact(CSS_PROP_COUNTER_INCREMENT);
+
+		if (!diff_counters_equal(ua->counter_reset,
+				ub->counter_reset))
+			result |= diff_impact(CSS_PROP_COUNTER_RESET);
+
+		if (!diff_content_equal(ua->content, ub->content))
+			result |= diff_impact(CSS_PROP_CONTENT);
+
+		if (!diff_string_list_equal(ua->cursor, ub->cursor))
+			result |= diff_impact(CSS_PROP_CURSOR);
+	}
+
+	*changes = result;
+
+	return CSS_OK;
+}
+
+/******************************************************************************
+ * Layout snapshots                                                           *
+ ******************************************************************************/
+
+/**
+ * Extract the layout-relevant properties of a style
+ *
+ * \param style   Style to extract from
+ * \param layout  Snapshot to populate
+ *
+ * Display is fixed up as for a non-root element.
+ */
+static void layout_snapshot(const css_computed_style *style,
+		css_computed_layout *layout)
+{
+	memset(layout, 0, sizeof(*layout));
+
+#define LAYOUT_LENGTH(l, get)						\
+	(l).type = get(style, &(l).value, &(l).unit)
+
+	LAYOUT_LENGTH(layout->width, get_width);
+	LAYOUT_LENGTH(layout->height, get_height);
+	LAYOUT_LENGTH(layout->min_width, get_min_width);
+	LAYOUT_LENGTH(layout->min_height, get_min_height);
+	LAYOUT_LENGTH(layout->max_width, get_max_width);
+	LAYOUT_LENGTH(layout->max_height, get_max_height);
+
+	LAYOUT_LENGTH(layout->offset[0], css_computed_top);
+	LAYOUT_LENGTH(layout->offset[1], css_computed_right);
+	LAYOUT_LENGTH(layout->offset[2], css_computed_bottom);
+	LAYOUT_LENGTH(layout->offset[3], css_computed_left);
+
+	LAYOUT_LENGTH(layout->margin[0], get_margin_top);
+	LAYOUT_LENGTH(layout->margin[1], get_margin_right);
+	LAYOUT_LENGTH(layout->margin[2], get_margin_bottom);
+	LAYOUT_LENGTH(layout->margin[3], get_margin_left);
+
+	LAYOUT_LENGTH(layout->padding[0], get_padding_top);
+	LAYOUT_LENGTH(layout->padding[1], get_padding_right);
+	LAYOUT_LENGTH(layout->padding[2], get_padding_bottom);
+	LAYOUT_LENGTH(layout->padding[3], get_padding_left);
+
+	LAYOUT_LENGTH(layout->border_width[0], get_border_top_width);
+	LAYOUT_LENGTH(layout->border_width[1], get_border_right_width);
+	LAYOUT_LENGTH(layout->border_width[2], get_border_bottom_width);
+	LAYOUT_LENGTH(layout->border_width[3], get_border_left_width);
+
+#undef LAYOUT_LENGTH
+
+	layout->flex_grow_type = get_flex_grow(style, &layout->flex_grow);
+	layout->flex_shrink_type = get_flex_shrink(style, &layout->flex_shrink);
+	layout->flex_basis_type = get_flex_basis(style, &layout->flex_basis);
+	layout->flex_direction = get_flex_direction(style);
+	layout->flex_wrap = get_flex_wrap(style);
+	layout->justify_content = get_justify_content(style);
+	layout->align_content = get_align_content(style);
+	layout->align_items = get_align_items(style);
+	layout->align_self = get_align_self(style);
+
+	layout->border_style[0] = get_border_top_style(style);
+	layout->border_style[1] = get_border_right_style(style);
+	layout->border_style[2] = get_border_bottom_style(style);
+	layout->border_style[3] = get_border_left_style(style);
+
+	layout->display = css_computed_display(style, false);
+	layout->position = get_position(style);
+	layout->floating = css_computed_float(style);
+	layout->clear = get_clear(style);
+	layout->overflow_x = get_overflow_x(style);
+	layout->overflow_y = get_overflow_y(style);
+	layout->direction = get_direction(style);
+	layout->writing_mode = get_writing_mode(style);
+}
+
+/**
+ * Retrieve the layout-relevant properties of a computed style
+ *
+ * \param style   Style to query
+ * \param root    Whether \a style belongs to the root element
+ * \param layout  Pointer to snapshot to populate
+ * \return CSS_OK on success,
+ *         CSS_BADPARM on bad parameters.
+ *
+ * The snapshot of an interned style is cached on the style, so nodes
+ * sharing a style share the cost of building it.
+ */
+css_error css_computed_layout_snapshot(
+		const css_computed_style *style,
+		bool root,
+		css_computed_layout *layout)
+{
+	if (style == NULL || layout == NULL)
+		return CSS_BADPARM;
+
+	if (style->layout != NULL) {
+		memcpy(layout, style->layout, sizeof(*layout));
+	} else {
+		layout_snapshot(style, layout);
+
+		/* Interned styles are immutable, so the snapshot is safe to
+		 * keep. Failure to allocate the cache is not fatal. */
+		if (style->bin != UINT32_MAX) {
+			css_computed_style *s = (css_computed_style *) style;
+
+			s->layout = css__pool_alloc(sizeof(*layout));
+			if (s->layout != NULL)
+				memcpy(s->layout, layout, sizeof(*layout));
+		}
+	}
+
+	if (root)
+		layout->display = css_computed_display(style, true);
+
+	return CSS_OK;
+}
+
+/**
+ * Retrieve the layout-relevant properties of a number of computed styles
+ *
+ * \param styles    Array of styles to query
+ * \param n_styles  Number of entries in \a styles
+ * \param layouts   Array of \a n_styles snapshots to populate
+ * \return CSS_OK on success,
+ *         CSS_BADPARM on bad parameters.
+ *
+ * All styles are treated as belonging to non-root elements.
+ */
+css_error css_computed_layout_snapshot_batch(
+		const css_computed_style *const *styles,
+		size_t n_styles,
+		css_computed_layout *layouts)
+{
+	size_t i;
+
+	if (styles == NULL || layouts == NULL)
+		return CSS_BADPARM;
+
+	for (i = 0; i < n_styles; i++) {
+		css_error error;
+
+		/* Runs of siblings frequently share a style */
+		if (i > 0 && styles[i] == styles[i - 1]) {
+			memcpy(&layouts[i], &layouts[i - 1], sizeof(*layouts));
+			continue;
+		}
+
+		error = css_computed_layout_snapshot(styles[i], false,
+				&layouts[i]);
+		if (error != CSS_OK)
+			return error;
+	}
+
+	return CSS_OK;
+}
+
 /******************************************************************************
  * Property accessors                                                         *
  ******************************************************************************/
@@ -1819,11 +2612,13 @@ css_error css__computed_image_destroy(css_computed_image *image)
 			if (image->type == CSS_COMPUTED_IMAGE_LINEAR_GRADIENT ||
 					image->type == CSS_COMPUTED_IMAGE_REPEATING_LINEAR_GRADIENT) {
 				if (image->data.linear->stops)
-					free(image->data.linear->stops);
-        free(image->data.linear);
+					css__free(image->data.linear->stops);
+        css__free(image->data.linear);
+			} else if (image->type == CSS_COMPUTED_IMAGE_URI) {
+				lwc_string_unref(image->data.uri);
 			}
 		}
-		free(image);
+		css__free(image);
 	}
 
 	return CSS_OK;
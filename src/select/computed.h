@@ -360,6 +360,8 @@ struct css_computed_style {
 	/* css3 support */
 	css_computed_border_radius *radius;
 	css_computed_image *background_image;
+
+	css_computed_layout *layout;	/**< Cached layout snapshot */
 };
 
 
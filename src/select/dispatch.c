@@ -5,9 +5,50 @@
  * Copyright 2009 John-Mark Bell <jmb@netsurf-browser.org>
  */
 
+#include "select/computed.h"
 #include "select/dispatch.h"
 #include "select/properties/properties.h"
 
+static void *uncommon_block(const css_computed_style *style)
+{
+	return style->i.uncommon;
+}
+
+static void *page_block(const css_computed_style *style)
+{
+	return style->page;
+}
+
+static void *aural_block(const css_computed_style *style)
+{
+	return style->i.aural;
+}
+
+static void *flexbox_block(const css_computed_style *style)
+{
+	return style->flexbox;
+}
+
+static void *radius_block(const css_computed_style *style)
+{
+	return style->radius;
+}
+
+/**
+ * Extension blocks, indexed by group
+ *
+ * The uncommon block owns strings and arrays, and the aural block is never
+ * allocated, so neither is flat.
+ */
+const struct prop_group_table prop_groups[GROUP_COUNT] = {
+	{ NULL, 0 },
+	{ uncommon_block, 0 },
+	{ page_block, sizeof(css_computed_page) },
+	{ aural_block, 0 },
+	{ flexbox_block, sizeof(css_computed_flexbox) },
+	{ radius_block, sizeof(css_computed_border_radius) }
+};
+
 /**
  * Dispatch table for properties, indexed by opcode
  */
@@ -21,633 +62,759 @@ struct prop_table prop_dispatch[CSS_N_PROPERTIES] = {
 	{
 		PROPERTY_FUNCS(azimuth),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(background_attachment),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(background_color),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(background_image),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(background_position),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(background_repeat),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(border_collapse),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_spacing),
 		1,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_top_color),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(border_right_color),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(border_bottom_color),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(border_left_color),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(border_top_style),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_right_style),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_bottom_style),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_left_style),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_top_width),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_right_width),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_bottom_width),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_left_width),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(bottom),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(caption_side),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(clear),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(clip),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(color),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(content),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(counter_increment),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(counter_reset),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(cue_after),
 		0,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(cue_before),
 		0,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(cursor),
 		1,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(direction),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(display),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(elevation),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(empty_cells),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(float),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(font_family),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(font_size),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(font_style),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(font_variant),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(font_weight),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(height),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(left),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(letter_spacing),
 		1,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(line_height),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(list_style_image),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(list_style_position),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(list_style_type),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(margin_top),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(margin_right),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(margin_bottom),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(margin_left),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(max_height),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(max_width),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(min_height),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(min_width),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(orphans),
 		1,
-		GROUP_PAGE
+		GROUP_PAGE,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(outline_color),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(outline_style),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(outline_width),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(overflow_x),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(padding_top),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(padding_right),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(padding_bottom),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(padding_left),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(page_break_after),
 		0,
-		GROUP_PAGE
+		GROUP_PAGE,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(page_break_before),
 		0,
-		GROUP_PAGE
+		GROUP_PAGE,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(page_break_inside),
 		1,
-		GROUP_PAGE
+		GROUP_PAGE,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(pause_after),
 		0,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(pause_before),
 		0,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(pitch_range),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(pitch),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(play_during),
 		0,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(position),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(quotes),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(richness),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(right),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(speak_header),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(speak_numeral),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(speak_punctuation),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(speak),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(speech_rate),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(stress),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(table_layout),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(text_align),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(text_decoration),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(text_indent),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(text_transform),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(top),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(unicode_bidi),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(vertical_align),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(visibility),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(voice_family),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(volume),
 		1,
-		GROUP_AURAL
+		GROUP_AURAL,
+		CSS_COMPUTED_CHANGE_NONE
 	},
 	{
 		PROPERTY_FUNCS(white_space),
 		1,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(widows),
 		1,
-		GROUP_PAGE
+		GROUP_PAGE,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(width),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(word_spacing),
 		1,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_TEXT
 	},
 	{
 		PROPERTY_FUNCS(z_index),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(opacity),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(break_after),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(break_before),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(break_inside),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(column_count),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(column_fill),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(column_gap),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(column_rule_color),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(column_rule_style),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(column_rule_width),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(column_span),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(column_width),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(writing_mode),
 		0,
-		GROUP_UNCOMMON
+		GROUP_UNCOMMON,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(overflow_y),
 		0,
-		GROUP_NORMAL
+		GROUP_NORMAL,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	}
     
 	,/* facebook css layout support  */
 	{
 		PROPERTY_FUNCS(flex_direction),
 		0,
-		GROUP_FLEXBOX
+		GROUP_FLEXBOX,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(justify_content),
 		0,
-		GROUP_FLEXBOX
+		GROUP_FLEXBOX,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(align_content),
 		0,
-		GROUP_FLEXBOX
+		GROUP_FLEXBOX,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(align_items),
 		0,
-		GROUP_FLEXBOX
+		GROUP_FLEXBOX,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(align_self),
 		0,
-		GROUP_FLEXBOX
+		GROUP_FLEXBOX,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(flex_wrap),
 		0,
-		GROUP_FLEXBOX
+		GROUP_FLEXBOX,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(flex_grow),
 		0,
-		GROUP_FLEXBOX
+		GROUP_FLEXBOX,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(flex_shrink),
 		0,
-		GROUP_FLEXBOX
+		GROUP_FLEXBOX,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(flex_basis),
 		0,
-		GROUP_FLEXBOX
+		GROUP_FLEXBOX,
+		CSS_COMPUTED_CHANGE_LAYOUT
 	},
 	{
 		PROPERTY_FUNCS(border_top_left_radius),
 		0,
-		GROUP_NORMAL
+		GROUP_RADIUS,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(border_top_right_radius),
 		0,
-		GROUP_NORMAL
+		GROUP_RADIUS,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(border_bottom_right_radius),
 		0,
-		GROUP_NORMAL
+		GROUP_RADIUS,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 	{
 		PROPERTY_FUNCS(border_bottom_left_radius),
 		0,
-		GROUP_NORMAL
+		GROUP_RADIUS,
+		CSS_COMPUTED_CHANGE_PAINT
 	},
 };
@@ -8,6 +8,8 @@
 #ifndef css_select_dispatch_h_
 #define css_select_dispatch_h_
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <libcss/errors.h>
@@ -25,9 +27,40 @@ enum prop_group {
 	GROUP_UNCOMMON	= 0x1,
 	GROUP_PAGE	= 0x2,
 	GROUP_AURAL	= 0x3,
-	GROUP_FLEXBOX   = 04
+	GROUP_FLEXBOX	= 0x4,
+	GROUP_RADIUS	= 0x5,
+
+	GROUP_COUNT
 };
 
+/**
+ * Extension block table, indexed by property group
+ *
+ * Properties outside GROUP_NORMAL live in separately allocated blocks,
+ * which are absent until one of their properties is set to a value other
+ * than its initial value. While absent, the property accessors report
+ * initial values.
+ */
+extern const struct prop_group_table {
+	/** Retrieve group's block from a style, or NULL for GROUP_NORMAL */
+	void *(*block)(const css_computed_style *style);
+	size_t size;		/**< Size of flat block, or 0 */
+} prop_groups[GROUP_COUNT];
+
+/**
+ * Determine whether a property group's storage exists in a style
+ *
+ * \param style  Style to test
+ * \param group  Group to test for
+ * \return True if the group's block is present, false otherwise
+ */
+static inline bool css__group_present(const css_computed_style *style,
+		enum prop_group group)
+{
+	return prop_groups[group].block == NULL ||
+			prop_groups[group].block(style) != NULL;
+}
+
 extern struct prop_table {
 	css_error (*cascade)(uint32_t opv, css_style *style, 
 			css_select_state *state);
@@ -39,6 +72,7 @@ extern struct prop_table {
 			css_computed_style *result);
 	unsigned int inherited;
 	unsigned int group;
+	unsigned int impact;	/**< css_computed_change class of property */
 } prop_dispatch[CSS_N_PROPERTIES];
 
 #endif
@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include "select/font_face.h"
+#include "utils/alloc.h"
 
 static void font_faces_srcs_destroy(css_font_face *font_face)
 {
@@ -21,7 +22,7 @@ static void font_faces_srcs_destroy(css_font_face *font_face)
 		}
 	}
 	
-	free(srcs);
+	css__free(srcs);
 	font_face->srcs = NULL;
 }
 
@@ -47,7 +48,7 @@ css_error css__font_face_create(css_font_face **result)
 	if (result == NULL)
 		return CSS_BADPARM;
 	
-	f = malloc(sizeof(css_font_face));
+	f = css__malloc(sizeof(css_font_face));
 	if (f == NULL)
 		return CSS_NOMEM;
 	
@@ -75,7 +76,7 @@ css_error css__font_face_destroy(css_font_face *font_face)
 	if (font_face->srcs != NULL)
 		font_faces_srcs_destroy(font_face);
 
-	free(font_face);
+	css__free(font_face);
 	
 	return CSS_OK;
 }
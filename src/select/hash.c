@@ -9,13 +9,17 @@
 #include <string.h>
 
 #include "stylesheet.h"
+#include "parse/propstrings.h"
 #include "select/hash.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #undef PRINT_CHAIN_BLOOM_DETAILS
 
 typedef struct hash_entry {
 	const css_selector *sel;
+	lwc_string *name;	/**< Insensitive name chain is keyed by */
+	lwc_string *element;	/**< Insensitive element name, or NULL */
 	css_bloom sel_chain_bloom[CSS_BLOOM_SIZE];
 	struct hash_entry *next;
 } hash_entry;
@@ -23,10 +27,16 @@ typedef struct hash_entry {
 typedef struct hash_t {
 #define DEFAULT_SLOTS (1<<6)
 	size_t n_slots;
+	size_t n_used;		/**< Number of selectors in the table */
 
 	hash_entry *slots;
 } hash_t;
 
+typedef struct attribute_chain {
+	lwc_string *name;	/**< Attribute name */
+	hash_entry chain;	/**< Selectors keyed by the attribute */
+} attribute_chain;
+
 struct css_selector_hash {
 	hash_t elements;
 
@@ -36,15 +46,31 @@ struct css_selector_hash {
 
 	hash_entry universal;
 
+	/** Universal selectors requiring a dynamic pseudo class, which are
+	 * only considered for nodes in that state */
+	hash_entry pseudo_classes[CSS_HASH_PSEUDO_CLASS_COUNT];
+	lwc_string *pseudo_class_names[CSS_HASH_PSEUDO_CLASS_COUNT];
+
+	/** Universal selectors requiring an attribute, which are only
+	 * considered for nodes having that attribute */
+	attribute_chain *attributes;
+	uint32_t n_attributes;
+
 	size_t hash_size;
+
+	bool sorted;		/**< Whether all chains are in cascade order */
 };
 
 static hash_entry empty_slot;
 
 static inline lwc_string *_class_name(const css_selector *selector);
 static inline lwc_string *_id_name(const css_selector *selector);
+static css_error _universal_chain(css_selector_hash *hash,
+		const css_selector *selector, bool create, hash_entry **head);
+static void _hash_grow(css_selector_hash *ctx, hash_t *table);
+static void _hash_sort(css_selector_hash *ctx);
 static css_error _insert_into_chain(css_selector_hash *ctx, hash_entry *head, 
-		const css_selector *selector);
+		const css_selector *selector, lwc_string *name);
 static css_error _remove_from_chain(css_selector_hash *ctx, hash_entry *head,
 		const css_selector *selector);
 
@@ -87,23 +113,15 @@ static css_error _iterate_universal(
  *   element name is a match.  If it comes from the class or id hash,
  *   we have to test for a match.
  *
- * \param selector	selector chain head to test
- * \param qname		element name to look for
+ * \param entry	hash entry for selector chain head to test
+ * \param qname	element name to look for
  * \return true iff chain head doesn't fail to match element name
  */
-static inline bool _chain_good_for_element_name(const css_selector *selector,
-		const css_qname *qname, const lwc_string *uni)
+static inline bool _chain_good_for_element_name(const hash_entry *entry,
+		const css_qname *qname)
 {
-	if (selector->data.qname.name != uni) {
-		bool match;
-		if (lwc_string_caseless_isequal(
-				selector->data.qname.name, qname->name,
-				&match) == lwc_error_ok && match == false) {
-			return false;
-		}
-	}
-
-	return true;
+	return entry->element == NULL ||
+			entry->element == qname->name->insensitive;
 }
 
 /**
@@ -136,53 +154,101 @@ static inline bool _rule_good_for_media(const css_rule *rule, uint64_t media)
 	return applies;
 }
 
+/**
+ * Find the first selector in a universal chain that may match
+ *
+ * \param req   Selection requirements
+ * \param head  Head of chain to search
+ * \return Entry for selector, or the empty slot if none
+ */
+static inline hash_entry *_find_in_chain(
+		const struct css_hash_selection_requirments *req,
+		hash_entry *head)
+{
+	if (head->sel != NULL) {
+		/* Search through chain for first match */
+		while (head != NULL) {
+			if (RULE_HAS_BYTECODE(head) &&
+			    css_bloom_in_bloom(
+					head->sel_chain_bloom,
+					req->node_bloom) &&
+			    _rule_good_for_media(head->sel->rule,
+					req->media)) {
+				/* Found a match */
+				break;
+			}
+
+			head = head->next;
+		}
+
+		if (head == NULL)
+			head = &empty_slot;
+	}
+
+	return head;
+}
+
 
 /**
  * Create a hash
  *
- * \param hash   Pointer to location to receive result
+ * \param strings  Interned property strings of the owning sheet
+ * \param hash     Pointer to location to receive result
  * \return CSS_OK on success, appropriate error otherwise
  */
-css_error css__selector_hash_create(css_selector_hash **hash)
+css_error css__selector_hash_create(lwc_string **strings,
+		css_selector_hash **hash)
 {
 	css_selector_hash *h;
 
-	if (hash == NULL)
+	if (strings == NULL || hash == NULL)
 		return CSS_BADPARM;
 
-	h = calloc(1, sizeof(css_selector_hash));
+	h = css__calloc(1, sizeof(css_selector_hash));
 	if (h == NULL)
 		return CSS_NOMEM;
 
 	/* Element hash */
-	h->elements.slots = calloc(DEFAULT_SLOTS, sizeof(hash_entry));
+	h->elements.slots = css__calloc(DEFAULT_SLOTS, sizeof(hash_entry));
 	if (h->elements.slots == NULL) {
-		free(h);
+		css__free(h);
 		return CSS_NOMEM;
 	}
 	h->elements.n_slots = DEFAULT_SLOTS;
 
 	/* Class hash */
-	h->classes.slots = calloc(DEFAULT_SLOTS, sizeof(hash_entry));
+	h->classes.slots = css__calloc(DEFAULT_SLOTS, sizeof(hash_entry));
 	if (h->classes.slots == NULL) {
-		free(h->elements.slots);
-		free(h);
+		css__free(h->elements.slots);
+		css__free(h);
 		return CSS_NOMEM;
 	}
 	h->classes.n_slots = DEFAULT_SLOTS;
 
 	/* ID hash */
-	h->ids.slots = calloc(DEFAULT_SLOTS, sizeof(hash_entry));
+	h->ids.slots = css__calloc(DEFAULT_SLOTS, sizeof(hash_entry));
 	if (h->ids.slots == NULL) {
-		free(h->classes.slots);
-		free(h->elements.slots);
-		free(h);
+		css__free(h->classes.slots);
+		css__free(h->elements.slots);
+		css__free(h);
 		return CSS_NOMEM;
 	}
 	h->ids.n_slots = DEFAULT_SLOTS;
 
 	/* Universal chain head already initiliased by calloc of `h`. */
 
+	/* As are the keyed universal chains. The parser stores pseudo
+	 * class names in their canonical, lower case, form, so selectors
+	 * are found by pointer comparison with the interned names. */
+	h->pseudo_class_names[CSS_HASH_PSEUDO_CLASS_LINK] = strings[LINK];
+	h->pseudo_class_names[CSS_HASH_PSEUDO_CLASS_VISITED] = strings[VISITED];
+	h->pseudo_class_names[CSS_HASH_PSEUDO_CLASS_HOVER] = strings[HOVER];
+	h->pseudo_class_names[CSS_HASH_PSEUDO_CLASS_ACTIVE] = strings[ACTIVE];
+	h->pseudo_class_names[CSS_HASH_PSEUDO_CLASS_FOCUS] = strings[FOCUS];
+
+	/* Empty chains are trivially ordered */
+	h->sorted = true;
+
 	h->hash_size = sizeof(css_selector_hash) + 
 			DEFAULT_SLOTS * sizeof(hash_entry) +
 			DEFAULT_SLOTS * sizeof(hash_entry) +
@@ -212,39 +278,60 @@ css_error css__selector_hash_destroy(css_selector_hash *hash)
 		for (d = hash->elements.slots[i].next; d != NULL; d = e) {
 			e = d->next;
 
-			free(d);
+			css__free(d);
 		}
 	}
-	free(hash->elements.slots);
+	css__free(hash->elements.slots);
 
 	/* Class hash */
 	for (i = 0; i < hash->classes.n_slots; i++) {
 		for (d = hash->classes.slots[i].next; d != NULL; d = e) {
 			e = d->next;
 
-			free(d);
+			css__free(d);
 		}
 	}
-	free(hash->classes.slots);
+	css__free(hash->classes.slots);
 
 	/* ID hash */
 	for (i = 0; i < hash->ids.n_slots; i++) {
 		for (d = hash->ids.slots[i].next; d != NULL; d = e) {
 			e = d->next;
 
-			free(d);
+			css__free(d);
 		}
 	}
-	free(hash->ids.slots);
+	css__free(hash->ids.slots);
 
 	/* Universal chain */
 	for (d = hash->universal.next; d != NULL; d = e) {
 		e = d->next;
 
-		free(d);
+		css__free(d);
+	}
+
+	/* Pseudo class chains */
+	for (i = 0; i < CSS_HASH_PSEUDO_CLASS_COUNT; i++) {
+		for (d = hash->pseudo_classes[i].next; d != NULL; d = e) {
+			e = d->next;
+
+			css__free(d);
+		}
+	}
+
+	/* Attribute chains */
+	for (i = 0; i < hash->n_attributes; i++) {
+		for (d = hash->attributes[i].chain.next; d != NULL; d = e) {
+			e = d->next;
+
+			css__free(d);
+		}
+
+		lwc_string_unref(hash->attributes[i].name);
 	}
+	css__free(hash->attributes);
 
-	free(hash);
+	css__free(hash);
 
 	return CSS_OK;
 }
@@ -259,6 +346,8 @@ css_error css__selector_hash_destroy(css_selector_hash *hash)
 css_error css__selector_hash_insert(css_selector_hash *hash,
 		const css_selector *selector)
 {
+	hash_t *table;
+	hash_entry *head;
 	uint32_t index, mask;
 	lwc_string *name;
 	css_error error;
@@ -269,32 +358,36 @@ css_error css__selector_hash_insert(css_selector_hash *hash,
 	/* Work out which hash to insert into */
 	if ((name = _id_name(selector)) != NULL) {
 		/* Named ID */
-		mask = hash->ids.n_slots - 1;
-		index = _hash_name(name) & mask;
-
-		error = _insert_into_chain(hash, &hash->ids.slots[index],
-				selector);
+		table = &hash->ids;
 	} else if ((name = _class_name(selector)) != NULL) {
 		/* Named class */
-		mask = hash->classes.n_slots - 1;
-		index = _hash_name(name) & mask;
-
-		error = _insert_into_chain(hash, &hash->classes.slots[index],
-				selector);
+		table = &hash->classes;
 	} else if (lwc_string_length(selector->data.qname.name) != 1 ||
 			lwc_string_data(selector->data.qname.name)[0] != '*') {
 		/* Named element */
-		mask = hash->elements.n_slots - 1;
-		index = _hash_name(selector->data.qname.name) & mask;
-
-		error = _insert_into_chain(hash, &hash->elements.slots[index],
-				selector);
+		name = selector->data.qname.name;
+		table = &hash->elements;
 	} else {
-		/* Universal chain */
-		error = _insert_into_chain(hash, &hash->universal, selector);
+		/* Universal or keyed universal chain */
+		error = _universal_chain(hash, selector, true, &head);
+		if (error != CSS_OK)
+			return error;
+
+		return _insert_into_chain(hash, head, selector, NULL);
 	}
 
-	return error;
+	mask = table->n_slots - 1;
+	index = _hash_name(name) & mask;
+
+	error = _insert_into_chain(hash, &table->slots[index], selector, name);
+	if (error != CSS_OK)
+		return error;
+
+	/* Keep chains short for large sheets */
+	if (++table->n_used > 2 * table->n_slots)
+		_hash_grow(hash, table);
+
+	return CSS_OK;
 }
 
 /**
@@ -307,6 +400,8 @@ css_error css__selector_hash_insert(css_selector_hash *hash,
 css_error css__selector_hash_remove(css_selector_hash *hash,
 		const css_selector *selector)
 {
+	hash_t *table;
+	hash_entry *head;
 	uint32_t index, mask;
 	lwc_string *name;
 	css_error error;
@@ -317,31 +412,31 @@ css_error css__selector_hash_remove(css_selector_hash *hash,
 	/* Work out which hash to remove from */
 	if ((name = _id_name(selector)) != NULL) {
 		/* Named ID */
-		mask = hash->ids.n_slots - 1;
-		index = _hash_name(name) & mask;
-
-		error = _remove_from_chain(hash, &hash->ids.slots[index],
-				selector);
+		table = &hash->ids;
 	} else if ((name = _class_name(selector)) != NULL) {
 		/* Named class */
-		mask = hash->classes.n_slots - 1;
-		index = _hash_name(name) & mask;
-
-		error = _remove_from_chain(hash, &hash->classes.slots[index],
-				selector);
+		table = &hash->classes;
 	} else if (lwc_string_length(selector->data.qname.name) != 1 ||
 			lwc_string_data(selector->data.qname.name)[0] != '*') {
 		/* Named element */
-		mask = hash->elements.n_slots - 1;
-		index = _hash_name(selector->data.qname.name) & mask;
-
-		error = _remove_from_chain(hash, &hash->elements.slots[index],
-				selector);
+		name = selector->data.qname.name;
+		table = &hash->elements;
 	} else {
-		/* Universal chain */
-		error = _remove_from_chain(hash, &hash->universal, selector);
+		/* Universal or keyed universal chain */
+		error = _universal_chain(hash, selector, false, &head);
+		if (error != CSS_OK)
+			return error;
+
+		return _remove_from_chain(hash, head, selector);
 	}
 
+	mask = table->n_slots - 1;
+	index = _hash_name(name) & mask;
+
+	error = _remove_from_chain(hash, &table->slots[index], selector);
+	if (error == CSS_OK)
+		table->n_used--;
+
 	return error;
 }
 
@@ -362,37 +457,26 @@ css_error css__selector_hash_find(css_selector_hash *hash,
 		const css_selector ***matched)
 {
 	uint32_t index, mask;
-	lwc_hash name_hash;
+	lwc_string *name;
 	hash_entry *head;
 
 	if (hash == NULL || req == NULL || iterator == NULL || matched == NULL)
 		return CSS_BADPARM;
 
+	if (hash->sorted == false)
+		_hash_sort(hash);
+
 	/* Find index */
 	mask = hash->elements.n_slots - 1;
-
-	if (lwc_string_caseless_hash_value(req->qname.name,
-			&name_hash) != lwc_error_ok) {
-		return CSS_NOMEM;
-	}
-	index = name_hash & mask;
+	name = req->qname.name->insensitive;
+	index = lwc_string_hash_value(name) & mask;
 
 	head = &hash->elements.slots[index];
 
 	if (head->sel != NULL) {
 		/* Search through chain for first match */
 		while (head != NULL) {
-			lwc_error lerror;
-			bool match = false;
-
-			lerror = lwc_string_isequal(
-					req->qname.name->insensitive,
-					head->sel->data.qname.name->insensitive,
-					&match);
-			if (lerror != lwc_error_ok)
-				return css_error_from_lwc_error(lerror);
-
-			if (match && RULE_HAS_BYTECODE(head)) {
+			if (head->name == name && RULE_HAS_BYTECODE(head)) {
 				if (css_bloom_in_bloom(
 						head->sel_chain_bloom,
 						req->node_bloom) &&
@@ -433,53 +517,37 @@ css_error css__selector_hash_find_by_class(css_selector_hash *hash,
 		const css_selector ***matched)
 {
 	uint32_t index, mask;
-	lwc_hash class_hash;
+	lwc_string *name;
 	hash_entry *head;
 
 	if (hash == NULL || req == NULL || req->class == NULL ||
 			iterator == NULL || matched == NULL)
 		return CSS_BADPARM;
 
+	if (hash->sorted == false)
+		_hash_sort(hash);
+
 	/* Find index */
 	mask = hash->classes.n_slots - 1;
 
-	if (lwc_string_caseless_hash_value(req->class,
-			&class_hash) != lwc_error_ok) {
-		return CSS_NOMEM;
-	}
-	index = class_hash & mask;
+	name = req->class->insensitive;
+	index = lwc_string_hash_value(name) & mask;
 
 	head = &hash->classes.slots[index];
 
 	if (head->sel != NULL) {
 		/* Search through chain for first match */
 		while (head != NULL) {
-			lwc_error lerror;
-			lwc_string *n;
-			bool match = false;
-
-			n = _class_name(head->sel);
-			if (n != NULL) {
-				lerror = lwc_string_isequal(
-						req->class->insensitive,
-						n->insensitive, &match);
-				if (lerror != lwc_error_ok)
-					return css_error_from_lwc_error(lerror);
-
-				if (match && RULE_HAS_BYTECODE(head)) {
-					if (css_bloom_in_bloom(
-							head->sel_chain_bloom,
-							req->node_bloom) &&
-					    _chain_good_for_element_name(
-							head->sel,
-							&(req->qname),
-							req->uni) &&
-					    _rule_good_for_media(
-							head->sel->rule,
-							req->media)) {
-						/* Found a match */
-						break;
-					}
+			if (head->name == name && RULE_HAS_BYTECODE(head)) {
+				if (css_bloom_in_bloom(
+						head->sel_chain_bloom,
+						req->node_bloom) &&
+				    _chain_good_for_element_name(head,
+						&req->qname) &&
+				    _rule_good_for_media(head->sel->rule,
+						req->media)) {
+					/* Found a match */
+					break;
 				}
 			}
 
@@ -513,53 +581,37 @@ css_error css__selector_hash_find_by_id(css_selector_hash *hash,
 		const css_selector ***matched)
 {
 	uint32_t index, mask;
-	lwc_hash id_hash;
+	lwc_string *name;
 	hash_entry *head;
 
 	if (hash == NULL || req == NULL || req->id == NULL ||
 			iterator == NULL || matched == NULL)
 		return CSS_BADPARM;
 
+	if (hash->sorted == false)
+		_hash_sort(hash);
+
 	/* Find index */
 	mask = hash->ids.n_slots - 1;
 
-	if (lwc_string_caseless_hash_value(req->id,
-			&id_hash) != lwc_error_ok) {
-		return CSS_NOMEM;
-	}
-	index = id_hash & mask;
+	name = req->id->insensitive;
+	index = lwc_string_hash_value(name) & mask;
 
 	head = &hash->ids.slots[index];
 
 	if (head->sel != NULL) {
 		/* Search through chain for first match */
 		while (head != NULL) {
-			lwc_error lerror;
-			lwc_string *n;
-			bool match = false;
-
-			n = _id_name(head->sel);
-			if (n != NULL) {
-				lerror = lwc_string_isequal(
-						req->id->insensitive,
-						n->insensitive, &match);
-				if (lerror != lwc_error_ok)
-					return css_error_from_lwc_error(lerror);
-
-				if (match && RULE_HAS_BYTECODE(head)) {
-					if (css_bloom_in_bloom(
-							head->sel_chain_bloom,
-							req->node_bloom) &&
-					    _chain_good_for_element_name(
-							head->sel,
-							&req->qname,
-							req->uni) &&
-					    _rule_good_for_media(
-							head->sel->rule,
-							req->media)) {
-						/* Found a match */
-						break;
-					}
+			if (head->name == name && RULE_HAS_BYTECODE(head)) {
+				if (css_bloom_in_bloom(
+						head->sel_chain_bloom,
+						req->node_bloom) &&
+				    _chain_good_for_element_name(head,
+						&req->qname) &&
+				    _rule_good_for_media(head->sel->rule,
+						req->media)) {
+					/* Found a match */
+					break;
 				}
 			}
 
@@ -591,35 +643,107 @@ css_error css__selector_hash_find_universal(css_selector_hash *hash,
 		css_selector_hash_iterator *iterator,
 		const css_selector ***matched)
 {
-	hash_entry *head;
-
 	if (hash == NULL || req == NULL || iterator == NULL || matched == NULL)
 		return CSS_BADPARM;
 
-	head = &hash->universal;
+	if (hash->sorted == false)
+		_hash_sort(hash);
 
-	if (head->sel != NULL) {
-		/* Search through chain for first match */
-		while (head != NULL) {
-			if (RULE_HAS_BYTECODE(head) &&
-			    css_bloom_in_bloom(
-					head->sel_chain_bloom,
-					req->node_bloom) &&
-			    _rule_good_for_media(head->sel->rule,
-					req->media)) {
-				/* Found a match */
-				break;
-			}
+	(*iterator) = _iterate_universal;
+	(*matched) = (const css_selector **) _find_in_chain(req,
+			&hash->universal);
 
-			head = head->next;
-		}
+	return CSS_OK;
+}
 
-		if (head == NULL)
-			head = &empty_slot;
-	}
+/**
+ * Find the first universal selector requiring a dynamic pseudo class
+ *
+ * \param hash      Hash to search
+ * \param req       Selection requirements, with pseudo_class set
+ * \param iterator  Pointer to location to receive iterator function
+ * \param matched   Pointer to location to receive selector
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * If nothing matches, CSS_OK will be returned and **matched == NULL
+ *
+ * \note The caller must only search the chains of pseudo classes the
+ *       node is in, as the pseudo class itself isn't tested.
+ */
+css_error css__selector_hash_find_by_pseudo_class(css_selector_hash *hash,
+		const struct css_hash_selection_requirments *req,
+		css_selector_hash_iterator *iterator,
+		const css_selector ***matched)
+{
+	if (hash == NULL || req == NULL || iterator == NULL ||
+			matched == NULL ||
+			req->pseudo_class >= CSS_HASH_PSEUDO_CLASS_COUNT)
+		return CSS_BADPARM;
+
+	if (hash->sorted == false)
+		_hash_sort(hash);
 
 	(*iterator) = _iterate_universal;
-	(*matched) = (const css_selector **) head;
+	(*matched) = (const css_selector **) _find_in_chain(req,
+			&hash->pseudo_classes[req->pseudo_class]);
+
+	return CSS_OK;
+}
+
+/**
+ * Find the first universal selector requiring an attribute
+ *
+ * \param hash      Hash to search
+ * \param req       Selection requirements, with attribute set
+ * \param name      Pointer to location to receive attribute name
+ * \param iterator  Pointer to location to receive iterator function
+ * \param matched   Pointer to location to receive selector
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * If nothing matches, CSS_OK will be returned and **matched == NULL
+ *
+ * \note The caller must only use the chain if the node has the attribute
+ *       named by \a name, in the null namespace.  Otherwise none of the
+ *       selectors in the chain can match.
+ */
+css_error css__selector_hash_find_by_attribute(css_selector_hash *hash,
+		const struct css_hash_selection_requirments *req,
+		lwc_string **name,
+		css_selector_hash_iterator *iterator,
+		const css_selector ***matched)
+{
+	if (hash == NULL || req == NULL || name == NULL ||
+			iterator == NULL || matched == NULL ||
+			req->attribute >= hash->n_attributes)
+		return CSS_BADPARM;
+
+	if (hash->sorted == false)
+		_hash_sort(hash);
+
+	(*name) = hash->attributes[req->attribute].name;
+	(*iterator) = _iterate_universal;
+	(*matched) = (const css_selector **) _find_in_chain(req,
+			&hash->attributes[req->attribute].chain);
+
+	return CSS_OK;
+}
+
+/**
+ * Retrieve the number of attribute chains in a hash
+ *
+ * \param hash          Hash to consider
+ * \param n_attributes  Pointer to location to receive count
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * Attribute chains are numbered from 0 to n_attributes - 1.
+ */
+css_error css__selector_hash_attributes(css_selector_hash *hash,
+		uint32_t *n_attributes)
+{
+	if (hash == NULL || n_attributes == NULL)
+		return CSS_BADPARM;
+
+	*n_attributes = hash->n_attributes;
 
 	return CSS_OK;
 }
@@ -702,6 +826,88 @@ lwc_string *_id_name(const css_selector *selector)
 	return name;
 }
 
+/**
+ * Find the chain a universal selector belongs in
+ *
+ * \param hash      Selector hash
+ * \param selector  Universal selector to consider
+ * \param create    Whether to create a missing attribute chain
+ * \param head      Pointer to location to receive chain head
+ * \return CSS_OK on success,
+ *         CSS_NOMEM on memory exhaustion,
+ *         CSS_INVALID if the attribute chain is missing and create is false
+ *
+ * Selectors requiring one of the dynamic pseudo classes are keyed by it,
+ * as a node's state is known without asking the client.  Failing that,
+ * selectors requiring an attribute in the null namespace are keyed by
+ * the attribute's name.  Everything else is in the universal chain.
+ */
+css_error _universal_chain(css_selector_hash *hash,
+		const css_selector *selector, bool create, hash_entry **head)
+{
+	const css_selector_detail *detail = &selector->data;
+	lwc_string *attribute = NULL;
+	attribute_chain *attrs;
+	uint32_t i;
+
+	do {
+		/* Ignore :not(:hover) and :not([attr]) */
+		if (detail->negate != 0) {
+			/* Nothing to key by */
+		} else if (detail->type == CSS_SELECTOR_PSEUDO_CLASS) {
+			for (i = 0; i < CSS_HASH_PSEUDO_CLASS_COUNT; i++) {
+				if (detail->qname.name ==
+						hash->pseudo_class_names[i]) {
+					*head = &hash->pseudo_classes[i];
+					return CSS_OK;
+				}
+			}
+		} else if (detail->type >= CSS_SELECTOR_ATTRIBUTE &&
+				detail->qname.ns == NULL &&
+				attribute == NULL) {
+			attribute = detail->qname.name;
+		}
+
+		if (detail->next)
+			detail++;
+		else
+			detail = NULL;
+	} while (detail != NULL);
+
+	if (attribute == NULL) {
+		*head = &hash->universal;
+		return CSS_OK;
+	}
+
+	/* Interned, so names compare by pointer */
+	for (i = 0; i < hash->n_attributes; i++) {
+		if (hash->attributes[i].name == attribute) {
+			*head = &hash->attributes[i].chain;
+			return CSS_OK;
+		}
+	}
+
+	if (create == false)
+		return CSS_INVALID;
+
+	attrs = css__realloc(hash->attributes,
+			(hash->n_attributes + 1) * sizeof(attribute_chain));
+	if (attrs == NULL)
+		return CSS_NOMEM;
+
+	hash->attributes = attrs;
+
+	attrs[hash->n_attributes].name = lwc_string_ref(attribute);
+	attrs[hash->n_attributes].chain.sel = NULL;
+	attrs[hash->n_attributes].chain.next = NULL;
+
+	*head = &attrs[hash->n_attributes++].chain;
+
+	hash->hash_size += sizeof(attribute_chain);
+
+	return CSS_OK;
+}
+
 
 /**
  * Add a selector detail to the bloom filter, if the detail is relevant.
@@ -807,64 +1013,47 @@ static void print_chain_bloom_details(css_bloom bloom[CSS_BLOOM_SIZE])
  * \param ctx       Selector hash
  * \param head      Head of chain to insert into
  * \param selector  Selector to insert
+ * \param name      Name the chain is keyed by, or NULL if unnamed
  * \return CSS_OK    on success,
  *         CSS_NOMEM on memory exhaustion.
+ *
+ * \note The selector is added directly after the chain head; chains are
+ *       put into cascade order by _hash_sort before the next selection.
+ *       This keeps building the hash linear in the size of the sheet.
  */
 css_error _insert_into_chain(css_selector_hash *ctx, hash_entry *head, 
-		const css_selector *selector)
+		const css_selector *selector, lwc_string *name)
 {
-	if (head->sel == NULL) {
-		head->sel = selector;
-		head->next = NULL;
-		_chain_bloom_generate(selector, head->sel_chain_bloom);
+	lwc_string *element = selector->data.qname.name;
+	hash_entry *entry;
 
-#ifdef PRINT_CHAIN_BLOOM_DETAILS
-		print_chain_bloom_details(head->sel_chain_bloom);
-#endif
+	if (head->sel == NULL) {
+		entry = head;
+		entry->next = NULL;
 	} else {
-		hash_entry *search = head;
-		hash_entry *prev = NULL;
-		hash_entry *entry = malloc(sizeof(hash_entry));
+		entry = css__malloc(sizeof(hash_entry));
 		if (entry == NULL)
 			return CSS_NOMEM;
 
-		/* Find place to insert entry */
-		do {
-			/* Sort by ascending specificity */
-			if (search->sel->specificity > selector->specificity)
-				break;
-
-			/* Sort by ascending rule index */
-			if (search->sel->specificity == selector->specificity &&
-					search->sel->rule->index > 
-					selector->rule->index)
-				break;
+		entry->next = head->next;
+		head->next = entry;
 
-			prev = search;
-			search = search->next;
-		} while (search != NULL);
+		ctx->hash_size += sizeof(hash_entry);
+		ctx->sorted = false;
+	}
 
-		entry->sel = selector;
-		_chain_bloom_generate(selector, entry->sel_chain_bloom);
+	/* Resolve names now, so chains are filtered by pointer comparison */
+	entry->sel = selector;
+	entry->name = (name != NULL) ? name->insensitive : NULL;
+	entry->element = (lwc_string_length(element) == 1 &&
+			lwc_string_data(element)[0] == '*') ?
+			NULL : element->insensitive;
+	_chain_bloom_generate(selector, entry->sel_chain_bloom);
 
 #ifdef PRINT_CHAIN_BLOOM_DETAILS
-		print_chain_bloom_details(entry->sel_chain_bloom);
+	print_chain_bloom_details(entry->sel_chain_bloom);
 #endif
 
-		if (prev == NULL) {
-			hash_entry temp;
-			entry->next = entry;
-			temp = *entry;
-			*entry = *head;
-			*head = temp;
-		} else {
-			entry->next = prev->next;
-			prev->next = entry;
-		}
-
-		ctx->hash_size += sizeof(hash_entry);
-	}
-
 	return CSS_OK;
 }
 
@@ -898,8 +1087,14 @@ css_error _remove_from_chain(css_selector_hash *ctx, hash_entry *head,
 
 	if (prev == NULL) {
 		if (search->next != NULL) {
-			head->sel = search->next->sel;
-			head->next = search->next->next;
+			/* Move next entry into the chain head */
+			hash_entry *next = search->next;
+
+			*head = *next;
+
+			css__free(next);
+
+			ctx->hash_size -= sizeof(hash_entry);
 		} else {
 			head->sel = NULL;
 			head->next = NULL;
@@ -907,7 +1102,7 @@ css_error _remove_from_chain(css_selector_hash *ctx, hash_entry *head,
 	} else {
 		prev->next = search->next;
 
-		free(search);
+		css__free(search);
 
 		ctx->hash_size -= sizeof(hash_entry);
 	}
@@ -915,6 +1110,203 @@ css_error _remove_from_chain(css_selector_hash *ctx, hash_entry *head,
 	return CSS_OK;
 }
 
+/**
+ * Determine whether one hash entry precedes another in cascade order
+ *
+ * \param a  Entry to consider
+ * \param b  Entry to compare against
+ * \return true iff a sorts strictly before b
+ */
+static inline bool _entry_before(const hash_entry *a, const hash_entry *b)
+{
+	/* Sort by ascending specificity, then by ascending rule index */
+	if (a->sel->specificity != b->sel->specificity)
+		return a->sel->specificity < b->sel->specificity;
+
+	return a->sel->rule->index < b->sel->rule->index;
+}
+
+/**
+ * Merge sort a list of hash entries into cascade order
+ *
+ * \param list  First entry in list
+ * \return First entry in sorted list
+ */
+static hash_entry *_sort_entries(hash_entry *list)
+{
+	size_t width;
+
+	/* Bottom-up: merge adjacent runs of doubling width */
+	for (width = 1; ; width *= 2) {
+		hash_entry *a = list, *b;
+		hash_entry **link = &list;
+		size_t merges = 0;
+
+		while (a != NULL) {
+			size_t a_len = 0, b_len = width;
+
+			merges++;
+
+			/* Run b follows run a */
+			for (b = a; b != NULL && a_len < width; b = b->next)
+				a_len++;
+
+			/* Take from run a on ties, so the sort is stable */
+			while (a_len > 0 || (b_len > 0 && b != NULL)) {
+				hash_entry *e;
+
+				if (a_len > 0 && (b_len == 0 || b == NULL ||
+						_entry_before(b, a) == false)) {
+					e = a;
+					a = a->next;
+					a_len--;
+				} else {
+					e = b;
+					b = b->next;
+					b_len--;
+				}
+
+				*link = e;
+				link = &e->next;
+			}
+
+			a = b;
+		}
+
+		*link = NULL;
+
+		if (merges <= 1)
+			return list;
+	}
+}
+
+/**
+ * Put a hash chain into cascade order
+ *
+ * \param head  Head of chain to sort
+ */
+static void _sort_chain(hash_entry *head)
+{
+	hash_entry first = *head;
+	hash_entry *list, *prev, *node, *next;
+
+	if (head->sel == NULL || head->next == NULL)
+		return;
+
+	/* Sort with the head's payload on the stack */
+	list = _sort_entries(&first);
+
+	if (list == &first) {
+		*head = first;
+		return;
+	}
+
+	/* The smallest entry's payload belongs in the chain head;
+	 * its node then takes the place of the stack entry. */
+	for (prev = list; prev->next != &first; prev = prev->next)
+		;
+
+	node = list;
+	next = node->next;
+
+	*head = *node;
+
+	*node = first;
+	if (prev == node) {
+		head->next = node;
+	} else {
+		head->next = next;
+		prev->next = node;
+	}
+}
+
+/**
+ * Put every chain in a hash into cascade order
+ *
+ * \param ctx  Selector hash to sort
+ */
+void _hash_sort(css_selector_hash *ctx)
+{
+	hash_t *tables[] = { &ctx->elements, &ctx->classes, &ctx->ids };
+	size_t t, i;
+
+	for (t = 0; t < sizeof(tables) / sizeof(tables[0]); t++) {
+		for (i = 0; i < tables[t]->n_slots; i++)
+			_sort_chain(&tables[t]->slots[i]);
+	}
+
+	_sort_chain(&ctx->universal);
+
+	for (i = 0; i < CSS_HASH_PSEUDO_CLASS_COUNT; i++)
+		_sort_chain(&ctx->pseudo_classes[i]);
+
+	for (i = 0; i < ctx->n_attributes; i++)
+		_sort_chain(&ctx->attributes[i].chain);
+
+	ctx->sorted = true;
+}
+
+/**
+ * Double the number of slots in a hash table
+ *
+ * \param ctx    Selector hash owning table
+ * \param table  Table to grow
+ *
+ * \note Failure to grow is not fatal; the table simply stays as it was.
+ */
+void _hash_grow(css_selector_hash *ctx, hash_t *table)
+{
+	size_t n_slots = table->n_slots * 2;
+	uint32_t mask = n_slots - 1;
+	hash_entry *slots;
+	size_t i;
+
+	slots = css__calloc(n_slots, sizeof(hash_entry));
+	if (slots == NULL)
+		return;
+
+	for (i = 0; i < table->n_slots; i++) {
+		hash_entry *old = &table->slots[i];
+		hash_entry *node, *next;
+		hash_entry *dest;
+
+		if (old->sel == NULL)
+			continue;
+
+		/* Entries from old slot i land only in new slots i and
+		 * i + n_slots / 2, both of which are still empty here. */
+		dest = &slots[lwc_string_hash_value(old->name) & mask];
+		*dest = *old;
+		dest->next = NULL;
+
+		for (node = old->next; node != NULL; node = next) {
+			next = node->next;
+
+			dest = &slots[lwc_string_hash_value(node->name) & mask];
+			if (dest->sel == NULL) {
+				*dest = *node;
+				dest->next = NULL;
+
+				css__free(node);
+
+				ctx->hash_size -= sizeof(hash_entry);
+			} else {
+				node->next = dest->next;
+				dest->next = node;
+			}
+		}
+	}
+
+	css__free(table->slots);
+
+	ctx->hash_size += (n_slots - table->n_slots) * sizeof(hash_entry);
+
+	table->slots = slots;
+	table->n_slots = n_slots;
+
+	ctx->sorted = false;
+}
+
 /**
  * Find the next selector that matches
  *
@@ -930,22 +1322,15 @@ css_error _iterate_elements(
 		const css_selector ***next)
 {
 	const hash_entry *head = (const hash_entry *) current;
-	bool match = false;
-	lwc_error lerror = lwc_error_ok;
 	lwc_string *name;
 
-	name = req->qname.name;
+	name = req->qname.name->insensitive;
 	head = head->next;
 
 	if (head != NULL && head->sel != NULL) {
 		/* Search through chain for first match */
 		while (head != NULL) {
-			lerror = lwc_string_caseless_isequal(name,
-					head->sel->data.qname.name, &match);
-			if (lerror != lwc_error_ok)
-				return css_error_from_lwc_error(lerror);
-
-			if (match && RULE_HAS_BYTECODE(head)) {
+			if (head->name == name && RULE_HAS_BYTECODE(head)) {
 				if (css_bloom_in_bloom(
 						head->sel_chain_bloom,
 						req->node_bloom) &&
@@ -982,38 +1367,24 @@ css_error _iterate_classes(
 		const css_selector ***next)
 {
 	const hash_entry *head = (const hash_entry *) current;
-	bool match = false;
-	lwc_error lerror = lwc_error_ok;
-	lwc_string *name, *ref;
+	lwc_string *name;
 
-	ref = req->class;
+	name = req->class->insensitive;
 	head = head->next;
 
 	if (head != NULL && head->sel != NULL) {
 		/* Search through chain for first match */
 		while (head != NULL) {
-			name = _class_name(head->sel);
-
-			if (name != NULL) {
-				lerror = lwc_string_caseless_isequal(
-						ref, name, &match);
-				if (lerror != lwc_error_ok)
-					return css_error_from_lwc_error(lerror);
-
-				if (match && RULE_HAS_BYTECODE(head)) {
-					if (css_bloom_in_bloom(
-							head->sel_chain_bloom,
-							req->node_bloom) &&
-					    _chain_good_for_element_name(
-							head->sel,
-							&(req->qname),
-							req->uni) &&
-					    _rule_good_for_media(
-							head->sel->rule,
-							req->media)) {
-						/* Found a match */
-						break;
-					}
+			if (head->name == name && RULE_HAS_BYTECODE(head)) {
+				if (css_bloom_in_bloom(
+						head->sel_chain_bloom,
+						req->node_bloom) &&
+				    _chain_good_for_element_name(head,
+						&req->qname) &&
+				    _rule_good_for_media(head->sel->rule,
+						req->media)) {
+					/* Found a match */
+					break;
 				}
 			}
 			head = head->next;
@@ -1043,38 +1414,24 @@ css_error _iterate_ids(
 		const css_selector ***next)
 {
 	const hash_entry *head = (const hash_entry *) current;
-	bool match = false;
-	lwc_error lerror = lwc_error_ok;
-	lwc_string *name, *ref;
+	lwc_string *name;
 
-	ref = req->id;
+	name = req->id->insensitive;
 	head = head->next;
 
 	if (head != NULL && head->sel != NULL) {
 		/* Search through chain for first match */
 		while (head != NULL) {
-			name = _id_name(head->sel);
-
-			if (name != NULL) {
-				lerror = lwc_string_caseless_isequal(
-						ref, name, &match);
-				if (lerror != lwc_error_ok)
-					return css_error_from_lwc_error(lerror);
-
-				if (match && RULE_HAS_BYTECODE(head)) {
-					if (css_bloom_in_bloom(
-							head->sel_chain_bloom,
-							req->node_bloom) &&
-					    _chain_good_for_element_name(
-							head->sel,
-							&req->qname,
-							req->uni) &&
-					    _rule_good_for_media(
-							head->sel->rule,
-							req->media)) {
-						/* Found a match */
-						break;
-					}
+			if (head->name == name && RULE_HAS_BYTECODE(head)) {
+				if (css_bloom_in_bloom(
+						head->sel_chain_bloom,
+						req->node_bloom) &&
+				    _chain_good_for_element_name(head,
+						&req->qname) &&
+				    _rule_good_for_media(head->sel->rule,
+						req->media)) {
+					/* Found a match */
+					break;
 				}
 			}
 			head = head->next;
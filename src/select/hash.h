@@ -20,11 +20,26 @@ struct css_selector;
 
 typedef struct css_selector_hash css_selector_hash;
 
+/**
+ * Dynamic pseudo classes which key universal selectors
+ */
+typedef enum css_selector_hash_pseudo_class {
+	CSS_HASH_PSEUDO_CLASS_LINK,
+	CSS_HASH_PSEUDO_CLASS_VISITED,
+	CSS_HASH_PSEUDO_CLASS_HOVER,
+	CSS_HASH_PSEUDO_CLASS_ACTIVE,
+	CSS_HASH_PSEUDO_CLASS_FOCUS,
+
+	CSS_HASH_PSEUDO_CLASS_COUNT
+} css_selector_hash_pseudo_class;
+
+/* Names must have their insensitive ptr set */
 struct css_hash_selection_requirments {
 	css_qname qname;		/* Element name, or universal "*" */
 	lwc_string *class;		/* Name of class, or NULL */
 	lwc_string *id;			/* Name of id, or NULL */
-	lwc_string *uni;		/* Universal element string "*" */
+	css_selector_hash_pseudo_class pseudo_class; /* Pseudo class */
+	uint32_t attribute;		/* Index of attribute chain */
 	uint64_t media;			/* Media type(s) we're selecting for */
 	const css_bloom *node_bloom;	/* Node's bloom filter */
 };
@@ -34,7 +49,8 @@ typedef css_error (*css_selector_hash_iterator)(
 		const struct css_selector **current,
 		const struct css_selector ***next);
 
-css_error css__selector_hash_create(css_selector_hash **hash);
+css_error css__selector_hash_create(lwc_string **strings,
+		css_selector_hash **hash);
 css_error css__selector_hash_destroy(css_selector_hash *hash);
 
 css_error css__selector_hash_insert(css_selector_hash *hash,
@@ -58,6 +74,18 @@ css_error css__selector_hash_find_universal(css_selector_hash *hash,
 		const struct css_hash_selection_requirments *req,
 		css_selector_hash_iterator *iterator,
 		const struct css_selector ***matched);
+css_error css__selector_hash_find_by_pseudo_class(css_selector_hash *hash,
+		const struct css_hash_selection_requirments *req,
+		css_selector_hash_iterator *iterator,
+		const struct css_selector ***matched);
+css_error css__selector_hash_find_by_attribute(css_selector_hash *hash,
+		const struct css_hash_selection_requirments *req,
+		lwc_string **name,
+		css_selector_hash_iterator *iterator,
+		const struct css_selector ***matched);
+
+css_error css__selector_hash_attributes(css_selector_hash *hash,
+		uint32_t *n_attributes);
 
 css_error css__selector_hash_size(css_selector_hash *hash, size_t *size);
 
@@ -0,0 +1,264 @@
+/*
+ * This file is part of LibCSS
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+
+#include "select/initial.h"
+#include "utils/alloc.h"
+#include "utils/utils.h"
+
+/**
+ * UA default callback used while probing initial handlers
+ *
+ * \param pw        Pointer to flag to set
+ * \param property  Unused
+ * \param hint      Unused
+ * \return CSS_INVALID, always.
+ *
+ * A property whose initial value depends on the client can't be templated.
+ */
+static css_error probe_ua_default(void *pw, uint32_t property,
+		css_hint *hint)
+{
+	bool *asked = pw;
+
+	UNUSED(property);
+	UNUSED(hint);
+
+	*asked = true;
+
+	return CSS_INVALID;
+}
+
+/**
+ * Find the bits of the normal block written by a property's initial handler
+ *
+ * \param template  Template to add property to
+ * \param prop      Property to probe
+ * \return true if the property may be templated, false otherwise
+ *
+ * The handler is run over one scratch block with every bit clear, and
+ * another with every bit set (other than pointers).  A bit belongs to
+ * the property if the handler changes it in either block.
+ */
+static bool probe_property(css_initial_template *template, uint32_t prop)
+{
+	css_computed_style orig[2], style[2];
+	css_select_handler handler;
+	css_select_state state;
+	css_initial_span *spans = template->spans[prop];
+	uint8_t n_spans = 0;
+	bool asked = false;
+	size_t b;
+	int k;
+
+	if (prop_dispatch[prop].group != GROUP_NORMAL)
+		return false;
+
+	memset(&handler, 0, sizeof(handler));
+	handler.ua_default_for_property = probe_ua_default;
+
+	memset(&state, 0, sizeof(state));
+	state.handler = &handler;
+	state.pw = &asked;
+
+	memset(orig, 0, sizeof(orig));
+	memset(&orig[1].i, 0xff, sizeof(orig[1].i));
+	orig[1].i.list_style_image = NULL;
+	orig[1].i.uncommon = NULL;
+	orig[1].i.aural = NULL;
+
+	for (k = 0; k < 2; k++) {
+		style[k] = orig[k];
+		state.computed = &style[k];
+
+		if (prop_dispatch[prop].initial(&state) != CSS_OK || asked)
+			return false;
+
+		/* Anything outside the normal block must be left alone */
+		if (memcmp((uint8_t *) &style[k] + sizeof(style[k].i),
+				(uint8_t *) &orig[k] + sizeof(orig[k].i),
+				sizeof(style[k]) - sizeof(style[k].i)) != 0)
+			return false;
+	}
+
+	for (b = 0; b < sizeof(struct css_computed_style_i); b++) {
+		const uint8_t *o0 = (const uint8_t *) &orig[0].i;
+		const uint8_t *o1 = (const uint8_t *) &orig[1].i;
+		const uint8_t *s0 = (const uint8_t *) &style[0].i;
+		const uint8_t *s1 = (const uint8_t *) &style[1].i;
+		uint8_t owned = (s0[b] ^ o0[b]) | (s1[b] ^ o1[b]);
+
+		if (owned == 0)
+			continue;
+
+		/* The value written mustn't depend on what was there */
+		if (((s0[b] ^ s1[b]) & owned) != 0 ||
+				n_spans == CSS_INITIAL_MAX_SPANS)
+			return false;
+
+		spans[n_spans].offset = b;
+		spans[n_spans].mask = owned;
+		n_spans++;
+	}
+
+	template->n_spans[prop] = n_spans;
+
+	for (b = 0; b < n_spans; b++) {
+		uint8_t *values = (uint8_t *) &template->values;
+
+		values[spans[b].offset] |= ((const uint8_t *) &style[0].i)
+				[spans[b].offset] & spans[b].mask;
+	}
+
+	return true;
+}
+
+/**
+ * Create the initial value template
+ *
+ * \param result  Pointer to location to receive template
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ */
+css_error css__initial_template_create(css_initial_template **result)
+{
+	bool templated[CSS_N_PROPERTIES];
+	css_initial_template *t;
+	uint16_t n_other = 0;
+	uint32_t prop;
+	uint32_t group;
+
+	t = css__calloc(1, sizeof(*t));
+	if (t == NULL)
+		return CSS_NOMEM;
+
+	for (prop = 0; prop < CSS_N_PROPERTIES; prop++) {
+		uint8_t i;
+
+		templated[prop] = probe_property(t, prop);
+		if (templated[prop] == false)
+			continue;
+
+		t->root_props[t->n_root_props++] = prop;
+		for (i = 0; i < t->n_spans[prop]; i++) {
+			t->root_mask[t->spans[prop][i].offset] |=
+					t->spans[prop][i].mask;
+		}
+
+		if (prop_dispatch[prop].inherited)
+			continue;
+
+		t->child_props[t->n_child_props++] = prop;
+		for (i = 0; i < t->n_spans[prop]; i++) {
+			t->child_mask[t->spans[prop][i].offset] |=
+					t->spans[prop][i].mask;
+		}
+	}
+
+	for (group = 0; group < GROUP_COUNT; group++) {
+		t->other_start[group] = n_other;
+
+		for (prop = 0; prop < CSS_N_PROPERTIES; prop++) {
+			if (templated[prop] == false &&
+					prop_dispatch[prop].group == group)
+				t->other_props[n_other++] = prop;
+		}
+	}
+	t->other_start[GROUP_COUNT] = n_other;
+
+	*result = t;
+
+	return CSS_OK;
+}
+
+/**
+ * Destroy an initial value template
+ *
+ * \param template  Template to destroy
+ */
+void css__initial_template_destroy(css_initial_template *template)
+{
+	css__free(template);
+}
+
+/**
+ * Give the properties of a style their initial values, where the cascade
+ * hasn't set them
+ *
+ * \param template  The template
+ * \param state     Selection state, with cascade complete
+ * \param pseudo    Pseudo element whose style is state->computed
+ * \param root      Whether the style is the root element's base style
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * Inherited properties are only given their initial values on the root
+ * element, where properties set to inherit are also given their initial
+ * values.  Properties in extension blocks which the style lacks are left
+ * for the property accessors to report as initial.
+ */
+css_error css__initial_values_set(const css_initial_template *template,
+		css_select_state *state, css_pseudo_element pseudo, bool root)
+{
+	uint8_t mask[sizeof(struct css_computed_style_i)];
+	const uint8_t *values = (const uint8_t *) &template->values;
+	uint8_t *block = (uint8_t *) &state->computed->i;
+	const uint16_t *props;
+	uint16_t n_props, i;
+	uint32_t group;
+	size_t b;
+
+	if (root) {
+		memcpy(mask, template->root_mask, sizeof(mask));
+		props = template->root_props;
+		n_props = template->n_root_props;
+	} else {
+		memcpy(mask, template->child_mask, sizeof(mask));
+		props = template->child_props;
+		n_props = template->n_child_props;
+	}
+
+	/* Leave alone the bits of properties the cascade has set */
+	for (i = 0; i < n_props; i++) {
+		const prop_state *prop = &state->props[props[i]][pseudo];
+		const css_initial_span *span;
+		uint8_t n;
+
+		if (prop->set == false || (root && prop->inherit))
+			continue;
+
+		span = template->spans[props[i]];
+		for (n = template->n_spans[props[i]]; n > 0; n--, span++)
+			mask[span->offset] &= ~span->mask;
+	}
+
+	for (b = 0; b < sizeof(mask); b++)
+		block[b] = (block[b] & ~mask[b]) | (values[b] & mask[b]);
+
+	/* The remaining properties use their initial handlers */
+	for (group = 0; group < GROUP_COUNT; group++) {
+		if (css__group_present(state->computed, group) == false)
+			continue;
+
+		for (i = template->other_start[group];
+				i < template->other_start[group + 1]; i++) {
+			uint16_t p = template->other_props[i];
+			const prop_state *prop = &state->props[p][pseudo];
+			css_error error;
+
+			if (prop->set && (root == false || prop->inherit == false))
+				continue;
+
+			if (prop_dispatch[p].inherited && root == false)
+				continue;
+
+			error = prop_dispatch[p].initial(state);
+			if (error != CSS_OK)
+				return error;
+		}
+	}
+
+	return CSS_OK;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of LibCSS
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Initial value templates.
+ *
+ * Once the cascade is complete, every property which is unset (or, on the
+ * root element, set to inherit) must be given its initial value.  Rather
+ * than calling each property's initial handler in turn, the values of the
+ * properties stored in the normal block of a computed style are copied
+ * from a template which has every such property at its initial value.
+ *
+ * Only the parts of the block belonging to properties which need their
+ * initial values are copied.  Which bits of the block belong to each
+ * property is found by running the initial handlers over scratch styles
+ * when the template is created.  Properties whose initial values come from
+ * the client, or which live outside the normal block, are not templated,
+ * and continue to use their initial handlers.
+ */
+
+#ifndef css_select_initial_h_
+#define css_select_initial_h_
+
+#include "select/computed.h"
+#include "select/dispatch.h"
+#include "select/select.h"
+
+/** Most bytes of the normal block belonging to a single property */
+#define CSS_INITIAL_MAX_SPANS 16
+
+/**
+ * Part of the normal block belonging to a property
+ */
+typedef struct css_initial_span {
+	uint16_t offset;		/**< Byte offset in block */
+	uint8_t mask;			/**< Bits of byte owned */
+} css_initial_span;
+
+typedef struct css_initial_template {
+	/** The normal block, with templated properties at their initial
+	 * values and all other bits clear */
+	struct css_computed_style_i values;
+
+	/** Bits to copy for each templated property */
+	css_initial_span spans[CSS_N_PROPERTIES][CSS_INITIAL_MAX_SPANS];
+	uint8_t n_spans[CSS_N_PROPERTIES];
+
+	/** Templated properties which are given their initial values on
+	 * the root element (all of them), and elsewhere (those which are
+	 * not inherited) */
+	uint16_t root_props[CSS_N_PROPERTIES];
+	uint16_t n_root_props;
+	uint16_t child_props[CSS_N_PROPERTIES];
+	uint16_t n_child_props;
+
+	/** Properties which aren't templated, ordered by group, and the
+	 * index in that list of each group's first property */
+	uint16_t other_props[CSS_N_PROPERTIES];
+	uint16_t other_start[GROUP_COUNT + 1];
+
+	/** Union of the bits of the root and child properties */
+	uint8_t root_mask[sizeof(struct css_computed_style_i)];
+	uint8_t child_mask[sizeof(struct css_computed_style_i)];
+} css_initial_template;
+
+css_error css__initial_template_create(css_initial_template **result);
+void css__initial_template_destroy(css_initial_template *template);
+
+css_error css__initial_values_set(const css_initial_template *template,
+		css_select_state *state, css_pseudo_element pseudo, bool root);
+
+#endif
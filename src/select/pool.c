@@ -0,0 +1,238 @@
+/*
+ * This file is part of LibCSS
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <libcss/computed.h>
+
+#include "select/pool.h"
+#include "utils/alloc.h"
+
+/*
+ * Computed styles and their extension blocks are small, fixed-size objects
+ * which are created and destroyed in large numbers during restyling.  They
+ * are carved out of slabs, one set of slabs per size class, and recycled
+ * through a per-class free list.  Once none of a class's blocks remain in
+ * use, all but one of its slabs are returned to the system.  The last is
+ * kept, so that a client which repeatedly creates and destroys a single
+ * style doesn't allocate and free a slab each time.
+ * css_computed_style_pool_trim() releases the kept slabs.
+ */
+
+#define POOL_GRANULE	16	/* Size class granularity; also the alignment */
+#define POOL_MAX_SIZE	512	/* Largest pooled block */
+#define POOL_CLASSES	(POOL_MAX_SIZE / POOL_GRANULE)
+#define POOL_SLAB_SIZE	8192	/* Target size of a slab */
+
+/* Slab header, padded so that the first block is suitably aligned */
+struct pool_slab {
+	struct pool_slab *next;
+};
+
+#define POOL_SLAB_HEADER \
+	((sizeof(struct pool_slab) + POOL_GRANULE - 1) & ~(POOL_GRANULE - 1))
+
+struct pool_block {
+	struct pool_block *next;
+};
+
+struct pool_class {
+	struct pool_block *free;	/**< Free list */
+	struct pool_slab *slabs;	/**< Slabs owned by this class */
+	uint32_t live;			/**< Blocks in use */
+};
+
+static struct pool_class pool_classes[POOL_CLASSES];
+static css_computed_alloc_stats pool_stats;
+
+static inline size_t pool_class_index(size_t size)
+{
+	return (size - 1) / POOL_GRANULE;
+}
+
+/**
+ * Thread the blocks of a slab onto its size class's free list
+ *
+ * \param pc     Size class owning slab
+ * \param slab   Slab, none of whose blocks are in use
+ * \param block  Size of blocks in the class
+ */
+static void pool_slab_thread(struct pool_class *pc, struct pool_slab *slab,
+		size_t block)
+{
+	size_t n = (POOL_SLAB_SIZE - POOL_SLAB_HEADER) / block;
+	uint8_t *b = (uint8_t *) slab + POOL_SLAB_HEADER;
+	size_t i;
+
+	for (i = 0; i < n; i++, b += block) {
+		struct pool_block *free_block = (struct pool_block *) b;
+
+		free_block->next = pc->free;
+		pc->free = free_block;
+	}
+}
+
+/**
+ * Allocate a new slab for a size class, and thread its blocks onto the
+ * class's free list
+ *
+ * \param pc     Size class to populate
+ * \param block  Size of blocks in the class
+ * \return True on success, false on memory exhaustion
+ */
+static bool pool_class_grow(struct pool_class *pc, size_t block)
+{
+	size_t n = (POOL_SLAB_SIZE - POOL_SLAB_HEADER) / block;
+	struct pool_slab *slab;
+
+	slab = css__malloc(POOL_SLAB_HEADER + n * block);
+	if (slab == NULL)
+		return false;
+
+	slab->next = pc->slabs;
+	pc->slabs = slab;
+
+	pool_slab_thread(pc, slab, block);
+
+	pool_stats.slabs++;
+	pool_stats.slab_bytes += POOL_SLAB_HEADER + n * block;
+
+	return true;
+}
+
+/**
+ * Return a size class's slabs to the system
+ *
+ * \param pc     Size class to drain, which must have no blocks in use
+ * \param block  Size of blocks in the class
+ * \param keep   Whether to keep one slab for reuse
+ */
+static void pool_class_drain(struct pool_class *pc, size_t block, bool keep)
+{
+	size_t n = (POOL_SLAB_SIZE - POOL_SLAB_HEADER) / block;
+	struct pool_slab *kept = NULL;
+
+	if (keep && pc->slabs != NULL) {
+		kept = pc->slabs;
+		pc->slabs = kept->next;
+	}
+
+	while (pc->slabs != NULL) {
+		struct pool_slab *next = pc->slabs->next;
+
+		css__free(pc->slabs);
+		pc->slabs = next;
+
+		pool_stats.slabs--;
+		pool_stats.slab_bytes -= POOL_SLAB_HEADER + n * block;
+	}
+
+	pc->free = NULL;
+
+	if (kept != NULL) {
+		kept->next = NULL;
+		pc->slabs = kept;
+		pool_slab_thread(pc, kept, block);
+	}
+}
+
+/* Exported function documented in select/pool.h */
+void *css__pool_alloc(size_t size)
+{
+	struct pool_class *pc;
+	struct pool_block *b;
+	size_t idx;
+
+	if (size == 0 || size > POOL_MAX_SIZE) {
+		b = css__malloc(size);
+		if (b != NULL)
+			pool_stats.allocs++;
+		return b;
+	}
+
+	idx = pool_class_index(size);
+	pc = &pool_classes[idx];
+
+	if (pc->free == NULL &&
+			pool_class_grow(pc, (idx + 1) * POOL_GRANULE) == false)
+		return NULL;
+
+	b = pc->free;
+	pc->free = b->next;
+	pc->live++;
+
+	pool_stats.allocs++;
+
+	return b;
+}
+
+/* Exported function documented in select/pool.h */
+void css__pool_free(void *block, size_t size)
+{
+	struct pool_class *pc;
+	struct pool_block *b = block;
+	size_t idx;
+
+	if (block == NULL)
+		return;
+
+	pool_stats.frees++;
+
+	if (size == 0 || size > POOL_MAX_SIZE) {
+		css__free(block);
+		return;
+	}
+
+	idx = pool_class_index(size);
+	pc = &pool_classes[idx];
+
+	b->next = pc->free;
+	pc->free = b;
+
+	/* Nothing to release unless the class has a slab to spare */
+	if (--pc->live == 0 && pc->slabs->next != NULL)
+		pool_class_drain(pc, (idx + 1) * POOL_GRANULE, true);
+}
+
+/**
+ * Release the memory kept for reuse by computed styles
+ *
+ * \return CSS_OK.
+ *
+ * Each size class of the pools keeps one slab once its blocks have all
+ * been freed, until this is called.  Classes with blocks in use are left
+ * alone.
+ */
+css_error css_computed_style_pool_trim(void)
+{
+	size_t idx;
+
+	for (idx = 0; idx < POOL_CLASSES; idx++) {
+		if (pool_classes[idx].live == 0)
+			pool_class_drain(&pool_classes[idx],
+					(idx + 1) * POOL_GRANULE, false);
+	}
+
+	return CSS_OK;
+}
+
+/**
+ * Retrieve computed style allocation statistics
+ *
+ * \param stats  Pointer to location to receive statistics
+ * \return CSS_OK on success, CSS_BADPARM on bad parameters.
+ */
+css_error css_computed_style_alloc_stats(css_computed_alloc_stats *stats)
+{
+	if (stats == NULL)
+		return CSS_BADPARM;
+
+	*stats = pool_stats;
+
+	return CSS_OK;
+}
+
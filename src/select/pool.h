@@ -0,0 +1,32 @@
+/*
+ * This file is part of LibCSS
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+#ifndef css_select_pool_h_
+#define css_select_pool_h_
+
+#include <stddef.h>
+
+/*
+ * Allocate a fixed-size block from the computed style pools
+ *
+ * Blocks larger than the largest size class are obtained from the system
+ * allocator.  The block's contents are undefined.
+ *
+ * \param size  Size of block, in bytes
+ * \return Pointer to block, or NULL on memory exhaustion
+ */
+void *css__pool_alloc(size_t size);
+
+/*
+ * Return a block to the computed style pools
+ *
+ * \param block  Block to release, or NULL
+ * \param size   Size of block, as passed to css__pool_alloc
+ */
+void css__pool_free(void *block, size_t size);
+
+#endif
+
@@ -10,6 +10,7 @@
 #include "bytecode/opcodes.h"
 #include "select/propset.h"
 #include "select/propget.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #include "select/properties/properties.h"
@@ -59,7 +60,7 @@ css_error css__compose_background_image(const css_computed_style *parent,
 
 		if (type == CSS_BACKGROUND_IMAGE_IMAGE && image)
 		{
-			copy = malloc(sizeof(css_computed_image));
+			copy = css__malloc(sizeof(css_computed_image));
 			if (copy == NULL)
 				return CSS_NOMEM;
 			*copy = *image;
@@ -68,26 +69,30 @@ css_error css__compose_background_image(const css_computed_style *parent,
 				if (image->type == CSS_COMPUTED_IMAGE_LINEAR_GRADIENT ||
 						image->type == CSS_COMPUTED_IMAGE_REPEATING_LINEAR_GRADIENT)
 				{
-					copy->data.linear = malloc(sizeof(css_computed_linear_gradient));
+					copy->data.linear = css__malloc(sizeof(css_computed_linear_gradient));
 					if (!copy->data.linear)
 					{
-						free(copy);
+						css__free(copy);
 						return CSS_NOMEM;
 					}
 					*copy->data.linear = *image->data.linear;
 					if (image->data.linear->nstop)
 					{
 						size_t size = image->data.linear->nstop * sizeof(css_computed_color_stop);
-						copy->data.linear->stops = malloc(size);
+						copy->data.linear->stops = css__malloc(size);
 						if (!copy->data.linear->stops)
 						{
-							free(copy->data.linear);
-							free(copy);
+							css__free(copy->data.linear);
+							css__free(copy);
 							return CSS_NOMEM;
 						}
 						memcpy(copy->data.linear->stops, image->data.linear->stops, size);
 					}
 				}
+				else if (image->type == CSS_COMPUTED_IMAGE_URI)
+				{
+					lwc_string_ref(copy->data.uri);
+				}
 			}
 		}
 
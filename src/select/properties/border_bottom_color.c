@@ -14,12 +14,7 @@
 #include "select/properties/properties.h"
 #include "select/properties/helpers.h"
 
-css_error css__cascade_border_bottom_color(uint32_t opv, css_style *style, 
-		css_select_state *state)
-{
-	return css__cascade_bg_border_color(opv, style, state,
-			set_border_bottom_color);
-}
+/* css__cascade_border_bottom_color() is generated from CSS_INLINE_PROPERTIES */
 
 css_error css__set_border_bottom_color_from_hint(const css_hint *hint, 
 		css_computed_style *style)
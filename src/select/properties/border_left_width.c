@@ -14,11 +14,7 @@
 #include "select/properties/properties.h"
 #include "select/properties/helpers.h"
 
-css_error css__cascade_border_left_width(uint32_t opv, css_style *style, 
-		css_select_state *state)
-{
-	return css__cascade_border_width(opv, style, state, set_border_left_width);
-}
+/* css__cascade_border_left_width() is generated from CSS_INLINE_PROPERTIES */
 
 css_error css__set_border_left_width_from_hint(const css_hint *hint, 
 		css_computed_style *style)
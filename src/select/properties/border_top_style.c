@@ -14,11 +14,7 @@
 #include "select/properties/properties.h"
 #include "select/properties/helpers.h"
 
-css_error css__cascade_border_top_style(uint32_t opv, css_style *style, 
-		css_select_state *state)
-{
-	return css__cascade_border_style(opv, style, state, set_border_top_style);
-}
+/* css__cascade_border_top_style() is generated from CSS_INLINE_PROPERTIES */
 
 css_error css__set_border_top_style_from_hint(const css_hint *hint, 
 		css_computed_style *style)
@@ -9,6 +9,7 @@
 #include "bytecode/opcodes.h"
 #include "select/propset.h"
 #include "select/propget.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #include "select/properties/properties.h"
@@ -38,12 +39,12 @@ css_error css__cascade_content(uint32_t opv, css_style *style,
 				css__stylesheet_string_get(style->sheet,
 					*((css_code_t *) style->bytecode), &he);
 				
-				temp = realloc(content,
+				temp = css__realloc(content,
 						(n_contents + 1) *
 						sizeof(css_computed_content_item));
 				if (temp == NULL) {
 					if (content != NULL) {
-						free(content);
+						css__free(content);
 					}
 					return CSS_NOMEM;
 				}
@@ -127,10 +128,10 @@ css_error css__cascade_content(uint32_t opv, css_style *style,
 	if (n_contents > 0) {
 		css_computed_content_item *temp;
 
-		temp = realloc(content, (n_contents + 1) *
+		temp = css__realloc(content, (n_contents + 1) *
 				sizeof(css_computed_content_item));
 		if (temp == NULL) {
-			free(content);
+			css__free(content);
 			return CSS_NOMEM;
 		}
 
@@ -145,11 +146,11 @@ css_error css__cascade_content(uint32_t opv, css_style *style,
 
 		error = set_content(state->computed, value, content);
 		if (error != CSS_OK && content != NULL)
-			free(content);
+			css__free(content);
 
 		return error;
 	} else if (content != NULL) {
-		free(content);
+		css__free(content);
 	}
 
 	return CSS_OK;
@@ -189,7 +190,7 @@ css_error css__set_content_from_hint(const css_hint *hint,
 	}
 
 	if (error != CSS_OK && hint->data.content != NULL)
-		free(hint->data.content);
+		css__free(hint->data.content);
 
 	return error;
 }
@@ -225,7 +226,7 @@ css_error css__compose_content(const css_computed_style *parent,
 					i++)
 				n_items++;
 
-			copy = malloc((n_items + 1) * 
+			copy = css__malloc((n_items + 1) * 
 					sizeof(css_computed_content_item));
 			if (copy == NULL)
 				return CSS_NOMEM;
@@ -236,7 +237,7 @@ css_error css__compose_content(const css_computed_style *parent,
 
 		error = set_content(result, type, copy);
 		if (error != CSS_OK && copy != NULL)
-			free(copy);
+			css__free(copy);
 
 		return error;
 	}
@@ -9,6 +9,7 @@
 #include "bytecode/opcodes.h"
 #include "select/propset.h"
 #include "select/propget.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #include "select/properties/properties.h"
@@ -37,7 +38,7 @@ css_error css__set_counter_increment_from_hint(const css_hint *hint,
 	}
 
 	if (error != CSS_OK && hint->data.counter != NULL)
-		free(hint->data.counter);
+		css__free(hint->data.counter);
 
 	return error;
 }
@@ -73,7 +74,7 @@ css_error css__compose_counter_increment(const css_computed_style *parent,
 			for (i = items; i->name != NULL; i++)
 				n_items++;
 
-			copy = malloc((n_items + 1) * 
+			copy = css__malloc((n_items + 1) * 
 					sizeof(css_computed_counter));
 			if (copy == NULL)
 				return CSS_NOMEM;
@@ -84,7 +85,7 @@ css_error css__compose_counter_increment(const css_computed_style *parent,
 
 		error = set_counter_increment(result, type, copy);
 		if (error != CSS_OK && copy != NULL)
-			free(copy);
+			css__free(copy);
 
 		return error;
 	}
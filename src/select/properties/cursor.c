@@ -9,6 +9,7 @@
 #include "bytecode/opcodes.h"
 #include "select/propset.h"
 #include "select/propget.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #include "select/properties/properties.h"
@@ -33,11 +34,11 @@ css_error css__cascade_cursor(uint32_t opv, css_style *style,
 					&uri);
 			advance_bytecode(style, sizeof(css_code_t));
 
-			temp = realloc(uris, 
+			temp = css__realloc(uris, 
 					(n_uris + 1) * sizeof(lwc_string *));
 			if (temp == NULL) {
 				if (uris != NULL) {
-					free(uris);
+					css__free(uris);
 				}
 				return CSS_NOMEM;
 			}
@@ -111,10 +112,10 @@ css_error css__cascade_cursor(uint32_t opv, css_style *style,
 	if (n_uris > 0) {
 		lwc_string **temp;
 
-		temp = realloc(uris, 
+		temp = css__realloc(uris, 
 				(n_uris + 1) * sizeof(lwc_string *));
 		if (temp == NULL) {
-			free(uris);
+			css__free(uris);
 			return CSS_NOMEM;
 		}
 
@@ -129,12 +130,12 @@ css_error css__cascade_cursor(uint32_t opv, css_style *style,
 
 		error = set_cursor(state->computed, value, uris);
 		if (error != CSS_OK && n_uris > 0)
-			free(uris);
+			css__free(uris);
 
 		return error;
 	} else {
 		if (n_uris > 0)
-			free(uris);
+			css__free(uris);
 	}
 
 	return CSS_OK;
@@ -154,7 +155,7 @@ css_error css__set_cursor_from_hint(const css_hint *hint,
 	}
 
 	if (error != CSS_OK && hint->data.strings != NULL)
-		free(hint->data.strings);
+		css__free(hint->data.strings);
 
 	return error;
 }
@@ -189,7 +190,7 @@ css_error css__compose_cursor(const css_computed_style *parent,
 			for (i = urls; (*i) != NULL; i++)
 				n_urls++;
 
-			copy = malloc((n_urls + 1) * 
+			copy = css__malloc((n_urls + 1) * 
 					sizeof(lwc_string *));
 			if (copy == NULL)
 				return CSS_NOMEM;
@@ -200,7 +201,7 @@ css_error css__compose_cursor(const css_computed_style *parent,
 
 		error = set_cursor(result, type, copy);
 		if (error != CSS_OK && copy != NULL)
-			free(copy);
+			css__free(copy);
 
 		return error;
 	}
@@ -9,6 +9,7 @@
 #include "bytecode/opcodes.h"
 #include "select/propset.h"
 #include "select/propget.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #include "select/properties/properties.h"
@@ -63,11 +64,11 @@ css_error css__cascade_font_family(uint32_t opv, css_style *style,
 			 * first generic-family are ignored. */
 			/** \todo Do this at bytecode generation time? */
 			if (value == CSS_FONT_FAMILY_INHERIT && font != NULL) {
-				temp = realloc(fonts, 
+				temp = css__realloc(fonts, 
 					(n_fonts + 1) * sizeof(lwc_string *));
 				if (temp == NULL) {
 					if (fonts != NULL) {
-						free(fonts);
+						css__free(fonts);
 					}
 					return CSS_NOMEM;
 				}
@@ -88,9 +89,9 @@ css_error css__cascade_font_family(uint32_t opv, css_style *style,
 	if (n_fonts > 0) {
 		lwc_string **temp;
 
-		temp = realloc(fonts, (n_fonts + 1) * sizeof(lwc_string *));
+		temp = css__realloc(fonts, (n_fonts + 1) * sizeof(lwc_string *));
 		if (temp == NULL) {
-			free(fonts);
+			css__free(fonts);
 			return CSS_NOMEM;
 		}
 
@@ -122,7 +123,7 @@ css_error css__cascade_font_family(uint32_t opv, css_style *style,
 				}
 
 				if (hint.data.strings != NULL) {
-					free(hint.data.strings);
+					css__free(hint.data.strings);
 				}
 			}
 
@@ -139,12 +140,12 @@ css_error css__cascade_font_family(uint32_t opv, css_style *style,
 
 		error = set_font_family(state->computed, value, fonts);
 		if (error != CSS_OK && n_fonts > 0)
-			free(fonts);
+			css__free(fonts);
 
 		return error;
 	} else {
 		if (n_fonts > 0)
-			free(fonts);
+			css__free(fonts);
 	}
 
 	return CSS_OK;
@@ -164,7 +165,7 @@ css_error css__set_font_family_from_hint(const css_hint *hint,
 	}
 
 	if (error != CSS_OK && hint->data.strings != NULL)
-		free(hint->data.strings);
+		css__free(hint->data.strings);
 
 	return error;
 }
@@ -203,7 +204,7 @@ css_error css__compose_font_family(const css_computed_style *parent,
 			for (i = names; (*i) != NULL; i++)
 				n_names++;
 
-			copy = malloc((n_names + 1) * sizeof(lwc_string *));
+			copy = css__malloc((n_names + 1) * sizeof(lwc_string *));
 			if (copy == NULL)
 				return CSS_NOMEM;
 
@@ -213,7 +214,7 @@ css_error css__compose_font_family(const css_computed_style *parent,
 
 		error = set_font_family(result, type, copy);
 		if (error != CSS_OK && copy != NULL)
-			free(copy);
+			css__free(copy);
 
 		return error;
 	}
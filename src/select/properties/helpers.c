@@ -13,92 +13,33 @@
 #include "select/properties/properties.h"
 #include "select/propget.h"
 #include "select/propset.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #include "select/properties/helpers.h"
 
-/* Useful helpers */
-
-css_unit css__to_css_unit(uint32_t u)
-{
-	switch (u) {
-	case UNIT_PX: return CSS_UNIT_PX;
-	case UNIT_EX: return CSS_UNIT_EX;
-	case UNIT_EM: return CSS_UNIT_EM;
-	case UNIT_IN: return CSS_UNIT_IN;
-	case UNIT_CM: return CSS_UNIT_CM;
-	case UNIT_MM: return CSS_UNIT_MM;
-	case UNIT_PT: return CSS_UNIT_PT;
-	case UNIT_PC: return CSS_UNIT_PC;
-	case UNIT_PCT: return CSS_UNIT_PCT;
-	case UNIT_DEG: return CSS_UNIT_DEG;
-	case UNIT_GRAD: return CSS_UNIT_GRAD;
-	case UNIT_RAD: return CSS_UNIT_RAD;
-	case UNIT_MS: return CSS_UNIT_MS;
-	case UNIT_S: return CSS_UNIT_S;
-	case UNIT_HZ: return CSS_UNIT_HZ;
-	case UNIT_KHZ: return CSS_UNIT_KHZ;
-	}
-
-	return 0;
-}
-
 /******************************************************************************
  * Utilities below here							      *
  ******************************************************************************/
-css_error css__cascade_bg_border_color(uint32_t opv, css_style *style,
-		css_select_state *state, 
-		css_error (*fun)(css_computed_style *, uint8_t, css_color))
-{
-	uint16_t value = CSS_BACKGROUND_COLOR_INHERIT;
-	css_color color = 0;
-
-	assert(CSS_BACKGROUND_COLOR_INHERIT == 
-	       (enum css_background_color_e)CSS_BORDER_COLOR_INHERIT);
-	assert(CSS_BACKGROUND_COLOR_COLOR == 
-	       (enum css_background_color_e)CSS_BORDER_COLOR_COLOR);
-	assert(CSS_BACKGROUND_COLOR_CURRENT_COLOR == 
-	       (enum css_background_color_e)CSS_BORDER_COLOR_CURRENT_COLOR);
-
-	if (isInherit(opv) == false) {
-		switch (getValue(opv)) {
-		case BACKGROUND_COLOR_TRANSPARENT:
-			value = CSS_BACKGROUND_COLOR_COLOR;
-			break;
-		case BACKGROUND_COLOR_CURRENT_COLOR:
-			value = CSS_BACKGROUND_COLOR_CURRENT_COLOR;
-			break;
-		case BACKGROUND_COLOR_SET:
-			value = CSS_BACKGROUND_COLOR_COLOR;
-			color = *((css_color *) style->bytecode);
-			advance_bytecode(style, sizeof(color));
-			break;
-		}
-	}
-
-	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
-			isInherit(opv))) {
-		return fun(state->computed, value, color);
-	}
-
-	return CSS_OK;
-}
-
 css_error css__cascade_uri_none(uint32_t opv, css_style *style,
 		css_select_state *state,
 		css_error (*fun)(css_computed_style *, uint8_t, 
 				lwc_string *))
 {
-	uint16_t value = CSS_BACKGROUND_IMAGE_INHERIT;
+	uint16_t value = CSS_LIST_STYLE_IMAGE_INHERIT;
 	lwc_string *uri = NULL;
 
+	/* cue-after, cue-before and list-style-image share these values */
+	assert(CUE_AFTER_URI == (enum op_cue_after) CUE_BEFORE_URI);
+	assert(CUE_AFTER_URI == (enum op_cue_after) LIST_STYLE_IMAGE_URI);
+
 	if (isInherit(opv) == false) {
 		switch (getValue(opv)) {
-		case BACKGROUND_IMAGE_NONE:
-			value = CSS_BACKGROUND_IMAGE_NONE;
+		case CUE_AFTER_NONE:
+			value = CSS_LIST_STYLE_IMAGE_NONE;
 			break;
-		case BACKGROUND_IMAGE_URI:
-			value = CSS_BACKGROUND_IMAGE_IMAGE;
+		case CUE_AFTER_URI:
+			value = CSS_LIST_STYLE_IMAGE_URI;
 			css__stylesheet_string_get(style->sheet, *((css_code_t *) style->bytecode), &uri);
 			advance_bytecode(style, sizeof(css_code_t));
 			break;
@@ -114,131 +55,6 @@ css_error css__cascade_uri_none(uint32_t opv, css_style *style,
 	return CSS_OK;
 }
 
-css_error css__cascade_border_style(uint32_t opv, css_style *style,
-		css_select_state *state, 
-		css_error (*fun)(css_computed_style *, uint8_t))
-{
-	uint16_t value = CSS_BORDER_STYLE_INHERIT;
-
-	UNUSED(style);
-
-	if (isInherit(opv) == false) {
-		switch (getValue(opv)) {
-		case BORDER_STYLE_NONE:
-			value = CSS_BORDER_STYLE_NONE;
-			break;
-		case BORDER_STYLE_HIDDEN:
-			value = CSS_BORDER_STYLE_HIDDEN;
-			break;
-		case BORDER_STYLE_DOTTED:
-			value = CSS_BORDER_STYLE_DOTTED;
-			break;
-		case BORDER_STYLE_DASHED:
-			value = CSS_BORDER_STYLE_DASHED;
-			break;
-		case BORDER_STYLE_SOLID:
-			value = CSS_BORDER_STYLE_SOLID;
-			break;
-		case BORDER_STYLE_DOUBLE:
-			value = CSS_BORDER_STYLE_DOUBLE;
-			break;
-		case BORDER_STYLE_GROOVE:
-			value = CSS_BORDER_STYLE_GROOVE;
-			break;
-		case BORDER_STYLE_RIDGE:
-			value = CSS_BORDER_STYLE_RIDGE;
-			break;
-		case BORDER_STYLE_INSET:
-			value = CSS_BORDER_STYLE_INSET;
-			break;
-		case BORDER_STYLE_OUTSET:
-			value = CSS_BORDER_STYLE_OUTSET;
-			break;
-		}
-	}
-
-	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
-			isInherit(opv))) {
-		return fun(state->computed, value);
-	}
-
-	return CSS_OK;
-}
-
-css_error css__cascade_border_width(uint32_t opv, css_style *style,
-		css_select_state *state, 
-		css_error (*fun)(css_computed_style *, uint8_t, css_fixed, 
-				css_unit))
-{
-	uint16_t value = CSS_BORDER_WIDTH_INHERIT;
-	css_fixed length = 0;
-	uint32_t unit = UNIT_PX;
-
-	if (isInherit(opv) == false) {
-		switch (getValue(opv)) {
-		case BORDER_WIDTH_SET:
-			value = CSS_BORDER_WIDTH_WIDTH;
-			length = *((css_fixed *) style->bytecode);
-			advance_bytecode(style, sizeof(length));
-			unit = *((uint32_t *) style->bytecode);
-			advance_bytecode(style, sizeof(unit));
-			break;
-		case BORDER_WIDTH_THIN:
-			value = CSS_BORDER_WIDTH_THIN;
-			break;
-		case BORDER_WIDTH_MEDIUM:
-			value = CSS_BORDER_WIDTH_MEDIUM;
-			break;
-		case BORDER_WIDTH_THICK:
-			value = CSS_BORDER_WIDTH_THICK;
-			break;
-		}
-	}
-
-	unit = css__to_css_unit(unit);
-
-	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
-			isInherit(opv))) {
-		return fun(state->computed, value, length, unit);
-	}
-
-	return CSS_OK;
-}
-
-css_error css__cascade_length_auto(uint32_t opv, css_style *style,
-		css_select_state *state,
-		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
-				css_unit))
-{
-	uint16_t value = CSS_BOTTOM_INHERIT;
-	css_fixed length = 0;
-	uint32_t unit = UNIT_PX;
-
-	if (isInherit(opv) == false) {
-		switch (getValue(opv)) {
-		case BOTTOM_SET:
-			value = CSS_BOTTOM_SET;
-			length = *((css_fixed *) style->bytecode);
-			advance_bytecode(style, sizeof(length));
-			unit = *((uint32_t *) style->bytecode);
-			advance_bytecode(style, sizeof(unit));
-			break;
-		case BOTTOM_AUTO:
-			value = CSS_BOTTOM_AUTO;
-			break;
-		}
-	}
-
-	unit = css__to_css_unit(unit);
-
-	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
-			isInherit(opv))) {
-		return fun(state->computed, value, length, unit);
-	}
-
-	return CSS_OK;
-}
-
 css_error css__cascade_length_normal(uint32_t opv, css_style *style,
 		css_select_state *state,
 		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
@@ -273,68 +89,6 @@ css_error css__cascade_length_normal(uint32_t opv, css_style *style,
 	return CSS_OK;
 }
 
-css_error css__cascade_length_none(uint32_t opv, css_style *style,
-		css_select_state *state,
-		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
-				css_unit))
-{
-	uint16_t value = CSS_MAX_HEIGHT_INHERIT;
-	css_fixed length = 0;
-	uint32_t unit = UNIT_PX;
-
-	if (isInherit(opv) == false) {
-		switch (getValue(opv)) {
-		case MAX_HEIGHT_SET:
-			value = CSS_MAX_HEIGHT_SET;
-			length = *((css_fixed *) style->bytecode);
-			advance_bytecode(style, sizeof(length));
-			unit = *((uint32_t *) style->bytecode);
-			advance_bytecode(style, sizeof(unit));
-			break;
-		case MAX_HEIGHT_NONE:
-			value = CSS_MAX_HEIGHT_NONE;
-			break;
-		}
-	}
-
-	unit = css__to_css_unit(unit);
-
-	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
-			isInherit(opv))) {
-		return fun(state->computed, value, length, unit);
-	}
-
-	return CSS_OK;
-}
-
-css_error css__cascade_length(uint32_t opv, css_style *style,
-		css_select_state *state,
-		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
-				css_unit))
-{
-	uint16_t value = CSS_MIN_HEIGHT_INHERIT;
-	css_fixed length = 0;
-	uint32_t unit = UNIT_PX;
-
-	if (isInherit(opv) == false) {
-		value = CSS_MIN_HEIGHT_SET;
-		length = *((css_fixed *) style->bytecode);
-		advance_bytecode(style, sizeof(length));
-		unit = *((uint32_t *) style->bytecode);
-		advance_bytecode(style, sizeof(unit));
-	}
-
-	unit = css__to_css_unit(unit);
-
-	/** \todo lose fun != NULL once all properties have set routines */
-	if (fun != NULL && css__outranks_existing(getOpcode(opv), 
-			isImportant(opv), state, isInherit(opv))) {
-		return fun(state->computed, value, length, unit);
-	}
-
-	return CSS_OK;
-}
-
 css_error css__cascade_number(uint32_t opv, css_style *style,
 		css_select_state *state,
 		css_error (*fun)(css_computed_style *, uint8_t, css_fixed))
@@ -471,12 +225,12 @@ css_error css__cascade_counter_increment_reset(uint32_t opv, css_style *style,
 				val = *((css_fixed *) style->bytecode);
 				advance_bytecode(style, sizeof(css_code_t));
 
-				temp = realloc(counters,
+				temp = css__realloc(counters,
 						(n_counters + 1) * 
 						sizeof(css_computed_counter));
 				if (temp == NULL) {
 					if (counters != NULL) {
-						free(counters);
+						css__free(counters);
 					}
 					return CSS_NOMEM;
 				}
@@ -503,10 +257,10 @@ css_error css__cascade_counter_increment_reset(uint32_t opv, css_style *style,
 	if (n_counters > 0) {
 		css_computed_counter *temp;
 
-		temp = realloc(counters, (n_counters + 1) *
+		temp = css__realloc(counters, (n_counters + 1) *
 				sizeof(css_computed_counter));
 		if (temp == NULL) {
-			free(counters);
+			css__free(counters);
 			return CSS_NOMEM;
 		}
 
@@ -522,11 +276,11 @@ css_error css__cascade_counter_increment_reset(uint32_t opv, css_style *style,
 
 		error = fun(state->computed, value, counters);
 		if (error != CSS_OK && n_counters > 0)
-			free(counters);
+			css__free(counters);
 
 		return error;
 	} else if (n_counters > 0) {
-		free(counters);
+		css__free(counters);
 	}
 
 	return CSS_OK;
@@ -541,14 +295,13 @@ css_error css__cascade_image(uint32_t opv, css_style *style,
   css_error error = CSS_OK;
 	uint8_t type = CSS_BACKGROUND_IMAGE_INHERIT;
 
-	if (!css__outranks_existing(getOpcode(opv), isImportant(opv), state,
-                             isInherit(opv))) {
-    return CSS_OK;
-	}
-
 	if (isInherit(opv) == false) {
-		image = calloc(1, sizeof(css_computed_image));
-    uint16_t value = getValue(opv);
+		uint16_t value = getValue(opv);
+
+		image = css__calloc(1, sizeof(css_computed_image));
+		if (image == NULL)
+			return CSS_NOMEM;
+
 		switch (value) {
 		case IMAGE_NONE:
 			image->type = CSS_COMPUTED_IMAGE_NONE;
@@ -556,6 +309,8 @@ css_error css__cascade_image(uint32_t opv, css_style *style,
 		case IMAGE_URI:
       image->type = CSS_COMPUTED_IMAGE_URI;
 			css__stylesheet_string_get(style->sheet, *((css_code_t *) style->bytecode), &image->data.uri);
+			/* The computed image holds a reference to its URI */
+			lwc_string_ref(image->data.uri);
 			advance_bytecode(style, sizeof(css_code_t));
 			break;
     case IMAGE_LINEAR_GRADIENT:
@@ -573,7 +328,7 @@ css_error css__cascade_image(uint32_t opv, css_style *style,
 		}
 
     if (value == IMAGE_LINEAR_GRADIENT || value == IMAGE_REPEATING_LINEAR_GRADIENT) {
-      css_computed_linear_gradient *linear = calloc(1, sizeof(css_computed_linear_gradient));
+      css_computed_linear_gradient *linear = css__calloc(1, sizeof(css_computed_linear_gradient));
       int nstop = 0;
       css_computed_color_stop stops[32];
 
@@ -610,9 +365,9 @@ css_error css__cascade_image(uint32_t opv, css_style *style,
 					goto invalid;
       }
       linear->nstop = nstop;
-      linear->stops = calloc(nstop, sizeof(css_computed_color_stop));
+      linear->stops = css__calloc(nstop, sizeof(css_computed_color_stop));
 			if (!linear->stops) {
-				free(linear);
+				css__free(linear);
 				error = CSS_NOMEM;
 				goto invalid;
 			}
@@ -625,8 +380,27 @@ css_error css__cascade_image(uint32_t opv, css_style *style,
 								 : CSS_BACKGROUND_IMAGE_NONE;
 	}
 
+	/* The value has been consumed, even if the declaration loses */
+	if (!css__outranks_existing(getOpcode(opv), isImportant(opv), state,
+			isInherit(opv))) {
+		css__computed_image_destroy(image);
+		return CSS_OK;
+	}
+
   return fun(state->computed, type, image);
 invalid:
   css__computed_image_destroy(image);
   return error;
 }
+
+/* Cascade handlers for the properties in CSS_INLINE_PROPERTIES */
+#define CSS_INLINE_CASCADE(pname, PNAME, helper)			\
+css_error css__cascade_##pname(uint32_t opv, css_style *style,		\
+		css_select_state *state)				\
+{									\
+	return css__cascade_##helper(opv, style, state, set_##pname);	\
+}
+
+CSS_INLINE_PROPERTIES(CSS_INLINE_CASCADE)
+
+#undef CSS_INLINE_CASCADE
@@ -8,43 +8,281 @@
 #ifndef css_select_properties_helpers_h_
 #define css_select_properties_helpers_h_
 
+#include <assert.h>
+
+#include "bytecode/bytecode.h"
+#include "bytecode/opcodes.h"
+#include "select/select.h"
+#include "utils/utils.h"
+
 uint32_t generic_destroy_color(void *bytecode);
 uint32_t generic_destroy_uri(void *bytecode);
 uint32_t generic_destroy_length(void *bytecode);
 uint32_t generic_destroy_number(void *bytecode);
 
-css_unit css__to_css_unit(uint32_t u);
+/*
+ * The helpers for the properties in CSS_INLINE_PROPERTIES are inline, so
+ * that cascade_style() can cascade those properties without calling out
+ * to their handlers.
+ */
+
+static inline css_unit css__to_css_unit(uint32_t u)
+{
+	switch (u) {
+	case UNIT_PX: return CSS_UNIT_PX;
+	case UNIT_EX: return CSS_UNIT_EX;
+	case UNIT_EM: return CSS_UNIT_EM;
+	case UNIT_IN: return CSS_UNIT_IN;
+	case UNIT_CM: return CSS_UNIT_CM;
+	case UNIT_MM: return CSS_UNIT_MM;
+	case UNIT_PT: return CSS_UNIT_PT;
+	case UNIT_PC: return CSS_UNIT_PC;
+	case UNIT_PCT: return CSS_UNIT_PCT;
+	case UNIT_DEG: return CSS_UNIT_DEG;
+	case UNIT_GRAD: return CSS_UNIT_GRAD;
+	case UNIT_RAD: return CSS_UNIT_RAD;
+	case UNIT_MS: return CSS_UNIT_MS;
+	case UNIT_S: return CSS_UNIT_S;
+	case UNIT_HZ: return CSS_UNIT_HZ;
+	case UNIT_KHZ: return CSS_UNIT_KHZ;
+	}
+
+	return 0;
+}
+
+static inline css_error css__cascade_bg_border_color(uint32_t opv,
+		css_style *style, css_select_state *state,
+		css_error (*fun)(css_computed_style *, uint8_t, css_color))
+{
+	uint16_t value = CSS_BACKGROUND_COLOR_INHERIT;
+	css_color color = 0;
+
+	assert(CSS_BACKGROUND_COLOR_INHERIT == 
+	       (enum css_background_color_e)CSS_BORDER_COLOR_INHERIT);
+	assert(CSS_BACKGROUND_COLOR_COLOR == 
+	       (enum css_background_color_e)CSS_BORDER_COLOR_COLOR);
+	assert(CSS_BACKGROUND_COLOR_CURRENT_COLOR == 
+	       (enum css_background_color_e)CSS_BORDER_COLOR_CURRENT_COLOR);
+
+	if (isInherit(opv) == false) {
+		switch (getValue(opv)) {
+		case BACKGROUND_COLOR_TRANSPARENT:
+			value = CSS_BACKGROUND_COLOR_COLOR;
+			break;
+		case BACKGROUND_COLOR_CURRENT_COLOR:
+			value = CSS_BACKGROUND_COLOR_CURRENT_COLOR;
+			break;
+		case BACKGROUND_COLOR_SET:
+			value = CSS_BACKGROUND_COLOR_COLOR;
+			color = *((css_color *) style->bytecode);
+			advance_bytecode(style, sizeof(color));
+			break;
+		}
+	}
+
+	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
+			isInherit(opv))) {
+		return fun(state->computed, value, color);
+	}
+
+	return CSS_OK;
+}
+
+static inline css_error css__cascade_border_style(uint32_t opv,
+		css_style *style, css_select_state *state,
+		css_error (*fun)(css_computed_style *, uint8_t))
+{
+	uint16_t value = CSS_BORDER_STYLE_INHERIT;
+
+	UNUSED(style);
+
+	if (isInherit(opv) == false) {
+		switch (getValue(opv)) {
+		case BORDER_STYLE_NONE:
+			value = CSS_BORDER_STYLE_NONE;
+			break;
+		case BORDER_STYLE_HIDDEN:
+			value = CSS_BORDER_STYLE_HIDDEN;
+			break;
+		case BORDER_STYLE_DOTTED:
+			value = CSS_BORDER_STYLE_DOTTED;
+			break;
+		case BORDER_STYLE_DASHED:
+			value = CSS_BORDER_STYLE_DASHED;
+			break;
+		case BORDER_STYLE_SOLID:
+			value = CSS_BORDER_STYLE_SOLID;
+			break;
+		case BORDER_STYLE_DOUBLE:
+			value = CSS_BORDER_STYLE_DOUBLE;
+			break;
+		case BORDER_STYLE_GROOVE:
+			value = CSS_BORDER_STYLE_GROOVE;
+			break;
+		case BORDER_STYLE_RIDGE:
+			value = CSS_BORDER_STYLE_RIDGE;
+			break;
+		case BORDER_STYLE_INSET:
+			value = CSS_BORDER_STYLE_INSET;
+			break;
+		case BORDER_STYLE_OUTSET:
+			value = CSS_BORDER_STYLE_OUTSET;
+			break;
+		}
+	}
+
+	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
+			isInherit(opv))) {
+		return fun(state->computed, value);
+	}
+
+	return CSS_OK;
+}
+
+static inline css_error css__cascade_border_width(uint32_t opv,
+		css_style *style, css_select_state *state,
+		css_error (*fun)(css_computed_style *, uint8_t, css_fixed, 
+				css_unit))
+{
+	uint16_t value = CSS_BORDER_WIDTH_INHERIT;
+	css_fixed length = 0;
+	uint32_t unit = UNIT_PX;
+
+	if (isInherit(opv) == false) {
+		switch (getValue(opv)) {
+		case BORDER_WIDTH_SET:
+			value = CSS_BORDER_WIDTH_WIDTH;
+			length = *((css_fixed *) style->bytecode);
+			advance_bytecode(style, sizeof(length));
+			unit = *((uint32_t *) style->bytecode);
+			advance_bytecode(style, sizeof(unit));
+			break;
+		case BORDER_WIDTH_THIN:
+			value = CSS_BORDER_WIDTH_THIN;
+			break;
+		case BORDER_WIDTH_MEDIUM:
+			value = CSS_BORDER_WIDTH_MEDIUM;
+			break;
+		case BORDER_WIDTH_THICK:
+			value = CSS_BORDER_WIDTH_THICK;
+			break;
+		}
+	}
+
+	unit = css__to_css_unit(unit);
+
+	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
+			isInherit(opv))) {
+		return fun(state->computed, value, length, unit);
+	}
+
+	return CSS_OK;
+}
+
+static inline css_error css__cascade_length_auto(uint32_t opv,
+		css_style *style, css_select_state *state,
+		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
+				css_unit))
+{
+	uint16_t value = CSS_BOTTOM_INHERIT;
+	css_fixed length = 0;
+	uint32_t unit = UNIT_PX;
+
+	if (isInherit(opv) == false) {
+		switch (getValue(opv)) {
+		case BOTTOM_SET:
+			value = CSS_BOTTOM_SET;
+			length = *((css_fixed *) style->bytecode);
+			advance_bytecode(style, sizeof(length));
+			unit = *((uint32_t *) style->bytecode);
+			advance_bytecode(style, sizeof(unit));
+			break;
+		case BOTTOM_AUTO:
+			value = CSS_BOTTOM_AUTO;
+			break;
+		}
+	}
+
+	unit = css__to_css_unit(unit);
+
+	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
+			isInherit(opv))) {
+		return fun(state->computed, value, length, unit);
+	}
+
+	return CSS_OK;
+}
+
+static inline css_error css__cascade_length_none(uint32_t opv,
+		css_style *style, css_select_state *state,
+		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
+				css_unit))
+{
+	uint16_t value = CSS_MAX_HEIGHT_INHERIT;
+	css_fixed length = 0;
+	uint32_t unit = UNIT_PX;
+
+	if (isInherit(opv) == false) {
+		switch (getValue(opv)) {
+		case MAX_HEIGHT_SET:
+			value = CSS_MAX_HEIGHT_SET;
+			length = *((css_fixed *) style->bytecode);
+			advance_bytecode(style, sizeof(length));
+			unit = *((uint32_t *) style->bytecode);
+			advance_bytecode(style, sizeof(unit));
+			break;
+		case MAX_HEIGHT_NONE:
+			value = CSS_MAX_HEIGHT_NONE;
+			break;
+		}
+	}
+
+	unit = css__to_css_unit(unit);
+
+	if (css__outranks_existing(getOpcode(opv), isImportant(opv), state,
+			isInherit(opv))) {
+		return fun(state->computed, value, length, unit);
+	}
+
+	return CSS_OK;
+}
+
+static inline css_error css__cascade_length(uint32_t opv,
+		css_style *style, css_select_state *state,
+		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
+				css_unit))
+{
+	uint16_t value = CSS_MIN_HEIGHT_INHERIT;
+	css_fixed length = 0;
+	uint32_t unit = UNIT_PX;
+
+	if (isInherit(opv) == false) {
+		value = CSS_MIN_HEIGHT_SET;
+		length = *((css_fixed *) style->bytecode);
+		advance_bytecode(style, sizeof(length));
+		unit = *((uint32_t *) style->bytecode);
+		advance_bytecode(style, sizeof(unit));
+	}
+
+	unit = css__to_css_unit(unit);
+
+	/** \todo lose fun != NULL once all properties have set routines */
+	if (fun != NULL && css__outranks_existing(getOpcode(opv), 
+			isImportant(opv), state, isInherit(opv))) {
+		return fun(state->computed, value, length, unit);
+	}
+
+	return CSS_OK;
+}
 
-css_error css__cascade_bg_border_color(uint32_t opv, css_style *style,
-		css_select_state *state, 
-		css_error (*fun)(css_computed_style *, uint8_t, css_color));
 css_error css__cascade_uri_none(uint32_t opv, css_style *style,
 		css_select_state *state,
 		css_error (*fun)(css_computed_style *, uint8_t, 
 				lwc_string *));
-css_error css__cascade_border_style(uint32_t opv, css_style *style,
-		css_select_state *state, 
-		css_error (*fun)(css_computed_style *, uint8_t));
-css_error css__cascade_border_width(uint32_t opv, css_style *style,
-		css_select_state *state, 
-		css_error (*fun)(css_computed_style *, uint8_t, css_fixed, 
-				css_unit));
-css_error css__cascade_length_auto(uint32_t opv, css_style *style,
-		css_select_state *state,
-		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
-				css_unit));
 css_error css__cascade_length_normal(uint32_t opv, css_style *style,
 		css_select_state *state,
 		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
 				css_unit));
-css_error css__cascade_length_none(uint32_t opv, css_style *style,
-		css_select_state *state,
-		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
-				css_unit));
-css_error css__cascade_length(uint32_t opv, css_style *style,
-		css_select_state *state,
-		css_error (*fun)(css_computed_style *, uint8_t, css_fixed,
-				css_unit));
 css_error css__cascade_number(uint32_t opv, css_style *style,
 		css_select_state *state,
 		css_error (*fun)(css_computed_style *, uint8_t, css_fixed));
@@ -63,4 +301,44 @@ css_error css__cascade_image(uint32_t opv, css_style *style,
 		css_select_state *state,
 		css_error (*fun)(css_computed_style *, uint8_t, css_computed_image *));
 
+/*
+ * The properties cascaded inline by cascade_style(), as
+ * X(property, opcode suffix, helper).  Each is cascaded by
+ * css__cascade_<helper>() with set_<property>(); their cascade handlers
+ * are generated from this list in helpers.c.
+ */
+#define CSS_INLINE_PROPERTIES(X)					\
+	X(background_color, BACKGROUND_COLOR, bg_border_color)		\
+	X(border_top_color, BORDER_TOP_COLOR, bg_border_color)		\
+	X(border_right_color, BORDER_RIGHT_COLOR, bg_border_color)	\
+	X(border_bottom_color, BORDER_BOTTOM_COLOR, bg_border_color)	\
+	X(border_left_color, BORDER_LEFT_COLOR, bg_border_color)	\
+	X(border_top_style, BORDER_TOP_STYLE, border_style)		\
+	X(border_right_style, BORDER_RIGHT_STYLE, border_style)		\
+	X(border_bottom_style, BORDER_BOTTOM_STYLE, border_style)	\
+	X(border_left_style, BORDER_LEFT_STYLE, border_style)		\
+	X(border_top_width, BORDER_TOP_WIDTH, border_width)		\
+	X(border_right_width, BORDER_RIGHT_WIDTH, border_width)		\
+	X(border_bottom_width, BORDER_BOTTOM_WIDTH, border_width)	\
+	X(border_left_width, BORDER_LEFT_WIDTH, border_width)		\
+	X(top, TOP, length_auto)					\
+	X(right, RIGHT, length_auto)					\
+	X(bottom, BOTTOM, length_auto)					\
+	X(left, LEFT, length_auto)					\
+	X(width, WIDTH, length_auto)					\
+	X(height, HEIGHT, length_auto)					\
+	X(margin_top, MARGIN_TOP, length_auto)				\
+	X(margin_right, MARGIN_RIGHT, length_auto)			\
+	X(margin_bottom, MARGIN_BOTTOM, length_auto)			\
+	X(margin_left, MARGIN_LEFT, length_auto)			\
+	X(max_height, MAX_HEIGHT, length_none)				\
+	X(max_width, MAX_WIDTH, length_none)				\
+	X(min_height, MIN_HEIGHT, length)				\
+	X(min_width, MIN_WIDTH, length)					\
+	X(padding_top, PADDING_TOP, length)				\
+	X(padding_right, PADDING_RIGHT, length)				\
+	X(padding_bottom, PADDING_BOTTOM, length)			\
+	X(padding_left, PADDING_LEFT, length)				\
+	X(text_indent, TEXT_INDENT, length)
+
 #endif
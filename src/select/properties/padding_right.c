@@ -14,11 +14,7 @@
 #include "select/properties/properties.h"
 #include "select/properties/helpers.h"
 
-css_error css__cascade_padding_right(uint32_t opv, css_style *style, 
-		css_select_state *state)
-{
-	return css__cascade_length(opv, style, state, set_padding_right);
-}
+/* css__cascade_padding_right() is generated from CSS_INLINE_PROPERTIES */
 
 css_error css__set_padding_right_from_hint(const css_hint *hint,
 		css_computed_style *style)
@@ -20,7 +20,7 @@ css_error css__cascade_play_during(uint32_t opv, css_style *style,
 	lwc_string *uri = NULL;
 
 	if (isInherit(opv) == false) {
-		switch (getValue(opv)) {
+		switch (getValue(opv) & PLAY_DURING_TYPE_MASK) {
 		case PLAY_DURING_URI:
 			css__stylesheet_string_get(style->sheet, *((css_code_t *) style->bytecode), &uri);
 			advance_bytecode(style, sizeof(css_code_t));
@@ -9,6 +9,7 @@
 #include "bytecode/opcodes.h"
 #include "select/propset.h"
 #include "select/propget.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #include "select/properties/properties.h"
@@ -40,11 +41,11 @@ css_error css__cascade_quotes(uint32_t opv, css_style *style,
 					&close);
 			advance_bytecode(style, sizeof(css_code_t));
 
-			temp = realloc(quotes, 
+			temp = css__realloc(quotes, 
 					(n_quotes + 2) * sizeof(lwc_string *));
 			if (temp == NULL) {
 				if (quotes != NULL) {
-					free(quotes);
+					css__free(quotes);
 				}
 				return CSS_NOMEM;
 			}
@@ -63,9 +64,9 @@ css_error css__cascade_quotes(uint32_t opv, css_style *style,
 	if (n_quotes > 0) {
 		lwc_string **temp;
 
-		temp = realloc(quotes, (n_quotes + 1) * sizeof(lwc_string *));
+		temp = css__realloc(quotes, (n_quotes + 1) * sizeof(lwc_string *));
 		if (temp == NULL) {
-			free(quotes);
+			css__free(quotes);
 			return CSS_NOMEM;
 		}
 
@@ -80,12 +81,12 @@ css_error css__cascade_quotes(uint32_t opv, css_style *style,
 
 		error = set_quotes(state->computed, value, quotes);
 		if (error != CSS_OK && quotes != NULL)
-			free(quotes);
+			css__free(quotes);
 
 		return error;
 	} else {
 		if (quotes != NULL)
-			free(quotes);
+			css__free(quotes);
 	}
 
 	return CSS_OK;
@@ -105,7 +106,7 @@ css_error css__set_quotes_from_hint(const css_hint *hint,
 	}
 
 	if (error != CSS_OK && hint->data.strings != NULL)
-		free(hint->data.strings);
+		css__free(hint->data.strings);
 
 	return error;
 }
@@ -145,7 +146,7 @@ css_error css__compose_quotes(const css_computed_style *parent,
 			for (i = quotes; (*i) != NULL; i++)
 				n_quotes++;
 
-			copy = malloc((n_quotes + 1) * sizeof(lwc_string *));
+			copy = css__malloc((n_quotes + 1) * sizeof(lwc_string *));
 			if (copy == NULL)
 				return CSS_NOMEM;
 
@@ -155,7 +156,7 @@ css_error css__compose_quotes(const css_computed_style *parent,
 
 		error = set_quotes(result, type, copy);
 		if (error != CSS_OK && copy != NULL)
-			free(copy);
+			css__free(copy);
 
 		return error;
 	}
@@ -9,6 +9,7 @@
 #include "bytecode/opcodes.h"
 #include "select/propset.h"
 #include "select/propget.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 #include "select/properties/properties.h"
@@ -55,11 +56,11 @@ css_error css__cascade_voice_family(uint32_t opv, css_style *style,
 			 * first generic-family are ignored. */
 			/** \todo Do this at bytecode generation time? */
 			if (value == 0 && voice != NULL) {
-				temp = realloc(voices, 
+				temp = css__realloc(voices, 
 					(n_voices + 1) * sizeof(lwc_string *));
 				if (temp == NULL) {
 					if (voices != NULL) {
-						free(voices);
+						css__free(voices);
 					}
 					return CSS_NOMEM;
 				}
@@ -80,9 +81,9 @@ css_error css__cascade_voice_family(uint32_t opv, css_style *style,
 	if (n_voices > 0) {
 		lwc_string **temp;
 
-		temp = realloc(voices, (n_voices + 1) * sizeof(lwc_string *));
+		temp = css__realloc(voices, (n_voices + 1) * sizeof(lwc_string *));
 		if (temp == NULL) {
-			free(voices);
+			css__free(voices);
 			return CSS_NOMEM;
 		}
 
@@ -95,10 +96,10 @@ css_error css__cascade_voice_family(uint32_t opv, css_style *style,
 			isInherit(opv))) {
 		/** \todo voice-family */
 		if (n_voices > 0)
-			free(voices);
+			css__free(voices);
 	} else {
 		if (n_voices > 0)
-			free(voices);
+			css__free(voices);
 	}
 
 	return CSS_OK;
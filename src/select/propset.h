@@ -12,6 +12,8 @@
 
 #include <libcss/computed.h>
 #include "computed.h"
+#include "pool.h"
+#include "utils/alloc.h"
 
 /* Important: keep this file in sync with computed.h */
 /** \todo Is there a better way to ensure this happens? */
@@ -67,7 +69,7 @@ static const css_computed_uncommon default_uncommon = {
 
 #define ENSURE_UNCOMMON do {						\
 	if (style->i.uncommon == NULL) {				\
-		style->i.uncommon = malloc(				\
+		style->i.uncommon = css__pool_alloc(			\
 				sizeof(css_computed_uncommon));		\
 		if (style->i.uncommon == NULL)				\
 			return CSS_NOMEM;				\
@@ -91,7 +93,8 @@ static const css_computed_page default_page = {
 
 #define ENSURE_PAGE do {						\
 	if (style->page == NULL) {					\
-		style->page = malloc(sizeof(css_computed_page));	\
+		style->page = css__pool_alloc(				\
+				sizeof(css_computed_page));		\
 		if (style->page == NULL)				\
 			return CSS_NOMEM;				\
 									\
@@ -355,7 +358,7 @@ static inline css_error set_counter_increment(
 			lwc_string_unref(c->name);
 
 		if (oldcounters != counters)
-			free(oldcounters);
+			css__free(oldcounters);
 	}
 
 	return CSS_OK;
@@ -395,7 +398,7 @@ static inline css_error set_counter_reset(
 			lwc_string_unref(c->name);
 
 		if (oldcounters != counters)
-			free(oldcounters);
+			css__free(oldcounters);
 	}
 
 	return CSS_OK;
@@ -435,7 +438,7 @@ static inline css_error set_cursor(
 			lwc_string_unref(*s);
 
 		if (oldurls != urls)
-			free(oldurls);
+			css__free(oldurls);
 	}
 
 	return CSS_OK;
@@ -763,7 +766,7 @@ static inline css_error set_content(
 		}
 
 		if (oldcontent != content)
-			free(oldcontent);
+			css__free(oldcontent);
 	}
 
 	return CSS_OK;
@@ -915,8 +918,8 @@ static inline css_error set_background_image(
 			if (oldimg->type == CSS_COMPUTED_IMAGE_LINEAR_GRADIENT ||
 					oldimg->type == CSS_COMPUTED_IMAGE_REPEATING_LINEAR_GRADIENT) {
 				if (oldimg->data.linear->nstop)
-					free(oldimg->data.linear->stops);
-				free(oldimg->data.linear);
+					css__free(oldimg->data.linear->stops);
+				css__free(oldimg->data.linear);
 			} else if (oldimg->type == CSS_COMPUTED_IMAGE_RADIAL_GRADIENT ||
 								 oldimg->type == CSS_COMPUTED_IMAGE_REPEATING_RADIAL_GRADIENT) {
 
@@ -924,7 +927,7 @@ static inline css_error set_background_image(
 				lwc_string_unref(oldimg->data.uri);
 			}
 		}
-    free(oldimg);
+    css__free(oldimg);
 	}
 
 	return CSS_OK;
@@ -1009,7 +1012,7 @@ static inline css_error set_quotes(
 			lwc_string_unref(*s);
 
 		if (oldquotes != quotes)
-			free(oldquotes);
+			css__free(oldquotes);
 	}
 
 	return CSS_OK;
@@ -1951,7 +1954,7 @@ static inline css_error set_font_family(
 			lwc_string_unref(*s);
 
 		if (oldnames != names)
-			free(oldnames);
+			css__free(oldnames);
 	}
 
 	return CSS_OK;
@@ -2334,7 +2337,7 @@ static const css_computed_flexbox default_flexbox = {
 #define ENSURE_FLEXBOX															  \
 	do {																			\
 		if (style->flexbox == NULL) {											   \
-			style->flexbox = malloc(sizeof(css_computed_flexbox));				  \
+			style->flexbox = css__pool_alloc(sizeof(css_computed_flexbox));		  \
 			if (style->flexbox == NULL)											 \
 				return CSS_NOMEM;												   \
 																					\
@@ -2582,7 +2585,7 @@ static const css_computed_border_radius default_border_radius = {
 #define ENSURE_RADIUS															  \
 	do {																			\
 		if (style->radius == NULL) {											   \
-			style->radius = malloc(sizeof(css_computed_border_radius));				  \
+			style->radius = css__pool_alloc(sizeof(css_computed_border_radius));	  \
 			if (style->radius == NULL)											 \
 				return CSS_NOMEM;												   \
 																					\
@@ -19,10 +19,13 @@
 #include "select/computed.h"
 #include "select/dispatch.h"
 #include "select/hash.h"
+#include "select/initial.h"
 #include "select/propset.h"
+#include "select/properties/helpers.h"
 #include "select/font_face.h"
 #include "select/select.h"
 #include "utils/parserutilserror.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 
 /* Define this to enable verbose messages when matching selector chains */
@@ -81,8 +84,28 @@ struct css_select_ctx {
 
 	/* Interned default style */
 	css_computed_style *default_style;
+
+	/* Initial value template */
+	css_initial_template *initial;
+
+	/* Generation of the sheet list, for ancestor memos */
+	uint32_t generation;
 };
 
+/**
+ * Source of selection context generations
+ *
+ * Every context takes a new generation whenever its sheets change, so an
+ * ancestor memo made with one set of sheets is never used with another.
+ * Memos live on nodes, which may be selected for with more than one context,
+ * so the generations come from the whole process rather than each context.
+ * They only change where a context adds, removes or destroys sheets, which
+ * interns and releases strings, so this is no less thread-safe than the
+ * string interning libcss already relies on.  A stale memo could only be
+ * mistaken for a current one once the counter wraps, after 2^32 changes.
+ */
+static uint32_t css_select_generation;
+
 /**
  * Container for selected font faces
  */
@@ -111,16 +134,15 @@ typedef struct css_select_rule_source {
 		CSS_SELECT_RULE_SRC_ELEMENT,
 		CSS_SELECT_RULE_SRC_CLASS,
 		CSS_SELECT_RULE_SRC_ID,
-		CSS_SELECT_RULE_SRC_UNIVERSAL
+		CSS_SELECT_RULE_SRC_UNIVERSAL,
+		CSS_SELECT_RULE_SRC_KEYED
 	} source;
 	uint32_t class;
+	uint32_t keyed;
 } css_select_rule_source;
 
 
 static css_error set_hint(css_select_state *state, css_hint *hint);
-static css_error set_initial(css_select_state *state, 
-		uint32_t prop, css_pseudo_element pseudo,
-		void *parent);
 
 static css_error intern_strings(css_select_ctx *ctx);
 static void destroy_strings(css_select_ctx *ctx);
@@ -139,13 +161,17 @@ static css_error match_universal_combinator(css_select_ctx *ctx,
 		css_combinator type, const css_selector *selector, 
 		css_select_state *state, void *node, bool may_optimise,
 		bool *rejected_by_cache, void **next_node);
+static css_error match_ancestor_details(css_select_ctx *ctx, void *node,
+		const css_selector *selector, css_select_state *state,
+		bool *match);
 static css_error match_details(css_select_ctx *ctx, void *node, 
 		const css_selector_detail *detail, css_select_state *state, 
 		bool *match, css_pseudo_element *pseudo_element);
 static css_error match_detail(css_select_ctx *ctx, void *node, 
 		const css_selector_detail *detail, css_select_state *state, 
 		bool *match, css_pseudo_element *pseudo_element);
-static css_error cascade_style(const css_style *style, css_select_state *state);
+static css_error cascade_style(css_style *style, css_select_state *state);
+static void decode_style(css_style *style);
 
 static css_error select_font_faces_from_sheet(
 		const css_stylesheet *sheet, 
@@ -161,7 +187,7 @@ static css_error css__create_node_data(struct css_node_data **node_data)
 {
 	struct css_node_data *nd;
 
-	nd = calloc(sizeof(struct css_node_data), 1);
+	nd = css__calloc(sizeof(struct css_node_data), 1);
 	if (nd == NULL) {
 		return CSS_NOMEM;
 	}
@@ -178,7 +204,11 @@ static void css__destroy_node_data(struct css_node_data *node_data)
 	assert(node_data != NULL);
 
 	if (node_data->bloom != NULL) {
-		free(node_data->bloom);
+		css__free(node_data->bloom);
+	}
+
+	if (node_data->memo != NULL) {
+		css__free(node_data->memo);
 	}
 
 	for (i = 0; i < CSS_PSEUDO_ELEMENT_COUNT; i++) {
@@ -188,7 +218,7 @@ static void css__destroy_node_data(struct css_node_data *node_data)
 		}
 	}
 
-	free(node_data);
+	css__free(node_data);
 }
 
 
@@ -257,16 +287,25 @@ css_error css_select_ctx_create(css_select_ctx **result)
 	if (result == NULL)
 		return CSS_BADPARM;
 
-	c = calloc(sizeof(css_select_ctx), 1);
+	c = css__calloc(sizeof(css_select_ctx), 1);
 	if (c == NULL)
 		return CSS_NOMEM;
 
+	error = css__initial_template_create(&c->initial);
+	if (error != CSS_OK) {
+		css__free(c);
+		return error;
+	}
+
 	error = intern_strings(c);
 	if (error != CSS_OK) {
-		free(c);
+		css__initial_template_destroy(c->initial);
+		css__free(c);
 		return error;
 	}
 
+	c->generation = ++css_select_generation;
+
 	*result = c;
 
 	return CSS_OK;
@@ -285,13 +324,18 @@ css_error css_select_ctx_destroy(css_select_ctx *ctx)
 
 	destroy_strings(ctx);
 
+	css__initial_template_destroy(ctx->initial);
+
 	if (ctx->default_style != NULL)
 		css_computed_style_destroy(ctx->default_style);
 
 	if (ctx->sheets != NULL)
-		free(ctx->sheets);
+		css__free(ctx->sheets);
+
+	/* The sheets may now be destroyed, and their memory reused */
+	css_select_generation++;
 
-	free(ctx);
+	css__free(ctx);
 
 	return CSS_OK;
 }
@@ -344,7 +388,7 @@ css_error css_select_ctx_insert_sheet(css_select_ctx *ctx,
 	if (index > ctx->n_sheets)
 		return CSS_INVALID;
 
-	temp = realloc(ctx->sheets, 
+	temp = css__realloc(ctx->sheets, 
 			(ctx->n_sheets + 1) * sizeof(css_select_sheet));
 	if (temp == NULL)
 		return CSS_NOMEM;
@@ -362,6 +406,8 @@ css_error css_select_ctx_insert_sheet(css_select_ctx *ctx,
 
 	ctx->n_sheets++;
 
+	ctx->generation = ++css_select_generation;
+
 	return CSS_OK;
 }
 
@@ -393,6 +439,8 @@ css_error css_select_ctx_remove_sheet(css_select_ctx *ctx,
 
 	ctx->n_sheets--;
 
+	ctx->generation = ++css_select_generation;
+
 	return CSS_OK;
 
 }
@@ -557,7 +605,7 @@ static css_error css__get_parent_bloom(void *parent,
 			 * fall back to a fully satruated bloom filter,
 			 * which is slower but perfectly valid.
 			 */
-			bloom = malloc(sizeof(css_bloom) * CSS_BLOOM_SIZE);
+			bloom = css__malloc(sizeof(css_bloom) * CSS_BLOOM_SIZE);
 			if (bloom == NULL) {
 				return CSS_NOMEM;
 			}
@@ -569,7 +617,7 @@ static css_error css__get_parent_bloom(void *parent,
 			if (node_data == NULL) {
 				error = css__create_node_data(&node_data);
 				if (error != CSS_OK) {
-					free(bloom);
+					css__free(bloom);
 					return error;
 				}
 				node_data->bloom = bloom;
@@ -612,7 +660,7 @@ static css_error css__create_node_bloom(
 	*node_bloom = NULL;
 
 	/* Create the node's bloom */
-	bloom = calloc(sizeof(css_bloom), CSS_BLOOM_SIZE);
+	bloom = css__calloc(sizeof(css_bloom), CSS_BLOOM_SIZE);
 	if (bloom == NULL) {
 		return CSS_NOMEM;
 	}
@@ -655,7 +703,7 @@ static css_error css__create_node_bloom(
 	return CSS_OK;
 
 cleanup:
-	free(bloom);
+	css__free(bloom);
 
 	return error;
 }
@@ -751,6 +799,16 @@ static css_error css_select_style__get_sharable_node_data_for_candidate(
 		return error;
 	}
 
+	/* The candidate must have selected the pseudo elements we want */
+	if ((node_data->pseudo_elements & state->pseudo_elements) !=
+			state->pseudo_elements) {
+#ifdef DEBUG_STYLE_SHARING
+		printf("      \t%s\tno share: pseudo elements not selected\n",
+				lwc_string_data(state->element.name));
+#endif
+		return CSS_OK;
+	}
+
 	/* If one node has hints and other doesn't then can't share */
 	if ((node_data->flags & CSS_NODE_FLAGS_HAS_HINTS) !=
 			(state->node_data->flags & CSS_NODE_FLAGS_HAS_HINTS)) {
@@ -775,14 +833,13 @@ static css_error css_select_style__get_sharable_node_data_for_candidate(
 	}
 
 	/* If the node was affected by attribute or pseudo class rules,
-	 * or had an inline style, it's not a candidate for sharing */
+	 * it's not a candidate for sharing */
 	if (node_data->flags & (
 			CSS_NODE_FLAGS_TAINT_PSEUDO_CLASS |
 			CSS_NODE_FLAGS_TAINT_ATTRIBUTE |
-			CSS_NODE_FLAGS_TAINT_SIBLING |
-			CSS_NODE_FLAGS_HAS_INLINE_STYLE)) {
+			CSS_NODE_FLAGS_TAINT_SIBLING)) {
 #ifdef DEBUG_STYLE_SHARING
-		printf("      \t%s\tno share: candidate flags: %s%s%s%s\n",
+		printf("      \t%s\tno share: candidate flags: %s%s%s\n",
 				lwc_string_data(state->element.name),
 				(node_data->flags &
 					CSS_NODE_FLAGS_TAINT_PSEUDO_CLASS) ?
@@ -792,10 +849,22 @@ static css_error css_select_style__get_sharable_node_data_for_candidate(
 						" ATTRIBUTE" : "",
 				(node_data->flags &
 					CSS_NODE_FLAGS_TAINT_SIBLING) ?
-						" SIBLING" : "",
-				(node_data->flags &
-					CSS_NODE_FLAGS_HAS_INLINE_STYLE) ?
-						" INLINE_STYLE" : "");
+						" SIBLING" : "");
+#endif
+		return CSS_OK;
+	}
+
+	/* Inline styles must be the same shared sheet.  The selection node's
+	 * inline style, if any, is known to be shared; an unshared inline
+	 * style on the candidate has id 0, so never matches. */
+	if ((node_data->flags & CSS_NODE_FLAGS_HAS_INLINE_STYLE) !=
+			(state->node_data->flags &
+					CSS_NODE_FLAGS_HAS_INLINE_STYLE) ||
+			node_data->inline_style !=
+					state->node_data->inline_style) {
+#ifdef DEBUG_STYLE_SHARING
+		printf("      \t%s\tno share: inline style mismatch\n",
+				lwc_string_data(state->element.name));
 #endif
 		return CSS_OK;
 	}
@@ -934,9 +1003,11 @@ printf("      \t%s\tno share: node id (%s)\n", lwc_string_data(state->element.na
 #endif
 		return CSS_OK;
 	}
-	if (state->node_data->flags & CSS_NODE_FLAGS_HAS_INLINE_STYLE) {
+	if ((state->node_data->flags & CSS_NODE_FLAGS_HAS_INLINE_STYLE) &&
+			state->node_data->inline_style == 0) {
+		/* Only nodes with a shared inline style can share. */
 #ifdef DEBUG_STYLE_SHARING
-printf("      \t%s\tno share: inline style\n");
+printf("      \t%s\tno share: unshared inline style\n", lwc_string_data(state->element.name));
 #endif
 		return CSS_OK;
 	}
@@ -1032,6 +1103,8 @@ static void css_select__finalise_selection_state(
  * \param[in]  node     The node we are selecting for.
  * \param[in]  parent   The node's parent node, or NULL.
  * \param[in]  media    The media type we're selecting for.
+ * \param[in]  pseudo_elements  Mask of pseudo elements to select for,
+ *                              including CSS_PSEUDO_ELEMENT_NONE.
  * \param[in]  handler  The client selection callback table.
  * \param[in]  pw       The client private data, passsed out to callbacks.
  * \return CSS_OK or appropriate error otherwise.
@@ -1041,23 +1114,26 @@ static css_error css_select__initialise_selection_state(
 		void *node,
 		void *parent,
 		uint64_t media,
+		uint32_t pseudo_elements,
 		css_select_handler *handler,
 		void *pw)
 {
 	css_error error;
+	uint32_t i;
 	bool match;
 
 	/* Set up the selection state */
 	memset(state, 0, sizeof(*state));
 	state->node = node;
 	state->media = media;
+	state->pseudo_elements = pseudo_elements;
 	state->handler = handler;
 	state->pw = pw;
 	state->next_reject = state->reject_cache +
 			(N_ELEMENTS(state->reject_cache) - 1);
 
 	/* Allocate the result set */
-	state->results = calloc(1, sizeof(css_select_results));
+	state->results = css__calloc(1, sizeof(css_select_results));
 	if (state->results == NULL) {
 		return CSS_NOMEM;
 	}
@@ -1092,6 +1168,31 @@ static css_error css_select__initialise_selection_state(
 		goto failed;
 	}
 
+	/* The selector hash compares names by their insensitive variants,
+	 * so resolve them once here */
+	if (state->element.name->insensitive == NULL &&
+			lwc__intern_caseless_string(state->element.name) !=
+			lwc_error_ok) {
+		error = CSS_NOMEM;
+		goto failed;
+	}
+
+	if (state->id != NULL && state->id->insensitive == NULL &&
+			lwc__intern_caseless_string(state->id) !=
+			lwc_error_ok) {
+		error = CSS_NOMEM;
+		goto failed;
+	}
+
+	for (i = 0; i < state->n_classes; i++) {
+		if (state->classes[i]->insensitive == NULL &&
+				lwc__intern_caseless_string(
+					state->classes[i]) != lwc_error_ok) {
+			error = CSS_NOMEM;
+			goto failed;
+		}
+	}
+
 	/* Node pseudo classes */
 	error = handler->node_is_link(pw, node, &match);
 	if (error != CSS_OK){
@@ -1148,6 +1249,37 @@ failed:
  * \param result          Pointer to location to receive result set
  * \return CSS_OK on success, appropriate error otherwise.
  *
+ * Styles are selected for all pseudo elements.  See
+ * css_select_style_pseudo_elements().
+ */
+css_error css_select_style(css_select_ctx *ctx, void *node,
+		uint64_t media, const css_stylesheet *inline_style,
+		css_select_handler *handler, void *pw,
+		css_select_results **result)
+{
+	return css_select_style_pseudo_elements(ctx, node, media,
+			inline_style, CSS_PSEUDO_ELEMENT_MASK_ALL,
+			handler, pw, result);
+}
+
+/**
+ * Select a style for the given node and some of its pseudo elements
+ *
+ * \param ctx              Selection context to use
+ * \param node             Node to select style for
+ * \param media            Currently active media types
+ * \param inline_style     Corresponding inline style for node, or NULL
+ * \param pseudo_elements  Mask of pseudo elements to select styles for
+ * \param handler          Dispatch table of handler functions
+ * \param pw               Client-specific private data for handler functions
+ * \param result           Pointer to location to receive result set
+ * \return CSS_OK on success, appropriate error otherwise.
+ *
+ * Rules for pseudo elements which aren't in \a pseudo_elements are not
+ * matched, and the result set has no styles for them.  They may be
+ * selected later, with css_select_pseudo_element().  The result set may
+ * include styles for other pseudo elements if they were available anyway.
+ *
  * In computing the style, no reference is made to the parent node's
  * style. Therefore, the resultant computed style is not ready for
  * immediate use, as some properties may be marked as inherited.
@@ -1157,8 +1289,9 @@ failed:
  * the client to store the partially computed style and efficiently
  * update the fully computed style for a node when layout changes.
  */
-css_error css_select_style(css_select_ctx *ctx, void *node,
+css_error css_select_style_pseudo_elements(css_select_ctx *ctx, void *node,
 		uint64_t media, const css_stylesheet *inline_style,
+		uint32_t pseudo_elements,
 		css_select_handler *handler, void *pw,
 		css_select_results **result)
 {
@@ -1177,8 +1310,11 @@ css_error css_select_style(css_select_ctx *ctx, void *node,
 	if (error != CSS_OK)
 		return error;
 
-	error = css_select__initialise_selection_state(
-			&state, node, parent, media, handler, pw);
+	/* The element's own style is always selected */
+	error = css_select__initialise_selection_state(&state, node, parent,
+			media, (pseudo_elements & CSS_PSEUDO_ELEMENT_MASK_ALL) |
+				(1 << CSS_PSEUDO_ELEMENT_NONE),
+			handler, pw);
 	if (error != CSS_OK)
 		return error;
 
@@ -1192,6 +1328,7 @@ css_error css_select_style(css_select_ctx *ctx, void *node,
 
 	if (inline_style != NULL) {
 		state.node_data->flags |= CSS_NODE_FLAGS_HAS_INLINE_STYLE;
+		state.node_data->inline_style = inline_style->shared_id;
 	}
 
 	/* Check if we can share another node's style */
@@ -1204,6 +1341,7 @@ css_error css_select_style(css_select_ctx *ctx, void *node,
 			state.results->styles[i] =
 					css__computed_style_ref(styles[i]);
 		}
+		state.node_data->pseudo_elements = share->pseudo_elements;
 #ifdef DEBUG_STYLE_SHARING
 		printf("style:\t%s\tSHARED!\n",
 				lwc_string_data(state.element.name));
@@ -1283,22 +1421,10 @@ css_error css_select_style(css_select_ctx *ctx, void *node,
 	/* Base element */
 	state.current_pseudo = CSS_PSEUDO_ELEMENT_NONE;
 	state.computed = state.results->styles[CSS_PSEUDO_ELEMENT_NONE];
-	for (i = 0; i < CSS_N_PROPERTIES; i++) {
-		const prop_state *prop = 
-				&state.props[i][CSS_PSEUDO_ELEMENT_NONE];
-
-		/* If the property is still unset or it's set to inherit 
-		 * and we're the root element, then set it to its initial 
-		 * value. */
-		if (prop->set == false || 
-				(parent == NULL && 
-				prop->inherit == true)) {
-			error = set_initial(&state, i, 
-					CSS_PSEUDO_ELEMENT_NONE, parent);
-			if (error != CSS_OK)
-				goto cleanup;
-		}
-	}
+	error = css__initial_values_set(ctx->initial, &state,
+			CSS_PSEUDO_ELEMENT_NONE, parent == NULL);
+	if (error != CSS_OK)
+		goto cleanup;
 
 	/* Pseudo elements, if any */
 	for (j = CSS_PSEUDO_ELEMENT_NONE + 1; j < CSS_PSEUDO_ELEMENT_COUNT; j++) {
@@ -1309,17 +1435,9 @@ css_error css_select_style(css_select_ctx *ctx, void *node,
 		if (state.computed == NULL)
 			continue;
 
-		for (i = 0; i < CSS_N_PROPERTIES; i++) {
-			const prop_state *prop = &state.props[i][j];
-
-			/* If the property is still unset then set it 
-			 * to its initial value. */
-			if (prop->set == false) {
-				error = set_initial(&state, i, j, parent);
-				if (error != CSS_OK)
-					goto cleanup;
-			}
-		}
+		error = css__initial_values_set(ctx->initial, &state, j, false);
+		if (error != CSS_OK)
+			goto cleanup;
 	}
 
 	/* If this is the root element, then we must ensure that all
@@ -1347,6 +1465,8 @@ css_error css_select_style(css_select_ctx *ctx, void *node,
 		}
 	}
 
+	state.node_data->pseudo_elements = state.pseudo_elements;
+
 complete:
 	error = css__set_node_data(node, &state, handler, pw);
 	if (error != CSS_OK) {
@@ -1369,6 +1489,123 @@ cleanup:
 	return error;
 }
 
+/**
+ * Select a style for one of a node's pseudo elements
+ *
+ * \param ctx             Selection context to use
+ * \param node            Node whose pseudo element to select style for
+ * \param media           Currently active media types
+ * \param pseudo_element  Pseudo element to select style for
+ * \param handler         Dispatch table of handler functions
+ * \param pw              Client-specific private data for handler functions
+ * \param style           Pointer to location to receive style, which is
+ *                        NULL if no rules apply to the pseudo element
+ * \return CSS_OK on success, appropriate error otherwise.
+ *
+ * This completes a selection for the node made without the pseudo
+ * element, and must be given the same selection context and media.  Only
+ * rules for the pseudo element are considered; the element's own style is
+ * not selected again.  The result is kept with the node's data, so it is
+ * reused by later calls for the node and by nodes sharing its style.
+ *
+ * As with css_select_style(), the style must be composed before use.
+ */
+css_error css_select_pseudo_element(css_select_ctx *ctx, void *node,
+		uint64_t media, css_pseudo_element pseudo_element,
+		css_select_handler *handler, void *pw,
+		css_computed_style **style)
+{
+	uint32_t i;
+	css_error error;
+	css_select_state state;
+	void *parent = NULL;
+	struct css_node_data *node_data = NULL;
+
+	if (ctx == NULL || node == NULL || style == NULL || handler == NULL ||
+	    handler->handler_version != CSS_SELECT_HANDLER_VERSION_1 ||
+	    pseudo_element <= CSS_PSEUDO_ELEMENT_NONE ||
+	    pseudo_element >= CSS_PSEUDO_ELEMENT_COUNT)
+		return CSS_BADPARM;
+
+	/* Hideous casting to avoid warnings on all platforms we build for. */
+	error = handler->get_libcss_node_data(pw, node,
+			(void **) (void *) &node_data);
+	if (error != CSS_OK)
+		return error;
+
+	/* Reuse the pseudo element's style if it has been selected */
+	if (node_data != NULL &&
+			(node_data->pseudo_elements & (1 << pseudo_element))) {
+		*style = css__computed_style_ref(
+				node_data->partial.styles[pseudo_element]);
+		return CSS_OK;
+	}
+
+	error = handler->parent_node(pw, node, &parent);
+	if (error != CSS_OK)
+		return error;
+
+	error = css_select__initialise_selection_state(&state, node, parent,
+			media, 1 << pseudo_element, handler, pw);
+	if (error != CSS_OK)
+		return error;
+
+	for (i = 0; i < ctx->n_sheets; i++) {
+		const css_select_sheet s = ctx->sheets[i];
+
+		if ((s.media & media) != 0 &&
+				s.sheet->disabled == false) {
+			error = select_from_sheet(ctx, s.sheet,
+					s.origin, &state);
+			if (error != CSS_OK)
+				goto cleanup;
+		}
+	}
+
+	/* Fix up any remaining unset properties */
+	if (state.results->styles[pseudo_element] != NULL) {
+		state.current_pseudo = pseudo_element;
+		state.computed = state.results->styles[pseudo_element];
+
+		error = css__initial_values_set(ctx->initial, &state,
+				pseudo_element, false);
+		if (error != CSS_OK)
+			goto cleanup;
+
+		error = css__arena_intern_style(
+				&state.results->styles[pseudo_element]);
+		if (error != CSS_OK)
+			goto cleanup;
+	}
+
+	/* Keep the style with the node's data.  Rules considered for the
+	 * pseudo element may prevent other nodes sharing the node's style. */
+	if (node_data != NULL) {
+		node_data->partial.styles[pseudo_element] =
+				css__computed_style_ref(
+				state.results->styles[pseudo_element]);
+		node_data->pseudo_elements |= (1 << pseudo_element);
+		node_data->flags |= state.node_data->flags &
+				(CSS_NODE_FLAGS_TAINT_PSEUDO_CLASS |
+				 CSS_NODE_FLAGS_TAINT_ATTRIBUTE |
+				 CSS_NODE_FLAGS_TAINT_SIBLING);
+	}
+
+	/* Steal the style from the selection state, so it doesn't get
+	 * freed when the selection state is finalised */
+	*style = state.results->styles[pseudo_element];
+	state.results->styles[pseudo_element] = NULL;
+
+	error = CSS_OK;
+
+cleanup:
+	/* The parent's bloom filter isn't ours to free */
+	state.node_data->bloom = NULL;
+	css_select__finalise_selection_state(&state);
+
+	return error;
+}
+
 /**
  * Destroy a selection result set
  *
@@ -1387,7 +1624,7 @@ css_error css_select_results_destroy(css_select_results *results)
 			css_computed_style_destroy(results->styles[i]);
 	}
 
-	free(results);
+	css__free(results);
 
 	return CSS_OK;
 }
@@ -1442,16 +1679,16 @@ css_error css_select_font_faces(css_select_ctx *ctx,
 		 * the font faces in priority order. */
 		css_select_font_faces_results *results;
 		
-		results = malloc(sizeof(css_select_font_faces_results));
+		results = css__malloc(sizeof(css_select_font_faces_results));
 		if (results == NULL) {
 			error = CSS_NOMEM;
 			goto cleanup;
 		}
 		
-		results->font_faces = malloc(
+		results->font_faces = css__malloc(
 				n_font_faces * sizeof(css_font_face *));
 		if (results->font_faces == NULL) {
-			free(results);
+			css__free(results);
 			error = CSS_NOMEM;
 			goto cleanup;
 		}
@@ -1490,13 +1727,13 @@ css_error css_select_font_faces(css_select_ctx *ctx,
 	
 cleanup:
 	if (state.ua_font_faces.count != 0) 
-		free(state.ua_font_faces.font_faces);
+		css__free(state.ua_font_faces.font_faces);
 
 	if (state.user_font_faces.count != 0) 
-		free(state.user_font_faces.font_faces);
+		css__free(state.user_font_faces.font_faces);
 	
 	if (state.author_font_faces.count != 0) 
-		free(state.author_font_faces.font_faces);
+		css__free(state.author_font_faces.font_faces);
 	
 	return error;
 }
@@ -1516,10 +1753,10 @@ css_error css_select_font_faces_results_destroy(
 	if (results->font_faces != NULL) {
 		/* Don't destroy the individual css_font_faces, they're owned
 		   by their respective sheets */
-		free(results->font_faces);
+		css__free(results->font_faces);
 	}
 	
-	free(results);
+	css__free(results);
 	
 	return CSS_OK;
 }
@@ -1768,6 +2005,8 @@ css_error set_hint(css_select_state *state, css_hint *hint)
 		return error;
 
 	/* Keep selection state in sync with reality */
+	set_decided(state, prop, CSS_PSEUDO_ELEMENT_NONE, existing,
+			CSS_ORIGIN_AUTHOR, false);
 	existing->set = 1;
 	existing->specificity = 0;
 	existing->origin = CSS_ORIGIN_AUTHOR;
@@ -1777,58 +2016,6 @@ css_error set_hint(css_select_state *state, css_hint *hint)
 	return CSS_OK;
 }
 
-css_error set_initial(css_select_state *state, 
-		uint32_t prop, css_pseudo_element pseudo,
-		void *parent)
-{
-	css_error error;
-
-	/* Do nothing if this property is inherited (the default state 
-	 * of a clean computed style is for everything to be set to inherit)
-	 *
-	 * If the node is tree root and we're dealing with the base element, 
-	 * everything should be defaulted.
-	 */
-	if (prop_dispatch[prop].inherited == false || 
-			(pseudo == CSS_PSEUDO_ELEMENT_NONE && parent == NULL)) {
-		enum prop_group group = prop_dispatch[prop].group;
-
-		/* Remaining properties are neither inherited nor 
-		 * already set. Thus, we set them to their initial 
-		 * values here. Except, however, if the property in 
-		 * question resides in one of the extension blocks and 
-		 * the extension block has yet to be allocated. In that 
-		 * case, we do nothing and leave it to the property 
-		 * accessors to return the initial values for the 
-		 * property.
-		 */
-		switch (group) {
-		case GROUP_NORMAL:
-			break;
-		case GROUP_UNCOMMON:
-			if (state->computed->i.uncommon == NULL)
-				return CSS_OK;
-			break;
-		case GROUP_PAGE:
-			if (state->computed->page == NULL)
-				return CSS_OK;
-			break;
-		case GROUP_AURAL:
-			if (state->computed->i.aural == NULL)
-				return CSS_OK;
-		case GROUP_FLEXBOX:
-			if (state->computed->flexbox == NULL)
-				return CSS_OK;
-			break;
-		}
-		error = prop_dispatch[prop].initial(state);
-		if (error != CSS_OK)
-			return error;
-	}
-
-	return CSS_OK;
-}
-
 #define IMPORT_STACK_SIZE 256
 
 css_error select_from_sheet(css_select_ctx *ctx, const css_stylesheet *sheet, 
@@ -1946,7 +2133,7 @@ static css_error _select_font_face_from_rule(
 			index = faces->count++;			
 			new_size = faces->count * sizeof(css_font_face *);
 			
-			new_faces = realloc(faces->font_faces, new_size);
+			new_faces = css__realloc(faces->font_faces, new_size);
 			if (new_faces == NULL) {
 				faces->count = 0;
 				return CSS_NOMEM;
@@ -2029,7 +2216,8 @@ static css_error select_font_faces_from_sheet(
 
 static inline bool _selectors_pending(const css_selector **node,
 		const css_selector **id, const css_selector ***classes,
-		uint32_t n_classes, const css_selector **univ)
+		uint32_t n_classes, const css_selector **univ,
+		const css_selector ***keyed, uint32_t n_keyed)
 {
 	bool pending = false;
 	uint32_t i;
@@ -2043,6 +2231,9 @@ static inline bool _selectors_pending(const css_selector **node,
 			pending |= *(classes[i]) != NULL;
 	}
 
+	for (i = 0; i < n_keyed; i++)
+		pending |= *(keyed[i]) != NULL;
+
 	return pending;
 }
 
@@ -2076,9 +2267,11 @@ static inline bool _selector_less_specific(const css_selector *ref,
 static const css_selector *_selector_next(const css_selector **node,
 		const css_selector **id, const css_selector ***classes,
 		uint32_t n_classes, const css_selector **univ,
+		const css_selector ***keyed, uint32_t n_keyed,
 		css_select_rule_source *src)
 {
 	const css_selector *ret = NULL;
+	uint32_t i;
 
 	if (_selector_less_specific(ret, *node)) {
 		ret = *node;
@@ -2096,8 +2289,6 @@ static const css_selector *_selector_next(const css_selector **node,
 	}
 
 	if (classes != NULL && n_classes > 0) {
-		uint32_t i;
-
 		for (i = 0; i < n_classes; i++) {
 			if (_selector_less_specific(ret, *(classes[i]))) {
 				ret = *(classes[i]);
@@ -2107,15 +2298,35 @@ static const css_selector *_selector_next(const css_selector **node,
 		}
 	}
 
+	for (i = 0; i < n_keyed; i++) {
+		if (_selector_less_specific(ret, *(keyed[i]))) {
+			ret = *(keyed[i]);
+			src->source = CSS_SELECT_RULE_SRC_KEYED;
+			src->keyed = i;
+		}
+	}
+
 	return ret;
 }
 
+/** Number of keyed universal chains visited without allocating: all the
+ * pseudo class chains and up to 27 attribute chains */
+#define CSS_KEYED_CHAINS_LOCAL 32
+
 css_error match_selectors_in_sheet(css_select_ctx *ctx, 
 		const css_stylesheet *sheet, css_select_state *state)
 {
 	static const css_selector *empty_selector = NULL;
+	/* Indexed by css_selector_hash_pseudo_class */
+	static const css_node_flags pseudo_class_flags[] = {
+		CSS_NODE_FLAGS_PSEUDO_CLASS_LINK,
+		CSS_NODE_FLAGS_PSEUDO_CLASS_VISITED,
+		CSS_NODE_FLAGS_PSEUDO_CLASS_HOVER,
+		CSS_NODE_FLAGS_PSEUDO_CLASS_ACTIVE,
+		CSS_NODE_FLAGS_PSEUDO_CLASS_FOCUS
+	};
 	const uint32_t n_classes = state->n_classes;
-	uint32_t i = 0;
+	uint32_t i = 0, n_keyed = 0, n_attributes;
 	const css_selector **node_selectors = &empty_selector;
 	css_selector_hash_iterator node_iterator;
 	const css_selector **id_selectors = &empty_selector;
@@ -2124,14 +2335,16 @@ css_error match_selectors_in_sheet(css_select_ctx *ctx,
 	css_selector_hash_iterator class_iterator;
 	const css_selector **univ_selectors = &empty_selector;
 	css_selector_hash_iterator univ_iterator;
-	css_select_rule_source src = { CSS_SELECT_RULE_SRC_ELEMENT, 0 };
+	const css_selector **keyed_local[CSS_KEYED_CHAINS_LOCAL];
+	const css_selector ***keyed_selectors = keyed_local;
+	css_selector_hash_iterator keyed_iterator;
+	css_select_rule_source src = { CSS_SELECT_RULE_SRC_ELEMENT, 0, 0 };
 	struct css_hash_selection_requirments req;
 	css_error error;
 
 	/* Set up general selector chain requirments */
 	req.media = state->media;
 	req.node_bloom = state->node_data->bloom;
-	req.uni = ctx->universal;
 
 	/* Find hash chain that applies to current node */
 	req.qname = state->element;
@@ -2143,7 +2356,7 @@ css_error match_selectors_in_sheet(css_select_ctx *ctx,
 
 	if (state->classes != NULL && n_classes > 0) {
 		/* Find hash chains for node classes */
-		class_selectors = malloc(n_classes * sizeof(css_selector **));
+		class_selectors = css__malloc(n_classes * sizeof(css_selector **));
 		if (class_selectors == NULL) {
 			error = CSS_NOMEM;
 			goto cleanup;
@@ -2174,9 +2387,69 @@ css_error match_selectors_in_sheet(css_select_ctx *ctx,
 	if (error != CSS_OK)
 		goto cleanup;
 
+	/* Find hash chains for universal selectors keyed by a dynamic
+	 * pseudo class the node is in, or by an attribute it has.  Chains
+	 * for anything else can't match, so needn't be visited. */
+	error = css__selector_hash_attributes(sheet->selectors, &n_attributes);
+	if (error != CSS_OK)
+		goto cleanup;
+
+	if (N_ELEMENTS(pseudo_class_flags) + n_attributes >
+			CSS_KEYED_CHAINS_LOCAL) {
+		keyed_selectors = css__malloc((N_ELEMENTS(pseudo_class_flags) +
+				n_attributes) * sizeof(css_selector **));
+		if (keyed_selectors == NULL) {
+			error = CSS_NOMEM;
+			goto cleanup;
+		}
+	}
+
+	for (i = 0; i < N_ELEMENTS(pseudo_class_flags); i++) {
+		if ((state->node_data->flags & pseudo_class_flags[i]) == 0)
+			continue;
+
+		req.pseudo_class = i;
+		error = css__selector_hash_find_by_pseudo_class(
+				sheet->selectors, &req, &keyed_iterator,
+				&keyed_selectors[n_keyed]);
+		if (error != CSS_OK)
+			goto cleanup;
+
+		if (*keyed_selectors[n_keyed] != NULL)
+			n_keyed++;
+	}
+
+	for (i = 0; i < n_attributes; i++) {
+		css_qname attr = { NULL, NULL };
+		bool match = false;
+
+		req.attribute = i;
+		error = css__selector_hash_find_by_attribute(sheet->selectors,
+				&req, &attr.name, &keyed_iterator,
+				&keyed_selectors[n_keyed]);
+		if (error != CSS_OK)
+			goto cleanup;
+
+		if (*keyed_selectors[n_keyed] == NULL)
+			continue;
+
+		/* One query stands in for matching the chain's selectors
+		 * against a node lacking the attribute */
+		error = state->handler->node_has_attribute(state->pw,
+				state->node, &attr, &match);
+		if (error != CSS_OK)
+			goto cleanup;
+
+		state->node_data->flags |= CSS_NODE_FLAGS_TAINT_ATTRIBUTE;
+
+		if (match)
+			n_keyed++;
+	}
+
 	/* Process matching selectors, if any */
 	while (_selectors_pending(node_selectors, id_selectors, 
-			class_selectors, n_classes, univ_selectors)) {
+			class_selectors, n_classes, univ_selectors,
+			keyed_selectors, n_keyed)) {
 		const css_selector *selector;
 
 		/* Selectors must be matched in ascending order of specificity
@@ -2186,7 +2459,7 @@ css_error match_selectors_in_sheet(css_select_ctx *ctx,
 		 */
 		selector = _selector_next(node_selectors, id_selectors,
 				class_selectors, n_classes, univ_selectors,
-				&src);
+				keyed_selectors, n_keyed, &src);
 
 		/* We know there are selectors pending, so should have a
 		 * selector here */
@@ -2220,6 +2493,11 @@ css_error match_selectors_in_sheet(css_select_ctx *ctx,
 			error = class_iterator(&req, class_selectors[src.class],
 					&class_selectors[src.class]);
 			break;
+
+		case CSS_SELECT_RULE_SRC_KEYED:
+			error = keyed_iterator(&req, keyed_selectors[src.keyed],
+					&keyed_selectors[src.keyed]);
+			break;
 		}
 
 		if (error != CSS_OK)
@@ -2229,7 +2507,10 @@ css_error match_selectors_in_sheet(css_select_ctx *ctx,
 	error = CSS_OK;
 cleanup:
 	if (class_selectors != NULL)
-		free(class_selectors);
+		css__free(class_selectors);
+
+	if (keyed_selectors != keyed_local)
+		css__free(keyed_selectors);
 
 	return error;
 }
@@ -2257,6 +2538,66 @@ static void update_reject_cache(css_select_state *state,
 	state->next_reject--;
 }
 
+/**
+ * Find the pseudo element with the given name
+ *
+ * \param ctx     Selection context
+ * \param name    Interned name of pseudo element
+ * \param pseudo  Pointer to location to receive pseudo element
+ * \return true if \a name is a pseudo element, false otherwise
+ */
+static inline bool pseudo_element_for_name(const css_select_ctx *ctx,
+		lwc_string *name, css_pseudo_element *pseudo)
+{
+	if (name == ctx->first_line) {
+		*pseudo = CSS_PSEUDO_ELEMENT_FIRST_LINE;
+	} else if (name == ctx->first_letter) {
+		*pseudo = CSS_PSEUDO_ELEMENT_FIRST_LETTER;
+	} else if (name == ctx->before) {
+		*pseudo = CSS_PSEUDO_ELEMENT_BEFORE;
+	} else if (name == ctx->after) {
+		*pseudo = CSS_PSEUDO_ELEMENT_AFTER;
+	} else
+		return false;
+
+	return true;
+}
+
+/**
+ * Determine whether a selector chain is for the element or one of the
+ * pseudo elements being selected for
+ *
+ * \param ctx       Selection context
+ * \param selector  Selector chain to consider
+ * \param state     Selection state
+ * \return false if the chain can't apply to the selection, true otherwise
+ *
+ * Pseudo elements only appear in the details of the first selector in the
+ * chain, so no other selectors need to be considered.
+ */
+static inline bool selector_wanted(const css_select_ctx *ctx,
+		const css_selector *selector, const css_select_state *state)
+{
+	const css_selector_detail *detail = &selector->data;
+	css_pseudo_element pseudo = CSS_PSEUDO_ELEMENT_NONE;
+
+	if (state->pseudo_elements == (CSS_PSEUDO_ELEMENT_MASK_ALL |
+			(1 << CSS_PSEUDO_ELEMENT_NONE)))
+		return true;
+
+	while (detail->next) {
+		detail++;
+
+		/* Unknown pseudo elements never match */
+		if (detail->type == CSS_SELECTOR_PSEUDO_ELEMENT &&
+				pseudo_element_for_name(ctx,
+					detail->qname.name, &pseudo) == false)
+			return false;
+	}
+
+	return (state->pseudo_elements & (1 << pseudo)) != 0;
+}
+
 css_error match_selector_chain(css_select_ctx *ctx, 
 		const css_selector *selector, css_select_state *state)
 {
@@ -2265,7 +2606,7 @@ css_error match_selector_chain(css_select_ctx *ctx,
 	const css_selector_detail *detail = &s->data;
 	bool match = false, may_optimise = true;
 	bool rejected_by_cache;
-	css_pseudo_element pseudo;
+	css_pseudo_element pseudo = CSS_PSEUDO_ELEMENT_NONE;
 	css_error error;
 
 #ifdef DEBUG_CHAIN_MATCHING
@@ -2274,6 +2615,10 @@ css_error match_selector_chain(css_select_ctx *ctx,
 	fprintf(stderr, "\n");
 #endif
 
+	/* Skip chains for pseudo elements we're not selecting for */
+	if (selector_wanted(ctx, selector, state) == false)
+		return CSS_OK;
+
 	/* Match the details of the first selector in the chain. 
 	 *
 	 * Note that pseudo elements will only appear as details of
@@ -2362,7 +2707,6 @@ css_error match_named_combinator(css_select_ctx *ctx, css_combinator type,
 		const css_selector *selector, css_select_state *state, 
 		void *node, void **next_node)
 {
-	const css_selector_detail *detail = &selector->data;
 	void *n = node;
 	css_error error;
 
@@ -2409,8 +2753,8 @@ css_error match_named_combinator(css_select_ctx *ctx, css_combinator type,
 
 		if (n != NULL) {
 			/* Match its details */
-			error = match_details(ctx, n, detail, state, 
-					&match, NULL);
+			error = match_ancestor_details(ctx, n, selector,
+					state, &match);
 			if (error != CSS_OK)
 				return error;
 
@@ -2512,8 +2856,8 @@ css_error match_universal_combinator(css_select_ctx *ctx, css_combinator type,
 
 		if (n != NULL) {
 			/* Match its details */
-			error = match_details(ctx, n, detail, state, 
-					&match, NULL);
+			error = match_ancestor_details(ctx, n, selector,
+					state, &match);
 			if (error != CSS_OK)
 				return error;
 
@@ -2535,30 +2879,168 @@ css_error match_universal_combinator(css_select_ctx *ctx, css_combinator type,
 	return CSS_OK;
 }
 
-css_error match_details(css_select_ctx *ctx, void *node, 
-		const css_selector_detail *detail, css_select_state *state, 
-		bool *match, css_pseudo_element *pseudo_element)
+/**
+ * Retrieve a node's ancestor memo, creating it if needed
+ *
+ * \param ctx    Selection context
+ * \param node   Node to retrieve memo for
+ * \param state  Selection state
+ * \param memo   Pointer to location to receive memo, or NULL if none
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * Nodes which haven't been selected for have no data to hold a memo.  The
+ * memos found are remembered for the rest of the selection.
+ */
+static css_error css__ancestor_memo(css_select_ctx *ctx, void *node,
+		css_select_state *state, css_ancestor_memo **memo)
 {
+	uint32_t slot = ((uintptr_t) node >> 4) % CSS_ANCESTOR_MEMO_CACHE_SIZE;
+	struct css_node_data *node_data = NULL;
 	css_error error;
-	css_pseudo_element pseudo = CSS_PSEUDO_ELEMENT_NONE;
 
-	/* Skip the element selector detail, which is always first.
-	 * (Named elements are handled by match_named_combinator, so the
-	 * element selector detail always matches here.) */
-	if (detail->next)
-		detail++;
-	else
-		detail = NULL;
+	/* A node's data doesn't change while another node is selected for */
+	if (state->memo_cache[slot].node == node) {
+		*memo = state->memo_cache[slot].memo;
+		return CSS_OK;
+	}
 
-	/* We match by default (if there are no details other than the element
-	 * selector, then we must match) */
-	*match = true;
+	*memo = NULL;
 
-	/** \todo Some details are easier to test than others (e.g. dashmatch 
-	 * actually requires looking at data rather than simply comparing 
-	 * pointers). Should we consider sorting the detail list such that the 
-	 * simpler details come first (and thus the expensive match routines 
-	 * can be avoided unless absolutely necessary)? */
+	error = state->handler->get_libcss_node_data(state->pw, node,
+			(void **) (void *) &node_data);
+	if (error != CSS_OK)
+		return error;
+
+	if (node_data == NULL)
+		goto done;
+
+	if (node_data->memo == NULL) {
+		/* Memoisation is only an optimisation, so may fail */
+		node_data->memo = css__calloc(1, sizeof(css_ancestor_memo));
+		if (node_data->memo == NULL)
+			goto done;
+
+		node_data->memo->generation = ctx->generation;
+	} else if (node_data->memo->generation != ctx->generation) {
+		memset(node_data->memo->entries, 0,
+				sizeof(node_data->memo->entries));
+		node_data->memo->generation = ctx->generation;
+	}
+
+	*memo = node_data->memo;
+
+done:
+	state->memo_cache[slot].node = node;
+	state->memo_cache[slot].memo = *memo;
+
+	return CSS_OK;
+}
+
+/**
+ * Match the details of a compound selector against a node other than the
+ * one being selected for, using the node's memo for classes and IDs
+ *
+ * \param ctx       Selection context
+ * \param node      Node to match against
+ * \param selector  Compound selector to match
+ * \param state     Selection state
+ * \param match     Pointer to location to receive result
+ * \return CSS_OK on success, appropriate error otherwise
+ */
+css_error match_ancestor_details(css_select_ctx *ctx, void *node,
+		const css_selector *selector, css_select_state *state,
+		bool *match)
+{
+	const css_selector_detail *detail = &selector->data;
+	css_pseudo_element pseudo = CSS_PSEUDO_ELEMENT_NONE;
+	css_ancestor_memo *memo = NULL;
+	bool have_memo = false;
+	css_error error;
+
+	/* Match by default.  The element selector detail, which is always
+	 * first, has been handled by the combinator. */
+	*match = true;
+
+	while (detail->next) {
+		uint32_t slot;
+
+		detail++;
+
+		if (detail->type != CSS_SELECTOR_CLASS &&
+				detail->type != CSS_SELECTOR_ID) {
+			error = match_detail(ctx, node, detail, state,
+					match, &pseudo);
+			if (error != CSS_OK)
+				return error;
+		} else {
+			if (have_memo == false) {
+				error = css__ancestor_memo(ctx, node, state,
+						&memo);
+				if (error != CSS_OK)
+					return error;
+
+				have_memo = true;
+			}
+
+			slot = (((uintptr_t) detail->qname.name >> 4) +
+					detail->type) % CSS_ANCESTOR_MEMO_SIZE;
+
+			if (memo != NULL &&
+					memo->entries[slot].name ==
+						detail->qname.name &&
+					memo->entries[slot].type ==
+						detail->type) {
+				/* Entries hold the un-negated result */
+				*match = memo->entries[slot].match ^
+						(detail->negate != 0);
+			} else {
+				error = match_detail(ctx, node, detail, state,
+						match, &pseudo);
+				if (error != CSS_OK)
+					return error;
+
+				if (memo != NULL) {
+					memo->entries[slot].name =
+							detail->qname.name;
+					memo->entries[slot].type = detail->type;
+					memo->entries[slot].match = *match ^
+							(detail->negate != 0);
+				}
+			}
+		}
+
+		/* Detail doesn't match, so reject selector chain */
+		if (*match == false)
+			return CSS_OK;
+	}
+
+	return CSS_OK;
+}
+
+css_error match_details(css_select_ctx *ctx, void *node, 
+		const css_selector_detail *detail, css_select_state *state, 
+		bool *match, css_pseudo_element *pseudo_element)
+{
+	css_error error;
+	css_pseudo_element pseudo = CSS_PSEUDO_ELEMENT_NONE;
+
+	/* Skip the element selector detail, which is always first.
+	 * (Named elements are handled by match_named_combinator, so the
+	 * element selector detail always matches here.) */
+	if (detail->next)
+		detail++;
+	else
+		detail = NULL;
+
+	/* We match by default (if there are no details other than the element
+	 * selector, then we must match) */
+	*match = true;
+
+	/** \todo Some details are easier to test than others (e.g. dashmatch 
+	 * actually requires looking at data rather than simply comparing 
+	 * pointers). Should we consider sorting the detail list such that the 
+	 * simpler details come first (and thus the expensive match routines 
+	 * can be avoided unless absolutely necessary)? */
 
 	while (detail != NULL) {
 		error = match_detail(ctx, node, detail, state, match, &pseudo);
@@ -2784,18 +3266,8 @@ css_error match_detail(css_select_ctx *ctx, void *node,
 		add_node_flags(node, state, flags);
 		break;
 	case CSS_SELECTOR_PSEUDO_ELEMENT:
-		*match = true;
-
-		if (detail->qname.name == ctx->first_line) {
-			*pseudo_element = CSS_PSEUDO_ELEMENT_FIRST_LINE;
-		} else if (detail->qname.name == ctx->first_letter) {
-			*pseudo_element = CSS_PSEUDO_ELEMENT_FIRST_LETTER;
-		} else if (detail->qname.name == ctx->before) {
-			*pseudo_element = CSS_PSEUDO_ELEMENT_BEFORE;
-		} else if (detail->qname.name == ctx->after) {
-			*pseudo_element = CSS_PSEUDO_ELEMENT_AFTER;
-		} else
-			*match = false;
+		*match = pseudo_element_for_name(ctx, detail->qname.name,
+				pseudo_element);
 		break;
 	case CSS_SELECTOR_ATTRIBUTE:
 		error = state->handler->node_has_attribute(state->pw, node,
@@ -2847,127 +3319,592 @@ css_error match_detail(css_select_ctx *ctx, void *node,
 	return error;
 }
 
-css_error cascade_style(const css_style *style, css_select_state *state)
+/**
+ * Determine whether none of a style's declarations could be applied
+ *
+ * \param style  Style to consider
+ * \param state  Selection state
+ * \return true if every property set by \a style is already set by a
+ *         declaration which its declarations cannot outrank, whatever
+ *         their specificity.
+ *
+ * This depends on origin and importance alone; see the table in
+ * css__outranks_existing().
+ */
+static bool style_is_decided(const css_style *style,
+		const css_select_state *state)
+{
+	const uint32_t (*decided)[CSS_PROP_BITMAP_WORDS] =
+			(const uint32_t (*)[CSS_PROP_BITMAP_WORDS])
+			state->decided[state->current_pseudo];
+	uint32_t i;
+
+	for (i = 0; i < CSS_PROP_BITMAP_WORDS; i++) {
+		uint32_t user = decided[
+				decided_class(CSS_ORIGIN_USER, false)][i];
+		uint32_t user_i = decided[
+				decided_class(CSS_ORIGIN_USER, true)][i];
+		uint32_t author = decided[
+				decided_class(CSS_ORIGIN_AUTHOR, false)][i];
+		uint32_t author_i = decided[
+				decided_class(CSS_ORIGIN_AUTHOR, true)][i];
+		uint32_t normal, important;
+
+		switch (state->current_origin) {
+		case CSS_ORIGIN_UA:
+			normal = important = user | user_i | author | author_i;
+			break;
+		case CSS_ORIGIN_USER:
+			normal = user_i | author | author_i;
+			important = 0;
+			break;
+		case CSS_ORIGIN_AUTHOR:
+		default:
+			normal = user_i | author_i;
+			important = user_i;
+			break;
+		}
+
+		if ((style->props[i] & ~normal) != 0 ||
+				(style->important[i] & ~important) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Cascade a single declaration
+ *
+ * \param opv    Declaration's opcode and flags
+ * \param s      Style, positioned after \a opv
+ * \param state  Selection state
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The properties in CSS_INLINE_PROPERTIES are cascaded inline, by the
+ * same helpers as their handlers use.  Everything else goes through the
+ * dispatch table.
+ */
+static inline css_error cascade_declaration(css_code_t opv, css_style *s,
+		css_select_state *state)
+{
+#define CSS_INLINE_CASE(pname, PNAME, helper)				\
+	case CSS_PROP_##PNAME:						\
+		return css__cascade_##helper(opv, s, state, set_##pname);
+
+	switch (getOpcode(opv)) {
+	CSS_INLINE_PROPERTIES(CSS_INLINE_CASE)
+	default:
+		break;
+	}
+
+#undef CSS_INLINE_CASE
+
+	return prop_dispatch[getOpcode(opv)].cascade(opv, s, state);
+}
+
+/** Number of times a style is cascaded before it is pre-decoded */
+#define CSS_DECODE_AFTER 2
+
+/**
+ * Cascade the pre-decoded form of a style
+ *
+ * \param style  Style to cascade, with pre-decoded form
+ * \param state  Selection state
+ * \return CSS_OK on success, appropriate error otherwise
+ */
+static css_error cascade_decoded(const css_style *style,
+		css_select_state *state)
+{
+	const css_decoded_style *decoded = style->decoded;
+	const css_decoded_decl *decl = decoded->decls;
+	const css_decoded_decl *end = decl + decoded->n_decls;
+
+	for (; decl < end; decl++) {
+		const css_decoded_span *span;
+		uint8_t *block;
+		uint8_t n;
+
+		if (decl->flags & CSS_DECODED_BYTECODE) {
+			css_style s = *style;
+			css_code_t opv;
+			css_error error;
+
+			advance_bytecode(&s, decl->index * sizeof(css_code_t));
+			opv = *s.bytecode;
+			advance_bytecode(&s, sizeof(opv));
+
+			error = cascade_declaration(opv, &s, state);
+			if (error != CSS_OK)
+				return error;
+
+			continue;
+		}
+
+		if (css__outranks_existing(decl->prop,
+				(decl->flags & CSS_DECODED_IMPORTANT) != 0,
+				state,
+				(decl->flags & CSS_DECODED_INHERIT) != 0) == false)
+			continue;
+
+		block = (uint8_t *) &state->computed->i;
+		span = decoded->spans + decl->index;
+		for (n = decl->n_spans; n > 0; n--, span++) {
+			uint32_t word;
+
+			memcpy(&word, block + span->offset, sizeof(word));
+			word = (word & ~span->mask) | span->value;
+			memcpy(block + span->offset, &word, sizeof(word));
+		}
+	}
+
+	return CSS_OK;
+}
+
+css_error cascade_style(css_style *style, css_select_state *state)
+{
+	css_style s;
+
+	/* Skip the whole block if it can't change the result */
+	if (style_is_decided(style, state))
+		return CSS_OK;
+
+	/* Decode styles which are cascaded repeatedly */
+	if (style->decoded == NULL && style->cascades < CSS_DECODE_AFTER &&
+			++style->cascades == CSS_DECODE_AFTER)
+		decode_style(style);
+
+	if (style->decoded != NULL)
+		return cascade_decoded(style, state);
+
+	s = *style;
+
+	while (s.used > 0) {
+		css_error error;
+		css_code_t opv = *s.bytecode;
+
+		advance_bytecode(&s, sizeof(opv));
+
+		error = cascade_declaration(opv, &s, state);
+		if (error != CSS_OK)
+			return error;
+	}
+
+	return CSS_OK;
+}
+
+/**
+ * Build the property bitmaps of a style
+ *
+ * \param style  Style to process
+ * \param state  Selection state to use for decoding
+ */
+static void build_style_bitmaps(css_style *style, css_select_state *state)
 {
 	css_style s = *style;
 
+	memset(style->props, 0, sizeof(style->props));
+	memset(style->important, 0, sizeof(style->important));
+
+	/* Decode the style with the cascade handlers, which report each
+	 * property to css__outranks_existing() */
+	state->collect = style;
+
 	while (s.used > 0) {
 		opcode_t op;
-		css_error error;
 		css_code_t opv = *s.bytecode;
 
 		advance_bytecode(&s, sizeof(opv));
 
 		op = getOpcode(opv);
 
-		error = prop_dispatch[op].cascade(opv, &s, state);
+		if (op >= CSS_N_PROPERTIES ||
+				prop_dispatch[op].cascade(opv, &s, state) !=
+					CSS_OK) {
+			/* Assume the style could set anything */
+			memset(style->props, 0xff, sizeof(style->props));
+			memset(style->important, 0xff,
+					sizeof(style->important));
+			break;
+		}
+	}
+
+	state->collect = NULL;
+}
+
+/**
+ * UA default callback for decoding styles outside selection
+ *
+ * Some cascade handlers consult the client for defaults while decoding;
+ * there is no client when styles are prepared, and the result is unused.
+ */
+static css_error prepare_ua_default(void *pw, uint32_t property,
+		css_hint *hint)
+{
+	UNUSED(pw);
+	UNUSED(property);
+	UNUSED(hint);
+
+	return CSS_INVALID;
+}
+
+/**
+ * Determine whether declarations of a property may be pre-decoded
+ *
+ * \param op  Property
+ * \return true if its declarations may be pre-decoded, false otherwise
+ *
+ * Only properties in the normal block of a computed style are decoded.
+ * Those which hold references to images or URIs, or allocated string
+ * lists, are left as bytecode.
+ */
+static inline bool decodable_property(opcode_t op)
+{
+	if (prop_dispatch[op].group != GROUP_NORMAL)
+		return false;
+
+	switch (op) {
+	case CSS_PROP_BACKGROUND_IMAGE:
+	case CSS_PROP_LIST_STYLE_IMAGE:
+	case CSS_PROP_FONT_FAMILY:
+	case CSS_PROP_QUOTES:
+		return false;
+	default:
+		return true;
+	}
+}
+
+/**
+ * Pre-decode a declaration
+ *
+ * \param opv      The declaration's OPV
+ * \param s        Style, positioned after \a opv, updated to follow the
+ *                 declaration
+ * \param state    Selection state to use for decoding
+ * \param spans    Array to receive spans, one per word of the normal block
+ * \param n_spans  Pointer to location to receive number of spans, or 0 if
+ *                 the declaration must be left as bytecode
+ * \param flags    Pointer to location to receive CSS_DECODED_* flags
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The declaration is cascaded into one scratch normal block with every
+ * bit clear, and another with every bit set (other than pointers).  The
+ * bits it stores are those it changes in either block.  Its importance,
+ * and whether it inherits, are as its handler gave them to
+ * css__outranks_existing(), which may differ from the OPV's flags.
+ */
+static css_error decode_declaration(css_code_t opv, css_style *s,
+		css_select_state *state, css_decoded_span *spans,
+		uint32_t *n_spans, uint8_t *flags)
+{
+	const prop_state *applied;
+	opcode_t op = getOpcode(opv);
+	css_computed_style orig[2], computed[2];
+	css_style after;
+	css_error error;
+	size_t b;
+	int k;
+
+	*n_spans = 0;
+
+	if (op >= CSS_N_PROPERTIES)
+		return CSS_INVALID;
+
+	if (decodable_property(op) == false) {
+		css_style collect;
+
+		/* Just step over the declaration */
+		memset(&collect, 0, sizeof(collect));
+		state->collect = &collect;
+		error = prop_dispatch[op].cascade(opv, s, state);
+		state->collect = NULL;
+
+		return error;
+	}
+
+	memset(orig, 0, sizeof(orig));
+	memset(&orig[1].i, 0xff, sizeof(orig[1].i));
+	orig[1].i.list_style_image = NULL;
+	orig[1].i.uncommon = NULL;
+	orig[1].i.aural = NULL;
+
+	for (k = 0; k < 2; k++) {
+		after = *s;
+		computed[k] = orig[k];
+		state->computed = &computed[k];
+
+		/* Ensure the declaration is applied */
+		memset(state->props[op], 0, sizeof(state->props[op]));
+
+		error = prop_dispatch[op].cascade(opv, &after, state);
 		if (error != CSS_OK)
 			return error;
 	}
 
+	*s = after;
+
+	applied = &state->props[op][CSS_PSEUDO_ELEMENT_NONE];
+	if (applied->set == 0)
+		return CSS_OK;
+
+	*flags = (applied->important ? CSS_DECODED_IMPORTANT : 0) |
+			(applied->inherit ? CSS_DECODED_INHERIT : 0);
+
+	for (k = 0; k < 2; k++) {
+		/* Anything outside the normal block must be left alone */
+		if (computed[k].i.list_style_image != NULL ||
+				computed[k].i.uncommon != NULL ||
+				computed[k].i.aural != NULL ||
+				memcmp((uint8_t *) &computed[k] +
+						sizeof(computed[k].i),
+					(uint8_t *) &orig[k] + sizeof(orig[k].i),
+					sizeof(orig[k]) - sizeof(orig[k].i)) != 0)
+			return CSS_OK;
+	}
+
+	for (b = 0; b < sizeof(struct css_computed_style_i);
+			b += sizeof(uint32_t)) {
+		uint32_t o0, o1, c0, c1, mask;
+
+		memcpy(&o0, (uint8_t *) &orig[0].i + b, sizeof(o0));
+		memcpy(&o1, (uint8_t *) &orig[1].i + b, sizeof(o1));
+		memcpy(&c0, (uint8_t *) &computed[0].i + b, sizeof(c0));
+		memcpy(&c1, (uint8_t *) &computed[1].i + b, sizeof(c1));
+
+		mask = (c0 ^ o0) | (c1 ^ o1);
+		if (mask == 0)
+			continue;
+
+		/* The value stored mustn't depend on what was there */
+		if (((c0 ^ c1) & mask) != 0) {
+			*n_spans = 0;
+			return CSS_OK;
+		}
+
+		spans[*n_spans].offset = b;
+		spans[*n_spans].mask = mask;
+		spans[*n_spans].value = c0 & mask;
+		(*n_spans)++;
+	}
+
+	if (*n_spans > UINT8_MAX)
+		*n_spans = 0;
+
 	return CSS_OK;
 }
 
-bool css__outranks_existing(uint16_t op, bool important, css_select_state *state,
-		bool inherit)
+/**
+ * Build the pre-decoded form of a style
+ *
+ * \param style  Style to process
+ *
+ * Styles with no declarations which can be decoded, and those which fail
+ * to decode, are left without a pre-decoded form.
+ */
+static void decode_style(css_style *style)
 {
-	prop_state *existing = &state->props[op][state->current_pseudo];
-	bool outranks = false;
-
-	/* Sorting on origin & importance gives the following:
-	 * 
-	 *           | UA, - | UA, i | USER, - | USER, i | AUTHOR, - | AUTHOR, i
-	 *           |----------------------------------------------------------
-	 * UA    , - |   S       S       Y          Y         Y           Y
-	 * UA    , i |   S       S       Y          Y         Y           Y
-	 * USER  , - |   -       -       S          Y         Y           Y
-	 * USER  , i |   -       -       -          S         -           -
-	 * AUTHOR, - |   -       -       -          Y         S           Y
-	 * AUTHOR, i |   -       -       -          Y         -           S
-	 *
-	 * Where the columns represent the origin/importance of the property 
-	 * being considered and the rows represent the origin/importance of 
-	 * the existing property.
-	 *
-	 * - means that the existing property must be preserved
-	 * Y means that the new property must be applied
-	 * S means that the specificities of the rules must be considered.
-	 *
-	 * If specificities are considered, the highest specificity wins.
-	 * If specificities are equal, then the rule defined last wins.
-	 *
-	 * We have no need to explicitly consider the ordering of rules if
-	 * the specificities are the same because:
-	 *
-	 * a) We process stylesheets in order
-	 * b) The selector hash chains within a sheet are ordered such that 
-	 *    more specific rules come after less specific ones and, when
-	 *    specificities are identical, rules defined later occur after
-	 *    those defined earlier.
-	 *
-	 * Therefore, where we consider specificity, below, the property 
-	 * currently being considered will always be applied if its specificity
-	 * is greater than or equal to that of the existing property.
-	 */
+	static css_select_handler handler;
+	css_select_state *state;
+	css_decoded_span tmp[sizeof(struct css_computed_style_i) /
+			sizeof(uint32_t)];
+	css_decoded_decl *decls = NULL;
+	css_decoded_span *spans = NULL;
+	uint32_t n_decls = 0, n_spans = 0, n_decoded = 0;
+	uint32_t decls_alloc = 0, spans_alloc = 0;
+	css_decoded_style *decoded;
+	css_style s = *style;
+	size_t size;
 
-	if (existing->set == 0) {
-		/* Property hasn't been set before, new one wins */
-		outranks = true;
-	} else {
-		assert(CSS_ORIGIN_UA < CSS_ORIGIN_USER);
-		assert(CSS_ORIGIN_USER < CSS_ORIGIN_AUTHOR);
-
-		if (existing->origin < state->current_origin) {
-			/* New origin has more weight than existing one.
-			 * Thus, new property wins, except when the existing 
-			 * one is USER, i. */
-			if (existing->important == 0 ||
-					existing->origin != CSS_ORIGIN_USER) {
-				outranks = true;
-			}
-		} else if (existing->origin == state->current_origin) {
-			/* Origins are identical, consider importance, except 
-			 * for UA stylesheets, when specificity is always 
-			 * considered (as importance is meaningless) */
-			if (existing->origin == CSS_ORIGIN_UA) {
-				if (state->current_specificity >=
-						existing->specificity) {
-					outranks = true;
-				}
-			} else if (existing->important == 0 && important) {
-				/* New is more important than old. */
-				outranks = true;
-			} else if (existing->important && important == false) {
-				/* Old is more important than new */
-			} else {
-				/* Same importance, consider specificity */
-				if (state->current_specificity >=
-						existing->specificity) {
-					outranks = true;
-				}
-			}
+	state = css__calloc(1, sizeof(*state));
+	if (state == NULL)
+		return;
+
+	handler.ua_default_for_property = prepare_ua_default;
+	state->handler = &handler;
+
+	while (s.used > 0) {
+		css_code_t opv = *s.bytecode;
+		uint32_t index = style->used - s.used;
+		css_decoded_decl *decl;
+		uint8_t flags;
+		uint32_t n;
+
+		advance_bytecode(&s, sizeof(opv));
+
+		if (decode_declaration(opv, &s, state, tmp, &n,
+				&flags) != CSS_OK)
+			goto cleanup;
+
+		if (n_decls == decls_alloc) {
+			uint32_t len = decls_alloc == 0 ? 8 : decls_alloc * 2;
+			css_decoded_decl *temp;
+
+			temp = css__realloc(decls, len * sizeof(*decls));
+			if (temp == NULL)
+				goto cleanup;
+
+			decls = temp;
+			decls_alloc = len;
+		}
+
+		if (n_spans + n > spans_alloc) {
+			uint32_t len = (n_spans + n) * 2;
+			css_decoded_span *temp;
+
+			temp = css__realloc(spans, len * sizeof(*spans));
+			if (temp == NULL)
+				goto cleanup;
+
+			spans = temp;
+			spans_alloc = len;
+		}
+
+		decl = &decls[n_decls++];
+		decl->prop = getOpcode(opv);
+
+		if (n == 0) {
+			decl->flags = CSS_DECODED_BYTECODE;
+			decl->n_spans = 0;
+			decl->index = index;
 		} else {
-			/* Existing origin has more weight than new one.
-			 * Thus, existing property wins, except when the new
-			 * one is USER, i. */
-			if (state->current_origin == CSS_ORIGIN_USER &&
-					important) {
-				outranks = true;
-			}
+			decl->flags = flags;
+			decl->n_spans = n;
+			decl->index = n_spans;
+			memcpy(spans + n_spans, tmp, n * sizeof(*spans));
+			n_spans += n;
+			n_decoded++;
 		}
 	}
 
-	if (outranks) {
-		/* The new property is about to replace the old one.
-		 * Update our state to reflect this. */
-		existing->set = 1;
-		existing->specificity = state->current_specificity;
-		existing->origin = state->current_origin;
-		existing->important = important;
-		existing->inherit = inherit;
+	if (n_decoded == 0)
+		goto cleanup;
+
+	size = sizeof(*decoded) + n_decls * sizeof(*decls) +
+			n_spans * sizeof(*spans);
+
+	decoded = css__malloc(size);
+	if (decoded == NULL)
+		goto cleanup;
+
+	decoded->n_decls = n_decls;
+	decoded->decls = (css_decoded_decl *) (decoded + 1);
+	decoded->spans = (css_decoded_span *) (decoded->decls + n_decls);
+	memcpy((css_decoded_decl *) decoded->decls, decls,
+			n_decls * sizeof(*decls));
+	if (n_spans > 0) {
+		memcpy((css_decoded_span *) decoded->spans, spans,
+				n_spans * sizeof(*spans));
 	}
 
-	return outranks;
+	style->decoded = decoded;
+
+cleanup:
+	if (decls != NULL)
+		css__free(decls);
+	if (spans != NULL)
+		css__free(spans);
+	css__free(state);
+}
+
+/**
+ * Find the declarations of a style
+ *
+ * \param style  Style to examine
+ * \param decls  Array of at least style->used entries, to receive the
+ *               style's declarations, in order
+ * \param count  Pointer to location to receive number of declarations
+ * \return CSS_OK on success,
+ *         CSS_NOMEM on memory exhaustion,
+ *         CSS_INVALID if the bytecode could not be decoded.
+ *
+ * The property and importance of each declaration are those it reports
+ * to the cascade.  A declaration which reports nothing never affects the
+ * result of the cascade.
+ */
+css_error css__select_style_declarations(const css_style *style,
+		css_select_declaration *decls, uint32_t *count)
+{
+	static css_select_handler handler;
+	css_select_state *state;
+	css_style collect;
+	css_style s = *style;
+	css_error error = CSS_OK;
+	uint32_t n = 0;
+
+	state = css__calloc(1, sizeof(*state));
+	if (state == NULL)
+		return CSS_NOMEM;
+
+	memset(&collect, 0, sizeof(collect));
+
+	handler.ua_default_for_property = prepare_ua_default;
+	state->handler = &handler;
+	state->collect = &collect;
+
+	while (s.used > 0) {
+		css_code_t opv = *s.bytecode;
+		opcode_t op = getOpcode(opv);
+		uint32_t bit = 1u << (op % 32);
+
+		memset(collect.props, 0, sizeof(collect.props));
+		memset(collect.important, 0, sizeof(collect.important));
+
+		decls[n].offset = style->used - s.used;
+		decls[n].prop = op;
+
+		advance_bytecode(&s, sizeof(opv));
+
+		if (op >= CSS_N_PROPERTIES ||
+				prop_dispatch[op].cascade(opv, &s, state) !=
+					CSS_OK) {
+			error = CSS_INVALID;
+			break;
+		}
+
+		decls[n].important = (collect.important[op / 32] & bit) != 0;
+		decls[n].reported = decls[n].important ||
+				(collect.props[op / 32] & bit) != 0;
+		n++;
+	}
+
+	css__free(state);
+
+	*count = n;
+
+	return error;
+}
+
+/**
+ * Prepare every style in a sheet for the cascade
+ *
+ * \param sheet  Sheet to process, which has finished parsing
+ *
+ * This builds the property bitmaps of each style.  Styles keep bitmaps
+ * with every bit set until this is called, and if it fails, so the
+ * bitmaps never claim that a style sets less than it does.
+ */
+void css__select_prepare_styles(css_stylesheet *sheet)
+{
+	static css_select_handler handler;
+	css_select_state *state;
+	css_rule *rule;
+
+	state = css__calloc(1, sizeof(*state));
+	if (state == NULL)
+		return;
+
+	handler.ua_default_for_property = prepare_ua_default;
+	state->handler = &handler;
+
+	for (rule = sheet->rule_list; rule != NULL;
+			rule = css__rule_next(rule)) {
+		css_style *style = css__rule_style(rule);
+
+		if (style != NULL)
+			build_style_bitmaps(style, state);
+	}
+
+	css__free(state);
 }
 
 /******************************************************************************
@@ -3078,4 +4015,3 @@ void dump_chain(const css_selector *selector)
 	} while (detail);
 }
 #endif
-
@@ -8,6 +8,7 @@
 #ifndef css_select_select_h_
 #define css_select_select_h_
 
+#include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -52,10 +53,37 @@ typedef enum css_node_flags {
 			 CSS_NODE_FLAGS_PSEUDO_CLASS_VISITED),
 } css_node_flags;
 
+/** Number of entries in an ancestor memo */
+#define CSS_ANCESTOR_MEMO_SIZE 16
+
+/**
+ * Results of matching class and ID selectors against a node, on behalf of
+ * the selector chains of the nodes after and below it
+ *
+ * Clients must already report changes to a node's classes and ID through
+ * css_libcss_node_data_handler, which discards the memo with the rest of
+ * the node's data.  Entries are only valid for the selection context
+ * generation they were made in, as the names belong to its sheets.
+ */
+typedef struct css_ancestor_memo {
+	uint32_t generation;		/* Generation of entries */
+	struct {
+		lwc_string *name;	/* Class or ID name, or NULL */
+		uint8_t type;		/* css_selector_type of name */
+		bool match;		/* Whether node has it */
+	} entries[CSS_ANCESTOR_MEMO_SIZE];
+} css_ancestor_memo;
+
+/** Number of ancestor memos a selection remembers finding */
+#define CSS_ANCESTOR_MEMO_CACHE_SIZE 8
+
 struct css_node_data {
 	css_select_results partial;
 	css_bloom *bloom;
 	css_node_flags flags;
+	uint64_t inline_style;	/* Shared id of inline style, or 0 */
+	css_ancestor_memo *memo;	/* Memo of compound matches, or NULL */
+	uint32_t pseudo_elements;	/* Mask of pseudo elements selected */
 };
 
 /**
@@ -68,6 +96,8 @@ typedef struct css_select_state {
 
 	css_pseudo_element current_pseudo;	/* Current pseudo element */
 	css_computed_style *computed;	/* Computed style to populate */
+	uint32_t pseudo_elements;	/* Mask of pseudo elements wanted,
+					 * including the element itself */
 
 	css_select_handler *handler;	/* Handler functions */
 	void *pw;			/* Client data for handlers */
@@ -87,17 +117,207 @@ typedef struct css_select_state {
 
 	struct css_node_data *node_data;	/* Data we'll store on node */
 
+	/* Memos of the nodes after and above the node, found so far, so the
+	 * client isn't asked for their data for each selector chain */
+	struct {
+		void *node;		/* Node, or NULL if slot is unused */
+		css_ancestor_memo *memo;	/* Node's memo, or NULL */
+	} memo_cache[CSS_ANCESTOR_MEMO_CACHE_SIZE];
+
 	prop_state props[CSS_N_PROPERTIES][CSS_PSEUDO_ELEMENT_COUNT];
+
+	/* Properties currently set by user or author declarations, by the
+	 * origin and importance of the declaration (see decided_class) */
+	uint32_t decided[CSS_PSEUDO_ELEMENT_COUNT][4][CSS_PROP_BITMAP_WORDS];
+
+	css_style *collect;		/* Style whose property bitmaps are
+					 * being built, or NULL */
 } css_select_state;
 
+/**
+ * Find the class of a decided property in css_select_state
+ *
+ * \param origin     Origin of the declaration, other than CSS_ORIGIN_UA
+ * \param important  Whether the declaration is !important
+ * \return Index into css_select_state's decided bitmaps
+ */
+static inline uint32_t decided_class(css_origin origin, bool important)
+{
+	return (origin - CSS_ORIGIN_USER) * 2 + (important ? 1 : 0);
+}
+
 static inline void advance_bytecode(css_style *style, uint32_t n_bytes)
 {
 	style->used -= (n_bytes / sizeof(css_code_t));
 	style->bytecode = style->bytecode + (n_bytes / sizeof(css_code_t));
 }
 
-bool css__outranks_existing(uint16_t op, bool important,
-		css_select_state *state, bool inherit);
+/**
+ * Record the origin and importance of the declaration now setting a property
+ *
+ * \param state      Selection state
+ * \param prop       Property being set
+ * \param pseudo     Pseudo element the property is being set for
+ * \param existing   State of the property before it is set
+ * \param origin     Origin of the new declaration
+ * \param important  Whether the new declaration is !important
+ */
+static inline void set_decided(css_select_state *state, uint32_t prop,
+		css_pseudo_element pseudo, const prop_state *existing,
+		css_origin origin, bool important)
+{
+	uint32_t (*decided)[CSS_PROP_BITMAP_WORDS] = state->decided[pseudo];
+	uint32_t word = prop / 32;
+	uint32_t bit = 1u << (prop % 32);
+
+	if (existing->set && existing->origin != CSS_ORIGIN_UA) {
+		decided[decided_class(existing->origin, existing->important)]
+				[word] &= ~bit;
+	}
+
+	if (origin != CSS_ORIGIN_UA)
+		decided[decided_class(origin, important)][word] |= bit;
+}
+
+/**
+ * Determine whether a declaration outranks the existing value of its property
+ *
+ * \param op         Property the declaration sets
+ * \param important  Whether the declaration is !important
+ * \param state      Selection state
+ * \param inherit    Whether the declaration's value is inherit
+ * \return true if the declaration is to be applied, in which case the
+ *         state has been updated to record it, false otherwise
+ */
+static inline bool css__outranks_existing(uint16_t op, bool important,
+		css_select_state *state, bool inherit)
+{
+	prop_state *existing = &state->props[op][state->current_pseudo];
+	bool outranks = false;
+
+	if (state->collect != NULL) {
+		/* Building property bitmaps: just note the property */
+		uint32_t *bitmap = important ? state->collect->important :
+				state->collect->props;
+
+		bitmap[op / 32] |= 1u << (op % 32);
+
+		return false;
+	}
+
+	/* Sorting on origin & importance gives the following:
+	 * 
+	 *           | UA, - | UA, i | USER, - | USER, i | AUTHOR, - | AUTHOR, i
+	 *           |----------------------------------------------------------
+	 * UA    , - |   S       S       Y          Y         Y           Y
+	 * UA    , i |   S       S       Y          Y         Y           Y
+	 * USER  , - |   -       -       S          Y         Y           Y
+	 * USER  , i |   -       -       -          S         -           -
+	 * AUTHOR, - |   -       -       -          Y         S           Y
+	 * AUTHOR, i |   -       -       -          Y         -           S
+	 *
+	 * Where the columns represent the origin/importance of the property 
+	 * being considered and the rows represent the origin/importance of 
+	 * the existing property.
+	 *
+	 * - means that the existing property must be preserved
+	 * Y means that the new property must be applied
+	 * S means that the specificities of the rules must be considered.
+	 *
+	 * If specificities are considered, the highest specificity wins.
+	 * If specificities are equal, then the rule defined last wins.
+	 *
+	 * We have no need to explicitly consider the ordering of rules if
+	 * the specificities are the same because:
+	 *
+	 * a) We process stylesheets in order
+	 * b) The selector hash chains within a sheet are ordered such that 
+	 *    more specific rules come after less specific ones and, when
+	 *    specificities are identical, rules defined later occur after
+	 *    those defined earlier.
+	 *
+	 * Therefore, where we consider specificity, below, the property 
+	 * currently being considered will always be applied if its specificity
+	 * is greater than or equal to that of the existing property.
+	 */
+
+	if (existing->set == 0) {
+		/* Property hasn't been set before, new one wins */
+		outranks = true;
+	} else {
+		assert(CSS_ORIGIN_UA < CSS_ORIGIN_USER);
+		assert(CSS_ORIGIN_USER < CSS_ORIGIN_AUTHOR);
+
+		if (existing->origin < state->current_origin) {
+			/* New origin has more weight than existing one.
+			 * Thus, new property wins, except when the existing 
+			 * one is USER, i. */
+			if (existing->important == 0 ||
+					existing->origin != CSS_ORIGIN_USER) {
+				outranks = true;
+			}
+		} else if (existing->origin == state->current_origin) {
+			/* Origins are identical, consider importance, except 
+			 * for UA stylesheets, when specificity is always 
+			 * considered (as importance is meaningless) */
+			if (existing->origin == CSS_ORIGIN_UA) {
+				if (state->current_specificity >=
+						existing->specificity) {
+					outranks = true;
+				}
+			} else if (existing->important == 0 && important) {
+				/* New is more important than old. */
+				outranks = true;
+			} else if (existing->important && important == false) {
+				/* Old is more important than new */
+			} else {
+				/* Same importance, consider specificity */
+				if (state->current_specificity >=
+						existing->specificity) {
+					outranks = true;
+				}
+			}
+		} else {
+			/* Existing origin has more weight than new one.
+			 * Thus, existing property wins, except when the new
+			 * one is USER, i. */
+			if (state->current_origin == CSS_ORIGIN_USER &&
+					important) {
+				outranks = true;
+			}
+		}
+	}
+
+	if (outranks) {
+		/* The new property is about to replace the old one.
+		 * Update our state to reflect this. */
+		set_decided(state, op, state->current_pseudo, existing,
+				state->current_origin, important);
+		existing->set = 1;
+		existing->specificity = state->current_specificity;
+		existing->origin = state->current_origin;
+		existing->important = important;
+		existing->inherit = inherit;
+	}
+
+	return outranks;
+}
+
+void css__select_prepare_styles(css_stylesheet *sheet);
+
+/**
+ * A declaration in a style's bytecode
+ */
+typedef struct css_select_declaration {
+	uint32_t offset;	/**< Offset of its OPV, in code entries */
+	uint16_t prop;		/**< Property it sets */
+	bool reported;		/**< Whether it reports the property to the
+				 * cascade */
+	bool important;		/**< Whether it is !important */
+} css_select_declaration;
+
+css_error css__select_style_declarations(const css_style *style,
+		css_select_declaration *decls, uint32_t *count);
 
 #endif
 
@@ -0,0 +1,1416 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *		  http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+
+#include "stylesheet.h"
+#include "bytecode/opcodes.h"
+#include "select/font_face.h"
+#include "utils/alloc.h"
+#include "utils/utils.h"
+
+/*
+ * Compiled stylesheet format
+ *
+ * A compiled sheet is a sequence of 32bit words in host byte order, so it
+ * may only be loaded on a host with the same endianness as the one that
+ * wrote it.  It contains no pointers: strings are referred to by number,
+ * and the bytecode's string numbers index the sheet's string vector, which
+ * forms the start of the string table.
+ *
+ *   header		magic, version, language level, flags,
+ *			string vector length, string table length,
+ *			string table offset (bytes), top-level rule count
+ *   rules		see _write_rule
+ *   string table	for each string, its length in bytes followed by
+ *			its data, padded to a word boundary
+ *
+ * String number 0 represents a NULL string.
+ *
+ * The selector hash is not stored; it is rebuilt as rules are added to
+ * the loaded sheet.
+ */
+
+#define COMPILED_MAGIC		0x4353536cu	/* "lSSC" */
+
+/* Must be bumped whenever the bytecode or this format changes */
+#define COMPILED_VERSION	1
+
+#define COMPILED_HEADER_WORDS	8
+
+#define COMPILED_QUIRKS_ALLOWED	(1 << 0)
+#define COMPILED_QUIRKS_USED	(1 << 1)
+#define COMPILED_INLINE_STYLE	(1 << 2)
+
+/** Compiled sheet output context */
+typedef struct writer {
+	uint8_t *data;		/**< Output buffer, or NULL to measure */
+	size_t len;		/**< Length of output buffer */
+	size_t pos;		/**< Current output position */
+
+	lwc_string **strings;	/**< Strings referenced by the sheet */
+	uint32_t n_strings;	/**< Number of strings used */
+	uint32_t strings_l;	/**< Number of strings allocated */
+
+	uint32_t *index;	/**< Open addressed table of string numbers */
+	uint32_t index_l;	/**< Number of slots in index; a power of two */
+} writer;
+
+/** Compiled sheet input context */
+typedef struct reader {
+	const uint8_t *data;	/**< Compiled sheet */
+	size_t len;		/**< Length of compiled sheet */
+	size_t pos;		/**< Current input position */
+	size_t end;		/**< End of rule data */
+	bool error;		/**< Whether malformed input has been seen */
+
+	lwc_string **strings;	/**< Interned string table */
+	uint32_t n_strings;	/**< Number of strings in table */
+} reader;
+
+/** Bytecode checking context */
+typedef struct bytecode_check {
+	const css_code_t *bytecode;	/**< Bytecode being checked */
+	uint32_t used;		/**< Length of bytecode, in words */
+	uint32_t pos;		/**< Current position, in words */
+	uint32_t n_strings;	/**< Number of strings in string vector */
+	bool error;		/**< Whether malformed bytecode has been seen */
+} bytecode_check;
+
+static css_error _write_rule(writer *w, const css_rule *rule);
+static css_error _read_rule(reader *r, css_stylesheet *sheet,
+		css_rule *parent);
+
+/******************************************************************************
+ * Output								      *
+ ******************************************************************************/
+
+static inline void _write_u32(writer *w, uint32_t value)
+{
+	if (w->data != NULL && w->pos + sizeof(value) <= w->len)
+		memcpy(w->data + w->pos, &value, sizeof(value));
+
+	w->pos += sizeof(value);
+}
+
+static inline void _write_u64(writer *w, uint64_t value)
+{
+	_write_u32(w, (uint32_t) value);
+	_write_u32(w, (uint32_t) (value >> 32));
+}
+
+static void _write_bytes(writer *w, const void *bytes, size_t len)
+{
+	size_t padded = (len + 3) & ~(size_t) 3;
+
+	if (w->data != NULL && w->pos + padded <= w->len) {
+		memcpy(w->data + w->pos, bytes, len);
+		memset(w->data + w->pos + len, 0, padded - len);
+	}
+
+	w->pos += padded;
+}
+
+/**
+ * Add a string to a writer's string table
+ *
+ * \param w       Writer to add string to
+ * \param string  String to add
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ */
+static css_error _writer_add_string(writer *w, lwc_string *string)
+{
+	css_error error;
+
+	if (w->n_strings == w->strings_l) {
+		uint32_t len = w->strings_l == 0 ? 256 : w->strings_l * 2;
+		lwc_string **strings;
+
+		strings = css__realloc(w->strings, len * sizeof(lwc_string *));
+		if (strings == NULL)
+			return CSS_NOMEM;
+
+		w->strings = strings;
+		w->strings_l = len;
+	}
+
+	error = css__string_index_grow(&w->index, &w->index_l, w->strings,
+			w->n_strings);
+	if (error != CSS_OK)
+		return error;
+
+	w->strings[w->n_strings++] = string;
+	css__string_index_insert(w->index, w->index_l, string, w->n_strings);
+
+	return CSS_OK;
+}
+
+/**
+ * Write a reference to a string
+ *
+ * \param w       Writer to output to
+ * \param string  String to write, or NULL
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ */
+static css_error _write_string(writer *w, lwc_string *string)
+{
+	uint32_t number;
+	css_error error;
+
+	if (string == NULL) {
+		_write_u32(w, 0);
+		return CSS_OK;
+	}
+
+	number = css__string_index_find(w->index, w->index_l, w->strings,
+			string);
+	if (number != 0) {
+		_write_u32(w, number);
+		return CSS_OK;
+	}
+
+	error = _writer_add_string(w, string);
+	if (error != CSS_OK)
+		return error;
+
+	_write_u32(w, w->n_strings);
+
+	return CSS_OK;
+}
+
+/**
+ * Write a selector chain
+ *
+ * \param w         Writer to output to
+ * \param selector  Selector at head of chain
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ *
+ * The chain is written as its length, followed by, for each selector from
+ * the head of the chain, its specificity, its number of details and then
+ * the details themselves.
+ */
+static css_error _write_selector(writer *w, const css_selector *selector)
+{
+	const css_selector *s;
+	uint32_t count = 0;
+	css_error error;
+
+	for (s = selector; s != NULL; s = s->combinator)
+		count++;
+
+	_write_u32(w, count);
+
+	for (s = selector; s != NULL; s = s->combinator) {
+		const css_selector_detail *d;
+		uint32_t details = 1;
+
+		for (d = &s->data; d->next; d++)
+			details++;
+
+		_write_u32(w, s->specificity);
+		_write_u32(w, details);
+
+		for (d = &s->data; details > 0; d++, details--) {
+			_write_u32(w, d->type | (d->comb << 4) |
+					(d->value_type << 7) |
+					(d->negate << 8));
+
+			error = _write_string(w, d->qname.ns);
+			if (error != CSS_OK)
+				return error;
+
+			error = _write_string(w, d->qname.name);
+			if (error != CSS_OK)
+				return error;
+
+			if (d->value_type == CSS_SELECTOR_DETAIL_VALUE_STRING) {
+				error = _write_string(w, d->value.string);
+				if (error != CSS_OK)
+					return error;
+			} else {
+				_write_u32(w, (uint32_t) d->value.nth.a);
+				_write_u32(w, (uint32_t) d->value.nth.b);
+			}
+		}
+	}
+
+	return CSS_OK;
+}
+
+/**
+ * Write a style's bytecode
+ *
+ * \param w      Writer to output to
+ * \param style  Style to write, or NULL
+ */
+static void _write_style(writer *w, const css_style *style)
+{
+	uint32_t i;
+
+	/* Length + 1, so that an absent style is distinct from an empty one */
+	if (style == NULL) {
+		_write_u32(w, 0);
+		return;
+	}
+
+	_write_u32(w, style->used + 1);
+
+	for (i = 0; i < style->used; i++)
+		_write_u32(w, style->bytecode[i]);
+}
+
+/**
+ * Write a rule
+ *
+ * \param w     Writer to output to
+ * \param rule  Rule to write
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ *
+ * A rule is written as its type followed by its type-specific contents.
+ * The children of an @media rule follow it, preceded by their count.
+ */
+static css_error _write_rule(writer *w, const css_rule *rule)
+{
+	css_error error = CSS_OK;
+
+	_write_u32(w, rule->type);
+
+	switch (rule->type) {
+	case CSS_RULE_UNKNOWN:
+		break;
+	case CSS_RULE_SELECTOR:
+	{
+		const css_rule_selector *s = (const css_rule_selector *) rule;
+		uint32_t i;
+
+		_write_u32(w, rule->items);
+
+		for (i = 0; i < rule->items; i++) {
+			error = _write_selector(w, s->selectors[i]);
+			if (error != CSS_OK)
+				return error;
+		}
+
+		_write_style(w, s->style);
+	}
+		break;
+	case CSS_RULE_CHARSET:
+	{
+		const css_rule_charset *c = (const css_rule_charset *) rule;
+
+		error = _write_string(w, c->encoding);
+	}
+		break;
+	case CSS_RULE_IMPORT:
+	{
+		const css_rule_import *i = (const css_rule_import *) rule;
+
+		error = _write_string(w, i->url);
+		_write_u64(w, i->media);
+	}
+		break;
+	case CSS_RULE_MEDIA:
+	{
+		const css_rule_media *m = (const css_rule_media *) rule;
+		const css_rule *c;
+		uint32_t count = 0;
+
+		_write_u64(w, m->media);
+
+		for (c = m->first_child; c != NULL; c = c->next)
+			count++;
+
+		_write_u32(w, count);
+
+		for (c = m->first_child; c != NULL; c = c->next) {
+			error = _write_rule(w, c);
+			if (error != CSS_OK)
+				return error;
+		}
+	}
+		break;
+	case CSS_RULE_FONT_FACE:
+	{
+		const css_rule_font_face *f = (const css_rule_font_face *) rule;
+		const css_font_face *font_face = f->font_face;
+		uint32_t i;
+
+		_write_u32(w, font_face != NULL);
+		if (font_face == NULL)
+			break;
+
+		error = _write_string(w, font_face->font_family);
+		if (error != CSS_OK)
+			return error;
+
+		_write_u32(w, font_face->bits[0]);
+		_write_u32(w, font_face->n_srcs);
+
+		for (i = 0; i < font_face->n_srcs; i++) {
+			error = _write_string(w, font_face->srcs[i].location);
+			if (error != CSS_OK)
+				return error;
+
+			_write_u32(w, font_face->srcs[i].bits[0]);
+		}
+	}
+		break;
+	case CSS_RULE_PAGE:
+	{
+		const css_rule_page *p = (const css_rule_page *) rule;
+
+		_write_u32(w, p->selector != NULL);
+		if (p->selector != NULL) {
+			error = _write_selector(w, p->selector);
+			if (error != CSS_OK)
+				return error;
+		}
+
+		_write_style(w, p->style);
+	}
+		break;
+	}
+
+	return error;
+}
+
+/**
+ * Serialise a stylesheet to its compiled form
+ *
+ * \param sheet  The stylesheet to serialise
+ * \param data   Buffer to receive compiled sheet, or NULL to measure
+ * \param len    Pointer to length of \a data on entry, updated with
+ *               length of compiled sheet on exit
+ * \return CSS_OK on success,
+ *         CSS_BADPARM on bad parameters,
+ *         CSS_INVALID if the sheet has not finished parsing,
+ *         CSS_NOMEM if \a data is too small, or on memory exhaustion
+ *
+ * The compiled form of the sheet may be passed to
+ * css_stylesheet_load_compiled() by any process using the same version
+ * of the library on a host of the same endianness.  Imported sheets are
+ * not included; they must be compiled and registered separately.
+ */
+css_error css_stylesheet_serialise(css_stylesheet *sheet,
+		uint8_t *data, size_t *len)
+{
+	const css_rule *rule;
+	size_t strings_pos;
+	uint32_t rules = 0;
+	uint32_t flags = 0;
+	css_error error = CSS_OK;
+	writer w;
+	uint32_t i;
+
+	if (sheet == NULL || len == NULL)
+		return CSS_BADPARM;
+
+	if (sheet->parser != NULL)
+		return CSS_INVALID;
+
+	memset(&w, 0, sizeof(w));
+	w.data = data;
+	w.len = (data != NULL) ? *len : 0;
+
+	/* The string vector must keep its numbering */
+	for (i = 0; i < sheet->string_vector_c && error == CSS_OK; i++)
+		error = _writer_add_string(&w, sheet->string_vector[i]);
+
+	if (sheet->quirks_allowed)
+		flags |= COMPILED_QUIRKS_ALLOWED;
+	if (sheet->quirks_used)
+		flags |= COMPILED_QUIRKS_USED;
+	if (sheet->inline_style)
+		flags |= COMPILED_INLINE_STYLE;
+
+	for (rule = sheet->rule_list; rule != NULL; rule = rule->next)
+		rules++;
+
+	/* Header, with string table length and offset fixed up below */
+	_write_u32(&w, COMPILED_MAGIC);
+	_write_u32(&w, COMPILED_VERSION);
+	_write_u32(&w, sheet->level);
+	_write_u32(&w, flags);
+	_write_u32(&w, sheet->string_vector_c);
+	_write_u32(&w, 0);
+	_write_u32(&w, 0);
+	_write_u32(&w, rules);
+
+	for (rule = sheet->rule_list; rule != NULL && error == CSS_OK;
+			rule = rule->next)
+		error = _write_rule(&w, rule);
+
+	strings_pos = w.pos;
+
+	for (i = 0; i < w.n_strings; i++) {
+		_write_u32(&w, lwc_string_length(w.strings[i]));
+		_write_bytes(&w, lwc_string_data(w.strings[i]),
+				lwc_string_length(w.strings[i]));
+	}
+
+	if (error == CSS_OK && strings_pos > UINT32_MAX)
+		error = CSS_INVALID;
+
+	if (error == CSS_OK) {
+		if (data != NULL && w.pos > w.len) {
+			error = CSS_NOMEM;
+		} else if (data != NULL) {
+			uint32_t words[2] = { w.n_strings,
+					(uint32_t) strings_pos };
+
+			memcpy(data + 5 * sizeof(uint32_t), words,
+					sizeof(words));
+		}
+
+		*len = w.pos;
+	}
+
+	css__free(w.index);
+	css__free(w.strings);
+
+	return error;
+}
+
+/******************************************************************************
+ * Input								      *
+ ******************************************************************************/
+
+static inline uint32_t _read_u32(reader *r)
+{
+	uint32_t value;
+
+	if (r->pos + sizeof(value) > r->end) {
+		r->error = true;
+		return 0;
+	}
+
+	memcpy(&value, r->data + r->pos, sizeof(value));
+	r->pos += sizeof(value);
+
+	return value;
+}
+
+static inline uint64_t _read_u64(reader *r)
+{
+	uint64_t low = _read_u32(r);
+
+	return low | ((uint64_t) _read_u32(r) << 32);
+}
+
+/**
+ * Read a reference to a string
+ *
+ * \param r  Reader to input from
+ * \return Pointer to string (not referenced), or NULL
+ *
+ * Invalid string numbers flag an error and yield NULL.
+ */
+static lwc_string *_read_string(reader *r)
+{
+	uint32_t number = _read_u32(r);
+
+	if (number > r->n_strings) {
+		r->error = true;
+		return NULL;
+	}
+
+	return number == 0 ? NULL : r->strings[number - 1];
+}
+
+/**
+ * Read a selector detail
+ *
+ * \param r       Reader to input from
+ * \param detail  Detail to fill in, with the strings it uses referenced
+ * \param first   Whether this is a selector's first detail
+ * \return CSS_OK on success, CSS_INVALID on malformed input
+ */
+static css_error _read_detail(reader *r, css_selector_detail *detail,
+		bool first)
+{
+	uint32_t bits = _read_u32(r);
+	lwc_string *ns = _read_string(r);
+	lwc_string *name = _read_string(r);
+	css_selector_detail_value value;
+
+	if ((bits & 0xf) > CSS_SELECTOR_ATTRIBUTE_SUBSTRING ||
+			((bits >> 4) & 0x7) > CSS_COMBINATOR_GENERIC_SIBLING ||
+			(bits >> 9) != 0)
+		r->error = true;
+
+	/* Selectors start with an element name, which holds the combinator */
+	if (first && (bits & 0xf) != CSS_SELECTOR_ELEMENT)
+		r->error = true;
+	if (first == false && ((bits >> 4) & 0x7) != CSS_COMBINATOR_NONE)
+		r->error = true;
+
+	if (((bits >> 7) & 0x1) == CSS_SELECTOR_DETAIL_VALUE_STRING) {
+		value.string = _read_string(r);
+	} else {
+		value.nth.a = (int32_t) _read_u32(r);
+		value.nth.b = (int32_t) _read_u32(r);
+	}
+
+	if (r->error || name == NULL)
+		return CSS_INVALID;
+
+	/* Selector hash and bloom rely on these having insensitive strings */
+	switch (bits & 0xf) {
+	case CSS_SELECTOR_ELEMENT:
+	case CSS_SELECTOR_CLASS:
+	case CSS_SELECTOR_ID:
+		if (name->insensitive == NULL &&
+				lwc__intern_caseless_string(name) !=
+				lwc_error_ok)
+			return CSS_NOMEM;
+		break;
+	}
+
+	memset(detail, 0, sizeof(css_selector_detail));
+
+	detail->type = bits & 0xf;
+	detail->comb = (bits >> 4) & 0x7;
+	detail->value_type = (bits >> 7) & 0x1;
+	detail->negate = (bits >> 8) & 0x1;
+
+	detail->qname.ns = (ns != NULL) ? lwc_string_ref(ns) : NULL;
+	detail->qname.name = lwc_string_ref(name);
+	detail->value = value;
+	if (detail->value_type == CSS_SELECTOR_DETAIL_VALUE_STRING &&
+			value.string != NULL)
+		detail->value.string = lwc_string_ref(value.string);
+
+	return CSS_OK;
+}
+
+/**
+ * Read a selector chain
+ *
+ * \param r         Reader to input from
+ * \param sheet     Stylesheet being loaded
+ * \param selector  Pointer to location to receive selector
+ * \return CSS_OK on success,
+ *         CSS_INVALID on malformed input,
+ *         CSS_NOMEM on memory exhaustion
+ */
+static css_error _read_selector(reader *r, css_stylesheet *sheet,
+		css_selector **selector)
+{
+	css_selector *head = NULL, *prev = NULL;
+	uint32_t count = _read_u32(r);
+	css_error error = CSS_OK;
+
+	if (count == 0)
+		return CSS_INVALID;
+
+	while (count-- > 0 && error == CSS_OK) {
+		uint32_t specificity = _read_u32(r);
+		uint32_t details = _read_u32(r);
+		css_selector *s;
+		uint32_t i;
+
+		/* Each detail occupies at least four words */
+		if (r->error || details == 0 ||
+				details > (r->end - r->pos) / 16) {
+			error = CSS_INVALID;
+			break;
+		}
+
+		s = css__malloc(sizeof(css_selector) +
+				(details - 1) * sizeof(css_selector_detail));
+		if (s == NULL) {
+			error = CSS_NOMEM;
+			break;
+		}
+
+		for (i = 0; i < details; i++) {
+			error = _read_detail(r, &(&s->data)[i], i == 0);
+			if (error != CSS_OK)
+				break;
+
+			(&s->data)[i].next = (i + 1 < details);
+		}
+
+		if (i == 0) {
+			css__free(s);
+			break;
+		}
+
+		/* Only the last selector in a chain lacks a combinator */
+		if (error == CSS_OK && (s->data.comb == CSS_COMBINATOR_NONE) !=
+				(count == 0))
+			error = CSS_INVALID;
+
+		/* Truncate at a bad detail, so the chain may be destroyed */
+		(&s->data)[i - 1].next = 0;
+
+		s->combinator = NULL;
+		s->rule = NULL;
+		s->specificity = specificity;
+
+		if (prev != NULL)
+			prev->combinator = s;
+		else
+			head = s;
+		prev = s;
+	}
+
+	if (error != CSS_OK) {
+		if (head != NULL)
+			css__stylesheet_selector_destroy(sheet, head);
+		return error;
+	}
+
+	*selector = head;
+
+	return CSS_OK;
+}
+
+/**
+ * Read the next word of the bytecode being checked
+ *
+ * \param c  Checking context
+ * \return The word, or 0 if there are no more words
+ */
+static inline uint32_t _check_word(bytecode_check *c)
+{
+	if (c->pos == c->used) {
+		c->error = true;
+		return 0;
+	}
+
+	return c->bytecode[c->pos++];
+}
+
+/**
+ * Skip some words of the bytecode being checked
+ *
+ * \param c      Checking context
+ * \param words  Number of words to skip
+ */
+static inline void _check_skip(bytecode_check *c, uint32_t words)
+{
+	if (words > c->used - c->pos) {
+		c->error = true;
+		return;
+	}
+
+	c->pos += words;
+}
+
+/**
+ * Skip a string number in the bytecode being checked
+ *
+ * \param c  Checking context
+ */
+static inline void _check_string(bytecode_check *c)
+{
+	uint32_t number = _check_word(c);
+
+	if (number == 0 || number > c->n_strings)
+		c->error = true;
+}
+
+/**
+ * Check a gradient's operands
+ *
+ * \param c  Checking context
+ *
+ * The limit on colour stops is that of css__cascade_image().
+ */
+static void _check_gradient(bytecode_check *c)
+{
+	uint32_t stops = 0;
+
+	/* Angle */
+	_check_skip(c, 2);
+
+	do {
+		if (++stops > 32) {
+			c->error = true;
+			return;
+		}
+
+		if (getValue(_check_word(c)) == COLOR_SET)
+			_check_skip(c, 1);
+
+		/* Stop position */
+		_check_skip(c, 2);
+	} while (c->error == false && c->pos < c->used &&
+			c->bytecode[c->pos] != 0);
+
+	/* Terminator */
+	_check_skip(c, 1);
+}
+
+/**
+ * Check a property's operands
+ *
+ * \param c    Checking context
+ * \param opv  The property's OPV, already read
+ *
+ * The operands are walked as the property's cascade handler, in
+ * src/select/properties, reads them, so a style which passes may be
+ * selected from without overrunning its bytecode.  The two must change
+ * together: a handler which reads fewer operands than are checked here
+ * reads the rest of the style out of step.
+ */
+static void _check_property(bytecode_check *c, uint32_t opv)
+{
+	uint32_t value = getValue(opv);
+
+	if (getOpcode(opv) >= CSS_N_PROPERTIES) {
+		c->error = true;
+		return;
+	}
+
+	if (isInherit(opv))
+		return;
+
+	switch (getOpcode(opv)) {
+	case CSS_PROP_BORDER_SPACING:
+		_check_skip(c, 4);
+		break;
+	case CSS_PROP_BORDER_TOP_LEFT_RADIUS:
+	case CSS_PROP_BORDER_TOP_RIGHT_RADIUS:
+	case CSS_PROP_BORDER_BOTTOM_RIGHT_RADIUS:
+	case CSS_PROP_BORDER_BOTTOM_LEFT_RADIUS:
+	case CSS_PROP_MIN_HEIGHT:
+	case CSS_PROP_MIN_WIDTH:
+	case CSS_PROP_PADDING_TOP:
+	case CSS_PROP_PADDING_RIGHT:
+	case CSS_PROP_PADDING_BOTTOM:
+	case CSS_PROP_PADDING_LEFT:
+	case CSS_PROP_PAUSE_AFTER:
+	case CSS_PROP_PAUSE_BEFORE:
+	case CSS_PROP_TEXT_INDENT:
+		_check_skip(c, 2);
+		break;
+	case CSS_PROP_FLEX_GROW:
+	case CSS_PROP_FLEX_SHRINK:
+	case CSS_PROP_OPACITY:
+	case CSS_PROP_ORPHANS:
+	case CSS_PROP_PITCH_RANGE:
+	case CSS_PROP_RICHNESS:
+	case CSS_PROP_STRESS:
+	case CSS_PROP_WIDOWS:
+		_check_skip(c, 1);
+		break;
+	case CSS_PROP_BACKGROUND_COLOR:
+	case CSS_PROP_BORDER_TOP_COLOR:
+	case CSS_PROP_BORDER_RIGHT_COLOR:
+	case CSS_PROP_BORDER_BOTTOM_COLOR:
+	case CSS_PROP_BORDER_LEFT_COLOR:
+	case CSS_PROP_COLOR:
+	case CSS_PROP_COLUMN_COUNT:
+	case CSS_PROP_COLUMN_RULE_COLOR:
+	case CSS_PROP_FLEX_BASIS:
+	case CSS_PROP_OUTLINE_COLOR:
+	case CSS_PROP_SPEECH_RATE:
+	case CSS_PROP_Z_INDEX:
+		/* All of these share BACKGROUND_COLOR_SET's value */
+		if (value == BACKGROUND_COLOR_SET)
+			_check_skip(c, 1);
+		break;
+	case CSS_PROP_BORDER_TOP_WIDTH:
+	case CSS_PROP_BORDER_RIGHT_WIDTH:
+	case CSS_PROP_BORDER_BOTTOM_WIDTH:
+	case CSS_PROP_BORDER_LEFT_WIDTH:
+	case CSS_PROP_BOTTOM:
+	case CSS_PROP_COLUMN_GAP:
+	case CSS_PROP_COLUMN_RULE_WIDTH:
+	case CSS_PROP_COLUMN_WIDTH:
+	case CSS_PROP_ELEVATION:
+	case CSS_PROP_FONT_SIZE:
+	case CSS_PROP_HEIGHT:
+	case CSS_PROP_LEFT:
+	case CSS_PROP_LETTER_SPACING:
+	case CSS_PROP_MARGIN_TOP:
+	case CSS_PROP_MARGIN_RIGHT:
+	case CSS_PROP_MARGIN_BOTTOM:
+	case CSS_PROP_MARGIN_LEFT:
+	case CSS_PROP_MAX_HEIGHT:
+	case CSS_PROP_MAX_WIDTH:
+	case CSS_PROP_OUTLINE_WIDTH:
+	case CSS_PROP_PITCH:
+	case CSS_PROP_RIGHT:
+	case CSS_PROP_TOP:
+	case CSS_PROP_VERTICAL_ALIGN:
+	case CSS_PROP_WIDTH:
+	case CSS_PROP_WORD_SPACING:
+		/* All of these share BORDER_WIDTH_SET's value */
+		if (value == BORDER_WIDTH_SET)
+			_check_skip(c, 2);
+		break;
+	case CSS_PROP_AZIMUTH:
+		if ((value & ~AZIMUTH_BEHIND) == AZIMUTH_ANGLE)
+			_check_skip(c, 2);
+		break;
+	case CSS_PROP_LINE_HEIGHT:
+	case CSS_PROP_VOLUME:
+		/* These share LINE_HEIGHT's values */
+		if (value == LINE_HEIGHT_NUMBER)
+			_check_skip(c, 1);
+		else if (value == LINE_HEIGHT_DIMENSION)
+			_check_skip(c, 2);
+		break;
+	case CSS_PROP_BACKGROUND_POSITION:
+		if ((value & 0xf0) == BACKGROUND_POSITION_HORZ_SET)
+			_check_skip(c, 2);
+		if ((value & 0x0f) == BACKGROUND_POSITION_VERT_SET)
+			_check_skip(c, 2);
+		break;
+	case CSS_PROP_CLIP:
+		if ((value & CLIP_SHAPE_MASK) == CLIP_SHAPE_RECT) {
+			if ((value & CLIP_RECT_TOP_AUTO) == 0)
+				_check_skip(c, 2);
+			if ((value & CLIP_RECT_RIGHT_AUTO) == 0)
+				_check_skip(c, 2);
+			if ((value & CLIP_RECT_BOTTOM_AUTO) == 0)
+				_check_skip(c, 2);
+			if ((value & CLIP_RECT_LEFT_AUTO) == 0)
+				_check_skip(c, 2);
+		}
+		break;
+	case CSS_PROP_CUE_AFTER:
+	case CSS_PROP_CUE_BEFORE:
+	case CSS_PROP_LIST_STYLE_IMAGE:
+		/* These share CUE_AFTER_URI's value */
+		if (value == CUE_AFTER_URI)
+			_check_string(c);
+		break;
+	case CSS_PROP_PLAY_DURING:
+		if ((value & PLAY_DURING_TYPE_MASK) == PLAY_DURING_URI)
+			_check_string(c);
+		break;
+	case CSS_PROP_BACKGROUND_IMAGE:
+		if (value == IMAGE_URI)
+			_check_string(c);
+		else if (value == IMAGE_LINEAR_GRADIENT ||
+				value == IMAGE_REPEATING_LINEAR_GRADIENT)
+			_check_gradient(c);
+		break;
+	case CSS_PROP_CONTENT:
+		if (value == CONTENT_NONE)
+			break;
+
+		while (value != CONTENT_NORMAL && c->error == false) {
+			switch (value & 0xff) {
+			case CONTENT_COUNTERS:
+				_check_string(c);
+				/* Fall through */
+			case CONTENT_COUNTER:
+			case CONTENT_URI:
+			case CONTENT_ATTR:
+			case CONTENT_STRING:
+				_check_string(c);
+				break;
+			}
+
+			value = _check_word(c);
+		}
+		break;
+	case CSS_PROP_COUNTER_INCREMENT:
+	case CSS_PROP_COUNTER_RESET:
+		/* These share COUNTER_INCREMENT's values */
+		if (value != COUNTER_INCREMENT_NAMED)
+			break;
+
+		while (value != COUNTER_INCREMENT_NONE &&
+				c->error == false) {
+			_check_string(c);
+			_check_skip(c, 1);
+			value = _check_word(c);
+		}
+		break;
+	case CSS_PROP_CURSOR:
+		while (value == CURSOR_URI && c->error == false) {
+			_check_string(c);
+			value = _check_word(c);
+		}
+		break;
+	case CSS_PROP_FONT_FAMILY:
+	case CSS_PROP_VOICE_FAMILY:
+		/* These share FONT_FAMILY's list values */
+		while (value != FONT_FAMILY_END && c->error == false) {
+			if (value == FONT_FAMILY_STRING ||
+					value == FONT_FAMILY_IDENT_LIST)
+				_check_string(c);
+			value = _check_word(c);
+		}
+		break;
+	case CSS_PROP_QUOTES:
+		while (value != QUOTES_NONE && c->error == false) {
+			_check_string(c);
+			_check_string(c);
+			value = _check_word(c);
+		}
+		break;
+	default:
+		/* Keywords only */
+		break;
+	}
+}
+
+/**
+ * Check that a style's bytecode is safe to select from
+ *
+ * \param style      Style to check
+ * \param n_strings  Number of strings in the sheet's string vector
+ * \return true if the bytecode is valid, false otherwise
+ */
+static bool _check_style(const css_style *style, uint32_t n_strings)
+{
+	bytecode_check c;
+
+	c.bytecode = style->bytecode;
+	c.used = style->used;
+	c.pos = 0;
+	c.n_strings = n_strings;
+	c.error = false;
+
+	while (c.pos < c.used && c.error == false)
+		_check_property(&c, _check_word(&c));
+
+	return c.error == false;
+}
+
+/**
+ * Read a style's bytecode
+ *
+ * \param r      Reader to input from
+ * \param sheet  Stylesheet being loaded
+ * \param style  Pointer to location to receive style, or NULL if none
+ * \return CSS_OK on success,
+ *         CSS_INVALID on malformed input,
+ *         CSS_NOMEM on memory exhaustion
+ */
+static css_error _read_style(reader *r, css_stylesheet *sheet,
+		css_style **style)
+{
+	uint32_t used = _read_u32(r);
+	css_style *s;
+	css_error error;
+
+	*style = NULL;
+
+	if (used == 0)
+		return r->error ? CSS_INVALID : CSS_OK;
+
+	used--;
+	if (used > (r->end - r->pos) / sizeof(css_code_t))
+		return CSS_INVALID;
+
+	error = css__stylesheet_style_create(sheet, &s);
+	if (error != CSS_OK)
+		return error;
+
+	while (used-- > 0) {
+		error = css__stylesheet_style_append(s, _read_u32(r));
+		if (error != CSS_OK) {
+			css__stylesheet_style_destroy(s);
+			return error;
+		}
+	}
+
+	if (_check_style(s, sheet->string_vector_c) == false) {
+		css__stylesheet_style_destroy(s);
+		return CSS_INVALID;
+	}
+
+	*style = s;
+
+	return CSS_OK;
+}
+
+/**
+ * Read a font face
+ *
+ * \param r          Reader to input from
+ * \param font_face  Pointer to location to receive font face
+ * \return CSS_OK on success,
+ *         CSS_INVALID on malformed input,
+ *         CSS_NOMEM on memory exhaustion
+ */
+static css_error _read_font_face(reader *r, css_font_face **font_face)
+{
+	lwc_string *family = _read_string(r);
+	uint32_t bits = _read_u32(r);
+	uint32_t n_srcs = _read_u32(r);
+	css_font_face_src *srcs = NULL;
+	css_font_face *f;
+	css_error error;
+	uint32_t i;
+
+	if (r->error || bits > 0xff || n_srcs > (r->end - r->pos) / 8)
+		return CSS_INVALID;
+
+	error = css__font_face_create(&f);
+	if (error != CSS_OK)
+		return error;
+
+	if (family != NULL)
+		css__font_face_set_font_family(f, family);
+
+	f->bits[0] = bits;
+
+	if (n_srcs > 0) {
+		srcs = css__calloc(n_srcs, sizeof(css_font_face_src));
+		if (srcs == NULL) {
+			css__font_face_destroy(f);
+			return CSS_NOMEM;
+		}
+
+		for (i = 0; i < n_srcs; i++) {
+			lwc_string *location = _read_string(r);
+
+			bits = _read_u32(r);
+			if (r->error || bits > 0xff)
+				break;
+
+			if (location != NULL)
+				srcs[i].location = lwc_string_ref(location);
+			srcs[i].bits[0] = bits;
+		}
+
+		/* Font face owns srcs from here, even if only partly read */
+		css__font_face_set_srcs(f, srcs, n_srcs);
+
+		if (i < n_srcs) {
+			css__font_face_destroy(f);
+			return CSS_INVALID;
+		}
+	}
+
+	*font_face = f;
+
+	return CSS_OK;
+}
+
+/**
+ * Read a rule's type-specific contents
+ *
+ * \param r      Reader to input from
+ * \param sheet  Stylesheet being loaded
+ * \param rule   Rule to fill in
+ * \return CSS_OK on success,
+ *         CSS_INVALID on malformed input,
+ *         CSS_NOMEM on memory exhaustion
+ */
+static css_error _read_rule_contents(reader *r, css_stylesheet *sheet,
+		css_rule *rule)
+{
+	css_error error = CSS_OK;
+
+	switch (rule->type) {
+	case CSS_RULE_UNKNOWN:
+	case CSS_RULE_MEDIA:
+		break;
+	case CSS_RULE_SELECTOR:
+	{
+		css_rule_selector *s = (css_rule_selector *) rule;
+		uint32_t items = _read_u32(r);
+
+		/* Rules hold at most 255 selectors */
+		if (items > 0xff)
+			return CSS_INVALID;
+
+		while (items-- > 0) {
+			css_selector *sel;
+
+			error = _read_selector(r, sheet, &sel);
+			if (error != CSS_OK)
+				return error;
+
+			error = css__stylesheet_rule_add_selector(sheet,
+					rule, sel);
+			if (error != CSS_OK) {
+				css__stylesheet_selector_destroy(sheet, sel);
+				return error;
+			}
+		}
+
+		error = _read_style(r, sheet, &s->style);
+	}
+		break;
+	case CSS_RULE_CHARSET:
+	{
+		lwc_string *encoding = _read_string(r);
+
+		if (encoding == NULL)
+			return CSS_INVALID;
+
+		error = css__stylesheet_rule_set_charset(sheet, rule,
+				encoding);
+	}
+		break;
+	case CSS_RULE_IMPORT:
+	{
+		lwc_string *url = _read_string(r);
+		uint64_t media = _read_u64(r);
+
+		if (url == NULL || r->error)
+			return CSS_INVALID;
+
+		error = css__stylesheet_rule_set_nascent_import(sheet, rule,
+				url, media);
+	}
+		break;
+	case CSS_RULE_FONT_FACE:
+	{
+		css_rule_font_face *f = (css_rule_font_face *) rule;
+
+		if (_read_u32(r) != 0)
+			error = _read_font_face(r, &f->font_face);
+	}
+		break;
+	case CSS_RULE_PAGE:
+	{
+		css_rule_page *p = (css_rule_page *) rule;
+
+		if (_read_u32(r) != 0) {
+			css_selector *sel;
+
+			error = _read_selector(r, sheet, &sel);
+			if (error != CSS_OK)
+				return error;
+
+			error = css__stylesheet_rule_set_page_selector(sheet,
+					rule, sel);
+			if (error != CSS_OK) {
+				css__stylesheet_selector_destroy(sheet, sel);
+				return error;
+			}
+		}
+
+		if (error == CSS_OK)
+			error = _read_style(r, sheet, &p->style);
+	}
+		break;
+	}
+
+	if (error == CSS_OK && r->error)
+		error = CSS_INVALID;
+
+	return error;
+}
+
+/**
+ * Read a rule and add it to a stylesheet
+ *
+ * \param r       Reader to input from
+ * \param sheet   Stylesheet being loaded
+ * \param parent  Parent @media rule, or NULL for a top-level rule
+ * \return CSS_OK on success,
+ *         CSS_INVALID on malformed input,
+ *         CSS_NOMEM on memory exhaustion
+ */
+static css_error _read_rule(reader *r, css_stylesheet *sheet,
+		css_rule *parent)
+{
+	uint32_t type = _read_u32(r);
+	uint64_t media = 0;
+	css_rule *rule;
+	css_error error;
+	uint32_t count;
+
+	/* @media rules may not nest */
+	if (r->error || type > CSS_RULE_PAGE ||
+			(type == CSS_RULE_MEDIA && parent != NULL))
+		return CSS_INVALID;
+
+	if (type == CSS_RULE_MEDIA) {
+		media = _read_u64(r);
+		if (r->error)
+			return CSS_INVALID;
+	}
+
+	error = css__stylesheet_rule_create(sheet, type, &rule);
+	if (error != CSS_OK)
+		return error;
+
+	error = _read_rule_contents(r, sheet, rule);
+	if (error == CSS_OK && type == CSS_RULE_MEDIA)
+		error = css__stylesheet_rule_set_media(sheet, rule, media);
+
+	/* Adding the rule gives it the same index it had when parsed */
+	if (error == CSS_OK)
+		error = css__stylesheet_add_rule(sheet, rule, parent);
+
+	if (error != CSS_OK) {
+		css__stylesheet_rule_destroy(sheet, rule);
+		return error;
+	}
+
+	if (type != CSS_RULE_MEDIA)
+		return CSS_OK;
+
+	/* Children follow their @media rule, which now owns them.  Each
+	 * occupies at least one word */
+	count = _read_u32(r);
+	if (r->error || count > (r->end - r->pos) / sizeof(uint32_t))
+		return CSS_INVALID;
+
+	while (count-- > 0) {
+		error = _read_rule(r, sheet, rule);
+		if (error != CSS_OK)
+			return error;
+	}
+
+	return CSS_OK;
+}
+
+/**
+ * Intern a compiled sheet's string table
+ *
+ * \param r      Reader to input from, positioned at the string table
+ * \param count  Number of strings in table
+ * \return CSS_OK on success,
+ *         CSS_INVALID on malformed input,
+ *         CSS_NOMEM on memory exhaustion
+ */
+static css_error _read_strings(reader *r, uint32_t count)
+{
+	if (count > (r->len - r->pos) / sizeof(uint32_t))
+		return CSS_INVALID;
+
+	if (count == 0)
+		return CSS_OK;
+
+	r->strings = css__malloc(count * sizeof(lwc_string *));
+	if (r->strings == NULL)
+		return CSS_NOMEM;
+
+	r->end = r->len;
+
+	while (r->n_strings < count) {
+		uint32_t length = _read_u32(r);
+		lwc_error lerror;
+
+		if (r->error || length > r->len - r->pos)
+			return CSS_INVALID;
+
+		lerror = lwc_intern_string((const char *) r->data + r->pos,
+				length, &r->strings[r->n_strings]);
+		if (lerror != lwc_error_ok)
+			return css_error_from_lwc_error(lerror);
+
+		r->n_strings++;
+		r->pos += (length + 3) & ~(size_t) 3;
+	}
+
+	return CSS_OK;
+}
+
+/**
+ * Create a stylesheet from its compiled form
+ *
+ * \param params      Stylesheet parameters
+ * \param data        Compiled sheet, as produced by css_stylesheet_serialise
+ * \param len         Length, in bytes, of data
+ * \param stylesheet  Pointer to location to receive stylesheet
+ * \return CSS_OK on success,
+ *	   CSS_IMPORTS_PENDING if there are imports pending,
+ *	   CSS_BADPARM on bad parameters,
+ *	   CSS_INVALID if \a data is not a compatible compiled sheet, or if
+ *	               \a params doesn't match the sheet's compiled settings,
+ *	   CSS_NOMEM on memory exhaustion
+ *
+ * The resulting sheet is the same as the one that was serialised.  Its
+ * language level, and whether it permits quirks or is an inline style,
+ * are fixed at compilation, and must match \a params.
+ *
+ * \a data need not be aligned, and is not modified or retained, so may
+ * be a read-only mapping of a file.  It is checked before use, so a
+ * truncated or corrupt sheet is rejected rather than loaded: rule types,
+ * selector details and string numbers must be in range, @media rules may
+ * not nest, and each property's operands must lie within its style.
+ *
+ * On CSS_IMPORTS_PENDING, \a stylesheet is valid, and the client must
+ * process its imports as it would after css_stylesheet_data_done().
+ */
+css_error css_stylesheet_load_compiled(const css_stylesheet_params *params,
+		const uint8_t *data, size_t len, css_stylesheet **stylesheet)
+{
+	uint32_t header[COMPILED_HEADER_WORDS];
+	css_stylesheet *sheet;
+	css_error error;
+	uint32_t flags = 0;
+	uint32_t i;
+	reader r;
+
+	if (params == NULL || data == NULL || stylesheet == NULL)
+		return CSS_BADPARM;
+
+	if (len < sizeof(header))
+		return CSS_INVALID;
+
+	memcpy(header, data, sizeof(header));
+
+	if (params->allow_quirks)
+		flags |= COMPILED_QUIRKS_ALLOWED;
+	if (params->inline_style)
+		flags |= COMPILED_INLINE_STYLE;
+
+	if (header[0] != COMPILED_MAGIC || header[1] != COMPILED_VERSION ||
+			header[2] != (uint32_t) params->level ||
+			(header[3] & ~COMPILED_QUIRKS_USED) != flags ||
+			header[4] > header[5] ||
+			header[6] < sizeof(header) || header[6] > len)
+		return CSS_INVALID;
+
+	memset(&r, 0, sizeof(r));
+	r.data = data;
+	r.len = len;
+	r.pos = header[6];
+
+	error = _read_strings(&r, header[5]);
+	if (error != CSS_OK)
+		goto cleanup;
+
+	error = css_stylesheet_create(params, &sheet);
+	if (error != CSS_OK)
+		goto cleanup;
+
+	sheet->quirks_used = (header[3] & COMPILED_QUIRKS_USED) != 0;
+
+	/* Rebuild string vector, so bytecode string numbers are unchanged */
+	for (i = 0; i < header[4] && error == CSS_OK; i++) {
+		uint32_t number;
+
+		error = css__stylesheet_string_add(sheet,
+				lwc_string_ref(r.strings[i]), &number);
+		if (error == CSS_OK && number != i + 1)
+			error = CSS_INVALID;
+	}
+
+	r.pos = sizeof(header);
+	r.end = header[6];
+
+	if (header[7] > (r.end - r.pos) / sizeof(uint32_t))
+		error = CSS_INVALID;
+
+	for (i = 0; i < header[7] && error == CSS_OK; i++)
+		error = _read_rule(&r, sheet, NULL);
+
+	if (error == CSS_OK && r.pos != r.end)
+		error = CSS_INVALID;
+
+	if (error == CSS_OK)
+		error = css__stylesheet_parse_done(sheet);
+
+	if (error != CSS_OK && error != CSS_IMPORTS_PENDING)
+		css_stylesheet_destroy(sheet);
+	else
+		*stylesheet = sheet;
+
+cleanup:
+	for (i = 0; i < r.n_strings; i++)
+		lwc_string_unref(r.strings[i]);
+	css__free(r.strings);
+
+	return error;
+}
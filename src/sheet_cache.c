@@ -0,0 +1,466 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *		  http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+
+#include "stylesheet.h"
+#include "utils/alloc.h"
+#include "utils/utils.h"
+
+/*
+ * Shared stylesheet cache
+ *
+ * Sheets created by css_stylesheet_create_shared() and
+ * css_stylesheet_create_inline() are entered into a table keyed by the
+ * hash of their source data.  A later request for the same source with
+ * the same parameters returns a further reference to the existing sheet
+ * rather than parsing it again.
+ *
+ * In general, the cache holds no reference of its own: an entry lives
+ * exactly as long as its sheet, and is removed when the last reference
+ * is released by css_stylesheet_destroy().  Clients commonly destroy an
+ * inline style as soon as it has been used for selection, however, so
+ * the cache also retains a reference to the most recently requested
+ * inline styles, up to INLINE_CACHE_SIZE of them.
+ *
+ * The table of hash chains doubles in size whenever the number of entries
+ * would exceed it, and is freed when the last entry is removed.
+ *
+ * Like the rest of the library, the cache is not thread-safe: the cache
+ * functions, and css_stylesheet_destroy() on a shared sheet, must not be
+ * called concurrently.
+ */
+
+/* Initial number of hash chains; a power of two */
+#define SHEET_CACHE_MIN_SIZE	64
+
+/* Maximum number of inline styles retained by the cache */
+#define INLINE_CACHE_SIZE	256
+
+struct css_stylesheet_cache_entry {
+	struct css_stylesheet_cache_entry *next;	/**< Next in chain */
+
+	uint32_t hash;			/**< Hash of source data */
+	uint32_t refs;			/**< References to sheet */
+
+	uint8_t *data;			/**< Copy of source data */
+	size_t len;			/**< Length of source data */
+	char *charset;			/**< Charset parameter, or NULL */
+
+	css_stylesheet *sheet;		/**< The shared sheet */
+
+	bool retained;			/**< Whether the cache holds a
+					 * reference to the sheet */
+	struct css_stylesheet_cache_entry *lru_prev;	/**< More recent */
+	struct css_stylesheet_cache_entry *lru_next;	/**< Less recent */
+};
+
+/* Hash chains, indexed by hash & (sheet_cache_size - 1) */
+static css_stylesheet_cache_entry **sheet_cache;
+static uint32_t sheet_cache_size;
+static uint32_t sheet_cache_count;
+
+/* Retained inline styles, most recently used first */
+static css_stylesheet_cache_entry *retained_head;
+static css_stylesheet_cache_entry *retained_tail;
+static uint32_t n_retained;
+
+/* Identity to give the next shared sheet */
+static uint64_t next_shared_id = 1;
+
+/**
+ * Hash a buffer of source data (FNV-1a)
+ *
+ * \param data  Source data
+ * \param len   Length, in bytes, of data
+ * \return Hash value
+ */
+static uint32_t _hash_data(const uint8_t *data, size_t len)
+{
+	uint32_t hash = 0x811c9dc5;
+
+	while (len-- > 0) {
+		hash ^= *data++;
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+/**
+ * Compare two possibly NULL strings for equality
+ */
+static inline bool _str_equal(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return a == b;
+
+	return strcmp(a, b) == 0;
+}
+
+/**
+ * Determine whether a cache entry was created with the given parameters
+ *
+ * \param entry   Entry to test
+ * \param params  Stylesheet parameters
+ * \return true if the entry's sheet was created with \a params
+ */
+static bool _params_match(const css_stylesheet_cache_entry *entry,
+		const css_stylesheet_params *params)
+{
+	const css_stylesheet *sheet = entry->sheet;
+
+	return sheet->level == params->level &&
+			sheet->quirks_allowed == params->allow_quirks &&
+			sheet->inline_style == params->inline_style &&
+			sheet->resolve == params->resolve &&
+			sheet->resolve_pw == params->resolve_pw &&
+			sheet->import == params->import &&
+			sheet->import_pw == params->import_pw &&
+			sheet->color == params->color &&
+			sheet->color_pw == params->color_pw &&
+			sheet->font == params->font &&
+			sheet->font_pw == params->font_pw &&
+			strcmp(sheet->url, params->url) == 0 &&
+			_str_equal(sheet->title, params->title) &&
+			_str_equal(entry->charset, params->charset);
+}
+
+/**
+ * Grow the table of hash chains, if necessary, to accommodate another entry
+ *
+ * \return true if there is a table to insert into, false otherwise
+ *
+ * Failure to grow an existing table isn't fatal; its chains just get longer.
+ */
+static bool _cache_grow(void)
+{
+	css_stylesheet_cache_entry **table;
+	uint32_t size, i;
+
+	if (sheet_cache_count < sheet_cache_size)
+		return true;
+
+	size = sheet_cache_size == 0 ? SHEET_CACHE_MIN_SIZE :
+			sheet_cache_size * 2;
+	table = css__calloc(size, sizeof(css_stylesheet_cache_entry *));
+	if (table == NULL)
+		return sheet_cache != NULL;
+
+	for (i = 0; i < sheet_cache_size; i++) {
+		while (sheet_cache[i] != NULL) {
+			css_stylesheet_cache_entry *entry = sheet_cache[i];
+
+			sheet_cache[i] = entry->next;
+			entry->next = table[entry->hash & (size - 1)];
+			table[entry->hash & (size - 1)] = entry;
+		}
+	}
+
+	css__free(sheet_cache);
+	sheet_cache = table;
+	sheet_cache_size = size;
+
+	return true;
+}
+
+/**
+ * Link a cache entry into the chain for its hash
+ *
+ * \param sheet   The newly created sheet
+ * \param params  Parameters \a sheet was created with
+ * \param data    Source data \a sheet was created from
+ * \param len     Length, in bytes, of data
+ * \param hash    Hash of \a data
+ * \return Pointer to entry, or NULL on memory exhaustion
+ */
+static css_stylesheet_cache_entry *_cache_insert(css_stylesheet *sheet,
+		const css_stylesheet_params *params,
+		const uint8_t *data, size_t len, uint32_t hash)
+{
+	css_stylesheet_cache_entry *entry;
+
+	if (_cache_grow() == false)
+		return NULL;
+
+	entry = css__malloc(sizeof(*entry));
+	if (entry == NULL)
+		return NULL;
+
+	entry->data = css__malloc(len > 0 ? len : 1);
+	if (entry->data == NULL) {
+		css__free(entry);
+		return NULL;
+	}
+	memcpy(entry->data, data, len);
+
+	entry->charset = NULL;
+	if (params->charset != NULL) {
+		entry->charset = css__strdup(params->charset);
+		if (entry->charset == NULL) {
+			css__free(entry->data);
+			css__free(entry);
+			return NULL;
+		}
+	}
+
+	entry->hash = hash;
+	entry->refs = 1;
+	entry->len = len;
+	entry->sheet = sheet;
+	entry->retained = false;
+	entry->lru_prev = NULL;
+	entry->lru_next = NULL;
+
+	entry->next = sheet_cache[hash & (sheet_cache_size - 1)];
+	sheet_cache[hash & (sheet_cache_size - 1)] = entry;
+	sheet_cache_count++;
+
+	sheet->cache_entry = entry;
+	sheet->shared_id = next_shared_id++;
+
+	return entry;
+}
+
+/**
+ * Release the cache's own reference to a sheet
+ *
+ * \param entry  Retained entry to release
+ *
+ * The entry (and its sheet) will be destroyed if there are no other
+ * references to the sheet.
+ */
+static void _unretain(css_stylesheet_cache_entry *entry)
+{
+	if (entry->lru_prev != NULL)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		retained_head = entry->lru_next;
+
+	if (entry->lru_next != NULL)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		retained_tail = entry->lru_prev;
+
+	entry->lru_prev = entry->lru_next = NULL;
+	entry->retained = false;
+	n_retained--;
+
+	css_stylesheet_destroy(entry->sheet);
+}
+
+/**
+ * Make a cache entry the most recently used retained entry
+ *
+ * \param entry  Entry to retain
+ *
+ * If this takes the cache over its limit, the least recently used
+ * retained entry is released.
+ */
+static void _retain(css_stylesheet_cache_entry *entry)
+{
+	if (entry->retained) {
+		if (entry == retained_head)
+			return;
+
+		/* Unlink; entry isn't the head, so has a predecessor */
+		entry->lru_prev->lru_next = entry->lru_next;
+		if (entry->lru_next != NULL)
+			entry->lru_next->lru_prev = entry->lru_prev;
+		else
+			retained_tail = entry->lru_prev;
+	} else {
+		entry->refs++;
+		entry->retained = true;
+		n_retained++;
+	}
+
+	entry->lru_prev = NULL;
+	entry->lru_next = retained_head;
+	if (retained_head != NULL)
+		retained_head->lru_prev = entry;
+	else
+		retained_tail = entry;
+	retained_head = entry;
+
+	if (n_retained > INLINE_CACHE_SIZE)
+		_unretain(retained_tail);
+}
+
+/**
+ * Find or create a shared stylesheet
+ *
+ * \param params      Stylesheet parameters
+ * \param data	      Pointer to stylesheet data
+ * \param len	      Length, in bytes, of data
+ * \param retain      Whether the cache should retain the sheet
+ * \param stylesheet  Pointer to location to receive stylesheet
+ * \return CSS_OK on success,
+ *	   CSS_IMPORTS_PENDING if there are imports pending,
+ *	   appropriate error otherwise
+ */
+static css_error _create_shared(const css_stylesheet_params *params,
+		const uint8_t *data, size_t len, bool retain,
+		css_stylesheet **stylesheet)
+{
+	css_stylesheet_cache_entry *entry;
+	css_stylesheet *sheet;
+	uint32_t hash;
+	css_error error;
+
+	hash = _hash_data(data, len);
+
+	for (entry = sheet_cache != NULL ?
+				sheet_cache[hash & (sheet_cache_size - 1)] : NULL;
+			entry != NULL; entry = entry->next) {
+		if (entry->hash == hash && entry->len == len &&
+				memcmp(entry->data, data, len) == 0 &&
+				_params_match(entry, params)) {
+			entry->refs++;
+			if (retain)
+				_retain(entry);
+			*stylesheet = entry->sheet;
+			return CSS_OK;
+		}
+	}
+
+	error = css_stylesheet_create_from_buffer(params, data, len, &sheet);
+	if (error != CSS_OK) {
+		if (error == CSS_IMPORTS_PENDING)
+			*stylesheet = sheet;
+		return error;
+	}
+
+	/* Failure to share the sheet isn't fatal; the caller simply gets
+	 * an unshared sheet */
+	entry = _cache_insert(sheet, params, data, len, hash);
+	if (entry != NULL && retain)
+		_retain(entry);
+
+	*stylesheet = sheet;
+
+	return CSS_OK;
+}
+
+/**
+ * Create a stylesheet from source data, sharing it with other users of
+ * the same source
+ *
+ * \param params      Stylesheet parameters
+ * \param data	      Pointer to stylesheet data
+ * \param len	      Length, in bytes, of data
+ * \param stylesheet  Pointer to location to receive stylesheet
+ * \return CSS_OK on success,
+ *	   CSS_IMPORTS_PENDING if there are imports pending,
+ *	   appropriate error otherwise
+ *
+ * If a sheet created by this function from identical data and parameters
+ * still exists, a new reference to it is returned.  Otherwise, this is
+ * equivalent to css_stylesheet_create_from_buffer(), and the resulting
+ * sheet is made available to later callers.
+ *
+ * A shared sheet must not be modified (other than by the selection
+ * engine): it may be appended to any number of selection contexts, and
+ * each reference is released with css_stylesheet_destroy().
+ *
+ * Sheets containing @import rules are never shared, as their imports are
+ * registered by the client.  These are returned unshared, with
+ * CSS_IMPORTS_PENDING, exactly as by css_stylesheet_create_from_buffer().
+ */
+css_error css_stylesheet_create_shared(const css_stylesheet_params *params,
+		const uint8_t *data, size_t len,
+		css_stylesheet **stylesheet)
+{
+	/* Parameters must be checked before they're compared with those
+	 * of cached sheets */
+	if (css__stylesheet_params_valid(params) == false || data == NULL ||
+			stylesheet == NULL)
+		return CSS_BADPARM;
+
+	return _create_shared(params, data, len, false, stylesheet);
+}
+
+/**
+ * Create an inline style from the value of a style attribute, sharing it
+ * with other elements with the same attribute value
+ *
+ * \param params      Stylesheet parameters, with inline_style set
+ * \param data	      Pointer to attribute value
+ * \param len	      Length, in bytes, of data
+ * \param stylesheet  Pointer to location to receive stylesheet
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * This behaves as css_stylesheet_create_shared(), except that the cache
+ * also keeps the most recently requested inline styles alive, so that
+ * clients which destroy each inline style after selection still find it
+ * when the same attribute value is next seen.  Use
+ * css_stylesheet_cache_flush() to release them.
+ *
+ * Nodes whose inline styles are the same shared sheet may share their
+ * computed styles in css_select_style().
+ */
+css_error css_stylesheet_create_inline(const css_stylesheet_params *params,
+		const uint8_t *data, size_t len,
+		css_stylesheet **stylesheet)
+{
+	if (css__stylesheet_params_valid(params) == false ||
+			params->inline_style == false ||
+			data == NULL || stylesheet == NULL)
+		return CSS_BADPARM;
+
+	return _create_shared(params, data, len, true, stylesheet);
+}
+
+/**
+ * Release the references the cache holds to inline styles
+ *
+ * \return CSS_OK.
+ *
+ * Inline styles with no other references are destroyed.
+ */
+css_error css_stylesheet_cache_flush(void)
+{
+	while (retained_head != NULL)
+		_unretain(retained_head);
+
+	return CSS_OK;
+}
+
+/**
+ * Release a reference to a shared stylesheet
+ *
+ * \param sheet  The shared stylesheet
+ * \return true if that was the last reference, and the sheet has been
+ *	   removed from the cache, false otherwise
+ */
+bool css__stylesheet_cache_release(css_stylesheet *sheet)
+{
+	css_stylesheet_cache_entry *entry = sheet->cache_entry;
+	css_stylesheet_cache_entry **prev;
+
+	if (--entry->refs > 0)
+		return false;
+
+	for (prev = &sheet_cache[entry->hash & (sheet_cache_size - 1)];
+			*prev != entry; prev = &(*prev)->next)
+		;
+	*prev = entry->next;
+
+	if (--sheet_cache_count == 0) {
+		css__free(sheet_cache);
+		sheet_cache = NULL;
+		sheet_cache_size = 0;
+	}
+
+	if (entry->charset != NULL)
+		css__free(entry->charset);
+	css__free(entry->data);
+	css__free(entry);
+
+	sheet->cache_entry = NULL;
+
+	return true;
+}
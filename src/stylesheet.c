@@ -13,14 +13,129 @@
 #include "bytecode/bytecode.h"
 #include "parse/language.h"
 #include "utils/parserutilserror.h"
+#include "utils/alloc.h"
 #include "utils/utils.h"
 #include "select/dispatch.h"
 #include "select/font_face.h"
+#include "select/select.h"
 
 static css_error _add_selectors(css_stylesheet *sheet, css_rule *rule);
 static css_error _remove_selectors(css_stylesheet *sheet, css_rule *rule);
 static size_t _rule_size(const css_rule *rule);
 
+/**
+ * Insert a string number into a string index
+ *
+ * \param index   Index to insert into
+ * \param length  Number of slots in index (a power of two)
+ * \param string  String being indexed
+ * \param string_number  Number of string
+ */
+void css__string_index_insert(uint32_t *index, uint32_t length,
+		lwc_string *string, uint32_t string_number)
+{
+	uint32_t slot = lwc_string_hash_value(string) & (length - 1);
+
+	while (index[slot] != 0)
+		slot = (slot + 1) & (length - 1);
+
+	index[slot] = string_number;
+}
+
+/**
+ * Find a string's number in a string index
+ *
+ * \param index    Index to search, or NULL if empty
+ * \param length   Number of slots in index (a power of two)
+ * \param strings  Indexed strings, by number - 1
+ * \param string   String to find
+ * \return Number of string, or 0 if it is not indexed
+ *
+ * Interned strings are equal iff they are the same object, so the
+ * strings are compared by address.
+ */
+uint32_t css__string_index_find(const uint32_t *index, uint32_t length,
+		lwc_string *const *strings, lwc_string *string)
+{
+	uint32_t mask = length - 1;
+	uint32_t slot;
+
+	if (index == NULL)
+		return 0;
+
+	for (slot = lwc_string_hash_value(string) & mask; index[slot] != 0;
+			slot = (slot + 1) & mask) {
+		if (strings[index[slot] - 1] == string)
+			return index[slot];
+	}
+
+	return 0;
+}
+
+/**
+ * Grow a string index, if necessary, to accommodate another string
+ *
+ * \param index    Pointer to index, updated on growth
+ * \param length   Pointer to number of slots in index, updated on growth
+ * \param strings  Indexed strings, by number - 1
+ * \param count    Number of indexed strings
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ */
+css_error css__string_index_grow(uint32_t **index, uint32_t *length,
+		lwc_string *const *strings, uint32_t count)
+{
+	uint32_t *new_index;
+	uint32_t new_length;
+	uint32_t i;
+
+	/* Keep the index at most half full */
+	if ((count + 1) * 2 <= *length)
+		return CSS_OK;
+
+	new_length = *length == 0 ? 512 : *length * 2;
+	new_index = css__calloc(new_length, sizeof(uint32_t));
+	if (new_index == NULL)
+		return CSS_NOMEM;
+
+	for (i = 0; i < count; i++)
+		css__string_index_insert(new_index, new_length, strings[i],
+				i + 1);
+
+	css__free(*index);
+	*index = new_index;
+	*length = new_length;
+
+	return CSS_OK;
+}
+
+/**
+ * Grow a stylesheet's string vector and index to accommodate another string
+ *
+ * \param sheet  The stylesheet to grow storage of
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ */
+static css_error _string_vector_grow(css_stylesheet *sheet)
+{
+	if (sheet->string_vector_c >= sheet->string_vector_l) {
+		lwc_string **new_vector;
+		uint32_t new_vector_len;
+
+		new_vector_len = sheet->string_vector_l == 0 ? 256 :
+				sheet->string_vector_l * 2;
+		new_vector = css__realloc(sheet->string_vector,
+				new_vector_len * sizeof(lwc_string *));
+		if (new_vector == NULL)
+			return CSS_NOMEM;
+
+		sheet->string_vector = new_vector;
+		sheet->string_vector_l = new_vector_len;
+	}
+
+	return css__string_index_grow(&sheet->string_index,
+			&sheet->string_index_l, sheet->string_vector,
+			sheet->string_vector_c);
+}
+
 /**
  * Add a string to a stylesheet's string vector.
  *
@@ -36,55 +151,30 @@ static size_t _rule_size(const css_rule *rule);
  */
 css_error css__stylesheet_string_add(css_stylesheet *sheet, lwc_string *string, uint32_t *string_number)
 {
-	uint32_t new_string_number; /* The string number count */
-
-	/* search for the string in the existing vector */
-	for (new_string_number = 0; 
-	     new_string_number < sheet->string_vector_c;
-	     new_string_number++) {
-		lwc_error res;
-		bool isequal;
-		res = lwc_string_isequal(string, 
-					 sheet->string_vector[new_string_number], 
-					 &isequal);
-
-		if (res != lwc_error_ok) {
-			lwc_string_unref(string);			
-			return css_error_from_lwc_error(res);
-		}
+	uint32_t number;
+	css_error error;
 
-		if (isequal) {
-			lwc_string_unref(string);			
-			*string_number = (new_string_number + 1);
-			return CSS_OK;
-		}
-		 
+	/* search for the string in the index */
+	number = css__string_index_find(sheet->string_index,
+			sheet->string_index_l, sheet->string_vector, string);
+	if (number != 0) {
+		lwc_string_unref(string);
+		*string_number = number;
+		return CSS_OK;
 	}
 
 	/* string does not exist in current vector, add a new one */
-
-	if (sheet->string_vector_c >= sheet->string_vector_l) {
-		/* additional storage must be allocated to deal with
-		 * this request. 
-		 */
-		lwc_string **new_vector;
-		uint32_t new_vector_len;
-
-		new_vector_len = sheet->string_vector_l + 256;
-		new_vector = realloc(sheet->string_vector,
-				new_vector_len * sizeof(lwc_string *));
-
-		if (new_vector == NULL) {
-			lwc_string_unref(string);			
-			return CSS_NOMEM;
-		}
-		sheet->string_vector = new_vector;
-		sheet->string_vector_l = new_vector_len;
+	error = _string_vector_grow(sheet);
+	if (error != CSS_OK) {
+		lwc_string_unref(string);
+		return error;
 	}
 
+	sheet->string_vector[sheet->string_vector_c] = string;
 	sheet->string_vector_c++;
-	sheet->string_vector[new_string_number] = string;
-	*string_number = (new_string_number + 1);
+	css__string_index_insert(sheet->string_index, sheet->string_index_l,
+			string, sheet->string_vector_c);
+	*string_number = sheet->string_vector_c;
 
 	return CSS_OK;
 }
@@ -104,7 +194,7 @@ css_error css__stylesheet_string_get(css_stylesheet *sheet,
 	/* External string numbers = index into vector + 1 */
 	string_number--;
 
-	if (string_number > sheet->string_vector_c) {
+	if (string_number >= sheet->string_vector_c) {
 		return CSS_BADPARM;
 	}
 
@@ -112,6 +202,20 @@ css_error css__stylesheet_string_get(css_stylesheet *sheet,
 	return CSS_OK;
 }
 
+/**
+ * Determine whether stylesheet parameters are valid
+ *
+ * \param params  Stylesheet parameters, or NULL
+ * \return true if a stylesheet may be created with \a params
+ */
+bool css__stylesheet_params_valid(const css_stylesheet_params *params)
+{
+	return params != NULL &&
+			params->params_version ==
+				CSS_STYLESHEET_PARAMS_VERSION_1 &&
+			params->url != NULL && params->resolve != NULL;
+}
+
 /**
  * Create a stylesheet
  *
@@ -128,19 +232,17 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 	css_error error;
 	css_stylesheet *sheet;
 
-	if (params == NULL || params->params_version != 
-				CSS_STYLESHEET_PARAMS_VERSION_1 ||
-			params->url == NULL || params->resolve == NULL ||
+	if (css__stylesheet_params_valid(params) == false ||
 			stylesheet == NULL)
 		return CSS_BADPARM;
 
-	sheet = calloc(1, sizeof(css_stylesheet));
+	sheet = css__calloc(1, sizeof(css_stylesheet));
 	if (sheet == NULL)
 		return CSS_NOMEM;
 
 	error = css__propstrings_get(&sheet->propstrings);
 	if (error != CSS_OK) {
-		free(sheet);
+		css__free(sheet);
 		return error;
 	}
 	
@@ -160,7 +262,7 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 
 	if (error != CSS_OK) {
 		css__propstrings_unref();
-		free(sheet);
+		css__free(sheet);
 		return error;
 	}
 
@@ -174,7 +276,7 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 		if (error != CSS_OK) {
 			css__parser_destroy(sheet->parser);
 			css__propstrings_unref();
-			free(sheet);
+			css__free(sheet);
 			return error;
 		}
 	}
@@ -185,38 +287,39 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 	if (error != CSS_OK) {
 		css__parser_destroy(sheet->parser);
 		css__propstrings_unref();
-		free(sheet);
+		css__free(sheet);
 		return error;
 	}
 
-	error = css__selector_hash_create(&sheet->selectors);
+	error = css__selector_hash_create(sheet->propstrings,
+			&sheet->selectors);
 	if (error != CSS_OK) {
 		css__language_destroy(sheet->parser_frontend);
 		css__parser_destroy(sheet->parser);
 		css__propstrings_unref();
-		free(sheet);
+		css__free(sheet);
 		return error;
 	}
 
-	sheet->url = strdup(params->url);
+	sheet->url = css__strdup(params->url);
 	if (sheet->url == NULL) {
 		css__selector_hash_destroy(sheet->selectors);
 		css__language_destroy(sheet->parser_frontend);
 		css__parser_destroy(sheet->parser);
 		css__propstrings_unref();
-		free(sheet);
+		css__free(sheet);
 		return CSS_NOMEM;
 	}
 
 	if (params->title != NULL) {
-		sheet->title = strdup(params->title);
+		sheet->title = css__strdup(params->title);
 		if (sheet->title == NULL) {
-			free(sheet->url);
+			css__free(sheet->url);
 			css__selector_hash_destroy(sheet->selectors);
 			css__language_destroy(sheet->parser_frontend);
 			css__parser_destroy(sheet->parser);
 			css__propstrings_unref();
-			free(sheet);
+			css__free(sheet);
 			return CSS_NOMEM;
 		}
 	}
@@ -242,11 +345,95 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 	return CSS_OK;
 }
 
+/**
+ * Create a stylesheet from a complete buffer of source data
+ *
+ * \param params      Stylesheet parameters
+ * \param data	      Pointer to stylesheet data
+ * \param len	      Length, in bytes, of data
+ * \param stylesheet  Pointer to location to receive stylesheet
+ * \return CSS_OK on success,
+ *	   CSS_IMPORTS_PENDING if there are imports pending,
+ *	   appropriate error otherwise
+ *
+ * This is equivalent to css_stylesheet_create(), followed by
+ * css_stylesheet_append_data() for all the data, then
+ * css_stylesheet_data_done().  Data in UTF-8 is passed to the lexer
+ * without being copied and converted by the input stream.
+ *
+ * On CSS_IMPORTS_PENDING, \a stylesheet is valid, and the client must
+ * process its imports as it would after css_stylesheet_data_done().
+ */
+css_error css_stylesheet_create_from_buffer(
+		const css_stylesheet_params *params,
+		const uint8_t *data, size_t len,
+		css_stylesheet **stylesheet)
+{
+	return css_stylesheet_create_parallel(params, data, len, 1, 
+			stylesheet);
+}
+
+/**
+ * Create a stylesheet from a complete buffer of source data, lexing it 
+ * in several threads
+ *
+ * \param params      Stylesheet parameters
+ * \param data	      Pointer to stylesheet data
+ * \param len	      Length, in bytes, of data
+ * \param n_threads   Maximum number of threads to use, including the 
+ *                    calling thread
+ * \param stylesheet  Pointer to location to receive stylesheet
+ * \return CSS_OK on success,
+ *	   CSS_IMPORTS_PENDING if there are imports pending,
+ *	   appropriate error otherwise
+ *
+ * This is css_stylesheet_create_from_buffer(), except that UTF-8 data is 
+ * split at the ends of top-level blocks, and the pieces after the first 
+ * are lexed by threads of their own.  Parsing remains in the calling 
+ * thread, so the resulting stylesheet is identical.  The allocator need 
+ * not be thread-safe.
+ *
+ * If \a n_threads is less than 2, or LibCSS was built without thread 
+ * support, this is the same as css_stylesheet_create_from_buffer().
+ */
+css_error css_stylesheet_create_parallel(
+		const css_stylesheet_params *params,
+		const uint8_t *data, size_t len, uint32_t n_threads,
+		css_stylesheet **stylesheet)
+{
+	css_stylesheet *sheet;
+	css_error error;
+
+	if (data == NULL || stylesheet == NULL)
+		return CSS_BADPARM;
+
+	error = css_stylesheet_create(params, &sheet);
+	if (error != CSS_OK)
+		return error;
+
+	error = css__parser_parse_buffer_parallel(sheet->parser, data, len,
+			n_threads);
+	if (error == CSS_OK)
+		error = css__stylesheet_parse_done(sheet);
+
+	if (error != CSS_OK && error != CSS_IMPORTS_PENDING) {
+		css_stylesheet_destroy(sheet);
+		return error;
+	}
+
+	*stylesheet = sheet;
+
+	return error;
+}
+
 /**
  * Destroy a stylesheet
  *
  * \param sheet	 The stylesheet to destroy
  * \return CSS_OK on success, appropriate error otherwise
+ *
+ * For a sheet created by css_stylesheet_create_shared(), this releases
+ * one reference; the sheet is destroyed with the last of them.
  */
 css_error css_stylesheet_destroy(css_stylesheet *sheet)
 {
@@ -255,11 +442,15 @@ css_error css_stylesheet_destroy(css_stylesheet *sheet)
 
 	if (sheet == NULL)
 		return CSS_BADPARM;
+
+	if (sheet->cache_entry != NULL &&
+			css__stylesheet_cache_release(sheet) == false)
+		return CSS_OK;
 	
 	if (sheet->title != NULL)
-		free(sheet->title);
+		css__free(sheet->title);
 
-	free(sheet->url);
+	css__free(sheet->url);
         
 	for (r = sheet->rule_list; r != NULL; r = s) {
 		s = r->next;
@@ -284,17 +475,23 @@ css_error css_stylesheet_destroy(css_stylesheet *sheet)
 	if (sheet->cached_style != NULL)
 		css__stylesheet_style_destroy(sheet->cached_style);
 
+	if (sheet->bytecode_pool != NULL)
+		css__free(sheet->bytecode_pool);
+
 	/* destroy string vector */
 	for (index = 0; index < sheet->string_vector_c; index++) {
 		lwc_string_unref(sheet->string_vector[index]);		
 	}
 
 	if (sheet->string_vector != NULL)
-		free(sheet->string_vector);
+		css__free(sheet->string_vector);
+
+	if (sheet->string_index != NULL)
+		css__free(sheet->string_index);
 
 	css__propstrings_unref();
 	
-	free(sheet);
+	css__free(sheet);
 
 	return CSS_OK;
 }
@@ -329,7 +526,6 @@ css_error css_stylesheet_append_data(css_stylesheet *sheet,
  */
 css_error css_stylesheet_data_done(css_stylesheet *sheet)
 {
-	const css_rule *r;
 	css_error error;
 
 	if (sheet == NULL)
@@ -342,6 +538,20 @@ css_error css_stylesheet_data_done(css_stylesheet *sheet)
 	if (error != CSS_OK)
 		return error;
 
+	return css__stylesheet_parse_done(sheet);
+}
+
+/**
+ * Tidy up once a stylesheet's parser has seen all of its data
+ *
+ * \param sheet	 The stylesheet in question
+ * \return CSS_OK on success,
+ *	   CSS_IMPORTS_PENDING if there are imports pending
+ */
+css_error css__stylesheet_parse_done(css_stylesheet *sheet)
+{
+	const css_rule *r;
+
 	/* Destroy the parser, as it's no longer needed */
 	css__language_destroy(sheet->parser_frontend);
 	css__parser_destroy(sheet->parser);
@@ -355,6 +565,13 @@ css_error css_stylesheet_data_done(css_stylesheet *sheet)
 		sheet->cached_style = NULL;
 	}
 
+	/* Move the styles' bytecode into the pool.  Failure isn't fatal;
+	 * the styles simply keep their own bytecode. */
+	css__stylesheet_pool_styles(sheet);
+
+	/* Prepare the styles for the cascade */
+	css__select_prepare_styles(sheet);
+
 	/* Determine if there are any pending imports */
 	for (r = sheet->rule_list; r != NULL; r = r->next) {
 		const css_rule_import *i = (const css_rule_import *) r;
@@ -645,25 +862,35 @@ css_error css__stylesheet_style_create(css_stylesheet *sheet, css_style **style)
 		return CSS_BADPARM;
 	
 	if (sheet->cached_style != NULL) {
-		*style = sheet->cached_style;
+		s = sheet->cached_style;
 		sheet->cached_style = NULL;
+
+		memset(s->props, 0xff, sizeof(s->props));
+		memset(s->important, 0xff, sizeof(s->important));
+		s->cascades = 0;
+
+		*style = s;
 		return CSS_OK;
 	}
 	
-	s = malloc(sizeof(css_style));
+	s = css__malloc(sizeof(css_style));
 	if (s == NULL)
 		return CSS_NOMEM;
 
-	s->bytecode = malloc(sizeof(css_code_t) * CSS_STYLE_DEFAULT_SIZE);
+	s->bytecode = css__malloc(sizeof(css_code_t) * CSS_STYLE_DEFAULT_SIZE);
 
 	if (s->bytecode == NULL) {
-		free(s); /* do not leak */
+		css__free(s); /* do not leak */
 	
 		return CSS_NOMEM;
 	}
 	s->allocated = CSS_STYLE_DEFAULT_SIZE;
 	s->used = 0;
 	s->sheet = sheet;
+	memset(s->props, 0xff, sizeof(s->props));
+	memset(s->important, 0xff, sizeof(s->important));
+	s->decoded = NULL;
+	s->cascades = 0;
 
 	*style = s;
 
@@ -683,7 +910,7 @@ css_error css__stylesheet_merge_style(css_style *target, css_style *style)
 	if (newcode_len > target->allocated) {
 		newcode_len += CSS_STYLE_DEFAULT_SIZE - 1;
 		newcode_len &= ~(CSS_STYLE_DEFAULT_SIZE - 1);
-		newcode = realloc(target->bytecode,
+		newcode = css__realloc(target->bytecode,
 				newcode_len * sizeof(css_code_t));
 
 		if (newcode == NULL)
@@ -731,7 +958,7 @@ css_error css__stylesheet_style_append(css_style *style, css_code_t css_code)
 		/* space not available to append, extend allocation */
 		css_code_t *newcode;
 		uint32_t newcode_len = style->allocated * 2;
-		newcode = realloc(style->bytecode,
+		newcode = css__realloc(style->bytecode,
 				sizeof(css_code_t) * newcode_len);
 		if (newcode == NULL)
 			return CSS_NOMEM;
@@ -761,17 +988,28 @@ css_error css__stylesheet_style_destroy(css_style *style)
 
 	sheet = style->sheet;
 
+	if (style->decoded != NULL) {
+		css__free(style->decoded);
+		style->decoded = NULL;
+	}
+
+	/* Pooled bytecode belongs to the sheet */
+	if (style->allocated == 0) {
+		css__free(style);
+		return CSS_OK;
+	}
+
 	if (sheet->cached_style == NULL) {
 		sheet->cached_style = style;
 		style->used = 0;
 	} else if (sheet->cached_style->allocated < style->allocated) {
-		free(sheet->cached_style->bytecode);
-		free(sheet->cached_style);
+		css__free(sheet->cached_style->bytecode);
+		css__free(sheet->cached_style);
 		sheet->cached_style = style;
 		style->used = 0;
 	} else {
-		free(style->bytecode);
-		free(style);
+		css__free(style->bytecode);
+		css__free(style);
 	}
 	
 	return CSS_OK;
@@ -796,7 +1034,7 @@ css_error css__stylesheet_selector_create(css_stylesheet *sheet,
 			selector == NULL)
 		return CSS_BADPARM;
 
-	sel = malloc(sizeof(css_selector));
+	sel = css__malloc(sizeof(css_selector));
 	if (sel == NULL)
 		return CSS_NOMEM;
 
@@ -869,7 +1107,7 @@ css_error css__stylesheet_selector_destroy(css_stylesheet *sheet,
 				detail = NULL;
 		}
 		
-		free(c);
+		css__free(c);
 	}
 	
 	for (detail = &selector->data; detail;) {
@@ -890,7 +1128,7 @@ css_error css__stylesheet_selector_destroy(css_stylesheet *sheet,
 		     
 	
 	/* Destroy this selector */
-	free(selector);
+	css__free(selector);
 
 	return CSS_OK;
 }
@@ -960,7 +1198,7 @@ css_error css__stylesheet_selector_append_specific(css_stylesheet *sheet,
 		num_details++;
 
 	/* Grow selector by one detail block */
-	temp = realloc((*parent), sizeof(css_selector) +
+	temp = css__realloc((*parent), sizeof(css_selector) +
 			(num_details + 1) * sizeof(css_selector_detail));
 	if (temp == NULL)
 		return CSS_NOMEM;
@@ -1089,7 +1327,7 @@ css_error css__stylesheet_rule_create(css_stylesheet *sheet, css_rule_type type,
 		break;
 	}
 
-	r = malloc(required);
+	r = css__malloc(required);
 	if (r == NULL)
 		return CSS_NOMEM;
 
@@ -1137,7 +1375,7 @@ css_error css__stylesheet_rule_destroy(css_stylesheet *sheet, css_rule *rule)
 		}
 
 		if (s->selectors != NULL)
-			free(s->selectors);
+			css__free(s->selectors);
 
 		if (s->style != NULL)
 			css__stylesheet_style_destroy(s->style);
@@ -1146,14 +1384,17 @@ css_error css__stylesheet_rule_destroy(css_stylesheet *sheet, css_rule *rule)
 	case CSS_RULE_CHARSET:
 	{
 		css_rule_charset *charset = (css_rule_charset *) rule;
-		lwc_string_unref(charset->encoding);
+
+		if (charset->encoding != NULL)
+			lwc_string_unref(charset->encoding);
 	}
 		break;
 	case CSS_RULE_IMPORT:
 	{
 		css_rule_import *import = (css_rule_import *) rule;
 		
-		lwc_string_unref(import->url);
+		if (import->url != NULL)
+			lwc_string_unref(import->url);
 		
 		/* Do not destroy imported sheet: it is owned by the client */
 	}
@@ -1199,7 +1440,7 @@ css_error css__stylesheet_rule_destroy(css_stylesheet *sheet, css_rule *rule)
 	}
 
 	/* Destroy rule */
-	free(rule);
+	css__free(rule);
 
 	return CSS_OK;
 }
@@ -1224,7 +1465,7 @@ css_error css__stylesheet_rule_add_selector(css_stylesheet *sheet,
 	/* Ensure rule is a CSS_RULE_SELECTOR */
 	assert(rule->type == CSS_RULE_SELECTOR);
 
-	sels = realloc(r->selectors,
+	sels = css__realloc(r->selectors,
 			(r->base.items + 1) * sizeof(css_selector *));
 	if (sels == NULL)
 		return CSS_NOMEM;
@@ -1271,6 +1512,9 @@ css_error css__stylesheet_rule_append_style(css_stylesheet *sheet,
 		if (error != CSS_OK)
 			return error;
 
+		/* Add to the sheet's size */
+		sheet->size += (style->used * sizeof(css_code_t));
+
 		/* Done with style */
 		css__stylesheet_style_destroy(style);
 	} else {
@@ -1490,15 +1734,29 @@ css_error css__stylesheet_remove_rule(css_stylesheet *sheet, css_rule *rule)
 	/* Reduce sheet's size */
 	sheet->size -= _rule_size(rule);
 
-	if (rule->next == NULL)
-		sheet->last_rule = rule->prev;
-	else
-		rule->next->prev = rule->prev;
+	if (rule->ptype == CSS_RULE_PARENT_RULE) {
+		css_rule_media *media = (css_rule_media *) rule->parent;
 
-	if (rule->prev == NULL)
-		sheet->rule_list = rule->next;
-	else
-		rule->prev->next = rule->next;
+		if (rule->next == NULL)
+			media->last_child = rule->prev;
+		else
+			rule->next->prev = rule->prev;
+
+		if (rule->prev == NULL)
+			media->first_child = rule->next;
+		else
+			rule->prev->next = rule->next;
+	} else {
+		if (rule->next == NULL)
+			sheet->last_rule = rule->prev;
+		else
+			rule->next->prev = rule->prev;
+
+		if (rule->prev == NULL)
+			sheet->rule_list = rule->next;
+		else
+			rule->prev->next = rule->next;
+	}
 
 	/* Invalidate linkage fields */
 	rule->parent = NULL;
@@ -1714,3 +1972,209 @@ size_t _rule_size(const css_rule *r)
 
 	return bytes;
 }
+
+/**
+ * Hash a style's bytecode (FNV-1a, by word)
+ *
+ * \param style  Style to hash
+ * \return Hash value
+ */
+static uint32_t _style_hash(const css_style *style)
+{
+	uint32_t hash = 0x811c9dc5;
+	uint32_t i;
+
+	for (i = 0; i < style->used; i++) {
+		hash ^= style->bytecode[i];
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+/**
+ * Move the bytecode of a sheet's styles into a single pool
+ *
+ * \param sheet  Stylesheet whose parsing is complete
+ *
+ * Each style's bytecode becomes an exact-size slice of the pool, and
+ * styles with identical bytecode share a slice.  The bytecode must not
+ * be modified until css__stylesheet_unpool_styles() has been called.  On
+ * memory exhaustion, the styles are left with their own bytecode.
+ */
+void css__stylesheet_pool_styles(css_stylesheet *sheet)
+{
+	css_style **styles = NULL;
+	uint32_t *canonical = NULL;
+	uint32_t *table = NULL;
+	uint32_t n_styles = 0, n_slots = 1, i;
+	size_t total = 0, unique = 0;
+	css_rule *r;
+
+	for (r = sheet->rule_list; r != NULL; r = css__rule_next(r)) {
+		css_style *style = css__rule_style(r);
+
+		if (style != NULL && style->used > 0 && style->allocated > 0)
+			n_styles++;
+	}
+
+	if (n_styles == 0)
+		return;
+
+	while (n_slots < n_styles * 2)
+		n_slots <<= 1;
+
+	styles = css__malloc(n_styles * sizeof(css_style *));
+	canonical = css__malloc(n_styles * sizeof(uint32_t));
+	table = css__calloc(n_slots, sizeof(uint32_t));
+	if (styles == NULL || canonical == NULL || table == NULL)
+		goto cleanup;
+
+	/* Find the first style with the same bytecode as each style.  The
+	 * table holds style indices plus one, keyed by bytecode hash. */
+	n_styles = 0;
+	for (r = sheet->rule_list; r != NULL; r = css__rule_next(r)) {
+		css_style *style = css__rule_style(r);
+		uint32_t slot;
+
+		if (style == NULL || style->used == 0 || style->allocated == 0)
+			continue;
+
+		styles[n_styles] = style;
+		canonical[n_styles] = n_styles;
+
+		for (slot = _style_hash(style) & (n_slots - 1);
+				table[slot] != 0;
+				slot = (slot + 1) & (n_slots - 1)) {
+			const css_style *other = styles[table[slot] - 1];
+
+			if (other->used == style->used &&
+					memcmp(other->bytecode, style->bytecode,
+					style->used * sizeof(css_code_t)) == 0) {
+				canonical[n_styles] = table[slot] - 1;
+				break;
+			}
+		}
+
+		if (canonical[n_styles] == n_styles) {
+			table[slot] = n_styles + 1;
+			unique += style->used;
+		}
+
+		total += style->used;
+		n_styles++;
+	}
+
+	sheet->bytecode_pool = css__malloc(unique * sizeof(css_code_t));
+	if (sheet->bytecode_pool == NULL)
+		goto cleanup;
+
+	/* Copy each distinct block into the pool, and point every style at
+	 * its block.  Canonical styles precede their duplicates, so each
+	 * duplicate's canonical entry has been replaced by the offset of
+	 * its block by the time the duplicate is reached. */
+	unique = 0;
+	for (i = 0; i < n_styles; i++) {
+		css_style *style = styles[i];
+
+		if (canonical[i] == i) {
+			memcpy(sheet->bytecode_pool + unique, style->bytecode,
+					style->used * sizeof(css_code_t));
+			canonical[i] = unique;
+			unique += style->used;
+		} else {
+			canonical[i] = canonical[canonical[i]];
+		}
+
+		css__free(style->bytecode);
+		style->bytecode = sheet->bytecode_pool + canonical[i];
+		style->allocated = 0;
+	}
+
+	sheet->bytecode_pool_l = unique;
+	sheet->size -= (total - unique) * sizeof(css_code_t);
+
+cleanup:
+	if (table != NULL)
+		css__free(table);
+	if (canonical != NULL)
+		css__free(canonical);
+	if (styles != NULL)
+		css__free(styles);
+}
+
+/**
+ * Give each of a sheet's styles its own bytecode again
+ *
+ * \param sheet  Stylesheet whose styles have been pooled
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ *
+ * This undoes css__stylesheet_pool_styles(), so that the styles' bytecode
+ * may be modified.  On failure, the styles are left as they were.
+ */
+css_error css__stylesheet_unpool_styles(css_stylesheet *sheet)
+{
+	css_code_t **buffers;
+	uint32_t n_styles = 0, i;
+	size_t total = 0;
+	css_rule *r;
+
+	if (sheet->bytecode_pool == NULL)
+		return CSS_OK;
+
+	for (r = sheet->rule_list; r != NULL; r = css__rule_next(r)) {
+		css_style *style = css__rule_style(r);
+
+		if (style != NULL && style->allocated == 0)
+			n_styles++;
+	}
+
+	buffers = css__malloc((n_styles > 0 ? n_styles : 1) *
+			sizeof(css_code_t *));
+	if (buffers == NULL)
+		return CSS_NOMEM;
+
+	/* Allocate everything before changing anything */
+	i = 0;
+	for (r = sheet->rule_list; r != NULL; r = css__rule_next(r)) {
+		css_style *style = css__rule_style(r);
+
+		if (style == NULL || style->allocated != 0)
+			continue;
+
+		buffers[i] = css__malloc(style->used * sizeof(css_code_t));
+		if (buffers[i] == NULL) {
+			while (i > 0)
+				css__free(buffers[--i]);
+			css__free(buffers);
+			return CSS_NOMEM;
+		}
+		i++;
+	}
+
+	i = 0;
+	for (r = sheet->rule_list; r != NULL; r = css__rule_next(r)) {
+		css_style *style = css__rule_style(r);
+
+		if (style == NULL || style->allocated != 0)
+			continue;
+
+		memcpy(buffers[i], style->bytecode,
+				style->used * sizeof(css_code_t));
+		style->bytecode = buffers[i];
+		style->allocated = style->used;
+		total += style->used;
+		i++;
+	}
+
+	css__free(buffers);
+
+	/* Restore the bytes which sharing saved */
+	sheet->size += (total - sheet->bytecode_pool_l) * sizeof(css_code_t);
+
+	css__free(sheet->bytecode_pool);
+	sheet->bytecode_pool = NULL;
+	sheet->bytecode_pool_l = 0;
+
+	return CSS_OK;
+}
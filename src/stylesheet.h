@@ -25,11 +25,62 @@
 typedef struct css_rule css_rule;
 typedef struct css_selector css_selector;
 
+/**
+ * Declaration of a pre-decoded style
+ *
+ * Declarations of properties held in the normal block of a computed style
+ * are decoded once, into the bytes they store in the block.  Any others
+ * refer back to their bytecode.
+ */
+typedef struct css_decoded_decl {
+	uint16_t prop;		/**< Property */
+	uint8_t flags;		/**< CSS_DECODED_* flags */
+	uint8_t n_spans;	/**< Number of spans, if decoded */
+	uint32_t index;		/**< Index of first span, if decoded, or
+				 * of declaration's OPV in bytecode */
+} css_decoded_decl;
+
+#define CSS_DECODED_IMPORTANT	(1 << 0)
+#define CSS_DECODED_INHERIT	(1 << 1)
+#define CSS_DECODED_BYTECODE	(1 << 2)
+
+/**
+ * Bits stored in one 32-bit word of a computed style's normal block
+ */
+typedef struct css_decoded_span {
+	uint32_t offset;	/**< Byte offset of word in block */
+	uint32_t mask;		/**< Bits stored */
+	uint32_t value;		/**< Value of those bits */
+} css_decoded_span;
+
+/**
+ * Pre-decoded form of a style, in a single allocation
+ */
+typedef struct css_decoded_style {
+	uint32_t n_decls;		/**< Number of declarations */
+	const css_decoded_decl *decls;	/**< Declarations, in order */
+	const css_decoded_span *spans;	/**< Spans of decoded ones */
+} css_decoded_style;
+
 typedef struct css_style {
 	css_code_t *bytecode;	      /**< Pointer to bytecode */
 	uint32_t used;		      /**< number of code entries used */
-	uint32_t allocated;	      /**< number of allocated code entries */
+	uint32_t allocated;	      /**< number of allocated code entries,
+				       * or 0 if bytecode is a slice of the
+				       * sheet's bytecode pool */
 	struct css_stylesheet *sheet; /**< containing sheet */
+
+	/** Properties set by normal declarations.  Until the sheet has
+	 * been parsed, every bit is set. */
+	uint32_t props[CSS_PROP_BITMAP_WORDS];
+	/** Properties set by !important declarations, likewise */
+	uint32_t important[CSS_PROP_BITMAP_WORDS];
+
+	/** Pre-decoded form, or NULL to use the bytecode.  Built during
+	 * selection, so not counted in the sheet's size. */
+	css_decoded_style *decoded;
+	/** Number of times cascaded, until decoded */
+	uint32_t cascades;
 } css_style;
 
 typedef enum css_selector_type {
@@ -116,8 +167,9 @@ struct css_rule {
 	css_rule *next;				/**< next in list */
 	css_rule *prev;				/**< previous in list */
 
+	uint32_t index;				/**< index in sheet */
+
 	unsigned int type  :  4,		/**< css_rule_type */
-		     index : 16,		/**< index in sheet */
 		     items :  8,		/**< # items in rule */
 		     ptype :  1;		/**< css_rule_parent_type */
 } _ALIGNED;
@@ -166,6 +218,8 @@ typedef struct css_rule_charset {
 	lwc_string *encoding;	/** \todo use MIB enum? */
 } css_rule_charset;
 
+typedef struct css_stylesheet_cache_entry css_stylesheet_cache_entry;
+
 struct css_stylesheet {
 	css_selector_hash *selectors;		/**< Hashtable of selectors */
 
@@ -205,14 +259,72 @@ struct css_stylesheet {
 	void *font_pw;				/**< Private word */
   
 	css_style *cached_style;		/**< Cache for style parsing */
+
+	css_code_t *bytecode_pool;		/**< Bytecode of all styles, once
+						 * parsing is complete */
+	size_t bytecode_pool_l;			/**< Length of pool, in code
+						 * entries */
   
 	lwc_string **string_vector;             /**< Bytecode string vector */
 	uint32_t string_vector_l;               /**< The string vector allocated
 						 * length in entries */
 	uint32_t string_vector_c;               /**< The number of string 
 						 * vector entries used */ 
+	uint32_t *string_index;			/**< Open addressed table of
+						 * string numbers, keyed by
+						 * string hash */
+	uint32_t string_index_l;		/**< Number of slots in string
+						 * index; a power of two */
+
+	css_stylesheet_cache_entry *cache_entry;	/**< Shared sheet cache entry,
+						 * or NULL if not shared */
+	uint64_t shared_id;			/**< Unique identity of shared
+						 * sheet, or 0 if not shared */
 };
 
+/**
+ * Find the style of a rule, if it has one
+ *
+ * \param r  Rule to consider
+ * \return Pointer to style, or NULL if none
+ */
+static inline css_style *css__rule_style(css_rule *r)
+{
+	if (r->type == CSS_RULE_SELECTOR)
+		return ((css_rule_selector *) r)->style;
+	else if (r->type == CSS_RULE_PAGE)
+		return ((css_rule_page *) r)->style;
+
+	return NULL;
+}
+
+/**
+ * Find the rule following a rule in a sheet, descending into @media blocks
+ *
+ * \param r  Rule to consider
+ * \return Pointer to next rule, or NULL if none
+ */
+static inline css_rule *css__rule_next(css_rule *r)
+{
+	if (r->type == CSS_RULE_MEDIA &&
+			((css_rule_media *) r)->first_child != NULL)
+		return ((css_rule_media *) r)->first_child;
+
+	if (r->next == NULL && r->ptype == CSS_RULE_PARENT_RULE)
+		return ((css_rule *) r->parent)->next;
+
+	return r->next;
+}
+
+css_error css__stylesheet_parse_done(css_stylesheet *sheet);
+
+void css__stylesheet_pool_styles(css_stylesheet *sheet);
+css_error css__stylesheet_unpool_styles(css_stylesheet *sheet);
+
+bool css__stylesheet_cache_release(css_stylesheet *sheet);
+
+bool css__stylesheet_params_valid(const css_stylesheet_params *params);
+
 css_error css__stylesheet_style_create(css_stylesheet *sheet, 
 		css_style **style);
 css_error css__stylesheet_style_append(css_style *style, css_code_t code);
@@ -286,5 +398,12 @@ css_error css__stylesheet_string_get(css_stylesheet *sheet,
 css_error css__stylesheet_string_add(css_stylesheet *sheet, 
 		lwc_string *string, uint32_t *string_number);
 
+void css__string_index_insert(uint32_t *index, uint32_t length,
+		lwc_string *string, uint32_t string_number);
+uint32_t css__string_index_find(const uint32_t *index, uint32_t length,
+		lwc_string *const *strings, lwc_string *string);
+css_error css__string_index_grow(uint32_t **index, uint32_t *length,
+		lwc_string *const *strings, uint32_t count);
+
 #endif
 
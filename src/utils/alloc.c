@@ -0,0 +1,69 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include <stdlib.h>
+
+#include <libcss/computed.h>
+#include <libcss/stylesheet.h>
+
+#include "utils/utils.h"
+#include "utils/alloc.h"
+
+static void *css__default_alloc(void *ptr, size_t size, void *pw)
+{
+	UNUSED(pw);
+
+	if (size == 0) {
+		free(ptr);
+		return NULL;
+	}
+
+	return realloc(ptr, size);
+}
+
+css_allocator_fn css__alloc = css__default_alloc;
+void *css__alloc_pw = NULL;
+
+/**
+ * Set the allocator used for all of libcss's memory
+ *
+ * This must be called before any libcss objects are created, or once all
+ * of them have been destroyed.  Memory passed to libcss by the client, such
+ * as the data of property hints, is freed by libcss, so must be obtained
+ * from the same allocator.
+ *
+ * \param alloc  Allocator to use, or NULL to restore the system allocator
+ * \param pw     Client data for \a alloc
+ * \return CSS_OK on success,
+ *         CSS_INVALID if computed styles are still in use.
+ *
+ * The inline styles retained by the stylesheet cache, and the memory kept
+ * for reuse by computed styles, came from the old allocator.  They are
+ * released, as by css_stylesheet_cache_flush() and
+ * css_computed_style_pool_trim(), before the new allocator is set.
+ */
+css_error css_allocator_set(css_allocator_fn alloc, void *pw)
+{
+	css_computed_alloc_stats stats;
+
+	css_computed_style_alloc_stats(&stats);
+	if (stats.allocs != stats.frees)
+		return CSS_INVALID;
+
+	css_stylesheet_cache_flush();
+	css_computed_style_pool_trim();
+
+	if (alloc == NULL) {
+		css__alloc = css__default_alloc;
+		css__alloc_pw = NULL;
+	} else {
+		css__alloc = alloc;
+		css__alloc_pw = pw;
+	}
+
+	return CSS_OK;
+}
+
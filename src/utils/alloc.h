@@ -0,0 +1,61 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+#ifndef css_utils_alloc_h_
+#define css_utils_alloc_h_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <libcss/functypes.h>
+
+/* Client allocator, set with css_allocator_set */
+extern css_allocator_fn css__alloc;
+extern void *css__alloc_pw;
+
+static inline void *css__malloc(size_t size)
+{
+	return css__alloc(NULL, size, css__alloc_pw);
+}
+
+static inline void *css__calloc(size_t nmemb, size_t size)
+{
+	void *ptr;
+
+	if (size != 0 && nmemb > SIZE_MAX / size)
+		return NULL;
+
+	ptr = css__alloc(NULL, nmemb * size, css__alloc_pw);
+	if (ptr != NULL)
+		memset(ptr, 0, nmemb * size);
+
+	return ptr;
+}
+
+static inline void *css__realloc(void *ptr, size_t size)
+{
+	return css__alloc(ptr, size, css__alloc_pw);
+}
+
+static inline void css__free(void *ptr)
+{
+	if (ptr != NULL)
+		css__alloc(ptr, 0, css__alloc_pw);
+}
+
+static inline char *css__strdup(const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *copy = css__malloc(len);
+
+	if (copy != NULL)
+		memcpy(copy, s, len);
+
+	return copy;
+}
+
+#endif
+
@@ -850,22 +850,24 @@ void dump_bytecode(css_style *style, char **ptr, uint32_t depth)
 				assert(BACKGROUND_IMAGE_NONE ==
 						(enum op_background_image)
 						CUE_AFTER_NONE);
-				assert(BACKGROUND_IMAGE_URI ==
-						(enum op_background_image)
-						CUE_AFTER_URI);
 				assert(BACKGROUND_IMAGE_NONE ==
 						(enum op_background_image)
 						CUE_BEFORE_NONE);
-				assert(BACKGROUND_IMAGE_URI ==
-						(enum op_background_image)
-						CUE_BEFORE_URI);
 				assert(BACKGROUND_IMAGE_NONE ==
 						(enum op_background_image)
 						LIST_STYLE_IMAGE_NONE);
-				assert(BACKGROUND_IMAGE_URI ==
-						(enum op_background_image)
+				assert(CUE_AFTER_URI ==
+						(enum op_cue_after)
+						CUE_BEFORE_URI);
+				assert(CUE_AFTER_URI ==
+						(enum op_cue_after)
 						LIST_STYLE_IMAGE_URI);
 
+				/* Background images have their own URI value */
+				if (op != CSS_PROP_BACKGROUND_IMAGE &&
+						value == CUE_AFTER_URI)
+					value = BACKGROUND_IMAGE_URI;
+
 				switch (value) {
 				case BACKGROUND_IMAGE_NONE:
 					*ptr += sprintf(*ptr, "none");
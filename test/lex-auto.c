@@ -257,30 +257,51 @@ css_token_type string_to_type(const char *data, size_t len)
 		return CSS_TOKEN_EOF;
 }
 
-void run_test(const uint8_t *data, size_t len, exp_entry *exp, size_t explen)
+static void run_test_chunked(const uint8_t *data, size_t len, size_t chunk,
+		exp_entry *exp, size_t explen, int testnum)
 {
 	parserutils_inputstream *input;
 	css_lexer *lexer;
 	css_error error;
 	css_token *tok;
-	size_t e;
-	static int testnum;
+	size_t e, used;
 
 	assert(parserutils_inputstream_create("UTF-8", CSS_CHARSET_DICTATED,
 			css__charset_extract, &input) == PARSERUTILS_OK);
 
 	assert(css__lexer_create(input, &lexer) == CSS_OK);
 
-	assert(parserutils_inputstream_append(input, data, len) == 
-			PARSERUTILS_OK);
+	used = chunk < len ? chunk : len;
 
-	assert(parserutils_inputstream_append(input, NULL, 0) == 
+	assert(parserutils_inputstream_append(input, data, used) == 
 			PARSERUTILS_OK);
 
+	if (used == len) {
+		assert(parserutils_inputstream_append(input, NULL, 0) == 
+				PARSERUTILS_OK);
+	}
+
 	e = 0;
-	testnum++;
 
-	while ((error = css__lexer_get_token(lexer, &tok)) == CSS_OK) {
+	while ((error = css__lexer_get_token(lexer, &tok)) == CSS_OK ||
+			error == CSS_NEEDDATA) {
+		if (error == CSS_NEEDDATA) {
+			size_t n = chunk < len - used ? chunk : len - used;
+
+			assert(used < len);
+
+			assert(parserutils_inputstream_append(input, 
+					data + used, n) == PARSERUTILS_OK);
+			used += n;
+
+			if (used == len) {
+				assert(parserutils_inputstream_append(input, 
+						NULL, 0) == PARSERUTILS_OK);
+			}
+
+			continue;
+		}
+
 		if (tok->type != exp[e].type) {
 			printf("%d: Got token %s, Expected %s [%d, %d]\n",
 				testnum, string_from_type(tok->type), 
@@ -318,6 +339,19 @@ void run_test(const uint8_t *data, size_t len, exp_entry *exp, size_t explen)
 	css__lexer_destroy(lexer);
 
 	parserutils_inputstream_destroy(input);
+}
+
+void run_test(const uint8_t *data, size_t len, exp_entry *exp, size_t explen)
+{
+	static int testnum;
+
+	testnum++;
+
+	/* With all the input available, the lexer consumes runs of input
+	 * in one go.  Fed a byte at a time, it must fall back to reading
+	 * single characters, and must produce the same tokens. */
+	run_test_chunked(data, len, len, exp, explen, testnum);
+	run_test_chunked(data, len, 1, exp, explen, testnum);
 
 	printf("Test %d: PASS\n", testnum);
 }
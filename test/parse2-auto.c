@@ -33,6 +33,9 @@ static bool handle_line(const char *data, size_t datalen, void *pw);
 static void css__parse_expected(line_ctx *ctx, const char *data, size_t len);
 static void run_test(const uint8_t *data, size_t len, 
 		const char *exp, size_t explen);
+static void test_malformed_compiled(void);
+static void test_shared_cache(void);
+static void test_shared_styles(void);
 
 static css_error resolve_url(void *pw,
 		const char *base, lwc_string *rel, lwc_string **abs)
@@ -86,6 +89,10 @@ int main(int argc, char **argv)
 	ctx.inerrors = false;
 	ctx.inexp = false;
 
+	test_malformed_compiled();
+	test_shared_cache();
+	test_shared_styles();
+
 	assert(css__parse_testfile(argv[1], handle_line, &ctx) == true);
 
 	/* and run final test */
@@ -174,6 +181,233 @@ void css__parse_expected(line_ctx *ctx, const char *data, size_t len)
 	ctx->expused += len;
 }
 
+static void init_params(css_stylesheet_params *params)
+{
+	params->params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
+	params->level = CSS_LEVEL_21;
+	params->charset = "UTF-8";
+	params->url = "foo";
+	params->title = NULL;
+	params->allow_quirks = false;
+	params->inline_style = false;
+	params->resolve = resolve_url;
+	params->resolve_pw = NULL;
+	params->import = NULL;
+	params->import_pw = NULL;
+	params->color = NULL;
+	params->color_pw = NULL;
+	params->font = NULL;
+	params->font_pw = NULL;
+}
+
+static uint8_t *compile(const css_stylesheet_params *params,
+		const char *css, size_t *len)
+{
+	css_stylesheet *sheet;
+	uint8_t *compiled;
+
+	assert(css_stylesheet_create_from_buffer(params,
+			(const uint8_t *) css, strlen(css), &sheet) == CSS_OK);
+	assert(css_stylesheet_serialise(sheet, NULL, len) == CSS_OK);
+
+	compiled = malloc(*len);
+	assert(compiled != NULL);
+
+	assert(css_stylesheet_serialise(sheet, compiled, len) == CSS_OK);
+
+	css_stylesheet_destroy(sheet);
+
+	return compiled;
+}
+
+static css_error load_with_word(const css_stylesheet_params *params,
+		const uint8_t *compiled, size_t len, size_t word,
+		uint32_t value)
+{
+	css_stylesheet *sheet;
+	uint8_t *copy;
+	css_error error;
+
+	copy = malloc(len);
+	assert(copy != NULL);
+
+	memcpy(copy, compiled, len);
+	memcpy(copy + word * sizeof(uint32_t), &value, sizeof(value));
+
+	error = css_stylesheet_load_compiled(params, copy, len, &sheet);
+	if (error == CSS_OK) {
+		/* Selecting from the sheet walks all its bytecode */
+		assert(css_stylesheet_optimise(sheet) == CSS_OK);
+		css_stylesheet_destroy(sheet);
+	} else if (error == CSS_IMPORTS_PENDING) {
+		css_stylesheet_destroy(sheet);
+	} else {
+		assert(error == CSS_INVALID);
+	}
+
+	free(copy);
+
+	return error;
+}
+
+/* Truncations of a compiled sheet must be rejected, and corrupting any of
+ * its words must either be rejected or yield a sheet that may be used */
+static void check_compiled(const css_stylesheet_params *params,
+		const uint8_t *compiled, size_t len)
+{
+	css_stylesheet *sheet;
+	size_t word;
+
+	for (word = 0; word < len / sizeof(uint32_t); word++) {
+		uint32_t value;
+
+		assert(css_stylesheet_load_compiled(params, compiled,
+				word * sizeof(uint32_t), &sheet) ==
+				CSS_INVALID);
+
+		memcpy(&value, compiled + word * sizeof(uint32_t),
+				sizeof(value));
+
+		load_with_word(params, compiled, len, word, 0);
+		load_with_word(params, compiled, len, word, value + 1);
+		load_with_word(params, compiled, len, word, 0xffffffff);
+	}
+}
+
+static void test_malformed_compiled(void)
+{
+	const css_code_t image = buildOPV(CSS_PROP_BACKGROUND_IMAGE, 0,
+			BACKGROUND_IMAGE_URI);
+	css_stylesheet_params params;
+	uint32_t header[8];
+	uint8_t *compiled;
+	size_t len, word;
+
+	init_params(&params);
+
+	compiled = compile(&params,
+			"a { background-image: url(x); color: red }", &len);
+	memcpy(header, compiled, sizeof(header));
+
+	for (word = 0; word < len / sizeof(uint32_t); word++) {
+		uint32_t value;
+
+		memcpy(&value, compiled + word * sizeof(uint32_t),
+				sizeof(value));
+		if (value == image)
+			break;
+	}
+	assert(word < len / sizeof(uint32_t));
+
+	/* Unchanged */
+	assert(load_with_word(&params, compiled, len, word,
+			image) == CSS_OK);
+	/* Unknown property */
+	assert(load_with_word(&params, compiled, len, word,
+			buildOPV(CSS_N_PROPERTIES, 0, 0)) == CSS_INVALID);
+	/* Property whose operands overrun the style */
+	assert(load_with_word(&params, compiled, len, word,
+			buildOPV(CSS_PROP_BORDER_SPACING, 0,
+			BORDER_SPACING_SET)) == CSS_INVALID);
+	/* String numbers out of range; header[4] is the highest */
+	assert(load_with_word(&params, compiled, len, word + 1,
+			header[4]) == CSS_OK);
+	assert(load_with_word(&params, compiled, len, word + 1,
+			header[4] + 1) == CSS_INVALID);
+	assert(load_with_word(&params, compiled, len, word + 1,
+			0) == CSS_INVALID);
+	/* Style longer than the rule data */
+	assert(load_with_word(&params, compiled, len, word - 1,
+			len) == CSS_INVALID);
+
+	free(compiled);
+
+	/* Nested @media: header, type, media, count, then child's type */
+	compiled = compile(&params, "@media screen { a { color: red } }",
+			&len);
+	assert(load_with_word(&params, compiled, len, 12,
+			CSS_RULE_SELECTOR) == CSS_OK);
+	assert(load_with_word(&params, compiled, len, 12,
+			CSS_RULE_MEDIA) == CSS_INVALID);
+	free(compiled);
+}
+
+static void test_shared_cache(void)
+{
+	css_stylesheet *sheets[300];
+	css_stylesheet_params params;
+	css_stylesheet *sheet;
+	char css[32];
+	int i;
+
+	init_params(&params);
+
+	/* Bad parameters are rejected before the cache is searched */
+	params.url = NULL;
+	assert(css_stylesheet_create_shared(&params, (const uint8_t *) "",
+			0, &sheet) == CSS_BADPARM);
+	init_params(&params);
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1 + 1;
+	assert(css_stylesheet_create_shared(&params, (const uint8_t *) "",
+			0, &sheet) == CSS_BADPARM);
+	init_params(&params);
+	params.inline_style = true;
+	params.resolve = NULL;
+	assert(css_stylesheet_create_inline(&params, (const uint8_t *) "",
+			0, &sheet) == CSS_BADPARM);
+	init_params(&params);
+
+	/* Enough sheets to grow the cache's table several times */
+	for (i = 0; i < 300; i++) {
+		sprintf(css, "a { z-index: %d }", i);
+		assert(css_stylesheet_create_shared(&params,
+				(const uint8_t *) css, strlen(css),
+				&sheets[i]) == CSS_OK);
+	}
+
+	for (i = 0; i < 300; i++) {
+		sprintf(css, "a { z-index: %d }", i);
+		assert(css_stylesheet_create_shared(&params,
+				(const uint8_t *) css, strlen(css),
+				&sheet) == CSS_OK);
+		assert(sheet == sheets[i]);
+		css_stylesheet_destroy(sheet);
+	}
+
+	for (i = 0; i < 300; i++)
+		css_stylesheet_destroy(sheets[i]);
+}
+
+static size_t sheet_size(const css_stylesheet_params *params, const char *css)
+{
+	css_stylesheet *sheet;
+	size_t size;
+
+	assert(css_stylesheet_create_from_buffer(params,
+			(const uint8_t *) css, strlen(css), &sheet) == CSS_OK);
+	assert(css_stylesheet_size(sheet, &size) == CSS_OK);
+	css_stylesheet_destroy(sheet);
+
+	return size;
+}
+
+static void test_shared_styles(void)
+{
+	css_stylesheet_params params;
+	size_t shared, unshared;
+
+	init_params(&params);
+
+	/* The two sheets differ only in whether the declaration blocks are
+	 * identical.  Identical blocks share their bytecode, of 5 words:
+	 * colour and width OPVs, a colour, and a length and its unit. */
+	shared = sheet_size(&params, "a { color: #f00; width: 1px } "
+			"b { color: #f00; width: 1px }");
+	unshared = sheet_size(&params, "a { color: #f00; width: 1px } "
+			"b { color: #f00; width: 2px }");
+	assert(unshared - shared == 5 * sizeof(uint32_t));
+}
+
 void run_test(const uint8_t *data, size_t len, const char *exp, size_t explen)
 {
 	css_stylesheet_params params;
@@ -181,53 +415,92 @@ void run_test(const uint8_t *data, size_t len, const char *exp, size_t explen)
 	css_error error;
 	char *buf;
 	size_t buflen;
+	int pass;
 	static int testnum;
 
 	buf = malloc(2 * explen);
 	if (buf == NULL) {
 		assert(0 && "No memory for result data");
 	}
-	buflen = 2 * explen;
 	
-	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
-	params.level = CSS_LEVEL_21;
-	params.charset = "UTF-8";
-	params.url = "foo";
-	params.title = NULL;
-	params.allow_quirks = false;
-	params.inline_style = false;
-	params.resolve = resolve_url;
-	params.resolve_pw = NULL;
-	params.import = NULL;
-	params.import_pw = NULL;
-	params.color = NULL;
-	params.color_pw = NULL;
-	params.font = NULL;
-	params.font_pw = NULL;
-
-	assert(css_stylesheet_create(&params, &sheet) == CSS_OK);
-
-	error = css_stylesheet_append_data(sheet, data, len);
-	if (error != CSS_OK && error != CSS_NEEDDATA) {
-		printf("Failed appending data: %d\n", error);
-		assert(0);
-	}
-
-	assert(css_stylesheet_data_done(sheet) == CSS_OK);
+	init_params(&params);
 
 	testnum++;
 
-	dump_sheet(sheet, buf, &buflen);
+	/* Parse the data incrementally, then in one go from a buffer, 
+	 * then reload it from its compiled form, then create it as a 
+	 * shared sheet, then lex it in several threads. 
+	 * All must produce the same sheet. */
+	for (pass = 0; pass < 5; pass++) {
+		if (pass == 0) {
+			assert(css_stylesheet_create(&params, &sheet) == 
+					CSS_OK);
+
+			error = css_stylesheet_append_data(sheet, data, len);
+			if (error != CSS_OK && error != CSS_NEEDDATA) {
+				printf("Failed appending data: %d\n", error);
+				assert(0);
+			}
+
+			assert(css_stylesheet_data_done(sheet) == CSS_OK);
+		} else if (pass == 3) {
+			css_stylesheet *other;
+
+			assert(css_stylesheet_create_shared(&params, 
+					data, len, &sheet) == CSS_OK);
+			assert(css_stylesheet_create_shared(&params, 
+					data, len, &other) == CSS_OK);
+			assert(other == sheet);
+
+			css_stylesheet_destroy(other);
+		} else if (pass == 4) {
+			assert(css_stylesheet_create_parallel(&params, 
+					data, len, 8, &sheet) == CSS_OK);
+		} else {
+			assert(css_stylesheet_create_from_buffer(&params, 
+					data, len, &sheet) == CSS_OK);
+		}
+
+		if (pass == 2) {
+			uint8_t *compiled;
+			size_t compiled_len;
 
-	if (2 * explen - buflen != explen || memcmp(buf, exp, explen) != 0) {
-		printf("Expected (%u):\n%.*s\n", 
-				(int) explen, (int) explen, exp);
-		printf("Result (%u):\n%.*s\n", (int) (2 * explen - buflen),
-			(int) (2 * explen - buflen), buf);
-		assert(0 && "Result doesn't match expected");
-	}
+			assert(css_stylesheet_serialise(sheet, NULL,
+					&compiled_len) == CSS_OK);
 
-	css_stylesheet_destroy(sheet);
+			compiled = malloc(compiled_len);
+			assert(compiled != NULL);
+
+			assert(css_stylesheet_serialise(sheet, compiled,
+					&compiled_len) == CSS_OK);
+
+			css_stylesheet_destroy(sheet);
+
+			check_compiled(&params, compiled, compiled_len);
+
+			assert(css_stylesheet_load_compiled(&params, 
+					compiled, compiled_len, 
+					&sheet) == CSS_OK);
+
+			free(compiled);
+		}
+
+		buflen = 2 * explen;
+
+		dump_sheet(sheet, buf, &buflen);
+
+		if (2 * explen - buflen != explen || 
+				memcmp(buf, exp, explen) != 0) {
+			printf("Expected (%u):\n%.*s\n", 
+					(int) explen, (int) explen, exp);
+			printf("Result (%u):\n%.*s\n", 
+					(int) (2 * explen - buflen),
+					(int) (2 * explen - buflen), buf);
+			assert(0 && "Result doesn't match expected");
+		}
+
+		css_stylesheet_destroy(sheet);
+	}
 
 	free(buf);
 
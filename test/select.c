@@ -65,9 +65,11 @@ typedef struct line_ctx {
 	uint64_t media;
 	uint32_t pseudo_element;
 	node *target;
+	bool lazy_pseudo;
 	
 	lwc_string *attr_class;
 	lwc_string *attr_id;
+	lwc_string *attr_style;
 } line_ctx;
 
 
@@ -77,11 +79,16 @@ static bool handle_line(const char *data, size_t datalen, void *pw);
 static void css__parse_tree(line_ctx *ctx, const char *data, size_t len);
 static void css__parse_tree_data(line_ctx *ctx, const char *data, size_t len);
 static void css__parse_sheet(line_ctx *ctx, const char *data, size_t len);
+static void css__parse_repeat(line_ctx *ctx, const char *data, size_t len);
 static void css__parse_media_list(const char **data, size_t *len, uint64_t *media);
 static void css__parse_pseudo_list(const char **data, size_t *len, 
 		uint32_t *element);
 static void css__parse_expected(line_ctx *ctx, const char *data, size_t len);
 static void run_test(line_ctx *ctx, const char *exp, size_t explen);
+static void run_diff_tests(line_ctx *ctx);
+static void run_memo_tests(line_ctx *ctx);
+static void run_compiled_tests(line_ctx *ctx);
+static void destroy_results(node *root);
 static void destroy_tree(node *root);
 
 static css_error node_name(void *pw, void *node,
@@ -231,6 +238,32 @@ printing_lwc_iterator(lwc_string *str, void *pw)
 	fail_because_lwc_leaked = true;
 }
 
+static uint32_t live_allocations = 0;
+static uint32_t total_allocations = 0;
+
+static void *counting_alloc(void *ptr, size_t size, void *pw)
+{
+	UNUSED(pw);
+
+	if (size == 0) {
+		if (ptr != NULL)
+			live_allocations--;
+		free(ptr);
+		return NULL;
+	}
+
+	if (ptr == NULL) {
+		ptr = malloc(size);
+		if (ptr != NULL) {
+			live_allocations++;
+			total_allocations++;
+		}
+		return ptr;
+	}
+
+	return realloc(ptr, size);
+}
+
 int main(int argc, char **argv)
 {
 	line_ctx ctx;
@@ -242,10 +275,16 @@ int main(int argc, char **argv)
 
 	memset(&ctx, 0, sizeof(ctx));
 
+	assert(css_allocator_set(counting_alloc, NULL) == CSS_OK);
 
 	lwc_intern_string("class", SLEN("class"), &ctx.attr_class);
 	lwc_intern_string("id", SLEN("id"), &ctx.attr_id);
+	lwc_intern_string("style", SLEN("style"), &ctx.attr_style);
 	
+	run_memo_tests(&ctx);
+	run_compiled_tests(&ctx);
+	run_diff_tests(&ctx);
+
 	assert(css__parse_testfile(argv[1], handle_line, &ctx) == true);
 	
 	/* and run final test */
@@ -256,10 +295,17 @@ int main(int argc, char **argv)
 	
 	lwc_string_unref(ctx.attr_class);
 	lwc_string_unref(ctx.attr_id);
+	lwc_string_unref(ctx.attr_style);
 	
 	lwc_iterate_strings(printing_lwc_iterator, NULL);
 	
 	assert(fail_because_lwc_leaked == false);
+
+	if (live_allocations != 0) {
+		printf("%u of %u allocations leaked\n",
+				live_allocations, total_allocations);
+	}
+	assert(live_allocations == 0);
 	
 	printf("PASS\n");
 	return 0;
@@ -296,6 +342,8 @@ bool handle_line(const char *data, size_t datalen, void *pw)
 				ctx->insheet = false;
 				ctx->inerrors = true;
 				ctx->inexp = false;
+			} else if (strncasecmp(data+1, "repeat", 6) == 0) {
+				css__parse_repeat(ctx, data + 7, datalen - 7);
 			} else if (strncasecmp(data+1, "ua", 2) == 0 ||
 					strncasecmp(data+1, "user", 4) == 0 ||
 					strncasecmp(data+1, "author", 6) == 0) {
@@ -579,6 +627,56 @@ void css__parse_sheet(line_ctx *ctx, const char *data, size_t len)
 	ctx->n_sheets++;
 }
 
+void css__parse_repeat(line_ctx *ctx, const char *data, size_t len)
+{
+	char format[256];
+	char buf[300];
+	unsigned long count, i;
+	char *p;
+
+	/* <count> ' ' <format>
+	 *
+	 * Appends the format to the current sheet count times.  Each %lu in
+	 * the format is replaced by the repetition number, counting from 0;
+	 * everything else, including any other %, is copied literally.
+	 */
+
+	assert(len < sizeof(format));
+	memcpy(format, data, len);
+	format[len] = '\0';
+
+	count = strtoul(format, &p, 10);
+	assert(p != format && *p == ' ');
+	p++;
+
+	for (i = 0; i < count; i++) {
+		const char *f = p;
+		css_error error;
+		size_t n = 0;
+
+		while (*f != '\0') {
+			if (strncmp(f, "%lu", 3) == 0) {
+				int l = snprintf(buf + n, sizeof(buf) - n,
+						"%lu", i);
+
+				assert(l > 0 && (size_t) l < sizeof(buf) - n);
+				n += l;
+				f += 3;
+			} else {
+				assert(n + 1 < sizeof(buf));
+				buf[n++] = *f++;
+			}
+		}
+
+		assert(n > 0);
+
+		error = css_stylesheet_append_data(
+				ctx->sheets[ctx->n_sheets - 1].sheet, 
+				(const uint8_t *) buf, n);
+		assert(error == CSS_OK || error == CSS_NEEDDATA);
+	}
+}
+
 void css__parse_media_list(const char **data, size_t *len, uint64_t *media)
 {
 	const char *p = *data;
@@ -758,15 +856,206 @@ static void show_differences(size_t len, const char *exp, const char *res)
 }
 
 
+static css_stylesheet *create_inline_style(node *node, line_ctx *ctx)
+{
+	css_stylesheet_params params;
+	css_stylesheet *sheet, *other;
+	uint32_t i;
+
+	for (i = 0; i < node->n_attrs; i++) {
+		bool amatch = false;
+
+		assert(lwc_string_caseless_isequal(node->attrs[i].name,
+				ctx->attr_style, &amatch) == lwc_error_ok);
+		if (amatch == true)
+			break;
+	}
+
+	if (i == node->n_attrs)
+		return NULL;
+
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
+	params.level = CSS_LEVEL_21;
+	params.charset = "UTF-8";
+	params.url = "foo";
+	params.title = NULL;
+	params.allow_quirks = false;
+	params.inline_style = true;
+	params.resolve = resolve_url;
+	params.resolve_pw = NULL;
+	params.import = NULL;
+	params.import_pw = NULL;
+	params.color = NULL;
+	params.color_pw = NULL;
+	params.font = NULL;
+	params.font_pw = NULL;
+
+	assert(css_stylesheet_create_inline(&params,
+			(const uint8_t *) lwc_string_data(node->attrs[i].value),
+			lwc_string_length(node->attrs[i].value),
+			&sheet) == CSS_OK);
+
+	/* The same attribute value gives the same sheet */
+	assert(css_stylesheet_create_inline(&params,
+			(const uint8_t *) lwc_string_data(node->attrs[i].value),
+			lwc_string_length(node->attrs[i].value),
+			&other) == CSS_OK);
+	assert(other == sheet);
+	css_stylesheet_destroy(other);
+
+	return sheet;
+}
+
+/**
+ * Check a style's layout snapshot against the property accessors
+ *
+ * \param style   Style to check
+ * \param parent  Style of the node's parent, or NULL for the root
+ */
+static void check_layout_snapshot(const css_computed_style *style,
+		const css_computed_style *parent)
+{
+	const css_computed_style *styles[3];
+	css_computed_layout layout, batch[3];
+
+#define CHECK_LENGTH(l, get)						\
+	do {								\
+		css_fixed value = 0;					\
+		css_unit unit = CSS_UNIT_PX;				\
+		uint8_t type = get(style, &value, &unit);		\
+									\
+		assert((l).type == type && (l).value == value &&	\
+				(l).unit == unit);			\
+	} while (0)
+
+	assert(css_computed_layout_snapshot(style, false, &layout) == CSS_OK);
+
+	CHECK_LENGTH(layout.width, css_computed_width);
+	CHECK_LENGTH(layout.height, css_computed_height);
+	CHECK_LENGTH(layout.min_width, css_computed_min_width);
+	CHECK_LENGTH(layout.min_height, css_computed_min_height);
+	CHECK_LENGTH(layout.max_width, css_computed_max_width);
+	CHECK_LENGTH(layout.max_height, css_computed_max_height);
+
+	CHECK_LENGTH(layout.offset[0], css_computed_top);
+	CHECK_LENGTH(layout.offset[1], css_computed_right);
+	CHECK_LENGTH(layout.offset[2], css_computed_bottom);
+	CHECK_LENGTH(layout.offset[3], css_computed_left);
+
+	CHECK_LENGTH(layout.margin[0], css_computed_margin_top);
+	CHECK_LENGTH(layout.margin[1], css_computed_margin_right);
+	CHECK_LENGTH(layout.margin[2], css_computed_margin_bottom);
+	CHECK_LENGTH(layout.margin[3], css_computed_margin_left);
+
+	CHECK_LENGTH(layout.padding[0], css_computed_padding_top);
+	CHECK_LENGTH(layout.padding[1], css_computed_padding_right);
+	CHECK_LENGTH(layout.padding[2], css_computed_padding_bottom);
+	CHECK_LENGTH(layout.padding[3], css_computed_padding_left);
+
+	CHECK_LENGTH(layout.border_width[0], css_computed_border_top_width);
+	CHECK_LENGTH(layout.border_width[1], css_computed_border_right_width);
+	CHECK_LENGTH(layout.border_width[2], css_computed_border_bottom_width);
+	CHECK_LENGTH(layout.border_width[3], css_computed_border_left_width);
+
+#undef CHECK_LENGTH
+
+	{
+		int32_t grow = 0, shrink = 0, basis = 0;
+
+		assert(layout.flex_grow_type ==
+				css_computed_flex_grow(style, &grow) &&
+				layout.flex_grow == grow);
+		assert(layout.flex_shrink_type ==
+				css_computed_flex_shrink(style, &shrink) &&
+				layout.flex_shrink == shrink);
+		assert(layout.flex_basis_type ==
+				css_computed_flex_basis(style, &basis) &&
+				layout.flex_basis == basis);
+	}
+
+	assert(layout.flex_direction == css_computed_flex_direction(style));
+	assert(layout.flex_wrap == css_computed_flex_wrap(style));
+	assert(layout.justify_content == css_computed_justify_content(style));
+	assert(layout.align_content == css_computed_align_content(style));
+	assert(layout.align_items == css_computed_align_items(style));
+	assert(layout.align_self == css_computed_align_self(style));
+
+	assert(layout.border_style[0] == css_computed_border_top_style(style));
+	assert(layout.border_style[1] ==
+			css_computed_border_right_style(style));
+	assert(layout.border_style[2] ==
+			css_computed_border_bottom_style(style));
+	assert(layout.border_style[3] ==
+			css_computed_border_left_style(style));
+
+	assert(layout.display == css_computed_display(style, false));
+	assert(layout.position == css_computed_position(style));
+	assert(layout.floating == css_computed_float(style));
+	assert(layout.clear == css_computed_clear(style));
+	assert(layout.overflow_x == css_computed_overflow_x(style));
+	assert(layout.overflow_y == css_computed_overflow_y(style));
+	assert(layout.direction == css_computed_direction(style));
+	assert(layout.writing_mode == css_computed_writing_mode(style));
+
+	/* Only display differs for the root, and a repeated snapshot, which
+	 * may come from the style's cache, is the same as the first */
+	assert(css_computed_layout_snapshot(style, true, &batch[0]) == CSS_OK);
+	assert(batch[0].display == css_computed_display(style, true));
+	batch[0].display = layout.display;
+	assert(memcmp(&batch[0], &layout, sizeof(layout)) == 0);
+
+	/* A batch gives the same snapshots, including for runs of a style */
+	styles[0] = parent != NULL ? parent : style;
+	styles[1] = style;
+	styles[2] = style;
+	assert(css_computed_layout_snapshot_batch(styles, 3, batch) == CSS_OK);
+	assert(memcmp(&batch[1], &layout, sizeof(layout)) == 0);
+	assert(memcmp(&batch[2], &layout, sizeof(layout)) == 0);
+	if (parent != NULL) {
+		assert(css_computed_layout_snapshot(parent, false,
+				&layout) == CSS_OK);
+		assert(memcmp(&batch[0], &layout, sizeof(layout)) == 0);
+	}
+}
+
 static void run_test_select_tree(css_select_ctx *select,
 		node *node, line_ctx *ctx,
 		char *buf, size_t *buflen)
 {
 	css_select_results *sr;
+	css_stylesheet *inline_style;
 	struct node *n = NULL;
 
-	assert(css_select_style(select, node, ctx->media, NULL, 
-			&select_handler, ctx, &sr) == CSS_OK);
+	/* Inline styles are destroyed straight after selection, and must be 
+	 * found again in the inline style cache. */
+	inline_style = create_inline_style(node, ctx);
+
+	if (ctx->lazy_pseudo == false) {
+		assert(css_select_style(select, node, ctx->media,
+				inline_style, &select_handler, ctx,
+				&sr) == CSS_OK);
+	} else {
+		/* Select the element alone, then its pseudo element */
+		assert(css_select_style_pseudo_elements(select, node,
+				ctx->media, inline_style, 0,
+				&select_handler, ctx, &sr) == CSS_OK);
+
+		if (ctx->pseudo_element != CSS_PSEUDO_ELEMENT_NONE) {
+			if (sr->styles[ctx->pseudo_element] != NULL) {
+				css_computed_style_destroy(
+					sr->styles[ctx->pseudo_element]);
+			}
+
+			assert(css_select_pseudo_element(select, node,
+					ctx->media, ctx->pseudo_element,
+					&select_handler, ctx,
+					&sr->styles[ctx->pseudo_element]) ==
+					CSS_OK);
+		}
+	}
+
+	if (inline_style != NULL)
+		css_stylesheet_destroy(inline_style);
 
 	if (node->parent != NULL) {
 		css_computed_style *composed;
@@ -781,6 +1070,10 @@ static void run_test_select_tree(css_select_ctx *select,
 
 	node->sr = sr;
 
+	check_layout_snapshot(sr->styles[ctx->pseudo_element],
+			node->parent != NULL ?
+			node->parent->sr->styles[ctx->pseudo_element] : NULL);
+
 	if (node == ctx->target) {
 		dump_computed_style(sr->styles[ctx->pseudo_element],
 				buf, buflen);
@@ -797,6 +1090,7 @@ void run_test(line_ctx *ctx, const char *exp, size_t explen)
 	css_select_ctx *select;
 	css_select_results *results;
 	uint32_t i;
+	int pass;
 	char *buf;
 	size_t buflen;
 	static int testnum;
@@ -809,40 +1103,73 @@ void run_test(line_ctx *ctx, const char *exp, size_t explen)
 	}
 	buflen = 8192;
 
-	assert(css_select_ctx_create(&select) == CSS_OK);
+	testnum++;
 
-	for (i = 0; i < ctx->n_sheets; i++) {
-		assert(css_select_ctx_append_sheet(select, 
-				ctx->sheets[i].sheet, ctx->sheets[i].origin,
-				ctx->sheets[i].media) == CSS_OK);
-	}
+	/* The second pass repeats the test unchanged.  Styles cascaded
+	 * before are now cascaded from their pre-decoded form, which must
+	 * give the same result, as must the third pass, with optimised
+	 * sheets, and the fourth, which selects any pseudo element
+	 * separately */
+	for (pass = 0; pass < 4; pass++) {
+		if (pass > 0)
+			destroy_results(ctx->tree);
+
+		if (pass == 2) {
+			for (i = 0; i < ctx->n_sheets; i++) {
+				assert(css_stylesheet_optimise(
+						ctx->sheets[i].sheet) ==
+						CSS_OK);
+			}
+		}
 
-	testnum++;
+		ctx->lazy_pseudo = (pass == 3);
+
+		buflen = 8192;
 
-	run_test_select_tree(select, ctx->tree, ctx, buf, &buflen);
+		assert(css_select_ctx_create(&select) == CSS_OK);
 
-	results = ctx->target->sr;
-	assert(results->styles[ctx->pseudo_element] != NULL);
+		for (i = 0; i < ctx->n_sheets; i++) {
+			assert(css_select_ctx_append_sheet(select, 
+					ctx->sheets[i].sheet,
+					ctx->sheets[i].origin,
+					ctx->sheets[i].media) == CSS_OK);
+		}
 
-	if (8192 - buflen != explen || memcmp(buf, exp, explen) != 0) {
-		size_t len = 8192 - buflen < explen ? 8192 - buflen : explen;
-		printf("Expected (%u):\n%.*s\n", 
-				(int) explen, (int) explen, exp);
-		printf("Result (%u):\n%.*s\n", (int) (8192 - buflen),
-			(int) (8192 - buflen), buf);
+		run_test_select_tree(select, ctx->tree, ctx, buf, &buflen);
+
+		results = ctx->target->sr;
+		assert(results->styles[ctx->pseudo_element] != NULL);
+
+		if (8192 - buflen != explen ||
+				memcmp(buf, exp, explen) != 0) {
+			size_t len = 8192 - buflen < explen ?
+					8192 - buflen : explen;
+			printf("Expected (%u):\n%.*s\n", 
+					(int) explen, (int) explen, exp);
+			printf("Result (%u)%s:\n%.*s\n",
+					(int) (8192 - buflen),
+					pass == 3 ? ", lazy" :
+					pass == 2 ? ", optimised" :
+					pass == 1 ? ", decoded" : "",
+					(int) (8192 - buflen), buf);
+
+			show_differences(len, exp, buf);
+			assert(0 && "Result doesn't match expected");
+		}
 
-		show_differences(len, exp, buf);
-		assert(0 && "Result doesn't match expected");
+		css_select_ctx_destroy(select);
 	}
 
 	/* Clean up */
-	css_select_ctx_destroy(select);
 	destroy_tree(ctx->tree);
 
 	for (i = 0; i < ctx->n_sheets; i++) {
 		css_stylesheet_destroy(ctx->sheets[i].sheet);
 	}
 
+	css_stylesheet_cache_flush();
+	css_computed_style_pool_trim();
+
 	ctx->tree = NULL;
 	ctx->current = NULL;
 	ctx->depth = 0;
@@ -856,6 +1183,450 @@ void run_test(line_ctx *ctx, const char *exp, size_t explen)
 	printf("Test %d: PASS\n", testnum);
 }
 
+/**
+ * Single property changes, and the change classes each must produce
+ */
+static const struct diff_test {
+	const char *decl;
+	uint32_t changes;
+} diff_tests[] = {
+	{ "", CSS_COMPUTED_CHANGE_NONE },
+	{ "width: 10px", CSS_COMPUTED_CHANGE_LAYOUT },
+	{ "display: block", CSS_COMPUTED_CHANGE_LAYOUT },
+	{ "background-color: #f00", CSS_COMPUTED_CHANGE_PAINT },
+	{ "z-index: 3", CSS_COMPUTED_CHANGE_PAINT },
+	{ "opacity: 0.5", CSS_COMPUTED_CHANGE_PAINT },
+	{ "color: #f00",
+		CSS_COMPUTED_CHANGE_PAINT | CSS_COMPUTED_CHANGE_INHERITED },
+	{ "list-style-image: url(a.png)",
+		CSS_COMPUTED_CHANGE_PAINT | CSS_COMPUTED_CHANGE_INHERITED },
+	{ "text-indent: 2px",
+		CSS_COMPUTED_CHANGE_TEXT | CSS_COMPUTED_CHANGE_INHERITED },
+	{ "font-family: serif",
+		CSS_COMPUTED_CHANGE_TEXT | CSS_COMPUTED_CHANGE_INHERITED },
+	{ "letter-spacing: 2px",
+		CSS_COMPUTED_CHANGE_TEXT | CSS_COMPUTED_CHANGE_INHERITED },
+	{ "content: \"x\"", CSS_COMPUTED_CHANGE_TEXT },
+	{ "counter-reset: x", CSS_COMPUTED_CHANGE_TEXT },
+	{ "orphans: 3",
+		CSS_COMPUTED_CHANGE_LAYOUT | CSS_COMPUTED_CHANGE_INHERITED },
+	{ "flex-grow: 2", CSS_COMPUTED_CHANGE_LAYOUT },
+	{ "border-top-left-radius: 2px", CSS_COMPUTED_CHANGE_PAINT }
+};
+
+static css_select_results *select_diff_test(line_ctx *ctx, node *n,
+		const char *decl)
+{
+	css_stylesheet_params params;
+	css_stylesheet *sheet;
+	css_select_ctx *select;
+	css_select_results *sr;
+	char buf[128];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "div { %s }", decl);
+	assert(len > 0 && (size_t) len < sizeof(buf));
+
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
+	params.level = CSS_LEVEL_21;
+	params.charset = "UTF-8";
+	params.url = "foo";
+	params.title = NULL;
+	params.allow_quirks = false;
+	params.inline_style = false;
+	params.resolve = resolve_url;
+	params.resolve_pw = NULL;
+	params.import = NULL;
+	params.import_pw = NULL;
+	params.color = NULL;
+	params.color_pw = NULL;
+	params.font = NULL;
+	params.font_pw = NULL;
+
+	assert(css_stylesheet_create_from_buffer(&params,
+			(const uint8_t *) buf, len, &sheet) == CSS_OK);
+
+	assert(css_select_ctx_create(&select) == CSS_OK);
+	assert(css_select_ctx_append_sheet(select, sheet, CSS_ORIGIN_AUTHOR,
+			CSS_MEDIA_ALL) == CSS_OK);
+
+	assert(css_select_style(select, n, CSS_MEDIA_SCREEN, NULL,
+			&select_handler, ctx, &sr) == CSS_OK);
+
+	if (n->libcss_node_data != NULL) {
+		css_libcss_node_data_handler(&select_handler, CSS_NODE_DELETED,
+				NULL, n, NULL, n->libcss_node_data);
+		n->libcss_node_data = NULL;
+	}
+
+	css_select_ctx_destroy(select);
+	css_stylesheet_destroy(sheet);
+
+	return sr;
+}
+
+/**
+ * Check that changing a single property changes exactly the expected
+ * classes reported by css_computed_style_diff
+ */
+void run_diff_tests(line_ctx *ctx)
+{
+	css_select_results *base, *sr;
+	css_computed_alloc_stats stats;
+	uint32_t changes;
+	node n;
+	size_t i;
+
+	memset(&n, 0, sizeof(n));
+	assert(lwc_intern_string("div", SLEN("div"), &n.name) ==
+			lwc_error_ok);
+
+	base = select_diff_test(ctx, &n, "");
+
+	for (i = 0; i < sizeof(diff_tests) / sizeof(diff_tests[0]); i++) {
+		sr = select_diff_test(ctx, &n, diff_tests[i].decl);
+
+		assert(css_computed_style_diff(
+				base->styles[CSS_PSEUDO_ELEMENT_NONE],
+				sr->styles[CSS_PSEUDO_ELEMENT_NONE],
+				&changes) == CSS_OK);
+		if (changes != diff_tests[i].changes) {
+			printf("Diff for \"%s\": expected 0x%x, got 0x%x\n",
+					diff_tests[i].decl,
+					diff_tests[i].changes, changes);
+			assert(0 && "Style diff doesn't match expected");
+		}
+
+		/* The difference is the same in the other direction */
+		assert(css_computed_style_diff(
+				sr->styles[CSS_PSEUDO_ELEMENT_NONE],
+				base->styles[CSS_PSEUDO_ELEMENT_NONE],
+				&changes) == CSS_OK);
+		assert(changes == diff_tests[i].changes);
+
+		css_select_results_destroy(sr);
+	}
+
+	/* The allocator can't change while styles from it are in use */
+	assert(css_allocator_set(counting_alloc, NULL) == CSS_INVALID);
+
+	css_select_results_destroy(base);
+
+	/* With every style destroyed, the pools keep a slab for reuse until
+	 * they are trimmed */
+	assert(css_computed_style_alloc_stats(&stats) == CSS_OK);
+	assert(stats.slabs > 0);
+
+	assert(css_stylesheet_cache_flush() == CSS_OK);
+	assert(css_computed_style_alloc_stats(&stats) == CSS_OK);
+	assert(stats.slabs > 0);
+
+	assert(css_computed_style_pool_trim() == CSS_OK);
+	assert(css_computed_style_alloc_stats(&stats) == CSS_OK);
+	assert(stats.slabs == 0 && stats.slab_bytes == 0);
+
+	/* Setting an allocator releases the slabs kept from the old one */
+	css_select_results_destroy(select_diff_test(ctx, &n, ""));
+	assert(css_computed_style_alloc_stats(&stats) == CSS_OK);
+	assert(stats.slabs > 0);
+
+	assert(css_allocator_set(counting_alloc, NULL) == CSS_OK);
+	assert(css_computed_style_alloc_stats(&stats) == CSS_OK);
+	assert(stats.slabs == 0 && stats.slab_bytes == 0);
+
+	lwc_string_unref(n.name);
+}
+
+/**
+ * Select for a node of run_memo_tests, replacing any data it has
+ */
+static css_select_results *select_memo_test(line_ctx *ctx,
+		css_select_ctx *select, node *n)
+{
+	css_select_results *sr;
+
+	if (n->libcss_node_data != NULL) {
+		css_libcss_node_data_handler(&select_handler, CSS_NODE_DELETED,
+				NULL, n, NULL, n->libcss_node_data);
+		n->libcss_node_data = NULL;
+	}
+
+	assert(css_select_style(select, n, CSS_MEDIA_SCREEN, NULL,
+			&select_handler, ctx, &sr) == CSS_OK);
+
+	return sr;
+}
+
+/**
+ * Select for the innermost node of run_memo_tests, first selecting for its
+ * ancestors if they are to have memos, and check the result against another
+ */
+static void check_memo_test(line_ctx *ctx, css_select_ctx *select,
+		node *n, bool memos, const css_select_results *expected)
+{
+	css_select_results *ancestors[2], *sr;
+	uint32_t changes;
+	int i;
+
+	ancestors[0] = select_memo_test(ctx, select, n->parent->parent);
+	ancestors[1] = select_memo_test(ctx, select, n->parent);
+
+	if (memos == false) {
+		css_libcss_node_data_handler(&select_handler, CSS_NODE_DELETED,
+				NULL, n->parent->parent, NULL,
+				n->parent->parent->libcss_node_data);
+		n->parent->parent->libcss_node_data = NULL;
+		css_libcss_node_data_handler(&select_handler, CSS_NODE_DELETED,
+				NULL, n->parent, NULL,
+				n->parent->libcss_node_data);
+		n->parent->libcss_node_data = NULL;
+	}
+
+	/* A second selection uses whatever the first left in the memos */
+	for (i = 0; i < 2; i++) {
+		sr = select_memo_test(ctx, select, n);
+		assert(css_computed_style_diff(
+				expected->styles[CSS_PSEUDO_ELEMENT_NONE],
+				sr->styles[CSS_PSEUDO_ELEMENT_NONE],
+				&changes) == CSS_OK);
+		assert(changes == 0);
+		css_select_results_destroy(sr);
+	}
+
+	css_select_results_destroy(ancestors[0]);
+	css_select_results_destroy(ancestors[1]);
+}
+
+/**
+ * Check that the memos of a node's ancestors give the same result as
+ * matching them afresh, and are discarded when an ancestor is modified
+ */
+void run_memo_tests(line_ctx *ctx)
+{
+	static const char data[] =
+			".a span { width: 1px; } .b span { width: 2px; } "
+			"div:not(.a) p span { height: 3px; }";
+	css_stylesheet_params params;
+	css_stylesheet *sheet;
+	css_select_ctx *select;
+	css_select_results *sr;
+	css_fixed length;
+	css_unit unit;
+	attribute attr;
+	node div, p, span;
+
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
+	params.level = CSS_LEVEL_21;
+	params.charset = "UTF-8";
+	params.url = "foo";
+	params.title = NULL;
+	params.allow_quirks = false;
+	params.inline_style = false;
+	params.resolve = resolve_url;
+	params.resolve_pw = NULL;
+	params.import = NULL;
+	params.import_pw = NULL;
+	params.color = NULL;
+	params.color_pw = NULL;
+	params.font = NULL;
+	params.font_pw = NULL;
+
+	assert(css_stylesheet_create_from_buffer(&params,
+			(const uint8_t *) data, SLEN(data), &sheet) == CSS_OK);
+
+	assert(css_select_ctx_create(&select) == CSS_OK);
+	assert(css_select_ctx_append_sheet(select, sheet, CSS_ORIGIN_AUTHOR,
+			CSS_MEDIA_ALL) == CSS_OK);
+
+	/* <div class="a"><p><span> */
+	memset(&div, 0, sizeof(div));
+	memset(&p, 0, sizeof(p));
+	memset(&span, 0, sizeof(span));
+	assert(lwc_intern_string("div", SLEN("div"), &div.name) ==
+			lwc_error_ok);
+	assert(lwc_intern_string("p", SLEN("p"), &p.name) == lwc_error_ok);
+	assert(lwc_intern_string("span", SLEN("span"), &span.name) ==
+			lwc_error_ok);
+	attr.name = lwc_string_ref(ctx->attr_class);
+	assert(lwc_intern_string("a", SLEN("a"), &attr.value) ==
+			lwc_error_ok);
+	div.attrs = &attr;
+	div.n_attrs = 1;
+	div.classes = &attr.value;
+	div.n_classes = 1;
+	p.parent = &div;
+	span.parent = &p;
+
+	/* The ancestors have no data yet, so no memos are used */
+	sr = select_memo_test(ctx, select, &span);
+	assert(css_computed_width(sr->styles[CSS_PSEUDO_ELEMENT_NONE],
+			&length, &unit) == CSS_WIDTH_SET &&
+			length == INTTOFIX(1) && unit == CSS_UNIT_PX);
+	assert(css_computed_height(sr->styles[CSS_PSEUDO_ELEMENT_NONE],
+			&length, &unit) == CSS_HEIGHT_AUTO);
+	check_memo_test(ctx, select, &span, true, sr);
+	css_select_results_destroy(sr);
+
+	/* Changing the div's class is reported for it and its descendants,
+	 * taking the memos made for the old class with the node data */
+	lwc_string_unref(attr.value);
+	assert(lwc_intern_string("b", SLEN("b"), &attr.value) ==
+			lwc_error_ok);
+	assert(css_libcss_node_data_handler(&select_handler,
+			CSS_NODE_MODIFIED, ctx, &div, NULL,
+			div.libcss_node_data) == CSS_OK);
+	assert(css_libcss_node_data_handler(&select_handler,
+			CSS_NODE_ANCESTORS_MODIFIED, ctx, &p, NULL,
+			p.libcss_node_data) == CSS_OK);
+	assert(css_libcss_node_data_handler(&select_handler,
+			CSS_NODE_ANCESTORS_MODIFIED, ctx, &span, NULL,
+			span.libcss_node_data) == CSS_OK);
+	assert(div.libcss_node_data == NULL);
+
+	sr = select_memo_test(ctx, select, &span);
+	assert(css_computed_width(sr->styles[CSS_PSEUDO_ELEMENT_NONE],
+			&length, &unit) == CSS_WIDTH_SET &&
+			length == INTTOFIX(2) && unit == CSS_UNIT_PX);
+	assert(css_computed_height(sr->styles[CSS_PSEUDO_ELEMENT_NONE],
+			&length, &unit) == CSS_HEIGHT_SET &&
+			length == INTTOFIX(3) && unit == CSS_UNIT_PX);
+	check_memo_test(ctx, select, &span, true, sr);
+	check_memo_test(ctx, select, &span, false, sr);
+	css_select_results_destroy(sr);
+
+	destroy_results(&span);
+	destroy_results(&p);
+	destroy_results(&div);
+
+	lwc_string_unref(attr.name);
+	lwc_string_unref(attr.value);
+	lwc_string_unref(div.name);
+	lwc_string_unref(p.name);
+	lwc_string_unref(span.name);
+
+	css_select_ctx_destroy(select);
+	css_stylesheet_destroy(sheet);
+}
+
+/**
+ * Check that a sheet loaded from its compiled form is selected from as
+ * the sheet it was compiled from
+ *
+ * The sheet has more strings than there are properties, so a cascade
+ * handler which leaves a string number unread makes selection go wrong.
+ */
+void run_compiled_tests(line_ctx *ctx)
+{
+	static const char rules[] =
+			"ul { list-style-image: url(a.png); cue-after: url(b); "
+			"cue-before: url(c); color: #f00; width: 3px } "
+			"ul { cue-after: none !important; height: 4px }";
+	css_stylesheet_params params;
+	css_stylesheet *sheet;
+	css_select_ctx *select;
+	css_select_results *sr;
+	const css_computed_style *style;
+	css_color color;
+	css_fixed length;
+	css_unit unit;
+	lwc_string *url;
+	uint8_t *compiled;
+	size_t len, used = 0;
+	char *css;
+	node ul;
+	int i;
+
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
+	params.level = CSS_LEVEL_21;
+	params.charset = "UTF-8";
+	params.url = "foo";
+	params.title = NULL;
+	params.allow_quirks = false;
+	params.inline_style = false;
+	params.resolve = resolve_url;
+	params.resolve_pw = NULL;
+	params.import = NULL;
+	params.import_pw = NULL;
+	params.color = NULL;
+	params.color_pw = NULL;
+	params.font = NULL;
+	params.font_pw = NULL;
+
+	len = 300 * 32 + sizeof(rules);
+	css = malloc(len);
+	assert(css != NULL);
+
+	for (i = 0; i < 300; i++) {
+		used += snprintf(css + used, len - used,
+				".c%d { font-family: f%d } ", i, i);
+	}
+	memcpy(css + used, rules, sizeof(rules));
+	used += SLEN(rules);
+
+	assert(css_stylesheet_create_from_buffer(&params,
+			(const uint8_t *) css, used, &sheet) == CSS_OK);
+	free(css);
+
+	assert(css_stylesheet_serialise(sheet, NULL, &len) == CSS_OK);
+	compiled = malloc(len);
+	assert(compiled != NULL);
+	assert(css_stylesheet_serialise(sheet, compiled, &len) == CSS_OK);
+	css_stylesheet_destroy(sheet);
+
+	assert(css_stylesheet_load_compiled(&params, compiled, len,
+			&sheet) == CSS_OK);
+	free(compiled);
+
+	assert(css_select_ctx_create(&select) == CSS_OK);
+	assert(css_select_ctx_append_sheet(select, sheet, CSS_ORIGIN_AUTHOR,
+			CSS_MEDIA_ALL) == CSS_OK);
+
+	memset(&ul, 0, sizeof(ul));
+	assert(lwc_intern_string("ul", SLEN("ul"), &ul.name) ==
+			lwc_error_ok);
+
+	assert(css_select_style(select, &ul, CSS_MEDIA_SCREEN, NULL,
+			&select_handler, ctx, &sr) == CSS_OK);
+	style = sr->styles[CSS_PSEUDO_ELEMENT_NONE];
+
+	assert(css_computed_list_style_image(style, &url) ==
+			CSS_LIST_STYLE_IMAGE_URI && url != NULL &&
+			lwc_string_length(url) == SLEN("a.png") &&
+			memcmp(lwc_string_data(url), "a.png",
+				SLEN("a.png")) == 0);
+	assert(css_computed_color(style, &color) == CSS_COLOR_COLOR &&
+			color == 0xffff0000);
+	assert(css_computed_width(style, &length, &unit) == CSS_WIDTH_SET &&
+			length == INTTOFIX(3) && unit == CSS_UNIT_PX);
+	assert(css_computed_height(style, &length, &unit) ==
+			CSS_HEIGHT_SET &&
+			length == INTTOFIX(4) && unit == CSS_UNIT_PX);
+
+	css_select_results_destroy(sr);
+	destroy_results(&ul);
+	lwc_string_unref(ul.name);
+
+	css_select_ctx_destroy(select);
+	css_stylesheet_destroy(sheet);
+}
+
+void destroy_results(node *root)
+{
+	node *n;
+
+	for (n = root->children; n != NULL; n = n->next)
+		destroy_results(n);
+
+	css_select_results_destroy(root->sr);
+	root->sr = NULL;
+
+	if (root->libcss_node_data != NULL) {
+		css_libcss_node_data_handler(&select_handler, CSS_NODE_DELETED,
+				NULL, root, NULL, root->libcss_node_data);
+		root->libcss_node_data = NULL;
+	}
+}
+
 void destroy_tree(node *root)
 {
 	node *n, *p;